@@ -75,6 +75,20 @@ uint32_t switch_get_state(uint32_t mask)
   return myGpio_read_value(&gpio_switch) & mask;
 }
 
+/**
+ * @brief Restituisce le interruzioni pendenti senza effettuarne l'acknowledge.
+ *
+ * @return Maschera di bit degli switch che hanno un'interruzione pendente.
+ *
+ * @note Il registro delle interruzioni pendenti è aggiornato anche quando le
+ *    interruzioni sono mascherate, per cui questa funzione può essere usata per
+ *    rilevare gli eventi in polling.
+ */
+uint32_t switch_int_pending(void)
+{
+  return myGpio_interruptGetStatus(&gpio_switch);
+}
+
 /**
  * @brief Effettua l'acknowledge delle interruzioni pendenti.
  *
@@ -0,0 +1,165 @@
+/**
+* @file cosim.h
+* @brief Interfaccia di co-simulazione tra l'IP VHDL simulato con GHDL ed i driver C/C++.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup COSIM
+* @{
+*
+* @details Il testbench tb_gpio_cosim.vhd istanzia gpio_v2_0 e, ad ogni passo, chiede al
+* 	processo del driver la prossima transazione attraverso le funzioni VHPIDIRECT di
+* 	cosim_sim.c. Le due parti comunicano con una memoria condivisa POSIX (una sola
+* 	transazione in volo, due semafori): il tempo simulato avanza solo durante le
+* 	transazioni e le attese richieste dal driver, per cui l'esecuzione è deterministica.
+*
+* 	Lato driver, cosim_client.c offre le transazioni come funzioni e come backend di
+* 	gpio_ll, così che gpio.c ed i BSP girino senza modifiche contro l'RTL:
+*
+* 		make && ./tb_gpio_cosim_sim &
+* 		./tb_gpio_cosim
+*
+* 	Le variazioni della linea irq sono registrate dal testbench con il ciclo di clock in
+* 	cui avvengono e notificate al driver, attraverso la callback, al termine della
+* 	transazione durante la quale sono avvenute.
+*/
+#ifndef COSIM_H_
+#define COSIM_H_
+
+/***************************** Include Files ********************************/
+#include <stdint.h>
+#include <semaphore.h>
+
+/************************** Constant Definitions *****************************/
+#define COSIM_SHM_NAME    "/gpio_cosim"   ///< Nome di default della memoria condivisa (variabile COSIM_SHM)
+#define COSIM_MAGIC       0x47504353      ///< Memoria condivisa inizializzata dal simulatore
+#define COSIM_IRQ_LOG     64              ///< Variazioni di irq conservate per transazione
+
+/**
+* @brief Operazioni richieste dal driver al testbench.
+*/
+enum cosim_op {
+	COSIM_OP_READ,        ///< Transazione di lettura AXI-Lite
+	COSIM_OP_WRITE,       ///< Transazione di scrittura AXI-Lite
+	COSIM_OP_IDLE,        ///< Attesa di arg cicli di clock
+	COSIM_OP_DRIVE,       ///< Pilotaggio esterno dei pad (value/mask, gli altri pad in alta impedenza)
+	COSIM_OP_QUIT         ///< Fine della simulazione
+};
+
+/**************************** Type Definitions ******************************/
+/**
+* @brief Variazione della linea irq.
+*/
+struct cosim_irq_change {
+	uint32_t level;       ///< Nuovo livello
+	uint32_t reserved;
+	uint64_t cycle;       ///< Ciclo di clock della variazione
+};
+
+/**
+* @brief Memoria condivisa tra simulatore e driver.
+*/
+struct cosim_shm {
+	uint32_t magic;           ///< COSIM_MAGIC quando il simulatore è pronto
+	uint32_t gpio_size;       ///< Numero di pin dell'IP simulato
+	sem_t request;            ///< Postato dal driver quando la richiesta è pronta
+	sem_t done;               ///< Postato dal simulatore al termine della richiesta
+
+	/* Richiesta */
+	uint32_t op;              ///< enum cosim_op
+	uint32_t addr;            ///< Indirizzo (spiazzamento del registro)
+	uint32_t data;            ///< Dato da scrivere, oppure valore dei pad per COSIM_OP_DRIVE
+	uint32_t strb;            ///< Byte enable, oppure maschera dei pad per COSIM_OP_DRIVE
+	uint32_t arg;             ///< Cicli di attesa per COSIM_OP_IDLE
+
+	/* Risposta */
+	uint32_t rdata;           ///< Dato letto
+	uint32_t resp;            ///< RRESP/BRESP
+	uint32_t cycles;          ///< Durata della transazione in cicli di clock
+	uint32_t pads;            ///< Valore dei pad al termine della richiesta
+	uint32_t irq;             ///< Livello di irq al termine della richiesta
+	uint64_t now;             ///< Ciclo di clock al termine della richiesta
+	uint32_t irq_changes;     ///< Variazioni di irq registrate durante la richiesta
+	uint32_t irq_dropped;     ///< Variazioni non registrate perché oltre COSIM_IRQ_LOG
+	struct cosim_irq_change irq_log[COSIM_IRQ_LOG];
+};
+
+/**
+* @brief Contatori delle transazioni eseguite dal driver.
+*/
+struct cosim_stats {
+	uint64_t reads;           ///< Transazioni di lettura
+	uint64_t writes;          ///< Transazioni di scrittura
+	uint64_t bus_cycles;      ///< Cicli di clock trascorsi in transazioni
+	uint64_t irq_rises;       ///< Fronti di salita di irq
+};
+
+typedef void (*cosim_irq_handler)(void *ctx, int level, uint64_t cycle);
+
+/************************** Function Prototypes *****************************/
+/**
+* @brief Si collega al simulatore in esecuzione.
+*
+* @return 0 in caso di successo, -1 altrimenti.
+*/
+int cosim_attach(void);
+
+/**
+* @brief Termina la simulazione e rilascia la memoria condivisa.
+*/
+void cosim_detach(void);
+
+/**
+* @brief Esegue una transazione di lettura AXI-Lite all'indirizzo addr.
+*/
+uint32_t cosim_read(uint32_t addr);
+
+/**
+* @brief Esegue una transazione di scrittura AXI-Lite all'indirizzo addr.
+*/
+void cosim_write(uint32_t addr, uint32_t data);
+
+/**
+* @brief Lascia trascorrere cycles cicli di clock senza transazioni.
+*/
+void cosim_idle(uint32_t cycles);
+
+/**
+* @brief Pilota dall'esterno i pad indicati in mask; gli altri restano in alta impedenza.
+*/
+void cosim_drive(uint32_t value, uint32_t mask);
+
+/**
+* @brief Restituisce il valore dei pad e, se cycle non è NULL, il ciclo corrente.
+*/
+uint32_t cosim_pads(uint64_t *cycle);
+
+/**
+* @brief Imposta la funzione chiamata ad ogni variazione di irq.
+*/
+void cosim_set_irq_handler(cosim_irq_handler handler, void *ctx);
+
+/**
+* @brief Restituisce i contatori delle transazioni.
+*/
+const struct cosim_stats *cosim_get_stats(void);
+
+/**
+* @brief Instrada gli accessi di gpio_ll (compilato con GPIO_LL_BACKEND) verso il simulatore.
+*
+* @details L'indirizzo base passato al driver è ignorato: l'IP simulato è uno solo.
+*/
+void cosim_install_backend(void);
+
+#endif /* COSIM_H_ */
+/** @} */
@@ -0,0 +1,182 @@
+/**
+* @file cosim_client.c
+* @brief Lato driver della co-simulazione: transazioni AXI-Lite verso l'IP simulato con GHDL.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup COSIM
+* @{
+*/
+/***************************** Include Files ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "cosim.h"
+#include "gpio_ll.h"
+
+/************************** Constant Definitions *****************************/
+#define COSIM_ATTACH_TIMEOUT_MS 10000   ///< Attesa massima del simulatore
+
+/************************** Variable Definitions *****************************/
+static struct cosim_shm *shm = NULL;
+static struct cosim_stats stats;
+static cosim_irq_handler irq_handler = NULL;
+static void *irq_ctx = NULL;
+
+/************************** Function Prototypes *****************************/
+static void cosim_transact(uint32_t op);
+static uint32_t backend_read(void *ctx, uint32_t *base, int offset);
+static void backend_write(void *ctx, uint32_t *base, int offset, uint32_t mask);
+
+static const gpio_ll_backend cosim_backend = { backend_read, backend_write, NULL };
+
+int cosim_attach(void)
+{
+	const char *name = getenv("COSIM_SHM") ? getenv("COSIM_SHM") : COSIM_SHM_NAME;
+	struct timespec delay = { 0, 10000000 };
+	int fd = -1, waited;
+
+	// Il simulatore potrebbe non aver ancora creato la memoria condivisa
+	for(waited = 0; waited < COSIM_ATTACH_TIMEOUT_MS; waited += 10){
+		fd = shm_open(name, O_RDWR, 0);
+		if(fd >= 0)
+			break;
+		nanosleep(&delay, NULL);
+	}
+	if(fd < 0){
+		printf("Simulatore non trovato su %s! Errore: %s\n", name, strerror(errno));
+		return -1;
+	}
+
+	shm = mmap(NULL, sizeof(struct cosim_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(shm == MAP_FAILED){
+		shm = NULL;
+		return -1;
+	}
+
+	for(; waited < COSIM_ATTACH_TIMEOUT_MS; waited += 10){
+		if(__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) == COSIM_MAGIC)
+			return 0;
+		nanosleep(&delay, NULL);
+	}
+	printf("Il simulatore non ha inizializzato %s\n", name);
+	munmap(shm, sizeof(struct cosim_shm));
+	shm = NULL;
+	return -1;
+}
+
+void cosim_detach(void)
+{
+	if(!shm)
+		return;
+	cosim_transact(COSIM_OP_QUIT);
+	munmap(shm, sizeof(struct cosim_shm));
+	shm = NULL;
+}
+
+/**
+* @brief Consegna la richiesta preparata in shm, ne attende il completamento e notifica
+* 	le variazioni di irq avvenute nel frattempo.
+*/
+static void cosim_transact(uint32_t op)
+{
+	uint32_t i;
+
+	shm->op = op;
+	sem_post(&shm->request);
+	while(sem_wait(&shm->done) < 0 && errno == EINTR)
+		;
+
+	if(op == COSIM_OP_READ || op == COSIM_OP_WRITE)
+		stats.bus_cycles += shm->cycles;
+
+	for(i = 0; i < shm->irq_changes; i++){
+		if(shm->irq_log[i].level)
+			stats.irq_rises++;
+		if(irq_handler)
+			irq_handler(irq_ctx, shm->irq_log[i].level, shm->irq_log[i].cycle);
+	}
+	if(shm->irq_dropped)
+		printf("[cosim] %u variazioni di irq non registrate\n", shm->irq_dropped);
+}
+
+uint32_t cosim_read(uint32_t addr)
+{
+	shm->addr = addr;
+	stats.reads++;
+	cosim_transact(COSIM_OP_READ);
+	return shm->rdata;
+}
+
+void cosim_write(uint32_t addr, uint32_t data)
+{
+	shm->addr = addr;
+	shm->data = data;
+	shm->strb = 0xF;
+	stats.writes++;
+	cosim_transact(COSIM_OP_WRITE);
+}
+
+void cosim_idle(uint32_t cycles)
+{
+	shm->arg = cycles;
+	cosim_transact(COSIM_OP_IDLE);
+}
+
+void cosim_drive(uint32_t value, uint32_t mask)
+{
+	shm->data = value;
+	shm->strb = mask;
+	cosim_transact(COSIM_OP_DRIVE);
+}
+
+uint32_t cosim_pads(uint64_t *cycle)
+{
+	if(cycle)
+		*cycle = shm->now;
+	return shm->pads;
+}
+
+void cosim_set_irq_handler(cosim_irq_handler handler, void *ctx)
+{
+	irq_handler = handler;
+	irq_ctx = ctx;
+}
+
+const struct cosim_stats *cosim_get_stats(void)
+{
+	return &stats;
+}
+
+static uint32_t backend_read(void *ctx, uint32_t *base, int offset)
+{
+	return cosim_read(offset);
+}
+
+static void backend_write(void *ctx, uint32_t *base, int offset, uint32_t mask)
+{
+	cosim_write(offset, mask);
+}
+
+void cosim_install_backend(void)
+{
+	gpio_ll_set_backend(&cosim_backend);
+}
+/** @} */
@@ -0,0 +1,132 @@
+/**
+* @file cosim_sim.c
+* @brief Funzioni VHPIDIRECT chiamate dal testbench tb_gpio_cosim.vhd in esecuzione in GHDL.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup COSIM
+* @{
+*
+* @details Gli interi VHDL sono a 32 bit con segno: dati ed indirizzi sono passati come
+* 	int e reinterpretati come unsigned. I parametri out delle procedure sono passati
+* 	per riferimento.
+*/
+/***************************** Include Files ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "cosim.h"
+
+/************************** Variable Definitions *****************************/
+static struct cosim_shm *shm = NULL;
+static const char *shm_name = COSIM_SHM_NAME;
+
+/************************** Function Prototypes *****************************/
+int cosim_sim_init(int gpio_size);
+void cosim_sim_next(int *op, int *addr, int *data, int *strb, int *arg);
+void cosim_sim_done(int rdata, int resp, int cycles, int pads, int irq, int now_hi, int now_lo);
+void cosim_sim_irq(int level, int cycle_hi, int cycle_lo);
+
+/**
+* @brief Crea la memoria condivisa ed attende il driver.
+*
+* @return 0 in caso di successo, -1 altrimenti (il testbench termina la simulazione).
+*/
+int cosim_sim_init(int gpio_size)
+{
+	int fd;
+
+	if(getenv("COSIM_SHM"))
+		shm_name = getenv("COSIM_SHM");
+
+	fd = shm_open(shm_name, O_CREAT | O_RDWR, 0600);
+	if(fd < 0 || ftruncate(fd, sizeof(struct cosim_shm)) < 0){
+		printf("Creazione della memoria condivisa %s non riuscita! Errore: %s\n", shm_name, strerror(errno));
+		return -1;
+	}
+	shm = mmap(NULL, sizeof(struct cosim_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(shm == MAP_FAILED){
+		printf("Mapping della memoria condivisa non riuscito! Errore: %s\n", strerror(errno));
+		return -1;
+	}
+
+	memset(shm, 0, sizeof(*shm));
+	sem_init(&shm->request, 1, 0);
+	sem_init(&shm->done, 1, 0);
+	shm->gpio_size = gpio_size;
+	__atomic_store_n(&shm->magic, COSIM_MAGIC, __ATOMIC_RELEASE);
+
+	printf("Simulatore pronto su %s, in attesa del driver...\n", shm_name);
+	fflush(stdout);
+	return 0;
+}
+
+/**
+* @brief Attende la prossima richiesta del driver. Il tempo simulato è fermo finché
+* 	la richiesta non arriva.
+*/
+void cosim_sim_next(int *op, int *addr, int *data, int *strb, int *arg)
+{
+	while(sem_wait(&shm->request) < 0 && errno == EINTR)
+		;
+
+	shm->irq_changes = 0;
+	shm->irq_dropped = 0;
+	*op = shm->op;
+	*addr = shm->addr;
+	*data = shm->data;
+	*strb = shm->strb;
+	*arg = shm->arg;
+}
+
+/**
+* @brief Completa la richiesta corrente. Dopo COSIM_OP_QUIT rimuove la memoria condivisa.
+*/
+void cosim_sim_done(int rdata, int resp, int cycles, int pads, int irq, int now_hi, int now_lo)
+{
+	shm->rdata = rdata;
+	shm->resp = resp;
+	shm->cycles = cycles;
+	shm->pads = pads;
+	shm->irq = irq;
+	shm->now = ((uint64_t)(uint32_t)now_hi << 32) | (uint32_t)now_lo;
+
+	if(shm->op == COSIM_OP_QUIT){
+		__atomic_store_n(&shm->magic, 0, __ATOMIC_RELEASE);
+		shm_unlink(shm_name);
+	}
+	sem_post(&shm->done);
+}
+
+/**
+* @brief Registra una variazione di irq avvenuta durante la richiesta corrente.
+*/
+void cosim_sim_irq(int level, int cycle_hi, int cycle_lo)
+{
+	struct cosim_irq_change *change;
+
+	if(shm->irq_changes == COSIM_IRQ_LOG){
+		shm->irq_dropped++;
+		return;
+	}
+	change = &shm->irq_log[shm->irq_changes++];
+	change->level = level;
+	change->cycle = ((uint64_t)(uint32_t)cycle_hi << 32) | (uint32_t)cycle_lo;
+}
+/** @} */
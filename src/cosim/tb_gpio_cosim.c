@@ -0,0 +1,157 @@
+/**
+* @file tb_gpio_cosim.c
+* @brief Test del driver C contro l'RTL della periferica simulato con GHDL.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup COSIM
+* @{
+*/
+/***************************** Include Files ********************************/
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "cosim.h"
+#include "gpio.h"
+#include "config.h"
+
+/************************** Constant Definitions *****************************/
+#define PIN_OUT   (GPIO_PIN_0|GPIO_PIN_1)
+#define PIN_IN    (GPIO_PIN_2|GPIO_PIN_3)
+
+/**************************** Macro Definitions *****************************/
+/** Esegue una chiamata del driver e ne riporta le transazioni */
+#define MEASURE(call) do { last = *cosim_get_stats(); call; account(#call); } while(0)
+
+/************************** Variable Definitions *****************************/
+static int errors = 0;
+static int irq_level = 0;
+static uint64_t irq_cycle = 0;
+static struct cosim_stats last;
+
+/************************** Function Prototypes *****************************/
+static void irq_handler(void *ctx, int level, uint64_t cycle);
+static void check(const char *what, uint32_t got, uint32_t expected);
+static void account(const char *call);
+
+/**
+* @details Ripete i passi di tb_gpio sull'RTL: direzione dei pin, scrittura e lettura
+* 	dei valori (i pin in ingresso sono pilotati dal testbench), generazione, lettura
+* 	e cancellazione delle interruzioni. Per ogni chiamata del driver riporta il numero
+* 	di transazioni AXI-Lite ed i cicli di clock impiegati.
+*
+* 	Restituisce 0 se tutti i controlli hanno successo.
+*/
+int main(void)
+{
+	myGpio_t gpio;
+	myGpio_config gpio_config;
+	const struct cosim_stats *stats;
+	uint32_t value;
+
+	if(cosim_attach() < 0)
+		return 1;
+	cosim_install_backend();
+	cosim_set_irq_handler(irq_handler, NULL);
+
+	gpio_config.base_address = (uint32_t*)GPIO_SWITCH_BASEADDR;
+	gpio_config.interrupt_config = INT_ENABLED;
+	myGpio_init(&gpio, &gpio_config);
+
+	printf("%-48s %7s %9s %6s\n", "chiamata", "letture", "scritture", "cicli");
+
+	MEASURE(myGpio_setDataDirection(&gpio, PIN_OUT, GPIO_WRITE));
+	MEASURE(value = myGpio_getDataDirection(&gpio, PIN_OUT));
+	check("TRI", value, PIN_OUT);
+
+	MEASURE(myGpio_write_value(&gpio, PIN_OUT));
+	MEASURE(value = myGpio_read_value(&gpio));
+	check("DIN (uscite)", value, PIN_OUT);
+
+	cosim_drive(PIN_IN, PIN_IN);
+	cosim_idle(4);
+	check("DIN (ingressi)", myGpio_read_value(&gpio), PIN_OUT|PIN_IN);
+	check("pad", cosim_pads(NULL), PIN_OUT|PIN_IN);
+
+	// Tutti i fronti precedenti sono registrati in ISR
+	MEASURE(value = myGpio_interruptGetStatus(&gpio));
+	check("ISR (fronti)", value, PIN_OUT|PIN_IN);
+	MEASURE(myGpio_interruptClear(&gpio, PIN_OUT|PIN_IN));
+	check("ISR (clear)", myGpio_interruptGetStatus(&gpio), 0);
+
+	MEASURE(myGpio_interruptEnable(&gpio, GPIO_PIN_2));
+	check("IER", myGpio_interruptGetEnabled(&gpio), GPIO_PIN_2);
+	check("irq (abilitazione)", irq_level, 0);
+
+	// Fronte di salita sul pin 2: irq deve alzarsi
+	cosim_drive(0, PIN_IN);
+	cosim_drive(GPIO_PIN_2, PIN_IN);
+	cosim_idle(4);
+	check("irq (fronte)", irq_level, 1);
+	printf("irq alto al ciclo %" PRIu64 "\n", irq_cycle);
+	check("ISR (pin 2)", myGpio_interruptGetStatus(&gpio) & GPIO_PIN_2, GPIO_PIN_2);
+
+	// Un fronte su un pin non abilitato non genera interruzioni
+	myGpio_interruptClear(&gpio, PIN_OUT|PIN_IN);
+	cosim_idle(2);
+	check("irq (clear)", irq_level, 0);
+	cosim_drive(GPIO_PIN_2|GPIO_PIN_3, PIN_IN);
+	cosim_idle(4);
+	check("irq (pin disabilitato)", irq_level, 0);
+	check("ISR (pin 3)", myGpio_interruptGetStatus(&gpio), GPIO_PIN_3);
+
+	MEASURE(myGpio_interruptDisable(&gpio, GPIO_PIN_2));
+	MEASURE(myGpio_toggle(&gpio, GPIO_DOUT_OFFSET, GPIO_PIN_0));
+	check("DOUT (toggle)", myGpio_read_value(&gpio) & PIN_OUT, GPIO_PIN_1);
+
+	stats = cosim_get_stats();
+	printf("Totale: %" PRIu64 " letture, %" PRIu64 " scritture, %" PRIu64 " cicli di bus, %" PRIu64 " interruzioni\n",
+		stats->reads, stats->writes, stats->bus_cycles, stats->irq_rises);
+	printf("%s (%d errori)\n", errors ? "FALLITO" : "SUPERATO", errors);
+
+	cosim_detach();
+	return errors ? 1 : 0;
+}
+
+/**
+* @brief Registra le variazioni della linea di interruzione.
+*/
+static void irq_handler(void *ctx, int level, uint64_t cycle)
+{
+	irq_level = level;
+	if(level)
+		irq_cycle = cycle;
+}
+
+/**
+* @brief Confronta un valore letto con quello atteso.
+*/
+static void check(const char *what, uint32_t got, uint32_t expected)
+{
+	if(got != expected){
+		printf("ERRORE %s: letto 0x%08x, atteso 0x%08x\n", what, got, expected);
+		errors++;
+	}
+}
+
+/**
+* @brief Riporta le transazioni eseguite da una chiamata (vedi MEASURE).
+*/
+static void account(const char *call)
+{
+	const struct cosim_stats *stats = cosim_get_stats();
+
+	printf("%-48s %7" PRIu64 " %9" PRIu64 " %6" PRIu64 "\n", call,
+		stats->reads - last.reads, stats->writes - last.writes, stats->bus_cycles - last.bus_cycles);
+}
+/** @} */
@@ -0,0 +1,289 @@
+----------------------------------------------------------------------------------
+-- Company:
+-- Engineer:
+--
+-- Create Date: 19.10.2026 10:12:40
+-- Design Name:
+-- Module Name: tb_gpio_cosim - Behavioral
+-- Project Name:
+-- Target Devices:
+-- Tool Versions: GHDL (--std=08)
+-- Description:
+--
+-- Dependencies: gpio_v2_0, cosim_sim.c
+--
+-- Revision:
+-- Revision 0.01 - File Created
+-- Additional Comments:
+--
+----------------------------------------------------------------------------------
+--! @file tb_gpio_cosim.vhd
+--! @author Antonio Riccio
+--! @brief Testbench di co-simulazione: le transazioni AXI-Lite verso gpio_v2_0 sono
+--! richieste da un processo esterno (il driver C) attraverso le funzioni VHPIDIRECT
+--! di cosim_sim.c.
+
+library IEEE;
+use IEEE.STD_LOGIC_1164.ALL;
+use IEEE.NUMERIC_STD.ALL;
+
+--! Dichiarazioni delle funzioni esterne, implementate in cosim_sim.c
+package cosim_pkg is
+  constant COSIM_OP_READ  : integer := 0;
+  constant COSIM_OP_WRITE : integer := 1;
+  constant COSIM_OP_IDLE  : integer := 2;
+  constant COSIM_OP_DRIVE : integer := 3;
+  constant COSIM_OP_QUIT  : integer := 4;
+
+  impure function cosim_sim_init(gpio_size : integer) return integer;
+  attribute foreign of cosim_sim_init : function is "VHPIDIRECT cosim_sim_init";
+
+  procedure cosim_sim_next(op, addr, data, strb, arg : out integer);
+  attribute foreign of cosim_sim_next : procedure is "VHPIDIRECT cosim_sim_next";
+
+  procedure cosim_sim_done(rdata, resp, cycles, pads, irq, now_hi, now_lo : integer);
+  attribute foreign of cosim_sim_done : procedure is "VHPIDIRECT cosim_sim_done";
+
+  procedure cosim_sim_irq(level, cycle_hi, cycle_lo : integer);
+  attribute foreign of cosim_sim_irq : procedure is "VHPIDIRECT cosim_sim_irq";
+end package cosim_pkg;
+
+package body cosim_pkg is
+  impure function cosim_sim_init(gpio_size : integer) return integer is
+  begin
+    assert false report "VHPIDIRECT cosim_sim_init" severity failure;
+    return -1;
+  end function;
+
+  procedure cosim_sim_next(op, addr, data, strb, arg : out integer) is
+  begin
+    assert false report "VHPIDIRECT cosim_sim_next" severity failure;
+  end procedure;
+
+  procedure cosim_sim_done(rdata, resp, cycles, pads, irq, now_hi, now_lo : integer) is
+  begin
+    assert false report "VHPIDIRECT cosim_sim_done" severity failure;
+  end procedure;
+
+  procedure cosim_sim_irq(level, cycle_hi, cycle_lo : integer) is
+  begin
+    assert false report "VHPIDIRECT cosim_sim_irq" severity failure;
+  end procedure;
+end package body cosim_pkg;
+
+library IEEE;
+use IEEE.STD_LOGIC_1164.ALL;
+use IEEE.NUMERIC_STD.ALL;
+use work.cosim_pkg.all;
+
+entity tb_gpio_cosim is
+    Generic ( gpio_size : natural := 4;
+              clk_period : time := 10 ns);
+end tb_gpio_cosim;
+
+architecture Behavioral of tb_gpio_cosim is
+
+  constant C_ADDR_WIDTH : integer := 5;
+  constant C_DATA_WIDTH : integer := 32;
+
+  signal clk     : std_logic := '0';
+  signal aresetn : std_logic := '0';
+  --! Cicli di clock dall'avvio della simulazione
+  signal cycle   : unsigned(63 downto 0) := (others => '0');
+
+  signal pad     : std_logic_vector(gpio_size-1 downto 0);
+  --! Pilotaggio esterno dei pad: 'L' (pull-down) per i pad non pilotati
+  signal pad_ext : std_logic_vector(gpio_size-1 downto 0) := (others => 'L');
+  signal irq     : std_logic;
+
+  signal awaddr  : std_logic_vector(C_ADDR_WIDTH-1 downto 0) := (others => '0');
+  signal awvalid : std_logic := '0';
+  signal awready : std_logic;
+  signal wdata   : std_logic_vector(C_DATA_WIDTH-1 downto 0) := (others => '0');
+  signal wstrb   : std_logic_vector((C_DATA_WIDTH/8)-1 downto 0) := (others => '0');
+  signal wvalid  : std_logic := '0';
+  signal wready  : std_logic;
+  signal bresp   : std_logic_vector(1 downto 0);
+  signal bvalid  : std_logic;
+  signal bready  : std_logic := '0';
+  signal araddr  : std_logic_vector(C_ADDR_WIDTH-1 downto 0) := (others => '0');
+  signal arvalid : std_logic := '0';
+  signal arready : std_logic;
+  signal rdata   : std_logic_vector(C_DATA_WIDTH-1 downto 0);
+  signal rresp   : std_logic_vector(1 downto 0);
+  signal rvalid  : std_logic;
+  signal rready  : std_logic := '0';
+
+  --! Parte alta e parte bassa di un contatore a 64 bit, come interi a 32 bit con segno
+  function hi(v : unsigned(63 downto 0)) return integer is
+  begin
+    return to_integer(signed(v(63 downto 32)));
+  end function;
+
+  function lo(v : unsigned(63 downto 0)) return integer is
+  begin
+    return to_integer(signed(v(31 downto 0)));
+  end function;
+
+  --! Valore di un vettore come intero; i bit non a '0'/'1' (pad in alta impedenza) valgono 0
+  function to_int(v : std_logic_vector) return integer is
+    variable r : std_logic_vector(C_DATA_WIDTH-1 downto 0) := (others => '0');
+  begin
+    r(v'length-1 downto 0) := to_stdlogicvector(to_bitvector(v));
+    return to_integer(signed(r));
+  end function;
+
+  function to_int(s : std_logic) return integer is
+  begin
+    if to_bit(s) = '1' then
+      return 1;
+    end if;
+    return 0;
+  end function;
+
+begin
+
+  DUT: entity work.gpio_v2_0
+    generic map ( gpio_size => gpio_size,
+                  C_S00_AXI_DATA_WIDTH => C_DATA_WIDTH,
+                  C_S00_AXI_ADDR_WIDTH => C_ADDR_WIDTH)
+    port map ( pad => pad,
+               irq => irq,
+               s00_axi_aclk => clk,
+               s00_axi_aresetn => aresetn,
+               s00_axi_awaddr => awaddr,
+               s00_axi_awprot => "000",
+               s00_axi_awvalid => awvalid,
+               s00_axi_awready => awready,
+               s00_axi_wdata => wdata,
+               s00_axi_wstrb => wstrb,
+               s00_axi_wvalid => wvalid,
+               s00_axi_wready => wready,
+               s00_axi_bresp => bresp,
+               s00_axi_bvalid => bvalid,
+               s00_axi_bready => bready,
+               s00_axi_araddr => araddr,
+               s00_axi_arprot => "000",
+               s00_axi_arvalid => arvalid,
+               s00_axi_arready => arready,
+               s00_axi_rdata => rdata,
+               s00_axi_rresp => rresp,
+               s00_axi_rvalid => rvalid,
+               s00_axi_rready => rready);
+
+  --! Il pad risolve il valore di gpio_pad (DOUT oppure 'Z') con quello imposto dall'esterno
+  pad <= pad_ext;
+
+  clk <= not clk after clk_period / 2;
+
+  cycle_counter: process(clk)
+  begin
+    if rising_edge(clk) then
+      cycle <= cycle + 1;
+    end if;
+  end process;
+
+  --! Registra ogni variazione di irq con il ciclo in cui avviene
+  irq_monitor: process(irq)
+  begin
+    if aresetn = '1' and (irq = '0' or irq = '1') then
+      cosim_sim_irq(to_int(irq), hi(cycle), lo(cycle));
+    end if;
+  end process;
+
+  --! Esegue le richieste del driver una alla volta; il tempo simulato avanza solo qui
+  bus_master: process
+    variable op, addr, data, strb, arg : integer;
+    variable start : unsigned(63 downto 0);
+    variable rd : integer;
+    variable drv_value, drv_mask : std_logic_vector(31 downto 0);
+    variable resp : integer;
+  begin
+    aresetn <= '0';
+    for i in 1 to 4 loop
+      wait until rising_edge(clk);
+    end loop;
+    aresetn <= '1';
+    wait until rising_edge(clk);
+
+    if cosim_sim_init(gpio_size) /= 0 then
+      report "Inizializzazione della co-simulazione non riuscita" severity failure;
+    end if;
+
+    loop
+      cosim_sim_next(op, addr, data, strb, arg);
+      start := cycle;
+      rd := 0;
+      resp := 0;
+
+      case op is
+        when COSIM_OP_READ =>
+          araddr <= std_logic_vector(to_unsigned(addr mod 2**C_ADDR_WIDTH, C_ADDR_WIDTH));
+          arvalid <= '1';
+          rready <= '1';
+          loop
+            wait until rising_edge(clk);
+            if arready = '1' then
+              arvalid <= '0';
+            end if;
+            if rvalid = '1' then
+              rd := to_int(rdata);
+              resp := to_int(rresp);
+              exit;
+            end if;
+          end loop;
+          rready <= '0';
+
+        when COSIM_OP_WRITE =>
+          awaddr <= std_logic_vector(to_unsigned(addr mod 2**C_ADDR_WIDTH, C_ADDR_WIDTH));
+          awvalid <= '1';
+          wdata <= std_logic_vector(to_signed(data, C_DATA_WIDTH));
+          wstrb <= std_logic_vector(to_unsigned(strb mod 2**(C_DATA_WIDTH/8), C_DATA_WIDTH/8));
+          wvalid <= '1';
+          bready <= '1';
+          loop
+            wait until rising_edge(clk);
+            if awready = '1' then
+              awvalid <= '0';
+            end if;
+            if wready = '1' then
+              wvalid <= '0';
+            end if;
+            if bvalid = '1' then
+              resp := to_int(bresp);
+              exit;
+            end if;
+          end loop;
+          bready <= '0';
+
+        when COSIM_OP_IDLE =>
+          for i in 1 to arg loop
+            wait until rising_edge(clk);
+          end loop;
+
+        when COSIM_OP_DRIVE =>
+          -- Lo stimolo cambia a metà periodo, come un ingresso asincrono
+          drv_value := std_logic_vector(to_signed(data, 32));
+          drv_mask := std_logic_vector(to_signed(strb, 32));
+          for i in 0 to gpio_size-1 loop
+            if drv_mask(i) = '1' then
+              pad_ext(i) <= drv_value(i);
+            else
+              pad_ext(i) <= 'L';
+            end if;
+          end loop;
+          wait until falling_edge(clk);
+
+        when others =>
+          null;
+      end case;
+
+      cosim_sim_done(rd, resp, to_integer(cycle - start), to_int(pad),
+                     to_int(irq), hi(cycle), lo(cycle));
+      exit when op = COSIM_OP_QUIT;
+    end loop;
+
+    std.env.finish;
+  end process;
+
+end Behavioral;
@@ -19,14 +19,139 @@
 */
 /***************************** Include Files ********************************/
 #include <assert.h>
+#include <stddef.h>
 #include "gpio_ll.h"
 
+#ifdef GPIO_LL_BACKEND
+static const gpio_ll_backend* backend = NULL;   ///< Backend installato, NULL per l'accesso diretto
+
+void gpio_ll_set_backend(const gpio_ll_backend* new_backend){
+	backend = new_backend;
+}
+#endif
+
+#ifdef GPIO_LL_TRACE
+#define GPIO_TRACE_DEVICES 16     ///< Periferiche distinte registrabili
+
+static gpio_trace_record* trace_buffer = NULL;   ///< Buffer dei record, NULL se la registrazione è ferma
+static uint32_t trace_entries;
+static uint32_t trace_next;                      ///< Prossimo record da scrivere
+static uint32_t trace_dropped;
+static uint64_t (*trace_clock)(void);
+static uint64_t trace_start;
+static uint64_t trace_last;                      ///< Tempo dell'ultimo record, da trace_start
+static uint32_t* trace_bases[GPIO_TRACE_DEVICES];
+static unsigned int trace_devices;
+
+/**
+ * @brief Scrive un record. L'indice è riservato con un'operazione atomica, per cui
+ *    il registratore può essere usato sia dal codice principale sia dalla ISR.
+ */
+static void trace_put(uint64_t now, uint8_t type, uint8_t device, int offset, uint32_t value){
+	uint32_t index = __atomic_fetch_add(&trace_next, 1, __ATOMIC_RELAXED);
+	gpio_trace_record* record;
+
+	if(index >= trace_entries){
+		__atomic_fetch_add(&trace_dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	record = &trace_buffer[index];
+	record->time = (uint32_t)now;
+	record->type = type;
+	record->device = device;
+	record->offset = offset;
+	record->reserved = 0;
+	record->value = value;
+}
+
+/**
+ * @brief Registra un evento di una periferica, preceduto se necessario dai record
+ *    GPIO_TRACE_TIME e GPIO_TRACE_DEVICE.
+ *
+ * @note Le periferiche sono aggiunte alla tabella senza sincronizzazione: il primo
+ *    accesso ad ogni periferica deve avvenire prima di abilitarne le interruzioni, come
+ *    accade con l'inizializzazione di gpio.c.
+ */
+static void trace_event(uint32_t* gpio_base_ptr, uint8_t type, int offset, uint32_t value){
+	unsigned int device;
+	uint64_t now;
+
+	if(trace_buffer == NULL)
+		return;
+
+	now = trace_clock() - trace_start;
+	if(now - trace_last >= GPIO_TRACE_GAP_NS && now > trace_last)
+		trace_put(now, GPIO_TRACE_TIME, 0, 0, (uint32_t)(now >> 32));
+	trace_last = now;
+
+	for(device = 0; device < trace_devices; device++){
+		if(trace_bases[device] == gpio_base_ptr)
+			break;
+	}
+	if(device == trace_devices){
+		assert(device < GPIO_TRACE_DEVICES);
+		trace_bases[device] = gpio_base_ptr;
+		trace_devices++;
+		trace_put(now, GPIO_TRACE_DEVICE, device, 0, (uint32_t)(uintptr_t)gpio_base_ptr);
+	}
+	trace_put(now, type, device, offset, value);
+}
+
+void gpio_ll_trace_start(gpio_trace_record* buffer, uint32_t entries, uint64_t (*clock_ns)(void)){
+	assert(buffer != NULL && clock_ns != NULL);
+
+	trace_entries = entries;
+	trace_next = 0;
+	trace_dropped = 0;
+	trace_devices = 0;
+	trace_clock = clock_ns;
+	trace_start = clock_ns();
+	trace_last = 0;
+	__atomic_store_n(&trace_buffer, buffer, __ATOMIC_RELEASE);
+}
+
+void gpio_ll_trace_stop(gpio_trace_header* header){
+	__atomic_store_n(&trace_buffer, NULL, __ATOMIC_RELEASE);
+
+	header->magic = GPIO_TRACE_MAGIC;
+	header->version = GPIO_TRACE_VERSION;
+	header->record_size = sizeof(gpio_trace_record);
+	header->start_ns = trace_start;
+	header->records = trace_next < trace_entries ? trace_next : trace_entries;
+	header->dropped = trace_dropped;
+}
+
+void gpio_ll_trace_irq(uint32_t* gpio_base_ptr){
+	trace_event(gpio_base_ptr, GPIO_TRACE_IRQ, 0, 0);
+}
+#endif
+
 void gpio_write_mask(uint32_t* gpio_base_ptr, int offset, uint32_t mask){
+#ifdef GPIO_LL_TRACE
+	trace_event(gpio_base_ptr, GPIO_TRACE_WRITE, offset, mask);
+#endif
+#ifdef GPIO_LL_BACKEND
+	if(backend != NULL){
+		backend->write(backend->ctx, gpio_base_ptr, offset, mask);
+		return;
+	}
+#endif
 	*(gpio_base_ptr + offset/4) = mask;
 }
 
 uint32_t gpio_read_mask(uint32_t* gpio_base_ptr, int offset){
-	return *(gpio_base_ptr + offset/4);
+	uint32_t value;
+
+#ifdef GPIO_LL_BACKEND
+	if(backend != NULL)
+		value = backend->read(backend->ctx, gpio_base_ptr, offset);
+	else
+#endif
+	value = *(gpio_base_ptr + offset/4);
+#ifdef GPIO_LL_TRACE
+	trace_event(gpio_base_ptr, GPIO_TRACE_READ, offset, value);
+#endif
+	return value;
 }
 
 void gpio_toggle_bit(uint32_t* gpio_base_ptr, int offset, uint32_t mask){
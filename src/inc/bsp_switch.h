@@ -74,6 +74,7 @@ uint32_t switch_get_state(uint32_t mask);
  * @name Funzioni per la gestione delle interruzioni
  * @{
  */
+uint32_t switch_int_pending(void);
 void switch_int_ack(void);
 /** @} */
 
@@ -26,6 +26,9 @@
 
 /***************************** Include Files *********************************/
 #include <inttypes.h>
+#ifdef GPIO_LL_TRACE
+#include "gpio_trace.h"
+#endif
 
 /************************** Constant Definitions *****************************/
 /**
@@ -41,6 +44,72 @@
 #define GPIO_ISR_OFFSET  20       ///< Registro per la lettura delle interruzioni pending
 /* @} */
 
+/**************************** Type Definitions *******************************/
+#ifdef GPIO_LL_BACKEND
+/**
+ * @brief Backend al quale sono inoltrati gli accessi ai registri.
+ *
+ * @details Disponibile solo compilando con GPIO_LL_BACKEND definita (simulazione su host):
+ *    quando un backend è installato gli accessi non dereferenziano gpio_base_ptr ma
+ *    sono passati, insieme ad esso, alle funzioni del backend, che lo usano per
+ *    individuare la periferica simulata. Senza GPIO_LL_BACKEND l'accesso resta una
+ *    semplice load/store.
+ */
+typedef struct {
+	uint32_t (*read)(void* ctx, uint32_t* gpio_base_ptr, int offset);                 ///< Lettura di un registro
+	void (*write)(void* ctx, uint32_t* gpio_base_ptr, int offset, uint32_t mask);     ///< Scrittura di un registro
+	void* ctx;                                                                        ///< Contesto passato alle funzioni
+} gpio_ll_backend;
+#endif
+
+/************************** Function Prototypes ******************************/
+#ifdef GPIO_LL_BACKEND
+/**
+ * @brief Installa il backend degli accessi ai registri (NULL per rimuoverlo).
+ *
+ * @param backend è il backend da installare. Deve restare valido finché è installato.
+ *
+ * @return none.
+ */
+void gpio_ll_set_backend(const gpio_ll_backend* backend);
+#endif
+
+#ifdef GPIO_LL_TRACE
+/**
+ * @brief Avvia la registrazione degli accessi ai registri (si veda gpio_trace.h).
+ *
+ * @param buffer è il buffer dei record. Deve restare valido fino a gpio_ll_trace_stop.
+ * @param entries è il numero di record del buffer; a buffer pieno i record sono contati come persi.
+ * @param clock_ns è l'orologio della registrazione, in nanosecondi (ad esempio il tempo
+ *    globale del processore su Zynq oppure CLOCK_MONOTONIC su Linux).
+ *
+ * @details Disponibile solo compilando con GPIO_LL_TRACE definita. Sono registrati tutti
+ *    gli accessi di gpio_read_mask e gpio_write_mask, anche quelli instradati verso un backend.
+ *
+ * @return none.
+ */
+void gpio_ll_trace_start(gpio_trace_record* buffer, uint32_t entries, uint64_t (*clock_ns)(void));
+
+/**
+ * @brief Termina la registrazione e compila l'intestazione della traccia.
+ *
+ * @param header è l'intestazione da compilare; header->records record del buffer sono validi.
+ *
+ * @return none.
+ */
+void gpio_ll_trace_stop(gpio_trace_header* header);
+
+/**
+ * @brief Registra l'ingresso nel gestore dell'interruzione di una periferica. Va chiamata
+ *    all'inizio del gestore, prima di ogni accesso ai registri.
+ *
+ * @param gpio_base_ptr è il puntatore all'indirizzo base della periferica.
+ *
+ * @return none.
+ */
+void gpio_ll_trace_irq(uint32_t* gpio_base_ptr);
+#endif
+
 /**
  * @brief Scrive un valore in un registro della periferica. La scrittura è su 32 bit.
  *
@@ -0,0 +1,91 @@
+/**
+* @file gpio_trace.h
+* @brief Formato delle tracce degli accessi ai registri e delle interruzioni della periferica GPIO.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup API_LL
+* @{
+*
+* @addtogroup TRACE
+* @{
+*
+* @brief Formato comune al registratore di gpio_ll (GPIO_LL_TRACE), a quello del modulo
+*     kernel (parametro reg_trace_entries, file reg_trace in debugfs) ed al motore di riproduzione.
+*
+* @details Una traccia è un'intestazione gpio_trace_header seguita da header.records record
+*     gpio_trace_record di 12 byte, in little-endian come le architetture su cui gira il driver.
+*
+*     Il tempo di ogni record è dato dai 32 bit bassi dei nanosecondi trascorsi da
+*     start_ns: chi legge ricostruisce il tempo assoluto dalla differenza, con segno, rispetto
+*     al record precedente, per cui due record consecutivi devono distare meno di 2^31 ns.
+*     Quando la distanza dal record precedente supera GPIO_TRACE_GAP_NS il registratore
+*     scrive prima un record GPIO_TRACE_TIME con i 32 bit alti del tempo. Il confronto con
+*     segno tollera anche i piccoli scambi di ordine tra record scritti da una ISR e dal
+*     codice che essa ha interrotto.
+*
+*     Il campo device identifica la periferica: il registratore di gpio_ll scrive un
+*     record GPIO_TRACE_DEVICE, con i 32 bit bassi dell'indirizzo base, al primo accesso
+*     ad ogni periferica; il modulo kernel registra una traccia per dispositivo con device 0.
+*/
+#ifndef GPIO_TRACE_H
+#define GPIO_TRACE_H
+
+/***************************** Include Files *********************************/
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdint.h>
+#endif
+
+/************************** Constant Definitions *****************************/
+#define GPIO_TRACE_MAGIC    0x43525447      ///< "GTRC"
+#define GPIO_TRACE_VERSION  1
+#define GPIO_TRACE_GAP_NS   (1U << 30)      ///< Distanza oltre la quale viene scritto un record GPIO_TRACE_TIME
+
+/**
+ * @name Tipi di record
+ * @{
+ */
+#define GPIO_TRACE_READ     0       ///< Lettura di un registro: value è il valore letto
+#define GPIO_TRACE_WRITE    1       ///< Scrittura di un registro: value è il valore scritto
+#define GPIO_TRACE_IRQ      2       ///< Ingresso nel gestore dell'interruzione
+#define GPIO_TRACE_TIME     3       ///< value sono i 32 bit alti del tempo
+#define GPIO_TRACE_DEVICE   4       ///< Nuova periferica: value sono i 32 bit bassi dell'indirizzo base
+/* @} */
+
+/**************************** Type Definitions *******************************/
+/**
+ * @brief Intestazione della traccia.
+ */
+typedef struct {
+	uint32_t magic;           ///< GPIO_TRACE_MAGIC
+	uint16_t version;         ///< GPIO_TRACE_VERSION
+	uint16_t record_size;     ///< sizeof(gpio_trace_record)
+	uint64_t start_ns;        ///< Istante di inizio della registrazione, nell'orologio del registratore
+	uint32_t records;         ///< Record che seguono l'intestazione
+	uint32_t dropped;         ///< Record persi per esaurimento del buffer
+} gpio_trace_header;
+
+/**
+ * @brief Record della traccia.
+ */
+typedef struct {
+	uint32_t time;            ///< 32 bit bassi dei nanosecondi trascorsi da start_ns
+	uint8_t type;             ///< GPIO_TRACE_*
+	uint8_t device;           ///< Indice della periferica
+	uint8_t offset;           ///< Spiazzamento del registro (GPIO_*_OFFSET)
+	uint8_t reserved;
+	uint32_t value;
+} gpio_trace_record;
+
+#endif /* GPIO_TRACE_H */
+/** @} */
+/** @} */
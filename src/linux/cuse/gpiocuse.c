@@ -0,0 +1,918 @@
+/**
+* @file gpiocuse.c
+* @brief Emulazione in user-space del device file /dev/gpioN del modulo kernel, basata su CUSE.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup LINUX
+* @{
+*
+* @addtogroup CUSE
+* @{
+*
+* @details Il demone crea attraverso /dev/cuse un device file /dev/gpioN servito da un
+* 	modello dei registri della periferica in memoria, così che driver.c, gpiobench e gli
+* 	altri client del modulo kernel possano essere provati su una macchina qualsiasi:
+*
+* 		sudo modprobe cuse
+* 		sudo ./gpiocuse -n gpio1 -c /tmp/gpio1.ctl
+*
+* 	Il protocollo è quello descritto in gpiodrv.h:
+* 	- read restituisce gli eventi (struct gpio_event) che soddisfano il filtro del file
+* 	  aperto, bloccando se la coda è vuota (-EAGAIN con O_NONBLOCK);
+* 	- write scrive le parole a 32 bit una dopo l'altra nel registro DOUT;
+* 	- poll segnala POLLIN quando la coda del file non è vuota;
+* 	- GPIO_IOC_BATCH, GPIO_IOC_SET_FILTER e GPIO_IOC_GET_FILTER hanno la stessa semantica
+* 	  del modulo kernel.
+*
+* 	Il kernel passa a CUSE sempre la posizione 0, per cui pread e pwrite non raggiungono i
+* 	registri ma il flusso: i registri vanno letti e scritti con GPIO_IOC_BATCH. La mmap
+* 	(registri, ring e buffer di acquisizione) e le ioctl di riproduzione ed acquisizione
+* 	non sono disponibili.
+*
+* 	Le interruzioni si iniettano scrivendo sulla FIFO di controllo (opzione -c) righe con
+* 	la stessa sintassi del file inject delle periferiche simulate del modulo:
+*
+* 		echo "0x1 0x1 1000" > /tmp/gpio1.ctl
+*
+* 	oppure con il generatore periodico (opzione -r), che ad ogni periodo commuta i pin
+* 	indicati con -m. La riga "stats" stampa i contatori del demone.
+*
+* 	Il demone è a singolo thread: le letture bloccanti non occupano un thread ma restano
+* 	in attesa come richieste FUSE senza risposta, per cui il numero di lettori concorrenti
+* 	è limitato solo dalla memoria.
+*/
+/** @} */
+/** @} */
+/***************************** Include Files ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <linux/fuse.h>
+
+#include "gpiodrv.h"
+
+/************************** Constant Definitions *****************************/
+#define GPIO_CUSE_MAX_IO      65536   ///< Dimensione massima di una read o di una write servita
+#define GPIO_CUSE_FIFO_SIZE   64      ///< Eventi accodabili per file aperto (come GPIO_EVENT_FIFO_SIZE)
+#define GPIO_CUSE_REGS_SIZE   24      ///< Dimensione del banco di registri
+#define GPIO_CUSE_CTL_LINE    128     ///< Lunghezza massima di una riga della FIFO di controllo
+
+/**************************** Type Definitions ******************************/
+/**
+* @brief Richiesta di lettura in attesa di eventi.
+*/
+struct gpio_cuse_req {
+	uint64_t unique;                ///< Identificativo della richiesta FUSE
+	uint32_t size;                  ///< Dimensione del buffer del processo
+	struct gpio_cuse_req *next;     ///< Richiesta successiva dello stesso file
+};
+
+/**
+* @brief File aperto sul device emulato.
+*/
+struct gpio_cuse_file {
+	struct gpio_filter filter;      ///< Filtro degli eventi
+	struct gpio_event events[GPIO_CUSE_FIFO_SIZE];  ///< Coda degli eventi
+	unsigned int head, tail;        ///< Indici liberi della coda
+	uint32_t seq;                   ///< Numero di sequenza del prossimo evento
+	uint32_t overflow;              ///< Eventi persi dall'ultimo evento accodato
+	uint64_t last_ns;               ///< Istante dell'ultimo evento consegnato
+	struct gpio_cuse_req *reads;    ///< Letture in attesa, in ordine di arrivo
+	struct gpio_cuse_req **reads_tail;
+	uint64_t poll_kh;               ///< Handle della poll da notificare (0 = nessuna)
+	struct gpio_cuse_file *prev, *next;
+};
+
+/**
+* @brief Stato del dispositivo emulato.
+*/
+struct gpio_cuse_dev {
+	int fd;                         ///< Descrittore di /dev/cuse
+	uint32_t dout, tri, din, ier, isr;  ///< Registri simulati
+	uint32_t last_value;            ///< Stato dei pin all'evento precedente
+	struct gpio_cuse_file *files;   ///< File aperti
+	unsigned int nfiles;
+	uint64_t irqs, events, overflows, reads, blocked_reads, writes, write_words, ioctls;
+};
+
+/************************** Function Prototypes *****************************/
+static uint64_t gpio_cuse_now(void);
+static int gpio_cuse_reply(struct gpio_cuse_dev *dev, uint64_t unique, int error, struct iovec *iov, int iovcnt);
+static int gpio_cuse_reply_data(struct gpio_cuse_dev *dev, uint64_t unique, const void *data, size_t len);
+static void gpio_cuse_init(struct gpio_cuse_dev *dev, struct fuse_in_header *in, const char *name);
+static void gpio_cuse_open(struct gpio_cuse_dev *dev, struct fuse_in_header *in);
+static void gpio_cuse_release(struct gpio_cuse_dev *dev, struct fuse_in_header *in);
+static unsigned int gpio_cuse_pull(struct gpio_cuse_file *file, struct gpio_event *events, unsigned int max);
+static void gpio_cuse_read(struct gpio_cuse_dev *dev, struct fuse_in_header *in);
+static void gpio_cuse_write(struct gpio_cuse_dev *dev, struct fuse_in_header *in);
+static void gpio_cuse_ioctl_retry(struct gpio_cuse_dev *dev, uint64_t unique,
+		struct fuse_ioctl_iovec *iov, unsigned int in_iovs, unsigned int out_iovs);
+static void gpio_cuse_ioctl_done(struct gpio_cuse_dev *dev, uint64_t unique, int result, const void *data, size_t len);
+static void gpio_cuse_ioctl(struct gpio_cuse_dev *dev, struct fuse_in_header *in);
+static void gpio_cuse_poll(struct gpio_cuse_dev *dev, struct fuse_in_header *in);
+static void gpio_cuse_interrupt(struct gpio_cuse_dev *dev, struct fuse_in_header *in);
+static void gpio_cuse_batch_op(struct gpio_cuse_dev *dev, struct gpio_op *op);
+static int gpio_cuse_filter_match(struct gpio_cuse_file *file, struct gpio_event *event, uint32_t last_value);
+static void gpio_cuse_irq(struct gpio_cuse_dev *dev);
+static void gpio_cuse_deliver(struct gpio_cuse_dev *dev, struct gpio_cuse_file *file);
+static void gpio_cuse_inject(struct gpio_cuse_dev *dev, uint32_t pending, uint32_t value);
+static void gpio_cuse_control(struct gpio_cuse_dev *dev, int ctl_fd);
+static void gpio_cuse_stats(struct gpio_cuse_dev *dev);
+static void usage(const char *prog);
+
+/**
+*
+* @addtogroup LINUX
+* @{
+*
+* @addtogroup CUSE
+* @{
+*/
+int main(int argc, char *argv[])
+{
+	static char buf[GPIO_CUSE_MAX_IO + 4096];
+	struct gpio_cuse_dev dev;
+	struct fuse_in_header *in = (struct fuse_in_header *)buf;
+	struct pollfd pfd[3];
+	struct itimerspec its;
+	const char *name = "gpio0", *ctl_path = NULL;
+	double rate = 0;
+	uint32_t toggle_mask = 0x1, value;
+	uint64_t expirations;
+	ssize_t len;
+	int opt, ctl_fd = -1, timer_fd = -1, nfds;
+
+	while((opt = getopt(argc, argv, "n:c:r:m:h")) != -1){
+		switch(opt){
+			case 'n': name = optarg; break;
+			case 'c': ctl_path = optarg; break;
+			case 'r': rate = atof(optarg); break;
+			case 'm': toggle_mask = strtoul(optarg, NULL, 0); break;
+			default: usage(argv[0]); return EXIT_FAILURE;
+		}
+	}
+
+	memset(&dev, 0, sizeof(dev));
+	dev.ier = 0xF;
+
+	dev.fd = open("/dev/cuse", O_RDWR | O_CLOEXEC);
+	if(dev.fd < 0){
+		printf("Apertura di /dev/cuse non riuscita! Errore: %s\n", strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	// La FIFO è aperta anche in scrittura così che la chiusura dei client non produca EOF
+	if(ctl_path){
+		if(mkfifo(ctl_path, 0666) < 0 && errno != EEXIST){
+			printf("Creazione della FIFO %s non riuscita! Errore: %s\n", ctl_path, strerror(errno));
+			return EXIT_FAILURE;
+		}
+		ctl_fd = open(ctl_path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+		if(ctl_fd < 0){
+			printf("Apertura della FIFO %s non riuscita! Errore: %s\n", ctl_path, strerror(errno));
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(rate > 0){
+		long long period = (long long)(1e9 / rate);
+
+		timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+		its.it_interval.tv_sec = period / 1000000000LL;
+		its.it_interval.tv_nsec = period % 1000000000LL;
+		its.it_value = its.it_interval;
+		if(timer_fd < 0 || timerfd_settime(timer_fd, 0, &its, NULL) < 0){
+			printf("Avvio del generatore non riuscito! Errore: %s\n", strerror(errno));
+			return EXIT_FAILURE;
+		}
+	}
+
+	pfd[0].fd = dev.fd;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = ctl_fd;
+	pfd[1].events = POLLIN;
+	pfd[2].fd = timer_fd;
+	pfd[2].events = POLLIN;
+	nfds = 3;
+
+	for(;;){
+		if(poll(pfd, nfds, -1) < 0){
+			if(errno == EINTR)
+				continue;
+			break;
+		}
+
+		if(pfd[2].revents & POLLIN){
+			if(read(timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations)){
+				// Ogni periodo commuta i pin: la periferica rileva i soli fronti di salita
+				while(expirations--){
+					value = dev.din ^ toggle_mask;
+					gpio_cuse_inject(&dev, value & ~dev.din, value);
+				}
+			}
+		}
+
+		if(pfd[1].revents & POLLIN)
+			gpio_cuse_control(&dev, ctl_fd);
+
+		if(!(pfd[0].revents & (POLLIN | POLLERR | POLLHUP)))
+			continue;
+
+		len = read(dev.fd, buf, sizeof(buf));
+		if(len < 0){
+			// ENOENT: la richiesta è stata interrotta prima di essere letta
+			if(errno == EINTR || errno == EAGAIN || errno == ENOENT)
+				continue;
+			if(errno != ENODEV)
+				printf("Lettura da /dev/cuse non riuscita! Errore: %s\n", strerror(errno));
+			break;
+		}
+		if(len < (ssize_t)sizeof(*in) || in->len != (uint32_t)len)
+			continue;
+
+		switch(in->opcode){
+			case CUSE_INIT: gpio_cuse_init(&dev, in, name); break;
+			case FUSE_OPEN: gpio_cuse_open(&dev, in); break;
+			case FUSE_RELEASE: gpio_cuse_release(&dev, in); break;
+			case FUSE_READ: gpio_cuse_read(&dev, in); break;
+			case FUSE_WRITE: gpio_cuse_write(&dev, in); break;
+			case FUSE_IOCTL: gpio_cuse_ioctl(&dev, in); break;
+			case FUSE_POLL: gpio_cuse_poll(&dev, in); break;
+			case FUSE_INTERRUPT: gpio_cuse_interrupt(&dev, in); break;
+			case FUSE_DESTROY: gpio_cuse_reply(&dev, in->unique, 0, NULL, 0); goto out;
+			default: gpio_cuse_reply(&dev, in->unique, -ENOSYS, NULL, 0); break;
+		}
+	}
+
+out:
+	gpio_cuse_stats(&dev);
+	close(dev.fd);
+	return 0;
+}
+
+/**
+* @brief Restituisce l'istante corrente in nanosecondi (CLOCK_MONOTONIC, come il modulo).
+*/
+static uint64_t gpio_cuse_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+* @brief Invia la risposta alla richiesta unique.
+*
+* @param error è 0 oppure -errno.
+* @param iov sono i dati della risposta (ignorati se error è diverso da 0).
+*
+* @return 0 in caso di successo, -1 altrimenti. ENOENT indica che la richiesta era già
+* 	stata interrotta ed è ignorato.
+*/
+static int gpio_cuse_reply(struct gpio_cuse_dev *dev, uint64_t unique, int error, struct iovec *iov, int iovcnt)
+{
+	struct fuse_out_header out;
+	struct iovec vec[4];
+	int i;
+
+	out.len = sizeof(out);
+	out.error = error;
+	out.unique = unique;
+	vec[0].iov_base = &out;
+	vec[0].iov_len = sizeof(out);
+	if(error != 0)
+		iovcnt = 0;
+	for(i = 0; i < iovcnt; i++){
+		vec[i + 1] = iov[i];
+		out.len += iov[i].iov_len;
+	}
+
+	if(writev(dev->fd, vec, iovcnt + 1) < 0 && errno != ENOENT){
+		printf("Risposta a /dev/cuse non riuscita! Errore: %s\n", strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+/**
+* @brief Invia una risposta con un solo buffer di dati.
+*/
+static int gpio_cuse_reply_data(struct gpio_cuse_dev *dev, uint64_t unique, const void *data, size_t len)
+{
+	struct iovec iov;
+
+	iov.iov_base = (void *)data;
+	iov.iov_len = len;
+	return gpio_cuse_reply(dev, unique, 0, &iov, 1);
+}
+
+/**
+* @brief Risponde a CUSE_INIT con il nome del device file da creare.
+*
+* @details Il major ed il minor number sono assegnati dal kernel.
+*/
+static void gpio_cuse_init(struct gpio_cuse_dev *dev, struct fuse_in_header *in, const char *name)
+{
+	struct cuse_init_in *arg = (struct cuse_init_in *)(in + 1);
+	struct cuse_init_out out;
+	struct iovec iov[2];
+	char info[64];
+
+	if(arg->major != FUSE_KERNEL_VERSION){
+		printf("Versione del protocollo FUSE non supportata (%u.%u)\n", arg->major, arg->minor);
+		gpio_cuse_reply(dev, in->unique, -EPROTO, NULL, 0);
+		return;
+	}
+
+	memset(&out, 0, sizeof(out));
+	out.major = FUSE_KERNEL_VERSION;
+	out.minor = arg->minor < FUSE_KERNEL_MINOR_VERSION ? arg->minor : FUSE_KERNEL_MINOR_VERSION;
+	out.flags = CUSE_UNRESTRICTED_IOCTL;
+	out.max_read = GPIO_CUSE_MAX_IO;
+	out.max_write = GPIO_CUSE_MAX_IO;
+
+	// Le informazioni sul device sono stringhe chiave=valore terminate da '\0'
+	iov[0].iov_base = &out;
+	iov[0].iov_len = sizeof(out);
+	iov[1].iov_base = info;
+	iov[1].iov_len = snprintf(info, sizeof(info), "DEVNAME=%s", name) + 1;
+
+	if(gpio_cuse_reply(dev, in->unique, 0, iov, 2) == 0)
+		printf("Device file /dev/%s creato\n", name);
+}
+
+/**
+* @brief Apertura del device file: crea il file aperto con il filtro di default.
+*/
+static void gpio_cuse_open(struct gpio_cuse_dev *dev, struct fuse_in_header *in)
+{
+	struct gpio_cuse_file *file;
+	struct fuse_open_out out;
+
+	file = calloc(1, sizeof(*file));
+	if(!file){
+		gpio_cuse_reply(dev, in->unique, -ENOMEM, NULL, 0);
+		return;
+	}
+
+	// Filtro di default: tutti i fronti di salita su tutti i pin
+	file->filter.mask = ~0U;
+	file->filter.edges = GPIO_EDGE_RISING;
+	file->reads_tail = &file->reads;
+
+	file->next = dev->files;
+	if(dev->files)
+		dev->files->prev = file;
+	dev->files = file;
+	dev->nfiles++;
+
+	memset(&out, 0, sizeof(out));
+	out.fh = (uintptr_t)file;
+	out.open_flags = FOPEN_DIRECT_IO;
+	gpio_cuse_reply_data(dev, in->unique, &out, sizeof(out));
+}
+
+/**
+* @brief Chiusura del device file.
+*
+* @note Il kernel invia FUSE_RELEASE solo quando non ci sono più operazioni in corso sul
+* 	file, per cui la lista delle letture in attesa è vuota.
+*/
+static void gpio_cuse_release(struct gpio_cuse_dev *dev, struct fuse_in_header *in)
+{
+	struct fuse_release_in *arg = (struct fuse_release_in *)(in + 1);
+	struct gpio_cuse_file *file = (struct gpio_cuse_file *)(uintptr_t)arg->fh;
+	struct gpio_cuse_req *req;
+
+	while((req = file->reads) != NULL){
+		file->reads = req->next;
+		gpio_cuse_reply(dev, req->unique, -EBADF, NULL, 0);
+		free(req);
+	}
+
+	if(file->prev)
+		file->prev->next = file->next;
+	else
+		dev->files = file->next;
+	if(file->next)
+		file->next->prev = file->prev;
+	dev->nfiles--;
+	free(file);
+
+	gpio_cuse_reply(dev, in->unique, 0, NULL, 0);
+}
+
+/**
+* @brief Estrae dalla coda del file al più max eventi.
+*/
+static unsigned int gpio_cuse_pull(struct gpio_cuse_file *file, struct gpio_event *events, unsigned int max)
+{
+	unsigned int n;
+
+	for(n = 0; n < max && file->tail != file->head; n++, file->tail++)
+		events[n] = file->events[file->tail % GPIO_CUSE_FIFO_SIZE];
+	return n;
+}
+
+/**
+* @brief Lettura dal device file.
+*
+* @details Se la coda del file non è vuota la richiesta è servita subito con tanti eventi
+* 	quanti ne entrano nel buffer; altrimenti resta in attesa (senza risposta) fino al
+* 	prossimo evento che soddisfa il filtro, oppure termina con -EAGAIN se il file è stato
+* 	aperto con O_NONBLOCK. Le letture in attesa sullo stesso file sono servite in ordine
+* 	di arrivo, come accade con il read_mutex del modulo.
+*/
+static void gpio_cuse_read(struct gpio_cuse_dev *dev, struct fuse_in_header *in)
+{
+	struct fuse_read_in *arg = (struct fuse_read_in *)(in + 1);
+	struct gpio_cuse_file *file = (struct gpio_cuse_file *)(uintptr_t)arg->fh;
+	struct gpio_event events[GPIO_CUSE_FIFO_SIZE];
+	struct gpio_cuse_req *req;
+	unsigned int n;
+
+	if(arg->size < sizeof(struct gpio_event)){
+		gpio_cuse_reply(dev, in->unique, -EINVAL, NULL, 0);
+		return;
+	}
+
+	if(file->reads == NULL && file->head != file->tail){
+		n = gpio_cuse_pull(file, events, arg->size / sizeof(struct gpio_event));
+		dev->reads++;
+		gpio_cuse_reply_data(dev, in->unique, events, n * sizeof(struct gpio_event));
+		return;
+	}
+
+	if(arg->flags & O_NONBLOCK){
+		gpio_cuse_reply(dev, in->unique, -EAGAIN, NULL, 0);
+		return;
+	}
+
+	req = malloc(sizeof(*req));
+	if(!req){
+		gpio_cuse_reply(dev, in->unique, -ENOMEM, NULL, 0);
+		return;
+	}
+	req->unique = in->unique;
+	req->size = arg->size;
+	req->next = NULL;
+	*file->reads_tail = req;
+	file->reads_tail = &req->next;
+	dev->blocked_reads++;
+}
+
+/**
+* @brief Scrittura sul device file: le parole a 32 bit sono scritte in sequenza su DOUT.
+*/
+static void gpio_cuse_write(struct gpio_cuse_dev *dev, struct fuse_in_header *in)
+{
+	struct fuse_write_in *arg = (struct fuse_write_in *)(in + 1);
+	struct fuse_write_out out;
+	uint32_t word;
+	const char *data = (const char *)(arg + 1);
+	unsigned int i;
+
+	if(arg->size % 4 != 0){
+		gpio_cuse_reply(dev, in->unique, -EINVAL, NULL, 0);
+		return;
+	}
+
+	for(i = 0; i < arg->size; i += 4){
+		memcpy(&word, data + i, 4);
+		dev->dout = word;
+	}
+	dev->writes++;
+	dev->write_words += arg->size / 4;
+
+	memset(&out, 0, sizeof(out));
+	out.size = arg->size;
+	gpio_cuse_reply_data(dev, in->unique, &out, sizeof(out));
+}
+
+/**
+* @brief Chiede al kernel di ripetere una ioctl copiando le aree di memoria indicate.
+*
+* @details Con CUSE_UNRESTRICTED_IOCTL il kernel non interpreta il comando: la prima
+* 	richiesta non contiene dati ed il demone indica quali aree del processo copiare in
+* 	ingresso (in) ed in uscita (out). Le aree in ingresso sono concatenate, nell'ordine,
+* 	dopo la struct fuse_ioctl_in della richiesta successiva.
+*/
+static void gpio_cuse_ioctl_retry(struct gpio_cuse_dev *dev, uint64_t unique,
+		struct fuse_ioctl_iovec *iov, unsigned int in_iovs, unsigned int out_iovs)
+{
+	struct fuse_ioctl_out out;
+	struct iovec vec[2];
+
+	memset(&out, 0, sizeof(out));
+	out.flags = FUSE_IOCTL_RETRY;
+	out.in_iovs = in_iovs;
+	out.out_iovs = out_iovs;
+
+	vec[0].iov_base = &out;
+	vec[0].iov_len = sizeof(out);
+	vec[1].iov_base = iov;
+	vec[1].iov_len = (in_iovs + out_iovs) * sizeof(*iov);
+	gpio_cuse_reply(dev, unique, 0, vec, 2);
+}
+
+/**
+* @brief Risponde ad una ioctl completata con il risultato e gli eventuali dati in uscita.
+*/
+static void gpio_cuse_ioctl_done(struct gpio_cuse_dev *dev, uint64_t unique, int result, const void *data, size_t len)
+{
+	struct fuse_ioctl_out out;
+	struct iovec vec[2];
+
+	memset(&out, 0, sizeof(out));
+	out.result = result;
+
+	vec[0].iov_base = &out;
+	vec[0].iov_len = sizeof(out);
+	vec[1].iov_base = (void *)data;
+	vec[1].iov_len = len;
+	gpio_cuse_reply(dev, unique, 0, vec, len ? 2 : 1);
+}
+
+/**
+* @brief ioctl sul device file.
+*
+* @details Sono supportate GPIO_IOC_BATCH, GPIO_IOC_SET_FILTER e GPIO_IOC_GET_FILTER, con
+* 	la stessa validazione del modulo; le altre restituiscono -ENOTTY. GPIO_IOC_BATCH
+* 	richiede due ripetizioni: la prima per leggere la struct gpio_batch, la seconda per
+* 	leggere e riscrivere l'array di operazioni al quale punta.
+*/
+static void gpio_cuse_ioctl(struct gpio_cuse_dev *dev, struct fuse_in_header *in)
+{
+	struct fuse_ioctl_in *arg = (struct fuse_ioctl_in *)(in + 1);
+	struct gpio_cuse_file *file = (struct gpio_cuse_file *)(uintptr_t)arg->fh;
+	const char *data = (const char *)(arg + 1);
+	struct fuse_ioctl_iovec iov[3];
+	struct gpio_filter filter;
+	struct gpio_batch batch;
+	struct gpio_op ops[GPIO_BATCH_MAX];
+	size_t ops_len;
+	unsigned int i;
+
+	dev->ioctls++;
+
+	switch(arg->cmd){
+		case GPIO_IOC_SET_FILTER:
+			if(arg->in_size < sizeof(filter)){
+				iov[0].base = arg->arg;
+				iov[0].len = sizeof(filter);
+				gpio_cuse_ioctl_retry(dev, in->unique, iov, 1, 0);
+				return;
+			}
+			memcpy(&filter, data, sizeof(filter));
+			if(filter.edges & ~(GPIO_EDGE_RISING | GPIO_EDGE_FALLING) || filter.value_match & ~filter.value_mask){
+				gpio_cuse_reply(dev, in->unique, -EINVAL, NULL, 0);
+				return;
+			}
+			file->filter = filter;
+			file->last_ns = 0;
+			gpio_cuse_ioctl_done(dev, in->unique, 0, NULL, 0);
+			return;
+
+		case GPIO_IOC_GET_FILTER:
+			if(arg->out_size < sizeof(filter)){
+				iov[0].base = arg->arg;
+				iov[0].len = sizeof(filter);
+				gpio_cuse_ioctl_retry(dev, in->unique, iov, 0, 1);
+				return;
+			}
+			gpio_cuse_ioctl_done(dev, in->unique, 0, &file->filter, sizeof(file->filter));
+			return;
+
+		case GPIO_IOC_BATCH:
+			if(arg->in_size < sizeof(batch)){
+				iov[0].base = arg->arg;
+				iov[0].len = sizeof(batch);
+				gpio_cuse_ioctl_retry(dev, in->unique, iov, 1, 0);
+				return;
+			}
+			memcpy(&batch, data, sizeof(batch));
+			if(batch.count == 0 || batch.count > GPIO_BATCH_MAX || batch.reserved != 0){
+				gpio_cuse_reply(dev, in->unique, -EINVAL, NULL, 0);
+				return;
+			}
+			ops_len = batch.count * sizeof(struct gpio_op);
+			if(arg->in_size < sizeof(batch) + ops_len){
+				iov[0].base = arg->arg;
+				iov[0].len = sizeof(batch);
+				iov[1].base = batch.ops;
+				iov[1].len = ops_len;
+				iov[2] = iov[1];
+				gpio_cuse_ioctl_retry(dev, in->unique, iov, 2, 1);
+				return;
+			}
+			memcpy(ops, data + sizeof(batch), ops_len);
+
+			// Tutte le operazioni sono validate prima di toccare i registri
+			for(i = 0; i < batch.count; i++){
+				if(ops[i].offset > GPIO_REG_ISR || ops[i].offset % 4 != 0 || ops[i].code > GPIO_OP_READ ||
+				   (ops[i].code != GPIO_OP_READ && ops[i].offset != GPIO_REG_DOUT &&
+				    ops[i].offset != GPIO_REG_TRI && ops[i].offset != GPIO_REG_IER)){
+					gpio_cuse_reply(dev, in->unique, -EINVAL, NULL, 0);
+					return;
+				}
+			}
+			for(i = 0; i < batch.count; i++)
+				gpio_cuse_batch_op(dev, &ops[i]);
+			gpio_cuse_ioctl_done(dev, in->unique, 0, ops, ops_len);
+
+			// Un'abilitazione in IER serve le interruzioni già pendenti
+			gpio_cuse_irq(dev);
+			return;
+
+		default:
+			gpio_cuse_reply(dev, in->unique, -ENOTTY, NULL, 0);
+			return;
+	}
+}
+
+/**
+* @brief poll sul device file: POLLIN se la coda del file non è vuota, POLLOUT sempre.
+*
+* @details Se il kernel lo richiede, l'handle della poll viene conservato e notificato
+* 	all'arrivo del prossimo evento consegnato al file.
+*/
+static void gpio_cuse_poll(struct gpio_cuse_dev *dev, struct fuse_in_header *in)
+{
+	struct fuse_poll_in *arg = (struct fuse_poll_in *)(in + 1);
+	struct gpio_cuse_file *file = (struct gpio_cuse_file *)(uintptr_t)arg->fh;
+	struct fuse_poll_out out;
+
+	memset(&out, 0, sizeof(out));
+	out.revents = POLLOUT | POLLWRNORM;
+	if(file->head != file->tail)
+		out.revents |= POLLIN | POLLRDNORM;
+
+	if(arg->flags & FUSE_POLL_SCHEDULE_NOTIFY)
+		file->poll_kh = arg->kh;
+
+	gpio_cuse_reply_data(dev, in->unique, &out, sizeof(out));
+}
+
+/**
+* @brief Interruzione di una richiesta (segnale al processo): se si tratta di una lettura
+* 	in attesa, termina con -EINTR.
+*/
+static void gpio_cuse_interrupt(struct gpio_cuse_dev *dev, struct fuse_in_header *in)
+{
+	struct fuse_interrupt_in *arg = (struct fuse_interrupt_in *)(in + 1);
+	struct gpio_cuse_file *file;
+	struct gpio_cuse_req **pp, *req;
+
+	for(file = dev->files; file; file = file->next){
+		for(pp = &file->reads; (req = *pp) != NULL; pp = &req->next){
+			if(req->unique != arg->unique)
+				continue;
+			*pp = req->next;
+			if(file->reads_tail == &req->next)
+				file->reads_tail = pp;
+			gpio_cuse_reply(dev, req->unique, -EINTR, NULL, 0);
+			free(req);
+			return;
+		}
+	}
+}
+
+/**
+* @brief Esegue un'operazione di GPIO_IOC_BATCH sul modello dei registri.
+*/
+static void gpio_cuse_batch_op(struct gpio_cuse_dev *dev, struct gpio_op *op)
+{
+	uint32_t *regs[GPIO_CUSE_REGS_SIZE/4] = { &dev->dout, &dev->tri, &dev->din, &dev->ier, NULL, &dev->isr };
+	uint32_t reg;
+
+	// ICL è in sola scrittura e si legge come 0
+	reg = regs[op->offset/4] ? *regs[op->offset/4] : 0;
+
+	switch(op->code){
+		case GPIO_OP_READ:
+			op->value = reg;
+			return;
+		case GPIO_OP_SET:
+			reg |= op->mask;
+			break;
+		case GPIO_OP_CLEAR:
+			reg &= ~op->mask;
+			break;
+		case GPIO_OP_TOGGLE:
+			reg ^= op->mask;
+			break;
+		case GPIO_OP_UPDATE:
+			reg = (reg & ~op->mask) | (op->value & op->mask);
+			break;
+	}
+	*regs[op->offset/4] = reg;
+}
+
+/**
+* @brief Verifica se un evento soddisfa il filtro di un file aperto (come gpio_filter_match).
+*/
+static int gpio_cuse_filter_match(struct gpio_cuse_file *file, struct gpio_event *event, uint32_t last_value)
+{
+	struct gpio_filter *filter = &file->filter;
+	uint32_t edges = 0;
+
+	if(filter->edges & GPIO_EDGE_RISING)
+		edges |= event->pending;
+	if(filter->edges & GPIO_EDGE_FALLING)
+		edges |= last_value & ~event->value;
+
+	if(!(edges & filter->mask))
+		return 0;
+	if((event->value & filter->value_mask) != filter->value_match)
+		return 0;
+	if(filter->min_interval_ns && file->last_ns && event->timestamp - file->last_ns < filter->min_interval_ns)
+		return 0;
+	return 1;
+}
+
+/**
+* @brief Serve l'interruzione della periferica simulata, se presente.
+*
+* @details Come gpio_take_snapshot e gpio_queue_event del modulo: ISR è letto e azzerato
+* 	(ICL) e l'evento è consegnato ad ogni file il cui filtro è soddisfatto. Se la coda
+* 	di un file è piena l'evento è contato nel campo overflow del successivo.
+*/
+static void gpio_cuse_irq(struct gpio_cuse_dev *dev)
+{
+	struct gpio_cuse_file *file;
+	struct gpio_event event;
+
+	if(!(dev->isr & dev->ier))
+		return;
+
+	event.timestamp = gpio_cuse_now();
+	event.pending = dev->isr;
+	event.value = dev->din;
+	dev->isr = 0;
+	dev->irqs++;
+
+	for(file = dev->files; file; file = file->next){
+		if(!gpio_cuse_filter_match(file, &event, dev->last_value))
+			continue;
+
+		if(file->head - file->tail == GPIO_CUSE_FIFO_SIZE){
+			file->overflow++;
+			dev->overflows++;
+			continue;
+		}
+
+		event.overflow = file->overflow;
+		event.seq = file->seq++;
+		file->overflow = 0;
+		file->last_ns = event.timestamp;
+		file->events[file->head++ % GPIO_CUSE_FIFO_SIZE] = event;
+		dev->events++;
+
+		gpio_cuse_deliver(dev, file);
+	}
+
+	dev->last_value = event.value;
+}
+
+/**
+* @brief Risveglia le letture in attesa e la poll di un file che ha ricevuto eventi.
+*/
+static void gpio_cuse_deliver(struct gpio_cuse_dev *dev, struct gpio_cuse_file *file)
+{
+	struct gpio_event events[GPIO_CUSE_FIFO_SIZE];
+	struct fuse_out_header out;
+	struct fuse_notify_poll_wakeup_out wakeup;
+	struct gpio_cuse_req *req;
+	struct iovec vec[2];
+	unsigned int n;
+
+	while((req = file->reads) != NULL && file->head != file->tail){
+		file->reads = req->next;
+		if(file->reads == NULL)
+			file->reads_tail = &file->reads;
+
+		n = gpio_cuse_pull(file, events, req->size / sizeof(struct gpio_event));
+		dev->reads++;
+		gpio_cuse_reply_data(dev, req->unique, events, n * sizeof(struct gpio_event));
+		free(req);
+	}
+
+	// La notifica è una risposta non richiesta: unique vale 0 ed error il codice della notifica
+	if(file->poll_kh && file->head != file->tail){
+		out.len = sizeof(out) + sizeof(wakeup);
+		out.error = FUSE_NOTIFY_POLL;
+		out.unique = 0;
+		wakeup.kh = file->poll_kh;
+		vec[0].iov_base = &out;
+		vec[0].iov_len = sizeof(out);
+		vec[1].iov_base = &wakeup;
+		vec[1].iov_len = sizeof(wakeup);
+		if(writev(dev->fd, vec, 2) < 0)
+			printf("Notifica della poll non riuscita! Errore: %s\n", strerror(errno));
+		file->poll_kh = 0;
+	}
+}
+
+/**
+* @brief Imposta lo stato dei pin, marca pendenti i pin indicati e serve l'interruzione.
+*
+* @details Come nella periferica, ISR registra i fronti anche se mascherati in IER:
+* 	restano pendenti finché non vengono abilitati.
+*/
+static void gpio_cuse_inject(struct gpio_cuse_dev *dev, uint32_t pending, uint32_t value)
+{
+	dev->din = value;
+	dev->isr |= pending;
+	gpio_cuse_irq(dev);
+}
+
+/**
+* @brief Esegue i comandi presenti sulla FIFO di controllo.
+*
+* @details Ogni riga contiene "pending value [count]" (valori anche esadecimali), come
+* 	il file inject delle periferiche simulate del modulo, oppure "stats".
+*/
+static void gpio_cuse_control(struct gpio_cuse_dev *dev, int ctl_fd)
+{
+	static char line[GPIO_CUSE_CTL_LINE];
+	static size_t used;
+	unsigned int pending, value, count, i;
+	char *nl;
+	ssize_t len;
+
+	len = read(ctl_fd, line + used, sizeof(line) - 1 - used);
+	if(len <= 0)
+		return;
+	used += len;
+	line[used] = '\0';
+
+	while((nl = strchr(line, '\n')) != NULL){
+		*nl = '\0';
+		count = 1;
+		if(strncmp(line, "stats", 5) == 0)
+			gpio_cuse_stats(dev);
+		else if(sscanf(line, "%i %i %u", &pending, &value, &count) >= 2)
+			for(i = 0; i < count; i++)
+				gpio_cuse_inject(dev, pending, value);
+		else
+			printf("Comando non riconosciuto: %s\n", line);
+
+		used -= nl + 1 - line;
+		memmove(line, nl + 1, used + 1);
+	}
+
+	// Una riga troppo lunga viene scartata
+	if(used == sizeof(line) - 1)
+		used = 0;
+}
+
+/**
+* @brief Stampa i contatori del dispositivo emulato.
+*/
+static void gpio_cuse_stats(struct gpio_cuse_dev *dev)
+{
+	printf("file aperti: %u\n", dev->nfiles);
+	printf("interruzioni: %llu, eventi consegnati: %llu, eventi persi: %llu\n",
+		(unsigned long long)dev->irqs, (unsigned long long)dev->events, (unsigned long long)dev->overflows);
+	printf("letture: %llu (in attesa: %llu), scritture: %llu (parole: %llu), ioctl: %llu\n",
+		(unsigned long long)dev->reads, (unsigned long long)dev->blocked_reads,
+		(unsigned long long)dev->writes, (unsigned long long)dev->write_words, (unsigned long long)dev->ioctls);
+	printf("DOUT 0x%08x TRI 0x%08x DIN 0x%08x IER 0x%08x\n", dev->dout, dev->tri, dev->din, dev->ier);
+	fflush(stdout);
+}
+
+/**
+* @brief Stampa le opzioni del demone.
+*/
+static void usage(const char *prog)
+{
+	printf("Utilizzo: %s [-n nome] [-c fifo] [-r frequenza_hz] [-m maschera]\n", prog);
+	printf("  -n nome del device file da creare in /dev (default gpio0)\n");
+	printf("  -c FIFO di controllo per l'iniezione di interruzioni (\"pending value [count]\", \"stats\")\n");
+	printf("  -r frequenza del generatore periodico di interruzioni\n");
+	printf("  -m pin commutati dal generatore (default 0x1)\n");
+	printf("Es: sudo %s -n gpio1 -c /tmp/gpio1.ctl -r 1000 -m 0xF\n", prog);
+}
+/** @} */
+/** @} */
@@ -0,0 +1,655 @@
+/**
+* @file fakeuio.c
+* @brief Libreria da caricare con LD_PRELOAD che simula i device file UIO della periferica GPIO.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup LINUX
+* @{
+*
+* @addtogroup FAKE_UIO
+* @{
+*
+* @details La libreria intercetta open, read, write, mmap, munmap e close sui percorsi /dev/uioN,
+* 	così che uio e intuio girino senza modifiche su una macchina qualsiasi:
+*
+* 		LD_PRELOAD=../fakeuio/libfakeuio.so FAKEUIO_RATE=1000 ./intuio /dev/uio0 /dev/uio1 200
+*
+* 	Ogni dispositivo è un banco di registri in un memfd, mappato dal processo al posto
+* 	della memoria della periferica; il device file è un eventfd, sul quale la read blocca
+* 	fino all'interruzione e restituisce il conteggio delle interruzioni come UIO.
+* 	La write di 1 (0) abilita (disabilita) l'interruzione, che come con uio_pdrv_genirq
+* 	viene disabilitata ad ogni notifica.
+*
+* 	Un thread della libreria fa da periferica: applica gli stimoli, registra in ISR i
+* 	fronti di salita di DIN (anche se mascherati in IER) e genera l'interruzione quando
+* 	ISR & IER è diverso da 0, scandendo i registri ogni FAKEUIO_SCAN_US microsecondi
+* 	(0 = scansione continua, che occupa una CPU) ed inoltre ad ogni read e write sul
+* 	device file.
+*
+* 	Il processo scrive i registri con semplici store, che la libreria non intercetta:
+* 	la scrittura (acknowledge in ICL, valore dei pin in uscita in DOUT) è applicata alla
+* 	scansione successiva. Finché un banco è mappato in scrittura il periodo di scansione
+* 	è limitato a FAKEUIO_STORE_US microsecondi, così che un acknowledge diventi visibile
+* 	in ISR entro quel tempo; la libreria lo riporta nell'ambiente come
+* 	FAKEUIO_DEFERRED_STORES ed intuio, nella finestra di busy-polling, attende al più
+* 	questo tempo dopo ogni acknowledge per non servire più volte lo stesso fronte.
+*
+* 	Variabili d'ambiente:
+* 	- FAKEUIO_SCRIPT: file di stimoli, una riga "ritardo_us dispositivo valore" per ogni
+* 	  assegnamento di DIN (il ritardo è relativo alla riga precedente, # commenta);
+* 	- FAKEUIO_LOOP: se 1 il file di stimoli è ripetuto all'infinito;
+* 	- FAKEUIO_RATE: frequenza in Hz del generatore di impulsi sul dispositivo
+* 	  FAKEUIO_DEV (default 1) e sui pin FAKEUIO_MASK (default 0x1);
+* 	- FAKEUIO_POISSON: se 1 gli impulsi arrivano come processo di Poisson di frequenza
+* 	  media FAKEUIO_RATE invece che periodici;
+* 	- FAKEUIO_SCAN_US: periodo di scansione dei registri (default 20);
+* 	- FAKEUIO_STORE_US: periodo massimo di scansione con un banco mappato in scrittura
+* 	  (default 5).
+*
+* 	Alla terminazione del processo sono riportati su stderr, per ogni dispositivo, le
+* 	interruzioni generate, i fronti persi perché già pendenti e la latenza tra la
+* 	notifica dell'interruzione ed il ritorno della read.
+*/
+/** @} */
+/** @} */
+/***************************** Include Files ********************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/eventfd.h>
+
+#include "gpio_ll.h"
+
+/************************** Constant Definitions *****************************/
+#define FAKEUIO_PATH        "/dev/uio"  ///< Prefisso dei percorsi intercettati
+#define FAKEUIO_MAX_DEVS    8           ///< Dispositivi simulati (uio0 ... uio7)
+#define FAKEUIO_MAX_FD      1024        ///< Descrittori gestiti dalla tabella dei file aperti
+#define FAKEUIO_MAP_SIZE    0x10000     ///< Dimensione della regione mappabile (come GPIO_MAP_SIZE)
+#define FAKEUIO_PULSE_NS    100000      ///< Durata massima di un impulso del generatore
+#define FAKEUIO_MAX_MAPS    16          ///< Mappature dei banchi di registri nel processo
+
+/**************************** Type Definitions ******************************/
+/**
+* @brief Stimolo del file di script.
+*/
+struct fakeuio_stim {
+	uint64_t delay_ns;          ///< Ritardo rispetto allo stimolo precedente
+	unsigned int dev;           ///< Dispositivo
+	uint32_t value;             ///< Nuovo valore dei pin in ingresso
+};
+
+/**
+* @brief Dispositivo simulato.
+*/
+struct fakeuio_dev {
+	int memfd;                  ///< Banco di registri condiviso con il processo
+	volatile uint32_t *regs;    ///< Mappatura del banco usata dal thread
+	int opened;                 ///< 1 se il dispositivo è stato aperto almeno una volta
+	int irq_on;                 ///< Interruzione abilitata presso UIO
+	uint32_t pins;              ///< Valore dei pin in ingresso imposto dagli stimoli
+	uint32_t irq_count;         ///< Interruzioni notificate (valore restituito dalla read)
+	uint64_t fire_ns;           ///< Istante dell'ultima notifica
+	uint64_t lost;              ///< Fronti arrivati su pin già pendenti
+	uint64_t wakes, wake_sum_ns, wake_max_ns;  ///< Latenza notifica - ritorno della read
+};
+
+/**
+* @brief Mappatura di un banco di registri nel processo.
+*/
+struct fakeuio_map {
+	char *addr;                 ///< Indirizzo restituito dalla mmap, NULL se libera
+	size_t length;
+	int dev;                    ///< Dispositivo del banco
+	int writable;               ///< Mappato con PROT_WRITE
+};
+
+/************************** Variable Definitions *****************************/
+static ssize_t (*real_read)(int, void *, size_t);
+static ssize_t (*real_write)(int, const void *, size_t);
+static int (*real_open)(const char *, int, ...);
+static int (*real_openat)(int, const char *, int, ...);
+static int (*real_close)(int);
+static void *(*real_mmap)(void *, size_t, int, int, int, off_t);
+static int (*real_munmap)(void *, size_t);
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;  ///< Protegge lo stato dei dispositivi
+static pthread_t hw_thread;
+static int hw_started;
+static struct fakeuio_dev devs[FAKEUIO_MAX_DEVS];
+static signed char fd_dev[FAKEUIO_MAX_FD];                ///< Dispositivo di ogni descrittore (-1 = nessuno)
+
+static struct fakeuio_stim *script;
+static unsigned int script_len;
+static int script_loop;
+static double rate_hz;
+static int poisson;
+static unsigned int gen_dev = 1;
+static uint32_t gen_mask = 0x1;
+static uint64_t scan_ns = 20000;
+
+static struct fakeuio_map maps[FAKEUIO_MAX_MAPS];
+static unsigned int maps_rw;                              ///< Mappature scrivibili dei banchi
+static uint64_t store_ns = 5000;
+
+/************************** Function Prototypes *****************************/
+static uint64_t fakeuio_now(void);
+static void fakeuio_load_script(const char *path);
+static int fakeuio_path_dev(const char *path);
+static int fakeuio_open_dev(int n, int flags);
+static void fakeuio_scan(struct fakeuio_dev *dev);
+static void fakeuio_set_pins(struct fakeuio_dev *dev, uint32_t value);
+static void *fakeuio_hw(void *arg);
+static struct fakeuio_map *fakeuio_map_find(void *addr);
+static void fakeuio_init(void) __attribute__((constructor));
+static void fakeuio_report(void) __attribute__((destructor));
+
+/**
+*
+* @addtogroup FAKE_UIO
+* @{
+*/
+/**
+* @brief Restituisce l'istante corrente in nanosecondi (CLOCK_MONOTONIC).
+*/
+static uint64_t fakeuio_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+* @brief Risolve le funzioni reali e legge la configurazione dall'ambiente.
+*/
+static void fakeuio_init(void)
+{
+	const char *env;
+	char buf[24];
+
+	real_read = dlsym(RTLD_NEXT, "read");
+	real_write = dlsym(RTLD_NEXT, "write");
+	real_open = dlsym(RTLD_NEXT, "open");
+	real_openat = dlsym(RTLD_NEXT, "openat");
+	real_close = dlsym(RTLD_NEXT, "close");
+	real_mmap = dlsym(RTLD_NEXT, "mmap");
+	real_munmap = dlsym(RTLD_NEXT, "munmap");
+
+	memset(fd_dev, -1, sizeof(fd_dev));
+
+	if((env = getenv("FAKEUIO_SCRIPT")) != NULL)
+		fakeuio_load_script(env);
+	if((env = getenv("FAKEUIO_LOOP")) != NULL)
+		script_loop = atoi(env);
+	if((env = getenv("FAKEUIO_RATE")) != NULL)
+		rate_hz = atof(env);
+	if((env = getenv("FAKEUIO_POISSON")) != NULL)
+		poisson = atoi(env);
+	if((env = getenv("FAKEUIO_DEV")) != NULL)
+		gen_dev = strtoul(env, NULL, 0) % FAKEUIO_MAX_DEVS;
+	if((env = getenv("FAKEUIO_MASK")) != NULL)
+		gen_mask = strtoul(env, NULL, 0);
+	if((env = getenv("FAKEUIO_SCAN_US")) != NULL)
+		scan_ns = strtoull(env, NULL, 0) * 1000;
+	if((env = getenv("FAKEUIO_STORE_US")) != NULL)
+		store_ns = strtoull(env, NULL, 0) * 1000;
+	if(scan_ns < store_ns)
+		store_ns = scan_ns;
+
+	// Ritardo massimo con cui il processo vede le proprie scritture sui registri
+	snprintf(buf, sizeof(buf), "%llu", (unsigned long long)(store_ns + 999) / 1000);
+	setenv("FAKEUIO_DEFERRED_STORES", buf, 1);
+}
+
+/**
+* @brief Carica il file di stimoli.
+*/
+static void fakeuio_load_script(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	char line[128];
+	unsigned long long delay_us;
+	unsigned int dev, value, size = 0;
+
+	if(!f){
+		fprintf(stderr, "[fakeuio] Apertura di %s non riuscita! Errore: %s\n", path, strerror(errno));
+		return;
+	}
+
+	while(fgets(line, sizeof(line), f)){
+		if(line[0] == '#' || sscanf(line, "%llu %u %i", &delay_us, &dev, &value) != 3)
+			continue;
+		if(script_len == size){
+			size = size ? 2 * size : 64;
+			script = realloc(script, size * sizeof(*script));
+		}
+		script[script_len].delay_ns = delay_us * 1000;
+		script[script_len].dev = dev % FAKEUIO_MAX_DEVS;
+		script[script_len].value = value;
+		script_len++;
+	}
+	fclose(f);
+}
+
+/**
+* @brief Restituisce il numero del dispositivo simulato indicato da path, oppure -1.
+*/
+static int fakeuio_path_dev(const char *path)
+{
+	char *end;
+	long n;
+
+	if(!path || strncmp(path, FAKEUIO_PATH, strlen(FAKEUIO_PATH)) != 0)
+		return -1;
+	n = strtol(path + strlen(FAKEUIO_PATH), &end, 10);
+	if(end == path + strlen(FAKEUIO_PATH) || *end != '\0' || n < 0 || n >= FAKEUIO_MAX_DEVS)
+		return -1;
+	return n;
+}
+
+/**
+* @brief Apre il dispositivo simulato n: crea al primo accesso il banco di registri ed
+* 	avvia il thread della periferica.
+*
+* @return il descrittore (un eventfd) oppure -1.
+*/
+static int fakeuio_open_dev(int n, int flags)
+{
+	struct fakeuio_dev *dev = &devs[n];
+	int fd;
+
+	fd = eventfd(0, EFD_CLOEXEC | (flags & O_NONBLOCK ? EFD_NONBLOCK : 0));
+	if(fd < 0)
+		return -1;
+	if(fd >= FAKEUIO_MAX_FD){
+		real_close(fd);
+		errno = EMFILE;
+		return -1;
+	}
+
+	pthread_mutex_lock(&lock);
+	if(!dev->opened){
+		dev->memfd = memfd_create("fakeuio", MFD_CLOEXEC);
+		if(dev->memfd < 0 || ftruncate(dev->memfd, FAKEUIO_MAP_SIZE) < 0){
+			pthread_mutex_unlock(&lock);
+			real_close(fd);
+			return -1;
+		}
+		dev->regs = real_mmap(NULL, FAKEUIO_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, dev->memfd, 0);
+		if(dev->regs == MAP_FAILED){
+			real_close(dev->memfd);
+			pthread_mutex_unlock(&lock);
+			real_close(fd);
+			return -1;
+		}
+		// Come con uio_pdrv_genirq l'interruzione è abilitata alla registrazione
+		dev->irq_on = 1;
+		dev->opened = 1;
+	}
+	fd_dev[fd] = n;
+
+	if(!hw_started && pthread_create(&hw_thread, NULL, fakeuio_hw, NULL) == 0){
+		pthread_detach(hw_thread);
+		hw_started = 1;
+	}
+	pthread_mutex_unlock(&lock);
+
+	return fd;
+}
+
+/**
+* @brief Applica le scritture del processo osservate dall'ultima scansione e genera
+* 	l'interruzione se abilitata e pendente.
+*
+* @note Chiamata con lock acquisito.
+*/
+static void fakeuio_scan(struct fakeuio_dev *dev)
+{
+	volatile uint32_t *regs = dev->regs;
+	uint32_t icl, tri, isr;
+	int fd;
+	uint64_t one = 1;
+
+	// ICL: i bit scritti dal processo azzerano quelli corrispondenti di ISR
+	icl = __atomic_exchange_n(&regs[GPIO_ICL_OFFSET/4], 0, __ATOMIC_ACQ_REL);
+	if(icl)
+		__atomic_and_fetch(&regs[GPIO_ISR_OFFSET/4], ~icl, __ATOMIC_RELEASE);
+
+	// DIN riporta DOUT sui pin in uscita ed il valore esterno su quelli in ingresso
+	tri = regs[GPIO_TRI_OFFSET/4];
+	fakeuio_set_pins(dev, (regs[GPIO_DOUT_OFFSET/4] & tri) | (dev->pins & ~tri));
+
+	isr = __atomic_load_n(&regs[GPIO_ISR_OFFSET/4], __ATOMIC_ACQUIRE);
+	if(!dev->irq_on || !(isr & regs[GPIO_IER_OFFSET/4]))
+		return;
+
+	// Come uio_pdrv_genirq la linea resta disabilitata fino alla write di 1
+	dev->irq_on = 0;
+	dev->irq_count++;
+	dev->fire_ns = fakeuio_now();
+	for(fd = 0; fd < FAKEUIO_MAX_FD; fd++)
+		if(fd_dev[fd] == dev - devs)
+			real_write(fd, &one, sizeof(one));
+}
+
+/**
+* @brief Aggiorna DIN e registra in ISR i fronti di salita.
+*
+* @note Chiamata con lock acquisito.
+*/
+static void fakeuio_set_pins(struct fakeuio_dev *dev, uint32_t value)
+{
+	volatile uint32_t *regs = dev->regs;
+	uint32_t rising = value & ~regs[GPIO_DIN_OFFSET/4];
+	uint32_t isr;
+
+	regs[GPIO_DIN_OFFSET/4] = value;
+	if(!rising)
+		return;
+
+	isr = __atomic_fetch_or(&regs[GPIO_ISR_OFFSET/4], rising, __ATOMIC_RELEASE);
+	if(isr & rising)
+		dev->lost++;
+}
+
+/**
+* @brief Thread della periferica: applica gli stimoli alla loro scadenza e scandisce
+* 	i registri di tutti i dispositivi aperti.
+*/
+static void *fakeuio_hw(void *arg)
+{
+	uint64_t now, next_scan, next_stim = UINT64_MAX, next_press = UINT64_MAX, next_release = UINT64_MAX;
+	uint64_t period_ns = 0, pulse_ns = 0, deadline, scan;
+	unsigned int pos = 0, n;
+	struct timespec ts;
+
+	// Senza timer slack anche le attese di pochi microsecondi sono rispettate
+	prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+
+	now = fakeuio_now();
+	next_scan = now;
+	if(script_len > 0)
+		next_stim = now + script[0].delay_ns;
+	if(rate_hz > 0){
+		period_ns = (uint64_t)(1e9 / rate_hz);
+		pulse_ns = period_ns / 2 < FAKEUIO_PULSE_NS ? period_ns / 2 : FAKEUIO_PULSE_NS;
+		next_press = now + period_ns;
+	}
+	srand48(now);
+
+	for(;;){
+		deadline = next_scan;
+		if(next_stim < deadline) deadline = next_stim;
+		if(next_press < deadline) deadline = next_press;
+		if(next_release < deadline) deadline = next_release;
+
+		if(deadline > fakeuio_now()){
+			ts.tv_sec = deadline / 1000000000ULL;
+			ts.tv_nsec = deadline % 1000000000ULL;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		}
+		now = fakeuio_now();
+
+		pthread_mutex_lock(&lock);
+		while(next_stim <= now){
+			devs[script[pos].dev].pins = script[pos].value;
+			if(++pos == script_len){
+				if(!script_loop){
+					next_stim = UINT64_MAX;
+					break;
+				}
+				pos = 0;
+			}
+			next_stim += script[pos].delay_ns;
+		}
+		if(next_release <= now){
+			devs[gen_dev].pins &= ~gen_mask;
+			next_release = UINT64_MAX;
+		}
+		if(next_press <= now){
+			devs[gen_dev].pins |= gen_mask;
+			next_release = now + pulse_ns;
+			// Intervalli esponenziali per il processo di Poisson
+			next_press += poisson ? (uint64_t)(-log(1.0 - drand48()) * period_ns) : period_ns;
+		}
+		for(n = 0; n < FAKEUIO_MAX_DEVS; n++)
+			if(devs[n].opened)
+				fakeuio_scan(&devs[n]);
+		// Con un banco scrivibile gli store del processo sono visti entro store_ns
+		scan = maps_rw > 0 ? store_ns : scan_ns;
+		pthread_mutex_unlock(&lock);
+
+		if(next_scan <= now)
+			next_scan = now + scan;
+	}
+
+	return NULL;
+}
+
+/**
+* @brief Restituisce la mappatura di un banco che contiene addr, oppure NULL.
+*/
+static struct fakeuio_map *fakeuio_map_find(void *addr)
+{
+	unsigned int i;
+
+	for(i = 0; i < FAKEUIO_MAX_MAPS; i++)
+		if(maps[i].addr && (char *)addr >= maps[i].addr && (char *)addr < maps[i].addr + maps[i].length)
+			return &maps[i];
+	return NULL;
+}
+
+/**
+* @brief Riporta su stderr le statistiche dei dispositivi simulati.
+*/
+static void fakeuio_report(void)
+{
+	unsigned int n;
+
+	for(n = 0; n < FAKEUIO_MAX_DEVS; n++){
+		if(!devs[n].opened)
+			continue;
+		fprintf(stderr, "[fakeuio] uio%u: interruzioni %u, fronti persi %llu, latenza di risveglio media %.1f us (max %.1f us)\n",
+			n, devs[n].irq_count, (unsigned long long)devs[n].lost,
+			devs[n].wakes ? devs[n].wake_sum_ns / 1e3 / devs[n].wakes : 0.0, devs[n].wake_max_ns / 1e3);
+	}
+}
+
+int open(const char *path, int flags, ...)
+{
+	va_list ap;
+	mode_t mode = 0;
+	int n = fakeuio_path_dev(path);
+
+	if(n >= 0)
+		return fakeuio_open_dev(n, flags);
+
+	va_start(ap, flags);
+	if(flags & (O_CREAT | O_TMPFILE))
+		mode = va_arg(ap, mode_t);
+	va_end(ap);
+	return real_open(path, flags, mode);
+}
+
+int open64(const char *path, int flags, ...)
+{
+	va_list ap;
+	mode_t mode = 0;
+
+	va_start(ap, flags);
+	if(flags & (O_CREAT | O_TMPFILE))
+		mode = va_arg(ap, mode_t);
+	va_end(ap);
+	return open(path, flags | O_LARGEFILE, mode);
+}
+
+int openat(int dirfd, const char *path, int flags, ...)
+{
+	va_list ap;
+	mode_t mode = 0;
+	int n = fakeuio_path_dev(path);
+
+	if(n >= 0)
+		return fakeuio_open_dev(n, flags);
+
+	va_start(ap, flags);
+	if(flags & (O_CREAT | O_TMPFILE))
+		mode = va_arg(ap, mode_t);
+	va_end(ap);
+	return real_openat(dirfd, path, flags, mode);
+}
+
+/**
+* @brief read sul device file: attende l'interruzione e restituisce il numero di
+* 	interruzioni notificate finora (un intero a 32 bit), come UIO.
+*/
+ssize_t read(int fd, void *buf, size_t count)
+{
+	struct fakeuio_dev *dev;
+	uint64_t value, latency;
+	uint32_t irq_count;
+
+	if(fd < 0 || fd >= FAKEUIO_MAX_FD || fd_dev[fd] < 0)
+		return real_read(fd, buf, count);
+	dev = &devs[(int)fd_dev[fd]];
+
+	if(count != sizeof(uint32_t)){
+		errno = EINVAL;
+		return -1;
+	}
+
+	pthread_mutex_lock(&lock);
+	fakeuio_scan(dev);
+	pthread_mutex_unlock(&lock);
+
+	if(real_read(fd, &value, sizeof(value)) != sizeof(value))
+		return -1;
+
+	pthread_mutex_lock(&lock);
+	latency = fakeuio_now() - dev->fire_ns;
+	dev->wakes++;
+	dev->wake_sum_ns += latency;
+	if(latency > dev->wake_max_ns)
+		dev->wake_max_ns = latency;
+	irq_count = dev->irq_count;
+	pthread_mutex_unlock(&lock);
+
+	memcpy(buf, &irq_count, sizeof(irq_count));
+	return sizeof(irq_count);
+}
+
+/**
+* @brief write sul device file: 1 abilita l'interruzione, 0 la disabilita.
+*
+* @details Un'interruzione pendente ed abilitata in IER è notificata subito dopo
+* 	l'abilitazione, come accade con la periferica reale.
+*/
+ssize_t write(int fd, const void *buf, size_t count)
+{
+	struct fakeuio_dev *dev;
+	int32_t irq_on;
+
+	if(fd < 0 || fd >= FAKEUIO_MAX_FD || fd_dev[fd] < 0)
+		return real_write(fd, buf, count);
+	dev = &devs[(int)fd_dev[fd]];
+
+	if(count != sizeof(irq_on)){
+		errno = EINVAL;
+		return -1;
+	}
+	memcpy(&irq_on, buf, sizeof(irq_on));
+
+	pthread_mutex_lock(&lock);
+	dev->irq_on = irq_on != 0;
+	fakeuio_scan(dev);
+	pthread_mutex_unlock(&lock);
+
+	return sizeof(irq_on);
+}
+
+/**
+* @brief mmap sul device file: la mappa 0 è il banco di registri del dispositivo.
+*/
+void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
+{
+	unsigned int i;
+	char *base;
+
+	if(fd < 0 || fd >= FAKEUIO_MAX_FD || fd_dev[fd] < 0)
+		return real_mmap(addr, length, prot, flags, fd, offset);
+
+	if(offset != 0 || length > FAKEUIO_MAP_SIZE){
+		errno = EINVAL;
+		return MAP_FAILED;
+	}
+
+	pthread_mutex_lock(&lock);
+	for(i = 0; i < FAKEUIO_MAX_MAPS && maps[i].addr; i++);
+	if(i == FAKEUIO_MAX_MAPS){
+		pthread_mutex_unlock(&lock);
+		errno = ENOMEM;
+		return MAP_FAILED;
+	}
+	base = real_mmap(addr, length, prot, flags, devs[(int)fd_dev[fd]].memfd, 0);
+	if(base != MAP_FAILED){
+		maps[i].length = length;
+		maps[i].dev = fd_dev[fd];
+		maps[i].addr = base;
+		maps[i].writable = (prot & PROT_WRITE) != 0;
+		maps_rw += maps[i].writable;
+	}
+	pthread_mutex_unlock(&lock);
+	return base;
+}
+
+void *mmap64(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
+{
+	return mmap(addr, length, prot, flags, fd, offset);
+}
+
+int munmap(void *addr, size_t length)
+{
+	struct fakeuio_map *map;
+
+	pthread_mutex_lock(&lock);
+	if((map = fakeuio_map_find(addr)) != NULL && map->addr == addr){
+		map->addr = NULL;
+		maps_rw -= map->writable;
+	}
+	pthread_mutex_unlock(&lock);
+	return real_munmap(addr, length);
+}
+
+int close(int fd)
+{
+	if(fd >= 0 && fd < FAKEUIO_MAX_FD && fd_dev[fd] >= 0){
+		pthread_mutex_lock(&lock);
+		fd_dev[fd] = -1;
+		pthread_mutex_unlock(&lock);
+	}
+	return real_close(fd);
+}
+/** @} */
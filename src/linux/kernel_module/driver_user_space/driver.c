@@ -38,10 +38,12 @@
 #include <string.h>
 #include <sys/mman.h>
 
+#include "gpiodrv.h"
+
 #define DEBUG
 
 int fd_led, fd_swt;
-unsigned char led_data = 0;
+unsigned int led_data = 0;
 char *dev_l, *dev_s;
 void *led_base_addr, *swt_base_addr;
 
@@ -92,6 +94,8 @@ int main(int argc, char *argv[])
 */
 void setup(void)
 {
+	unsigned int led_tri = 0x0F;
+
 	#ifdef DEBUG
 	printf("[DEBUG] Apertura dei device files...\n");
 	#endif
@@ -113,6 +117,18 @@ void setup(void)
 		exit(-1);
 	}
 
+	#ifdef DEBUG
+	printf("[DEBUG] Configurazione dei device hardware...\n");
+	#endif
+
+	// Configura in scrittura i pin dei LED scrivendo direttamente il registro TRI
+	if(pwrite(fd_led, &led_tri, sizeof(led_tri), GPIO_REG_TRI) != sizeof(led_tri)){
+		printf("Configurazione dei LED non riuscita. Errore: %s\n", strerror(errno));
+		close(fd_led);
+		close(fd_swt);
+		exit(EXIT_FAILURE);
+	}
+
 	#ifdef DEBUG
 	printf("[DEBUG] Configurazione completata!\n");
 	#endif
@@ -124,17 +140,24 @@ void setup(void)
 */
 void loop(void)
 {
-	unsigned char swt_status;
+	unsigned int swt_status;
+	struct gpio_event event;
 
 	printf("In attesa che il dato sia pronto...\n");
 
-	// Chiamata bloccante
-	if(read(fd_swt, &swt_status, sizeof(swt_status)) != sizeof(swt_status)){
+	// Chiamata bloccante: il driver restituisce un evento per ogni interruzione
+	if(read(fd_swt, &event, sizeof(event)) != sizeof(event)){
 		printf("Lettura non riuscita. Errore: %s\n", strerror(errno));
 		close(fd_led);
 		close(fd_swt);
 		exit(EXIT_FAILURE);
 	}
+	swt_status = event.value;
+
+	#ifdef DEBUG
+	if(event.overflow)
+		printf("[DEBUG] Eventi persi: %u\n", event.overflow);
+	#endif
 
 	// Incrementa la variabile di conteggio in base allo stato degli switch/pulsanti
 	led_data = led_data + swt_status;
@@ -0,0 +1,562 @@
+/**
+* @file gpiobench.c
+* @brief Applicazione per la misura delle prestazioni del modulo kernel.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup LINUX
+* @{
+*
+* @addtogroup KERNEL_MODULE
+* @{
+*
+* @addtogroup DRIVER
+* @{
+*/
+/***************************** Include Files ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/aio_abi.h>
+
+#include "gpiodrv.h"
+#include "gpioring.h"
+
+#define STREAM_MAX 1024
+#define EVENTS_MAX 64
+#define AIO_MAX 64
+
+#ifndef RWF_NOWAIT
+#define RWF_NOWAIT 0x00000008
+#endif
+
+int fd;
+unsigned long updates, syscalls;
+
+/************************** Function Prototypes *****************************/
+void bench_write(unsigned long n);
+void bench_stream(unsigned long n, unsigned int k);
+void bench_batch(unsigned long n, unsigned int k);
+void bench_read(unsigned long n);
+void bench_ring(unsigned long n);
+void bench_writev(unsigned long n, unsigned int k);
+void bench_aio(unsigned long n, unsigned int k, int nowait);
+void bench_pattern(unsigned long n, unsigned long period_us);
+void bench_uloop(unsigned long n, unsigned long period_us);
+void bench_capture(unsigned long n, unsigned long period_ns, int mode);
+double elapsed_us(struct timespec *from, struct timespec *to);
+double cpu_us(void);
+
+/**
+* @details Misura il costo di un aggiornamento logico dei pin di uscita (commutazione
+* 	di un singolo LED) attraverso i diversi percorsi offerti dal modulo kernel.
+*
+* 	Modalità disponibili:
+* 	- write N: un aggiornamento per ogni write sul device file;
+* 	- stream N K: K parole a 32 bit per ogni write, scritte in sequenza su DOUT;
+* 	- batch N K: K aggiornamenti mascherati per ogni GPIO_IOC_BATCH.
+*
+* 	Misura inoltre il costo della consegna di N eventi (interruzioni) a seconda del
+* 	percorso utilizzato per consumarli:
+* 	- read N: fino a EVENTS_MAX eventi per ogni read sul flusso;
+* 	- ring N: eventi letti dal ring mappato in memoria, poll solo a ring vuoto;
+* 	- aio N K: K letture per ogni io_submit (AIO nativo del kernel) con RWF_NOWAIT: le
+* 	  letture senza eventi terminano con -EAGAIN ed il processo attende con poll;
+* 	- aiosync N K: come aio ma senza RWF_NOWAIT, per cui io_submit si blocca nella
+* 	  lettura come accade ai driver che non gestiscono le richieste asincrone.
+*
+* 	La modalità writev N K scrive su DOUT K parole per chiamata, ciascuna in un
+* 	proprio buffer (iovec).
+*
+* 	Infine, per confrontare la precisione temporale delle forme d'onda generate:
+* 	- pattern N P: N commutazioni di un LED ogni P microsecondi riprodotte dal driver
+* 	  (GPIO_IOC_PATTERN_LOAD), con il jitter misurato dall'hrtimer;
+* 	- uloop N P: le stesse commutazioni generate da un ciclo user-space con
+* 	  clock_nanosleep assoluta e write, con il jitter misurato al risveglio.
+*
+* 	ed i campionamenti di DIN eseguiti dal driver (GPIO_IOC_CAPTURE_START):
+* 	- capture N P: N campioni ogni P nanosecondi scanditi da un hrtimer;
+* 	- burst N P: N campioni in un ciclo stretto (P = 0 per la massima frequenza).
+*
+* 	Per ciascuna modalità sono riportati il numero di chiamate di sistema per aggiornamento
+* 	(o evento), il throughput ottenuto ed il throughput per core, calcolato sul tempo
+* 	di CPU consumato dal processo.
+*
+* 	Es: ./gpiobench /dev/gpio0 batch 100000 16
+*/
+int main(int argc, char *argv[])
+{
+	struct timespec start, end;
+	double us, cpu;
+
+	if(argc < 4){
+		printf("Utilizzo: ./gpiobench device_path write|stream|batch|writev|read|ring|aio|aiosync|pattern|uloop|capture|burst N [K|P]\n Es: ./gpiobench /dev/gpio0 batch 100000 16\n");
+		exit(EXIT_FAILURE);
+	}
+
+	fd = open(argv[1], O_RDWR);
+	if (fd < 0) {
+		printf("Apertura device file (%s) non riuscita! Errore: %s\n", argv[1], strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	cpu = cpu_us();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if(strcmp(argv[2], "write") == 0){
+		bench_write(strtoul(argv[3], NULL, 10));
+	} else if(strcmp(argv[2], "stream") == 0){
+		bench_stream(strtoul(argv[3], NULL, 10), argc > 4 ? strtoul(argv[4], NULL, 10) : STREAM_MAX);
+	} else if(strcmp(argv[2], "batch") == 0){
+		bench_batch(strtoul(argv[3], NULL, 10), argc > 4 ? strtoul(argv[4], NULL, 10) : GPIO_BATCH_MAX);
+	} else if(strcmp(argv[2], "read") == 0){
+		bench_read(strtoul(argv[3], NULL, 10));
+	} else if(strcmp(argv[2], "ring") == 0){
+		bench_ring(strtoul(argv[3], NULL, 10));
+	} else if(strcmp(argv[2], "writev") == 0){
+		bench_writev(strtoul(argv[3], NULL, 10), argc > 4 ? strtoul(argv[4], NULL, 10) : STREAM_MAX);
+	} else if(strcmp(argv[2], "aio") == 0){
+		bench_aio(strtoul(argv[3], NULL, 10), argc > 4 ? strtoul(argv[4], NULL, 10) : 8, 1);
+	} else if(strcmp(argv[2], "aiosync") == 0){
+		bench_aio(strtoul(argv[3], NULL, 10), argc > 4 ? strtoul(argv[4], NULL, 10) : 8, 0);
+	} else if(strcmp(argv[2], "pattern") == 0){
+		bench_pattern(strtoul(argv[3], NULL, 10), argc > 4 ? strtoul(argv[4], NULL, 10) : 100);
+	} else if(strcmp(argv[2], "uloop") == 0){
+		bench_uloop(strtoul(argv[3], NULL, 10), argc > 4 ? strtoul(argv[4], NULL, 10) : 100);
+	} else if(strcmp(argv[2], "capture") == 0){
+		bench_capture(strtoul(argv[3], NULL, 10), argc > 4 ? strtoul(argv[4], NULL, 10) : 10000, GPIO_CAPTURE_TIMER);
+	} else if(strcmp(argv[2], "burst") == 0){
+		bench_capture(strtoul(argv[3], NULL, 10), argc > 4 ? strtoul(argv[4], NULL, 10) : 0, GPIO_CAPTURE_BURST);
+	} else {
+		printf("Modalità %s non supportata\n", argv[2]);
+		close(fd);
+		exit(EXIT_FAILURE);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	cpu = cpu_us() - cpu;
+
+	us = elapsed_us(&start, &end);
+	printf("Aggiornamenti: %lu, chiamate di sistema: %lu (%.3f per aggiornamento)\n", updates, syscalls, (double)syscalls / updates);
+	printf("Tempo: %.0f us, %.3f us per aggiornamento, %.0f aggiornamenti/s\n", us, us / updates, updates * 1e6 / us);
+	printf("Tempo di CPU: %.0f us, %.0f aggiornamenti/s per core\n", cpu, cpu > 0 ? updates * 1e6 / cpu : 0.0);
+
+	close(fd);
+	return 0;
+}
+
+/**
+* @brief Commuta un LED con una write per ogni aggiornamento.
+*
+* @details La write sovrascrive l'intero registro di uscita: lo stato dei pin è
+* 	mantenuto dal processo.
+*/
+void bench_write(unsigned long n)
+{
+	unsigned int led_data = 0;
+
+	for(updates = 0; updates < n; updates++){
+		led_data ^= 0x01;
+		if(write(fd, &led_data, sizeof(led_data)) < sizeof(led_data)){
+			printf("Scrittura non riuscita. Errore: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		syscalls++;
+	}
+}
+
+/**
+* @brief Commuta un LED scrivendo K parole su DOUT con ogni write.
+*/
+void bench_stream(unsigned long n, unsigned int k)
+{
+	unsigned int words[STREAM_MAX];
+	unsigned int i, count;
+
+	if(k == 0 || k > STREAM_MAX){
+		printf("K deve essere compreso tra 1 e %d\n", STREAM_MAX);
+		exit(EXIT_FAILURE);
+	}
+
+	for(i = 0; i < k; i++)
+		words[i] = i & 0x01;
+
+	for(updates = 0; updates < n; updates += count){
+		count = (n - updates < k ? n - updates : k);
+		if(write(fd, words, count * sizeof(words[0])) < count * sizeof(words[0])){
+			printf("Scrittura non riuscita. Errore: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		syscalls++;
+	}
+}
+
+/**
+* @brief Commuta un LED con K operazioni mascherate per ogni GPIO_IOC_BATCH.
+*/
+void bench_batch(unsigned long n, unsigned int k)
+{
+	struct gpio_op ops[GPIO_BATCH_MAX];
+	struct gpio_batch batch;
+	unsigned int i;
+
+	if(k == 0 || k > GPIO_BATCH_MAX){
+		printf("K deve essere compreso tra 1 e %d\n", GPIO_BATCH_MAX);
+		exit(EXIT_FAILURE);
+	}
+
+	for(i = 0; i < k; i++){
+		ops[i].code = GPIO_OP_TOGGLE;
+		ops[i].offset = GPIO_REG_DOUT;
+		ops[i].mask = 0x01;
+		ops[i].value = 0;
+	}
+	batch.ops = (__u64)(unsigned long)ops;
+	batch.reserved = 0;
+
+	for(updates = 0; updates < n; updates += batch.count){
+		batch.count = (n - updates < k ? n - updates : k);
+		if(ioctl(fd, GPIO_IOC_BATCH, &batch) < 0){
+			printf("ioctl non riuscita. Errore: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		syscalls++;
+	}
+}
+
+/**
+* @brief Consuma N eventi con read bloccanti sul flusso.
+*/
+void bench_read(unsigned long n)
+{
+	struct gpio_event events[EVENTS_MAX];
+	ssize_t ret;
+
+	for(updates = 0; updates < n; updates += ret / sizeof(events[0])){
+		ret = read(fd, events, sizeof(events));
+		if(ret < 0){
+			printf("Lettura non riuscita. Errore: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		syscalls++;
+	}
+}
+
+/**
+* @brief Consuma N eventi dal ring mappato in memoria.
+*
+* @details Le uniche chiamate di sistema sono le poll effettuate a ring vuoto.
+*/
+void bench_ring(unsigned long n)
+{
+	struct gpio_ring_consumer ring;
+	struct gpio_event events[EVENTS_MAX];
+	unsigned int got;
+
+	if(gpio_ring_attach(&ring, fd) < 0){
+		printf("Mapping del ring non riuscito. Errore: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	for(updates = 0; updates < n; updates += got){
+		got = gpio_ring_consume(&ring, events, EVENTS_MAX);
+		if(got == 0){
+			if(gpio_ring_wait(&ring, -1) < 0){
+				printf("Attesa sul ring non riuscita. Errore: %s\n", strerror(errno));
+				exit(EXIT_FAILURE);
+			}
+			syscalls++;
+		}
+	}
+
+	gpio_ring_detach(&ring);
+}
+
+/**
+* @brief Commuta un LED scrivendo K parole su DOUT con ogni writev, una per iovec.
+*/
+void bench_writev(unsigned long n, unsigned int k)
+{
+	static struct iovec iov[STREAM_MAX];
+	static unsigned int words[STREAM_MAX];
+	unsigned int i, count;
+
+	if(k == 0 || k > STREAM_MAX){
+		printf("K deve essere compreso tra 1 e %d\n", STREAM_MAX);
+		exit(EXIT_FAILURE);
+	}
+
+	for(i = 0; i < k; i++){
+		words[i] = i & 0x01;
+		iov[i].iov_base = &words[i];
+		iov[i].iov_len = sizeof(words[i]);
+	}
+
+	for(updates = 0; updates < n; updates += count){
+		count = (n - updates < k ? n - updates : k);
+		if(writev(fd, iov, count) < count * sizeof(words[0])){
+			printf("Scrittura non riuscita. Errore: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		syscalls++;
+	}
+}
+
+/**
+* @brief Consuma N eventi con K letture asincrone (AIO nativo) per ogni io_submit.
+*
+* @details Ogni lettura è una preadv sul flusso (offset GPIO_STREAM_OFFSET) con due buffer,
+* 	così da esercitare anche il supporto agli iovec. Con nowait le letture senza eventi
+* 	disponibili sono completate subito con -EAGAIN: il processo attende allora con poll
+* 	e sottomette di nuovo. Senza nowait io_submit esegue le letture in modo sincrono e
+* 	blocca il processo finché non arrivano eventi.
+*
+* 	Sono contate come chiamate di sistema io_submit, io_getevents e poll.
+*/
+void bench_aio(unsigned long n, unsigned int k, int nowait)
+{
+	static struct gpio_event events[AIO_MAX][EVENTS_MAX];
+	static struct iovec iov[AIO_MAX][2];
+	static struct iocb cbs[AIO_MAX];
+	struct iocb *cbp[AIO_MAX];
+	struct io_event done[AIO_MAX];
+	struct pollfd pfd;
+	aio_context_t ctx = 0;
+	unsigned int i, again;
+	int got;
+
+	if(k == 0 || k > AIO_MAX){
+		printf("K deve essere compreso tra 1 e %d\n", AIO_MAX);
+		exit(EXIT_FAILURE);
+	}
+
+	if(syscall(SYS_io_setup, k, &ctx) < 0){
+		printf("io_setup non riuscita. Errore: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	memset(cbs, 0, sizeof(cbs));
+	for(i = 0; i < k; i++){
+		iov[i][0].iov_base = events[i];
+		iov[i][0].iov_len = sizeof(events[i]) / 2;
+		iov[i][1].iov_base = (char *)events[i] + sizeof(events[i]) / 2;
+		iov[i][1].iov_len = sizeof(events[i]) / 2;
+
+		cbs[i].aio_fildes = fd;
+		cbs[i].aio_lio_opcode = IOCB_CMD_PREADV;
+		cbs[i].aio_buf = (__u64)(unsigned long)iov[i];
+		cbs[i].aio_nbytes = 2;
+		cbs[i].aio_offset = GPIO_STREAM_OFFSET;
+		cbs[i].aio_rw_flags = nowait ? RWF_NOWAIT : 0;
+		cbp[i] = &cbs[i];
+	}
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+
+	for(updates = 0; updates < n;){
+		if(syscall(SYS_io_submit, ctx, (long)k, cbp) != k){
+			printf("io_submit non riuscita. Errore: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		got = syscall(SYS_io_getevents, ctx, (long)k, (long)k, done, NULL);
+		if(got < 0){
+			printf("io_getevents non riuscita. Errore: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		syscalls += 2;
+
+		for(i = 0, again = 0; i < got; i++){
+			if(done[i].res == -EAGAIN){
+				again++;
+			} else if(done[i].res < 0){
+				printf("Lettura asincrona non riuscita. Errore: %s\n", strerror(-done[i].res));
+				exit(EXIT_FAILURE);
+			} else {
+				updates += done[i].res / sizeof(struct gpio_event);
+			}
+		}
+
+		// Nessuna lettura ha trovato eventi: si attende con poll prima di sottomettere di nuovo
+		if(again == got && updates < n){
+			if(poll(&pfd, 1, -1) < 0 && errno != EINTR){
+				printf("Attesa non riuscita. Errore: %s\n", strerror(errno));
+				exit(EXIT_FAILURE);
+			}
+			syscalls++;
+		}
+	}
+
+	syscall(SYS_io_destroy, ctx);
+}
+
+/**
+* @brief Commuta un LED N volte ogni P microsecondi con la riproduzione del driver.
+*
+* @details Il driver riproduce in ciclo una sequenza di due passi; il processo dorme per
+* 	la durata prevista e poi ferma la riproduzione.
+*/
+void bench_pattern(unsigned long n, unsigned long period_us)
+{
+	struct gpio_pattern_step steps[2];
+	struct gpio_pattern pattern;
+	struct gpio_pattern_status status;
+	struct timespec ts;
+	unsigned long long total_ns = (unsigned long long)n * period_us * 1000;
+
+	steps[0].value = 0x01;
+	steps[1].value = 0x00;
+	steps[0].mask = steps[1].mask = 0x01;
+	steps[0].delay_ns = steps[1].delay_ns = (__u64)period_us * 1000;
+
+	pattern.steps = (__u64)(unsigned long)steps;
+	pattern.count = 2;
+	pattern.flags = GPIO_PATTERN_LOOP;
+	if(ioctl(fd, GPIO_IOC_PATTERN_LOAD, &pattern) < 0){
+		printf("Caricamento della sequenza non riuscito. Errore: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	ts.tv_sec = total_ns / 1000000000ULL;
+	ts.tv_nsec = total_ns % 1000000000ULL;
+	while(nanosleep(&ts, &ts) < 0 && errno == EINTR);
+
+	if(ioctl(fd, GPIO_IOC_PATTERN_STATUS, &status) < 0 || ioctl(fd, GPIO_IOC_PATTERN_STOP) < 0){
+		printf("ioctl non riuscita. Errore: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	syscalls = 3;
+	updates = status.steps;
+
+	printf("Jitter (driver): medio %llu ns, massimo %llu ns, underrun: %llu\n",
+		(unsigned long long)status.jitter_mean_ns, (unsigned long long)status.jitter_max_ns,
+		(unsigned long long)status.underruns);
+}
+
+/**
+* @brief Commuta un LED N volte ogni P microsecondi con un ciclo user-space.
+*
+* @details Le scadenze sono assolute, come nel driver; il jitter è il ritardo del
+* 	risveglio rispetto alla scadenza, al quale va sommato il costo della write.
+*/
+void bench_uloop(unsigned long n, unsigned long period_us)
+{
+	struct timespec next, now;
+	unsigned int led_data = 0;
+	double jitter, jitter_sum = 0, jitter_max = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for(updates = 0; updates < n; updates++){
+		next.tv_nsec += period_us * 1000;
+		while(next.tv_nsec >= 1000000000L){
+			next.tv_nsec -= 1000000000L;
+			next.tv_sec++;
+		}
+		while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		led_data ^= 0x01;
+		if(write(fd, &led_data, sizeof(led_data)) < sizeof(led_data)){
+			printf("Scrittura non riuscita. Errore: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		syscalls += 2;
+
+		jitter = elapsed_us(&next, &now) * 1000;
+		jitter_sum += jitter;
+		if(jitter > jitter_max)
+			jitter_max = jitter;
+	}
+
+	printf("Jitter (user-space): medio %.0f ns, massimo %.0f ns\n", n ? jitter_sum / n : 0.0, jitter_max);
+}
+
+/**
+* @brief Acquisisce N campioni di DIN ogni P nanosecondi, senza trigger.
+*
+* @details Oltre alla frequenza riportata dal driver calcola, dai timestamp dei campioni
+* 	letti attraverso il buffer mappato, l'intervallo massimo tra due campioni consecutivi.
+*/
+void bench_capture(unsigned long n, unsigned long period_ns, int mode)
+{
+	struct gpio_capture capture;
+	struct gpio_capture_status status;
+	struct gpio_sample *buf, *prev, *cur;
+	long page_size = sysconf(_SC_PAGESIZE);
+	size_t size = ((GPIO_CAPTURE_MAX * sizeof(struct gpio_sample) + page_size - 1) / page_size) * page_size;
+	unsigned long long gap, gap_max = 0;
+	unsigned int i;
+
+	if(n == 0 || n > GPIO_CAPTURE_MAX){
+		printf("N deve essere compreso tra 1 e %d\n", GPIO_CAPTURE_MAX);
+		exit(EXIT_FAILURE);
+	}
+
+	memset(&capture, 0, sizeof(capture));
+	capture.mode = mode;
+	capture.post_samples = n;
+	capture.period_ns = period_ns;
+	if(ioctl(fd, GPIO_IOC_CAPTURE_START, &capture) < 0 || ioctl(fd, GPIO_IOC_CAPTURE_WAIT, &status) < 0){
+		printf("Acquisizione non riuscita. Errore: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	syscalls = 2;
+	updates = status.count;
+
+	buf = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, GPIO_MMAP_CAPTURE_OFFSET * page_size);
+	if(buf == MAP_FAILED){
+		printf("Mapping del buffer non riuscito. Errore: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	for(i = 1; i < status.count; i++){
+		prev = &buf[(status.first + i - 1) % n];
+		cur = &buf[(status.first + i) % n];
+		gap = cur->timestamp - prev->timestamp;
+		if(gap > gap_max)
+			gap_max = gap;
+	}
+	munmap(buf, size);
+
+	printf("Campioni: %u, frequenza ottenuta: %llu Hz, intervallo massimo: %llu ns, scadenze saltate: %llu\n",
+		status.count, (unsigned long long)status.rate_hz, gap_max, (unsigned long long)status.missed);
+}
+
+/**
+* @brief Restituisce il tempo di CPU (utente e sistema) consumato dal processo in microsecondi.
+*/
+double cpu_us(void)
+{
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e6 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+/**
+* @brief Restituisce il tempo in microsecondi trascorso tra due istanti.
+*/
+double elapsed_us(struct timespec *from, struct timespec *to)
+{
+	return (to->tv_sec - from->tv_sec) * 1e6 + (to->tv_nsec - from->tv_nsec) / 1e3;
+}
+/** @} */
+/** @} */
+/** @} */
@@ -0,0 +1,96 @@
+/**
+* @file gpioring.c
+* @brief Libreria per il consumo degli eventi dal ring condiviso con il modulo kernel.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup LINUX
+* @{
+*
+* @addtogroup KERNEL_MODULE
+* @{
+*
+* @addtogroup DRIVER
+* @{
+*/
+/***************************** Include Files ********************************/
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+
+#include "gpioring.h"
+
+int gpio_ring_attach(struct gpio_ring_consumer *ring, int fd)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+
+	ring->fd = fd;
+	ring->size = page_size + GPIO_RING_ENTRIES * sizeof(struct gpio_event);
+	ring->base = mmap(NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, GPIO_MMAP_RING_OFFSET * page_size);
+	if(ring->base == MAP_FAILED)
+		return -1;
+
+	ring->header = ring->base;
+	if(ring->header->entries != GPIO_RING_ENTRIES || ring->header->data_offset != page_size){
+		munmap(ring->base, ring->size);
+		errno = EINVAL;
+		return -1;
+	}
+	ring->data = (struct gpio_event *)((char *)ring->base + ring->header->data_offset);
+
+	return 0;
+}
+
+unsigned int gpio_ring_consume(struct gpio_ring_consumer *ring, struct gpio_event *events, unsigned int max)
+{
+	__u32 head, tail;
+	unsigned int n;
+
+	// head è letto con semantica acquire: gli eventi fino ad head sono già stati scritti
+	head = __atomic_load_n(&ring->header->head, __ATOMIC_ACQUIRE);
+	tail = ring->header->tail;
+
+	for(n = 0; n < max && tail != head; n++, tail++)
+		events[n] = ring->data[tail & (GPIO_RING_ENTRIES - 1)];
+
+	// tail è scritto con semantica release: gli eventi vanno copiati prima di liberarne il posto
+	if(n > 0)
+		__atomic_store_n(&ring->header->tail, tail, __ATOMIC_RELEASE);
+
+	return n;
+}
+
+int gpio_ring_wait(struct gpio_ring_consumer *ring, int timeout_ms)
+{
+	struct pollfd pfd;
+	int ret;
+
+	pfd.fd = ring->fd;
+	pfd.events = POLLIN;
+
+	do {
+		ret = poll(&pfd, 1, timeout_ms);
+	} while(ret < 0 && errno == EINTR);
+
+	return ret < 0 ? -1 : (ret > 0);
+}
+
+void gpio_ring_detach(struct gpio_ring_consumer *ring)
+{
+	munmap(ring->base, ring->size);
+	ring->base = NULL;
+}
+/** @} */
+/** @} */
+/** @} */
@@ -0,0 +1,91 @@
+/**
+* @file gpioring.h
+* @brief Libreria per il consumo degli eventi dal ring condiviso con il modulo kernel.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup LINUX
+* @{
+*
+* @addtogroup KERNEL_MODULE
+* @{
+*
+* @addtogroup DRIVER
+* @{
+*
+* @details Gli eventi sono letti dal ring con semplici load: l'unica chiamata di sistema
+* 	è la poll in gpio_ring_wait, da usare solo quando il ring è vuoto.
+*
+* 	Es:
+* 		gpio_ring_attach(&ring, fd);
+* 		for(;;){
+* 			if(gpio_ring_consume(&ring, events, 16) == 0)
+* 				gpio_ring_wait(&ring, -1);
+* 		}
+*/
+#ifndef GPIORING_H_
+#define GPIORING_H_
+
+/***************************** Include Files ********************************/
+#include <stddef.h>
+
+#include "gpiodrv.h"
+
+/**************************** Type Definitions ******************************/
+/**
+* @brief Consumatore del ring degli eventi di un dispositivo.
+*/
+struct gpio_ring_consumer {
+	int fd;                     ///< Descrittore del device file
+	void *base;                 ///< Inizio della mappatura
+	size_t size;                ///< Dimensione della mappatura
+	struct gpio_ring *header;   ///< Intestazione del ring
+	struct gpio_event *data;    ///< Primo elemento del ring
+};
+
+/************************** Function Prototypes *****************************/
+/**
+* @brief Mappa il ring degli eventi del dispositivo aperto con il descrittore fd.
+*
+* @return 0 in caso di successo, -1 altrimenti (errno indica la causa).
+*
+* @note Da questo momento in poi gli eventi del dispositivo sono consegnati solo
+* 	attraverso il ring.
+*/
+int gpio_ring_attach(struct gpio_ring_consumer *ring, int fd);
+
+/**
+* @brief Copia in events al più max eventi presenti nel ring, senza chiamate di sistema.
+*
+* @return il numero di eventi copiati (0 se il ring è vuoto).
+*/
+unsigned int gpio_ring_consume(struct gpio_ring_consumer *ring, struct gpio_event *events, unsigned int max);
+
+/**
+* @brief Attende che nel ring sia presente almeno un evento.
+*
+* @param timeout_ms è il tempo massimo di attesa in millisecondi (-1 per un'attesa indefinita).
+*
+* @return 1 se il ring non è vuoto, 0 allo scadere del timeout, -1 in caso di errore.
+*/
+int gpio_ring_wait(struct gpio_ring_consumer *ring, int timeout_ms);
+
+/**
+* @brief Rilascia la mappatura del ring.
+*/
+void gpio_ring_detach(struct gpio_ring_consumer *ring);
+
+#endif /* GPIORING_H_ */
+/** @} */
+/** @} */
+/** @} */
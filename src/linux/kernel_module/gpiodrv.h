@@ -0,0 +1,344 @@
+/**
+* @file gpiodrv.h
+* @brief Definizioni condivise tra il modulo kernel ed i processi user-space che lo utilizzano.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details. You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup LINUX
+* @{
+*
+* @addtogroup KERNEL_MODULE
+* @{
+*
+* @addtogroup MODULE
+* @{
+*
+* @details Questo file descrive il formato dei dati scambiati attraverso il device file
+*   /dev/gpioN ed è incluso sia dal modulo kernel che dalle applicazioni user-space.
+*/
+#ifndef GPIODRV_H_
+#define GPIODRV_H_
+
+/***************************** Include Files ********************************/
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/************************** Constant Definitions *****************************/
+/**
+ * @name Offset di mmap
+ * @brief Pagine da passare come offset (in unità di pagina) alla mmap sul device file
+ * @{
+ */
+#define GPIO_MMAP_REGS_OFFSET 0   ///< Registri della periferica (accesso diretto, non cacheable)
+#define GPIO_MMAP_RING_OFFSET 1   ///< Ring degli eventi (una pagina di intestazione seguita dagli eventi)
+#define GPIO_MMAP_CAPTURE_OFFSET 2  ///< Buffer dei campioni acquisiti (array di struct gpio_sample)
+/* @} */
+
+/**
+ * @name Registri
+ * @brief Spiazzamenti dei registri della periferica, da usare nelle operazioni di ioctl
+ * @{
+ */
+#define GPIO_REG_DOUT  0          ///< Registro per i dati in scrittura
+#define GPIO_REG_TRI   4          ///< Registro per il settaggio della direzione (1 = scrittura)
+#define GPIO_REG_DIN   8          ///< Registro per i dati in lettura
+#define GPIO_REG_IER  12          ///< Registro per l'abilitazione alle interruzioni
+#define GPIO_REG_ICL  16          ///< Registro per l'acknoledge delle interruzioni
+#define GPIO_REG_ISR  20          ///< Registro per la lettura delle interruzioni pending
+/* @} */
+
+#define GPIO_BATCH_MAX  64        ///< Numero massimo di operazioni in una singola GPIO_IOC_BATCH
+#define GPIO_RING_ENTRIES 512     ///< Eventi contenuti nel ring (deve essere una potenza di 2)
+#define GPIO_PATTERN_MAX  256     ///< Numero massimo di passi in un buffer di GPIO_IOC_PATTERN_LOAD
+#define GPIO_PATTERN_MIN_DELAY_NS 1000  ///< Durata minima di un passo della riproduzione
+#define GPIO_CAPTURE_MAX  16384   ///< Numero massimo di campioni di un'acquisizione (pre + post)
+#define GPIO_CAPTURE_MIN_PERIOD_NS 2000 ///< Periodo minimo di campionamento in modalità GPIO_CAPTURE_TIMER
+
+/**
+ * @brief Posizione del flusso nel device file.
+ *
+ * @details All'apertura la posizione del file è impostata a questo valore: read e write
+ *    operano sul flusso (eventi in lettura, parole a 32 bit verso DOUT in scrittura).
+ *    pread e pwrite con offset compreso tra GPIO_REG_DOUT e GPIO_REG_ISR accedono invece
+ *    direttamente ai registri, una parola a 32 bit per registro.
+ *
+ *    Le interfacce che specificano sempre la posizione (preadv2, AIO, io_uring) raggiungono
+ *    il flusso passando GPIO_STREAM_OFFSET come offset; con RWF_NOWAIT una lettura senza
+ *    eventi disponibili termina subito con -EAGAIN invece di bloccare.
+ */
+#define GPIO_STREAM_OFFSET  0x10000
+
+/**
+ * @brief Codici delle operazioni eseguibili attraverso GPIO_IOC_BATCH.
+ *
+ * @details Le operazioni di modifica agiscono sul registro indicato nel campo offset
+ *    della struct gpio_op, che deve essere GPIO_REG_DOUT, GPIO_REG_TRI oppure
+ *    GPIO_REG_IER. La lettura è ammessa su tutti i registri.
+ */
+enum gpio_op_code {
+  GPIO_OP_SET,        ///< reg = reg | mask
+  GPIO_OP_CLEAR,      ///< reg = reg & ~mask
+  GPIO_OP_TOGGLE,     ///< reg = reg ^ mask
+  GPIO_OP_UPDATE,     ///< reg = (reg & ~mask) | (value & mask)
+  GPIO_OP_READ        ///< value = reg (il campo mask è ignorato)
+};
+
+/**
+ * @name Fronti
+ * @brief Valori combinabili del campo edges della struct gpio_filter
+ * @{
+ */
+#define GPIO_EDGE_RISING   0x1    ///< Fronte di salita rilevato dalla periferica (bit di ISR)
+#define GPIO_EDGE_FALLING  0x2    ///< Pin passato da 1 a 0 rispetto all'evento precedente (registro DIN)
+/* @} */
+
+/**
+ * @name Flag della riproduzione
+ * @brief Valori combinabili del campo flags della struct gpio_pattern
+ * @{
+ */
+#define GPIO_PATTERN_LOOP  0x1    ///< Il buffer è ripetuto finché non ne viene accodato un altro
+#define GPIO_PATTERN_LAST  0x2    ///< Ultimo buffer del flusso: la sua fine non è un underrun
+/* @} */
+
+/**
+ * @brief Modalità di campionamento di GPIO_IOC_CAPTURE_START.
+ */
+enum gpio_capture_mode {
+  GPIO_CAPTURE_TIMER,   ///< Un campione per ogni scadenza di un hrtimer (acquisizioni lunghe)
+  GPIO_CAPTURE_BURST    ///< Ciclo stretto senza prelazione (acquisizioni brevi, massima frequenza)
+};
+
+/**
+ * @brief Stati di un'acquisizione (campo state della struct gpio_capture_status).
+ */
+enum gpio_capture_state {
+  GPIO_CAPTURE_IDLE,      ///< Nessuna acquisizione avviata
+  GPIO_CAPTURE_ARMED,     ///< In attesa del trigger: sono conservati gli ultimi pre_samples campioni
+  GPIO_CAPTURE_TRIGGERED, ///< Trigger rilevato, acquisizione dei campioni successivi in corso
+  GPIO_CAPTURE_DONE       ///< Acquisizione terminata (completata, fermata oppure scaduta)
+};
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief Evento restituito dalla read sul device file.
+ *
+ * @details Il driver accoda un evento di questo tipo per ogni interruzione servita
+ *    che soddisfa il filtro del file aperto (si veda struct gpio_filter): ogni file
+ *    aperto riceve la propria copia degli eventi, con numeri di sequenza e conteggio
+ *    degli eventi persi propri. Una read restituisce tanti eventi quanti ne entrano nel
+ *    buffer fornito dal processo user-space (la dimensione del buffer deve essere almeno
+ *    pari a quella di un evento).
+ */
+struct gpio_event {
+  __u64 timestamp;    ///< Istante di ingresso nella ISR (o nella callback di polling) in nanosecondi, CLOCK_MONOTONIC
+  __u32 pending;      ///< Maschera delle interruzioni pendenti (registro ISR)
+  __u32 value;        ///< Stato dei pin all'istante dell'evento (registro DIN)
+  __u32 overflow;     ///< Eventi persi, per coda piena, immediatamente prima di questo
+  __u32 seq;          ///< Numero di sequenza dell'evento (per file aperto, oppure per ring)
+};
+
+/**
+ * @brief Filtro degli eventi di un file aperto (GPIO_IOC_SET_FILTER).
+ *
+ * @details Il filtro è valutato dal driver prima di accodare l'evento: i processi sono
+ *    risvegliati solo per gli eventi che lo soddisfano. Un evento soddisfa il filtro se:
+ *    - almeno uno dei pin in mask presenta uno dei fronti indicati in edges;
+ *    - (value & value_mask) == value_match, dove value è lo stato dei pin (DIN);
+ *    - sono trascorsi almeno min_interval_ns nanosecondi dall'ultimo evento consegnato
+ *      al file (0 = nessun vincolo).
+ *
+ *    All'apertura il filtro accetta tutti i fronti di salita su tutti i pin.
+ */
+struct gpio_filter {
+  __u32 mask;             ///< Pin di interesse
+  __u32 edges;            ///< Fronti di interesse (GPIO_EDGE_RISING, GPIO_EDGE_FALLING)
+  __u32 value_mask;       ///< Pin il cui stato deve coincidere con value_match
+  __u32 value_match;      ///< Stato richiesto per i pin in value_mask
+  __u64 min_interval_ns;  ///< Distanza minima tra due eventi consegnati
+};
+
+/**
+ * @brief Intestazione del ring degli eventi.
+ *
+ * @details Il ring si ottiene con una mmap all'offset GPIO_MMAP_RING_OFFSET (in unità di
+ *    pagina) e ne occupa la prima pagina; a data_offset byte dall'inizio della mappatura
+ *    si trovano entries elementi di tipo struct gpio_event.
+ *
+ *    head e tail sono indici liberi di avanzare (l'elemento corrispondente è quello di
+ *    posizione indice & (entries - 1)): il driver scrive gli eventi e poi aggiorna head,
+ *    il processo legge gli eventi compresi tra tail ed head e poi aggiorna tail. Per
+ *    entrambi l'aggiornamento dell'indice deve avere semantica release e la lettura
+ *    dell'indice altrui semantica acquire.
+ *
+ *    Il ring è unico per dispositivo e riceve, finché è mappato, tutti gli eventi senza
+ *    filtri. Il file aperto attraverso il quale è stato mappato riceve gli eventi solo
+ *    attraverso il ring (la read sul flusso non ne restituisce) e la poll su di esso
+ *    segnala POLLIN quando il ring non è vuoto. Quando il ring è pieno gli eventi sono
+ *    scartati e contati nel campo overflow del primo evento successivo.
+ */
+struct gpio_ring {
+  __u32 head;         ///< Indice del prossimo evento che scriverà il driver
+  __u32 tail;         ///< Indice del prossimo evento che leggerà il processo
+  __u32 entries;      ///< Numero di eventi contenuti nel ring (GPIO_RING_ENTRIES)
+  __u32 data_offset;  ///< Spiazzamento in byte del primo evento dall'inizio della mappatura
+};
+
+/**
+ * @brief Passo di una sequenza riprodotta dal driver (GPIO_IOC_PATTERN_LOAD).
+ *
+ * @details Allo scoccare del passo i pin in mask assumono il valore indicato in value
+ *    (DOUT = (DOUT & ~mask) | (value & mask)); il passo successivo scocca delay_ns
+ *    nanosecondi dopo, misurati dall'istante previsto per questo passo e non da quello
+ *    effettivo, così che i ritardi non si accumulino.
+ */
+struct gpio_pattern_step {
+  __u32 value;        ///< Valore dei pin
+  __u32 mask;         ///< Pin interessati dal passo
+  __u64 delay_ns;     ///< Durata del passo (almeno GPIO_PATTERN_MIN_DELAY_NS)
+};
+
+/**
+ * @brief Argomento della GPIO_IOC_PATTERN_LOAD.
+ *
+ * @details Il driver riproduce le sequenze da un hrtimer, scrivendo direttamente su DOUT,
+ *    con due buffer: quello in riproduzione e quello successivo. Se il dispositivo è fermo
+ *    il buffer caricato viene riprodotto subito, altrimenti viene accodato e riprodotto al
+ *    termine di quello corrente (al termine dell'iterazione in corso se questo è in
+ *    GPIO_PATTERN_LOOP). Se un buffer è già in coda la GPIO_IOC_PATTERN_LOAD restituisce
+ *    -EBUSY: il processo deve attendere che inizi la riproduzione di quello in coda (si
+ *    veda il campo queued della struct gpio_pattern_status).
+ *
+ *    Un buffer senza GPIO_PATTERN_LOOP che termina senza successore ferma la riproduzione:
+ *    se non è marcato GPIO_PATTERN_LAST l'evento è contato come underrun.
+ */
+struct gpio_pattern {
+  __u64 steps;        ///< Puntatore ad un array di struct gpio_pattern_step
+  __u32 count;        ///< Numero di passi nell'array (al più GPIO_PATTERN_MAX)
+  __u32 flags;        ///< GPIO_PATTERN_LOOP, GPIO_PATTERN_LAST
+};
+
+/**
+ * @brief Stato della riproduzione (GPIO_IOC_PATTERN_STATUS).
+ *
+ * @details Le statistiche sono azzerate ogni volta che la riproduzione parte da ferma.
+ *    Il jitter di un passo è il ritardo con il quale l'hrtimer scocca rispetto all'istante
+ *    previsto.
+ */
+struct gpio_pattern_status {
+  __u32 running;          ///< 1 se la riproduzione è in corso
+  __u32 queued;           ///< 1 se un buffer è in coda dietro a quello in riproduzione
+  __u64 steps;            ///< Passi riprodotti
+  __u64 underruns;        ///< Buffer terminati senza successore (e senza GPIO_PATTERN_LAST)
+  __u64 jitter_mean_ns;   ///< Jitter medio
+  __u64 jitter_max_ns;    ///< Jitter massimo
+};
+
+/**
+ * @brief Campione del registro DIN acquisito da GPIO_IOC_CAPTURE_START.
+ */
+struct gpio_sample {
+  __u64 timestamp;    ///< Istante del campionamento in nanosecondi (CLOCK_MONOTONIC)
+  __u32 value;        ///< Stato dei pin (registro DIN)
+  __u32 reserved;     ///< Non utilizzato
+};
+
+/**
+ * @brief Argomento della GPIO_IOC_CAPTURE_START.
+ *
+ * @details Il driver campiona DIN ogni period_ns nanosecondi in un buffer circolare di
+ *    pre_samples + post_samples campioni, mappabile all'offset GPIO_MMAP_CAPTURE_OFFSET.
+ *    Il trigger scatta sul primo campione per il quale (value & trigger_mask) ==
+ *    trigger_value (trigger_mask = 0: trigger sul primo campione): a quel punto sono
+ *    conservati al più pre_samples campioni precedenti ed acquisiti post_samples campioni
+ *    a partire da quello di trigger.
+ *
+ *    In modalità GPIO_CAPTURE_BURST la ioctl ritorna ad acquisizione terminata ed il
+ *    campionamento avviene con la prelazione disabilitata; period_ns = 0 indica la
+ *    massima frequenza possibile. L'acquisizione termina comunque dopo capture_burst_us
+ *    microsecondi (parametro del modulo, al più 50), anche se il trigger non è scattato.
+ *    In modalità GPIO_CAPTURE_TIMER la ioctl ritorna subito e la fine dell'acquisizione
+ *    si attende con GPIO_IOC_CAPTURE_WAIT.
+ */
+struct gpio_capture {
+  __u32 mode;             ///< Modalità di campionamento (enum gpio_capture_mode)
+  __u32 pre_samples;      ///< Campioni da conservare prima del trigger
+  __u32 post_samples;     ///< Campioni da acquisire dal trigger in poi (almeno 1)
+  __u32 trigger_mask;     ///< Pin che partecipano al trigger
+  __u32 trigger_value;    ///< Stato dei pin in trigger_mask che fa scattare il trigger
+  __u32 reserved;         ///< Non utilizzato, deve essere 0
+  __u64 period_ns;        ///< Periodo di campionamento (almeno GPIO_CAPTURE_MIN_PERIOD_NS in GPIO_CAPTURE_TIMER)
+};
+
+/**
+ * @brief Stato di un'acquisizione (GPIO_IOC_CAPTURE_STATUS, GPIO_IOC_CAPTURE_WAIT).
+ *
+ * @details I campioni validi, in ordine cronologico, sono buf[(first + i) % size] per
+ *    i compreso tra 0 e count - 1, dove buf è il buffer mappato e size è pari a
+ *    pre_samples + post_samples.
+ */
+struct gpio_capture_status {
+  __u32 state;            ///< Stato dell'acquisizione (enum gpio_capture_state)
+  __u32 first;            ///< Posizione nel buffer del campione più vecchio
+  __u32 count;            ///< Numero di campioni validi
+  __u32 trigger_index;    ///< Indice (cronologico) del campione di trigger, oppure 0xFFFFFFFF
+  __u64 rate_hz;          ///< Frequenza di campionamento ottenuta
+  __u64 missed;           ///< Scadenze dell'hrtimer saltate (solo GPIO_CAPTURE_TIMER)
+};
+
+/**
+ * @brief Singola operazione di una GPIO_IOC_BATCH.
+ */
+struct gpio_op {
+  __u32 code;         ///< Codice dell'operazione (enum gpio_op_code)
+  __u32 offset;       ///< Spiazzamento del registro sul quale operare
+  __u32 mask;         ///< Maschera dei bit interessati dall'operazione
+  __u32 value;        ///< Valore da scrivere oppure, per GPIO_OP_READ, valore letto
+};
+
+/**
+ * @brief Argomento della GPIO_IOC_BATCH.
+ *
+ * @details Le operazioni sono eseguite nell'ordine in cui compaiono nell'array, con
+ *    un'unica acquisizione dei lock del dispositivo: più letture nella stessa chiamata
+ *    restituiscono quindi una fotografia consistente dei registri. Al ritorno, il
+ *    campo value delle operazioni di lettura contiene il valore letto.
+ */
+struct gpio_batch {
+  __u64 ops;          ///< Puntatore ad un array di struct gpio_op
+  __u32 count;        ///< Numero di operazioni nell'array (al più GPIO_BATCH_MAX)
+  __u32 reserved;     ///< Non utilizzato, deve essere 0
+};
+
+/************************** ioctl *****************************/
+/**
+ * @name Comandi ioctl
+ * @{
+ */
+#define GPIO_IOC_MAGIC  'g'
+#define GPIO_IOC_BATCH  _IOWR(GPIO_IOC_MAGIC, 1, struct gpio_batch)   ///< Esegue un array di operazioni sui registri
+#define GPIO_IOC_SET_FILTER _IOW(GPIO_IOC_MAGIC, 2, struct gpio_filter)   ///< Imposta il filtro degli eventi del file aperto
+#define GPIO_IOC_GET_FILTER _IOR(GPIO_IOC_MAGIC, 3, struct gpio_filter)   ///< Restituisce il filtro degli eventi del file aperto
+#define GPIO_IOC_PATTERN_LOAD _IOW(GPIO_IOC_MAGIC, 4, struct gpio_pattern)  ///< Riproduce o accoda una sequenza su DOUT
+#define GPIO_IOC_PATTERN_STOP _IO(GPIO_IOC_MAGIC, 5)                        ///< Ferma la riproduzione e scarta il buffer in coda
+#define GPIO_IOC_PATTERN_STATUS _IOR(GPIO_IOC_MAGIC, 6, struct gpio_pattern_status) ///< Restituisce lo stato della riproduzione
+#define GPIO_IOC_CAPTURE_START _IOW(GPIO_IOC_MAGIC, 7, struct gpio_capture)           ///< Avvia un'acquisizione di DIN
+#define GPIO_IOC_CAPTURE_STOP _IO(GPIO_IOC_MAGIC, 8)                                   ///< Termina l'acquisizione in corso
+#define GPIO_IOC_CAPTURE_STATUS _IOR(GPIO_IOC_MAGIC, 9, struct gpio_capture_status)   ///< Restituisce lo stato dell'acquisizione
+#define GPIO_IOC_CAPTURE_WAIT _IOR(GPIO_IOC_MAGIC, 10, struct gpio_capture_status)    ///< Attende la fine dell'acquisizione e ne restituisce lo stato
+/* @} */
+
+#endif /* GPIODRV_H_ */
+/** @} */
+/** @} */
+/** @} */
@@ -0,0 +1,337 @@
+/**
+* @file gpiodrv_core.h
+* @brief Strutture dati e funzioni condivise dai file sorgenti del modulo kernel.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details. You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup LINUX
+* @{
+*
+* @addtogroup KERNEL_MODULE
+* @{
+*
+* @addtogroup MODULE
+* @{
+*
+* @details Il modulo è diviso in:
+*   - kmodule.c: logica del driver (device file, ISR, code degli eventi, riproduzione ed
+*     acquisizione) e collegamento con il device tree e con il platform bus;
+*   - gpiodrv_mock.c: banco di registri simulato ed iniettore di interruzioni sintetiche,
+*     compilato solo con GPIODRV_MOCK=y, che consente di caricare il modulo e misurarne
+*     i percorsi di lettura, scrittura ed interruzione su qualsiasi macchina Linux.
+*   - gpiodrv_kunit.c: test KUnit, compilati solo con GPIODRV_KUNIT ed inclusi in coda a
+*     kmodule.c per poterne verificare anche le funzioni static.
+*
+*   Tutti gli accessi ai registri passano per gpio_reg_read e gpio_reg_write: senza
+*   GPIODRV_MOCK e senza registrazione degli accessi (parametro reg_trace_entries) si
+*   riducono ad una ioread32/iowrite32.
+*/
+#ifndef GPIODRV_CORE_H_
+#define GPIODRV_CORE_H_
+
+/***************************** Include Files ********************************/
+#include <linux/types.h>
+#include <linux/io.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
+#include <linux/kfifo.h>
+#include <linux/kref.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/irqdomain.h>
+#include <linux/gpio/driver.h>
+#include <linux/atomic.h>
+
+#include "gpiodrv.h"
+#include "gpio_trace.h"
+
+/************************** Constant Definitions *****************************/
+#define DRIVER_NAME       "gpiodrv"   ///< Nome con il quale il driver si registra presso il kernel
+
+#define GPIO_EVENT_FIFO_SIZE  64      ///< Numero di eventi accodabili per file aperto (deve essere una potenza di 2)
+#define GPIO_SNAPSHOT_FIFO_SIZE 32    ///< Campionamenti in attesa del thread di interruzione (deve essere una potenza di 2)
+#define GPIO_WAKE_HIST_BUCKETS  32    ///< Classi dell'istogramma della latenza di risveglio (potenze di 2 in ns)
+
+#define NO 0
+#define YES 1
+
+#define GPIO_DOUT_OFFSET  0
+#define GPIO_DIN_OFFSET   8
+#define GPIO_TRI_OFFSET   4
+#define GPIO_IER_OFFSET  12
+#define GPIO_ICL_OFFSET  16
+#define GPIO_ISR_OFFSET  20
+#define GPIO_REGS_SIZE   24           ///< Dimensione in byte del banco di registri della periferica
+#define GPIO_WRITE_CHUNK 64           ///< Parole copiate dallo spazio user per ogni iterazione della write
+#define GPIO_READ_CHUNK 16            ///< Eventi copiati verso lo spazio user per ogni iterazione della read
+#define GPIO_RING_BYTES  (PAGE_SIZE + PAGE_ALIGN(GPIO_RING_ENTRIES * sizeof(struct gpio_event))) ///< Dimensione del ring degli eventi
+#define GPIO_CAPTURE_BYTES PAGE_ALIGN(GPIO_CAPTURE_MAX * sizeof(struct gpio_sample)) ///< Dimensione del buffer delle acquisizioni
+#define GPIO_NGPIO        4           ///< Numero di pin della periferica (generic size di gpio_array)
+#define INT_ENABLE 0x0000000F
+#define INT_DISABLE 0x00000000
+#define GPIO_KUNIT_DEVICES 40        ///< Minor number riservati alle periferiche create dai test KUnit
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief Banco di registri simulato (si veda gpiodrv_mock.c).
+ */
+struct gpio_mock_regs{
+  u32 dout;                 ///< Registro DOUT
+  u32 tri;                  ///< Registro TRI
+  u32 din;                  ///< Registro DIN, impostato dall'iniettore
+  u32 ier;                  ///< Registro IER
+  u32 isr;                  ///< Registro ISR, impostato dall'iniettore ed azzerato da ICL
+  u64 inject_events;        ///< Eventi iniettati
+  u64 inject_ns;            ///< Tempo complessivo trascorso nei gestori per gli eventi iniettati
+};
+
+/**
+ * @brief Campionamento dei registri della periferica effettuato in contesto di interruzione.
+ *
+ * @details Il gestore di primo livello (ISR o callback di polling) si limita a leggere
+ *    e ad azzerare il registro ISR ed a leggere DIN, demandando la costruzione degli
+ *    eventi al thread di interruzione gpio_isr_thread.
+ */
+struct gpio_snapshot{
+  u64 timestamp;            ///< Istante del campionamento in nanosecondi (CLOCK_MONOTONIC)
+  u32 pending;              ///< Maschera delle interruzioni pendenti (registro ISR)
+  u32 value;                ///< Stato dei pin (registro DIN)
+  u32 lost;                 ///< Campionamenti persi, per coda piena, immediatamente prima di questo
+  u32 polled;               ///< YES se il campionamento è stato effettuato dalla callback di polling
+};
+
+/**
+ * @brief Buffer di una sequenza riprodotta su DOUT (si veda struct gpio_pattern).
+ */
+struct gpio_pattern_buf{
+  struct gpio_pattern_step steps[GPIO_PATTERN_MAX]; ///< Passi della sequenza
+  u32 count;                ///< Numero di passi validi
+  u32 flags;                ///< GPIO_PATTERN_LOOP, GPIO_PATTERN_LAST
+};
+
+/**
+ * @brief Linea di interruzione condivisa da più periferiche (modalità aggregata).
+ */
+struct gpio_irq_line{
+  unsigned int irq;         ///< Numero di interruzione della linea
+  struct list_head node;    ///< Elemento della lista irq_lines
+  struct list_head banks;   ///< Periferiche collegate alla linea (lista RCU)
+  struct mutex lock;        ///< Serializza le modifiche alla lista banks ed il thread della linea
+};
+
+/**
+ * @brief Struttura dati per la gestione del singolo dispositivo GPIO.
+ *
+ * @details Il driver crea una struttura di questo tipo per ogni dispositivo
+ *    presente nel sistema.
+ *
+ */
+struct gpio_device{
+  struct kref ref;          ///< Riferimenti al dispositivo: probe, file aperti e mappature del ring
+  struct rcu_head rcu;      ///< Consente di liberare la struttura al termine delle ricerche in corso
+  int mem_region;           ///< YES se la regione di memoria della periferica è stata riservata
+  unsigned long *base_addr; ///< Indirizzo (virtuale) base della periferica
+  unsigned int irq;         ///< Numero di interruzione (se la periferica genera interruzioni, altrimenti non è specificato)
+  void *irq_cookie;         ///< dev_id con il quale è registrato il gestore: il dispositivo oppure la sua linea
+  struct gpio_irq_line *line; ///< Linea alla quale è collegata la periferica in modalità aggregata
+  struct list_head line_node; ///< Elemento della lista banks della linea
+  struct resource res;      ///< Struttura dati popolata da informazioni estratte dal device-tree
+  dev_t gpiox_dev_number;   ///< Device numbers della periferica (ogni periferica ha un minor number diverso)
+  spinlock_t write_lock;    ///< Spinlock per garantire l'accesso in mutua esclusione alle operazioni di scrittura
+  u32 ier;                  ///< Copia del registro IER impostato dall'utente (in polling l'hardware è mascherato)
+  u32 irq_unmasked;         ///< Pin le cui interruzioni sono abilitate attraverso l'irq_chip (protetto da irq_lock)
+  spinlock_t irq_lock;      ///< Spinlock che serializza la ISR e la callback di polling
+  struct hrtimer poll_timer;  ///< Timer utilizzato per il campionamento in modalità polling
+  int polling;              ///< YES se il dispositivo è in modalità polling, NO se lavora ad interruzioni
+  ktime_t window_start;     ///< Istante di inizio della finestra di misura del tasso di interruzioni
+  unsigned int window_events; ///< Interruzioni arrivate nella finestra corrente
+  unsigned int idle_ticks;  ///< Campionamenti consecutivi senza eventi in modalità polling
+  u64 irq_events;           ///< Eventi consegnati attraverso le interruzioni
+  u64 poll_events;          ///< Eventi consegnati in polling (ovvero interruzioni risparmiate)
+  DECLARE_KFIFO(snapshots, struct gpio_snapshot, GPIO_SNAPSHOT_FIFO_SIZE); ///< Campionamenti in attesa del thread di interruzione
+  u32 snapshot_lost;        ///< Campionamenti persi dall'ultimo accodato (protetto da irq_lock)
+  u64 hardirq_ns;           ///< Tempo complessivo trascorso nel gestore di primo livello
+  u64 hardirq_max_ns;       ///< Durata massima del gestore di primo livello
+  u64 hardirq_min_ns;       ///< Durata minima del gestore di primo livello
+  u64 hardirq_window_events; ///< Esecuzioni del gestore dall'ultimo azzeramento del file stats
+  u64 hardirq_window_ns;    ///< Tempo nel gestore dall'ultimo azzeramento del file stats
+  u64 last_event_ns;        ///< Istante dell'ultimo evento consegnato (aggiornato dal thread)
+  u64 intervals;            ///< Intervalli tra eventi consecutivi misurati
+  u64 interval_sum_ns;      ///< Somma degli intervalli tra eventi consecutivi
+  u64 interval_min_ns;      ///< Intervallo minimo tra eventi consecutivi
+  u64 interval_max_ns;      ///< Intervallo massimo tra eventi consecutivi
+  u64 wake_hist[GPIO_WAKE_HIST_BUCKETS]; ///< Latenze ISR-lettore: la classe i conta quelle in [2^i, 2^(i+1)) ns
+  u64 wake_max_ns;          ///< Latenza ISR-lettore massima
+  u64 thread_runs;          ///< Esecuzioni del thread di interruzione
+  u64 thread_batch_max;     ///< Numero massimo di campionamenti consegnati in una sola esecuzione del thread
+  struct list_head subscribers; ///< File aperti sul dispositivo (struct gpio_subscriber)
+  struct mutex subs_lock;   ///< Serializza la lista dei file aperti ed il thread di interruzione
+  u32 last_value;           ///< Stato dei pin all'ultimo evento, per il riconoscimento dei fronti di discesa
+  u32 seq;                  ///< Numero di sequenza del prossimo evento del ring
+  u32 overflow;             ///< Eventi persi dal ring dall'ultimo evento accodato
+  int ring_woken;           ///< YES se il ring ha ricevuto eventi nella passata corrente del thread
+  u64 overflows;            ///< Eventi persi in totale per coda piena
+  u64 reads;                ///< Letture dal flusso degli eventi completate
+  u64 read_events;          ///< Eventi restituiti ai processi user-space
+  u64 writes;               ///< Scritture sul flusso verso DOUT completate
+  u64 write_words;          ///< Parole scritte su DOUT
+  struct gpio_ring *ring;   ///< Ring degli eventi condiviso con i processi user-space (vmalloc_user)
+  struct gpio_event *ring_data; ///< Primo elemento del ring, a data_offset byte dall'intestazione
+  u32 ring_head;            ///< Copia privata dell'indice head (quella nel ring è modificabile dai processi)
+  atomic_t ring_users;      ///< Mappature del ring attive: se diverso da 0 gli eventi vanno nel ring
+  u64 ring_events;          ///< Eventi consegnati attraverso il ring
+  struct dentry *debugfs;   ///< Directory del dispositivo in debugfs, contiene i contatori
+  struct gpio_mock_regs *mock; ///< Banco di registri simulato (NULL per le periferiche reali)
+  struct hrtimer pattern_timer; ///< Timer che riproduce le sequenze su DOUT
+  struct mutex pattern_mutex; ///< Serializza caricamento ed arresto delle sequenze
+  spinlock_t pattern_lock;  ///< Protegge lo stato della riproduzione, condiviso con pattern_timer
+  struct gpio_pattern_buf *pattern; ///< I due buffer delle sequenze (allocati al primo caricamento)
+  int pattern_active;       ///< Buffer in riproduzione (0 oppure 1)
+  unsigned int pattern_pos; ///< Prossimo passo del buffer in riproduzione
+  int pattern_running;      ///< YES se la riproduzione è in corso
+  int pattern_next;         ///< YES se l'altro buffer è in coda
+  u64 pattern_steps;        ///< Passi riprodotti
+  u64 pattern_underruns;    ///< Buffer terminati senza successore
+  u64 pattern_jitter_sum_ns;  ///< Somma dei ritardi dell'hrtimer rispetto agli istanti previsti
+  u64 pattern_jitter_max_ns;  ///< Ritardo massimo dell'hrtimer rispetto all'istante previsto
+  struct hrtimer capture_timer; ///< Timer di campionamento delle acquisizioni GPIO_CAPTURE_TIMER
+  struct mutex capture_mutex; ///< Serializza avvio ed arresto delle acquisizioni e l'allocazione del buffer
+  spinlock_t capture_lock;  ///< Protegge lo stato dell'acquisizione, condiviso con capture_timer
+  wait_queue_head_t capture_wait; ///< Processi in attesa della fine dell'acquisizione
+  struct gpio_sample *capture_buf;  ///< Buffer dei campioni (vmalloc_user, allocato al primo utilizzo)
+  struct gpio_capture capture;  ///< Parametri dell'acquisizione corrente
+  int capture_state;        ///< Stato dell'acquisizione (enum gpio_capture_state)
+  u32 capture_pos;          ///< Campioni acquisiti dall'avvio
+  u32 capture_trigger_pos;  ///< Numero d'ordine del campione di trigger
+  int capture_triggered;    ///< YES se il trigger è scattato nell'acquisizione corrente
+  u64 capture_missed;       ///< Scadenze dell'hrtimer saltate
+  gpio_trace_record *reg_trace; ///< Registrazione degli accessi ai registri (vmalloc, NULL se disabilitata)
+  u32 reg_trace_entries;    ///< Record del buffer reg_trace
+  atomic_t reg_trace_next;  ///< Prossimo record da scrivere
+  atomic_t reg_trace_dropped; ///< Record persi a buffer pieno
+  u64 reg_trace_start;      ///< Istante di inizio della registrazione (ktime_get_ns)
+  u64 reg_trace_last;       ///< Tempo dell'ultimo record, da reg_trace_start
+#ifdef CONFIG_GPIOLIB
+  struct gpio_chip chip;    ///< Chip registrato presso gpiolib (pin accessibili con libgpiod)
+  struct irq_domain *irq_domain; ///< Dominio che associa ad ogni pin la propria interruzione
+  int chip_registered;      ///< YES se il chip è stato registrato presso gpiolib
+#endif
+};
+
+/**
+ * @brief Stato di un file aperto sul dispositivo.
+ *
+ * @details Ogni file aperto riceve la propria copia degli eventi che soddisfano il suo
+ *    filtro, con numeri di sequenza propri: più lettori non si contendono più la stessa
+ *    coda.
+ */
+struct gpio_subscriber{
+  struct gpio_device *dev;  ///< Dispositivo al quale si riferisce il file
+  struct list_head node;    ///< Elemento della lista subscribers del dispositivo
+  struct gpio_filter filter;  ///< Filtro degli eventi (protetto da subs_lock)
+  DECLARE_KFIFO(events, struct gpio_event, GPIO_EVENT_FIFO_SIZE); ///< Coda degli eventi in attesa di essere letti
+  wait_queue_head_t wait;   ///< Wait queue sulla quale i processi si bloccano in attesa di eventi
+  struct mutex read_mutex;  ///< Serializza i lettori del file, unici consumatori della coda
+  u32 seq;                  ///< Numero di sequenza del prossimo evento
+  u32 overflow;             ///< Eventi persi dall'ultimo evento accodato
+  u64 last_ns;              ///< Istante dell'ultimo evento consegnato (per min_interval_ns)
+  int wake;                 ///< YES se il file ha ricevuto eventi nella passata corrente del thread
+  atomic_t ring_maps;       ///< Mappature del ring create attraverso questo file
+};
+
+/************************** Accesso ai registri *****************************/
+#ifdef GPIODRV_MOCK
+u32 gpio_mock_read(struct gpio_mock_regs *mock, unsigned int offset);
+void gpio_mock_write(struct gpio_mock_regs *mock, unsigned int offset, u32 value);
+#endif
+void gpio_reg_trace(struct gpio_device *gpio_dev_ptr, u8 type, unsigned int offset, u32 value, u64 now);
+
+/**
+ * @brief Legge un registro della periferica.
+ *
+ * @param gpio_dev_ptr è il puntatore al dispositivo.
+ * @param offset è lo spiazzamento in byte del registro (GPIO_*_OFFSET).
+ */
+static inline u32 gpio_reg_read(struct gpio_device *gpio_dev_ptr, unsigned int offset)
+{
+  u32 value;
+
+#ifdef GPIODRV_MOCK
+  if(gpio_dev_ptr->mock)
+    value = gpio_mock_read(gpio_dev_ptr->mock, offset);
+  else
+#endif
+  value = ioread32(gpio_dev_ptr->base_addr + (offset/4));
+  if(unlikely(gpio_dev_ptr->reg_trace))
+    gpio_reg_trace(gpio_dev_ptr, GPIO_TRACE_READ, offset, value, ktime_get_ns());
+  return value;
+}
+
+/**
+ * @brief Scrive un registro della periferica.
+ *
+ * @param gpio_dev_ptr è il puntatore al dispositivo.
+ * @param offset è lo spiazzamento in byte del registro (GPIO_*_OFFSET).
+ * @param value è il valore da scrivere.
+ */
+static inline void gpio_reg_write(struct gpio_device *gpio_dev_ptr, unsigned int offset, u32 value)
+{
+  if(unlikely(gpio_dev_ptr->reg_trace))
+    gpio_reg_trace(gpio_dev_ptr, GPIO_TRACE_WRITE, offset, value, ktime_get_ns());
+#ifdef GPIODRV_MOCK
+  if(gpio_dev_ptr->mock){
+    gpio_mock_write(gpio_dev_ptr->mock, offset, value);
+    return;
+  }
+#endif
+  iowrite32(value, gpio_dev_ptr->base_addr + (offset/4));
+}
+
+/************************** Function Prototypes *****************************/
+/*
+ *  Ciclo di vita del dispositivo, indipendente dal modo in cui la periferica è stata
+ *  trovata (device tree oppure banco simulato).
+ */
+struct gpio_device *gpio_device_alloc(void);
+int gpio_device_register(struct gpio_device *gpio_dev_ptr, struct device *parent);
+void gpio_device_unregister(struct gpio_device *gpio_dev_ptr);
+void gpio_device_put(struct gpio_device *gpio_dev_ptr);
+
+/*
+ *  Gestori di primo e secondo livello di un singolo dispositivo. gpio_bank_isr va
+ *  chiamata con le interruzioni locali disabilitate, gpio_bank_thread in contesto di processo.
+ */
+irqreturn_t gpio_bank_isr(struct gpio_device *gpio_dev_ptr, ktime_t start);
+void gpio_bank_thread(struct gpio_device *gpio_dev_ptr);
+
+#ifdef GPIODRV_MOCK
+unsigned int gpio_mock_count(void);
+int gpio_mock_init(void);
+void gpio_mock_exit(void);
+struct gpio_device *gpio_mock_create(void);
+void gpio_mock_destroy(struct gpio_device *gpio_dev_ptr);
+void gpio_mock_inject(struct gpio_device *gpio_dev_ptr, u32 pending, u32 value);
+#else
+static inline unsigned int gpio_mock_count(void) { return 0; }
+static inline int gpio_mock_init(void) { return 0; }
+static inline void gpio_mock_exit(void) {}
+#endif
+
+#endif /* GPIODRV_CORE_H_ */
+/** @} */
+/** @} */
+/** @} */
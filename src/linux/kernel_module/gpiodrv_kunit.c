@@ -0,0 +1,956 @@
+/**
+* @file gpiodrv_kunit.c
+* @brief Test KUnit dei gestori di interruzione, delle code degli eventi e del device file.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details. You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup LINUX
+* @{
+*
+* @addtogroup KERNEL_MODULE
+* @{
+*
+* @addtogroup MODULE
+* @{
+*
+* @details Compilato solo con GPIODRV_KUNIT ed incluso in coda a kmodule.c. Ogni test
+*   lavora su una periferica simulata creata con gpio_mock_create: i registri sono
+*   impostati direttamente in gpio_mock_regs, i gestori sono chiamati come farebbe la
+*   linea di interruzione (la ISR con timestamp scelto dal test, per rendere
+*   deterministici i filtri sugli intervalli) ed i file sono aperti con gpio_open su
+*   un inode e una struct file allocati dal test.
+*
+*   Con CONFIG_GPIOLIB sono verificati anche i callback del gpio_chip e lo smistamento
+*   delle interruzioni ai pin.
+*
+*   La suite gpiodrv_scale registra e rimuove decine di periferiche (fino ad esaurire i
+*   GPIO_KUNIT_DEVICES minor number riservati ai test) e ne apre e chiude i device file
+*   da più thread mentre vengono rimosse, verificando minor number, idr e riferimenti.
+*   Con il parametro max_devices i minor number dei test non sono riservati ed i test
+*   che non trovano minor liberi vengono saltati.
+*
+*   Esecuzione (si veda Kconfig):
+*
+*     ./tools/testing/kunit/kunit.py run --arch=um --kunitconfig=drivers/gpio/gpiodrv
+*/
+/***************************** Include Files ********************************/
+#include <kunit/test.h>
+#include <linux/uio.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+
+/************************** Constant Definitions *****************************/
+#define GPIO_KUNIT_FILES  4       ///< File aperti al massimo da un singolo test
+#define GPIO_KUNIT_SCALE_DEVICES 32 ///< Periferiche rimosse durante le aperture concorrenti
+#define GPIO_KUNIT_WORKERS 4      ///< Thread che aprono e chiudono i device file
+#define GPIO_KUNIT_ROUNDS  4      ///< Passate di ciascun thread su tutte le periferiche
+
+/**************************** Type Definitions ******************************/
+/**
+ * @brief Stato di un test: periferica simulata e file aperti su di essa.
+ */
+struct gpio_kunit_ctx{
+  struct gpio_device *dev;              ///< Periferica simulata del test
+  struct inode *inode;                  ///< Inode del device file (solo i_rdev)
+  struct file *files[GPIO_KUNIT_FILES]; ///< File aperti, chiusi da gpio_kunit_exit
+  unsigned int nfiles;                  ///< Numero di file aperti
+};
+
+/**
+ * @brief Stato condiviso dai thread di gpio_kunit_scale_concurrent.
+ */
+struct gpio_kunit_scale{
+  dev_t devnums[GPIO_KUNIT_SCALE_DEVICES]; ///< Device number delle periferiche
+  struct completion start;  ///< Segnala ai thread l'inizio delle aperture
+  struct completion done;   ///< Segnalato dall'ultimo thread che termina
+  atomic_t running;         ///< Thread non ancora terminati
+};
+
+/**
+ * @brief Thread che apre e chiude i device file (si veda gpio_kunit_scale_worker).
+ */
+struct gpio_kunit_worker{
+  struct gpio_kunit_scale *scale; ///< Stato condiviso
+  unsigned int id;          ///< Indice del thread, sfasa la sequenza delle periferiche
+  struct inode *inode;      ///< Inode riutilizzato ad ogni apertura
+  struct file *filp;        ///< File riutilizzato ad ogni apertura
+  unsigned int opens;       ///< Aperture riuscite
+  unsigned int missing;     ///< Aperture fallite con -ENODEV (periferica già rimossa)
+  unsigned int errors;      ///< Aperture fallite altrimenti, oppure dispositivo errato
+};
+
+/**
+ * @brief Crea la periferica simulata del test.
+ */
+static int gpio_kunit_init(struct kunit *test)
+{
+  struct gpio_kunit_ctx *ctx;
+
+  ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+  KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ctx);
+  ctx->inode = kunit_kzalloc(test, sizeof(*ctx->inode), GFP_KERNEL);
+  KUNIT_ASSERT_NOT_ERR_OR_NULL(test, ctx->inode);
+
+  ctx->dev = gpio_mock_create();
+  // Con max_devices i minor number dei test non sono riservati e possono mancare
+  if(PTR_ERR_OR_ZERO(ctx->dev) == -ENOSPC)
+    kunit_skip(test, "minor number esauriti (max_devices = %u)", max_devices);
+  if(IS_ERR(ctx->dev))
+    return PTR_ERR(ctx->dev);
+  ctx->inode->i_rdev = ctx->dev->gpiox_dev_number;
+
+  test->priv = ctx;
+  return 0;
+}
+
+/**
+ * @brief Chiude i file rimasti aperti e rimuove la periferica.
+ *
+ * @details KUnit chiama exit anche quando init non è andata a buon fine: in tal caso
+ *    test->priv è NULL.
+ */
+static void gpio_kunit_exit(struct kunit *test)
+{
+  struct gpio_kunit_ctx *ctx = test->priv;
+  unsigned int i;
+
+  if(!ctx)
+    return;
+  for(i = 0; i < ctx->nfiles; i++)
+    gpio_release(ctx->inode, ctx->files[i]);
+  gpio_mock_destroy(ctx->dev);
+}
+
+/**
+ * @brief Apre il device file della periferica in modalità non bloccante.
+ *
+ * @return il subscriber del file aperto.
+ */
+static struct gpio_subscriber *gpio_kunit_open(struct kunit *test)
+{
+  struct gpio_kunit_ctx *ctx = test->priv;
+  struct file *filp;
+
+  KUNIT_ASSERT_LT(test, ctx->nfiles, GPIO_KUNIT_FILES);
+  filp = kunit_kzalloc(test, sizeof(*filp), GFP_KERNEL);
+  KUNIT_ASSERT_NOT_ERR_OR_NULL(test, filp);
+  filp->f_flags = O_RDWR | O_NONBLOCK;
+  filp->f_inode = ctx->inode;
+
+  KUNIT_ASSERT_EQ(test, gpio_open(ctx->inode, filp), 0);
+  KUNIT_EXPECT_EQ(test, filp->f_pos, (loff_t)GPIO_STREAM_OFFSET);
+  ctx->files[ctx->nfiles++] = filp;
+  return filp->private_data;
+}
+
+/**
+ * @brief Imposta DIN ed aggiunge pending ad ISR, come farebbe la periferica.
+ */
+static void gpio_kunit_pins(struct gpio_device *gpio_dev_ptr, u32 pending, u32 value)
+{
+  unsigned long flags;
+
+  spin_lock_irqsave(&gpio_dev_ptr->irq_lock, flags);
+    gpio_dev_ptr->mock->din = value;
+    gpio_dev_ptr->mock->isr |= pending;
+  spin_unlock_irqrestore(&gpio_dev_ptr->irq_lock, flags);
+}
+
+/**
+ * @brief Esegue la ISR con le interruzioni locali disabilitate.
+ *
+ * @param timestamp è l'istante di ingresso nella ISR, in nanosecondi.
+ */
+static irqreturn_t gpio_kunit_isr(struct gpio_device *gpio_dev_ptr, u64 timestamp)
+{
+  unsigned long flags;
+  irqreturn_t ret;
+
+  local_irq_save(flags);
+    ret = gpio_bank_isr(gpio_dev_ptr, ns_to_ktime(timestamp));
+  local_irq_restore(flags);
+  return ret;
+}
+
+/**
+ * @brief Evento completo: fronte, ISR e thread di interruzione.
+ */
+static void gpio_kunit_event(struct gpio_device *gpio_dev_ptr, u32 pending, u32 value, u64 timestamp)
+{
+  gpio_kunit_pins(gpio_dev_ptr, pending, value);
+  if(gpio_kunit_isr(gpio_dev_ptr, timestamp) == IRQ_WAKE_THREAD)
+    gpio_bank_thread(gpio_dev_ptr);
+}
+
+/**
+ * @brief Lettura o scrittura sul file alla posizione pos, come read/pread e write/pwrite.
+ *
+ * @return il valore restituito da gpio_read_iter oppure da gpio_write_iter.
+ */
+static ssize_t gpio_kunit_rw(struct kunit *test, struct gpio_subscriber *sub, int write, void *buf, size_t len, loff_t pos)
+{
+  struct gpio_kunit_ctx *ctx = test->priv;
+  struct kvec kv = { .iov_base = buf, .iov_len = len };
+  struct iov_iter iter;
+  struct file *filp = NULL;
+  struct kiocb iocb;
+  unsigned int i;
+
+  for(i = 0; i < ctx->nfiles; i++)
+    if(ctx->files[i]->private_data == sub)
+      filp = ctx->files[i];
+  KUNIT_ASSERT_NOT_ERR_OR_NULL(test, filp);
+
+  init_sync_kiocb(&iocb, filp);
+  iocb.ki_pos = pos;
+  iov_iter_kvec(&iter, write ? WRITE : READ, &kv, 1, len);
+  return write ? gpio_write_iter(&iocb, &iter) : gpio_read_iter(&iocb, &iter);
+}
+
+/**
+ * @brief Esegue una singola operazione del batch con i lock richiesti da gpio_batch_op.
+ *
+ * @return il campo value dell'operazione al termine.
+ */
+static u32 gpio_kunit_op(struct gpio_device *gpio_dev_ptr, u32 code, u32 offset, u32 mask, u32 value)
+{
+  struct gpio_op op = { .code = code, .offset = offset, .mask = mask, .value = value };
+  unsigned long flags;
+
+  spin_lock_irqsave(&gpio_dev_ptr->write_lock, flags);
+  spin_lock(&gpio_dev_ptr->irq_lock);
+    gpio_batch_op(gpio_dev_ptr, &op);
+  spin_unlock(&gpio_dev_ptr->irq_lock);
+  spin_unlock_irqrestore(&gpio_dev_ptr->write_lock, flags);
+  return op.value;
+}
+
+/****************************** Gestori di interruzione ******************************/
+/**
+ * @brief Senza interruzioni pendenti la ISR non accoda nulla e non sveglia il thread.
+ */
+static void gpio_kunit_isr_idle(struct kunit *test)
+{
+  struct gpio_kunit_ctx *ctx = test->priv;
+
+  KUNIT_EXPECT_EQ(test, gpio_kunit_isr(ctx->dev, 1000), IRQ_NONE);
+  KUNIT_EXPECT_TRUE(test, kfifo_is_empty(&ctx->dev->snapshots));
+  KUNIT_EXPECT_EQ(test, ctx->dev->irq_events, 0ULL);
+  KUNIT_EXPECT_EQ(test, ctx->dev->hardirq_window_events, 0ULL);
+}
+
+/**
+ * @brief La ISR campiona ISR e DIN, azzera ISR attraverso ICL ed aggiorna i contatori.
+ */
+static void gpio_kunit_isr_snapshot(struct kunit *test)
+{
+  struct gpio_kunit_ctx *ctx = test->priv;
+  struct gpio_snapshot snap;
+
+  gpio_kunit_pins(ctx->dev, 0x1, 0x5);
+  KUNIT_EXPECT_EQ(test, gpio_kunit_isr(ctx->dev, 1234), IRQ_WAKE_THREAD);
+  KUNIT_EXPECT_EQ(test, ctx->dev->mock->isr, 0U);
+
+  KUNIT_ASSERT_EQ(test, kfifo_len(&ctx->dev->snapshots), 1U);
+  KUNIT_ASSERT_TRUE(test, kfifo_peek(&ctx->dev->snapshots, &snap));
+  KUNIT_EXPECT_EQ(test, snap.timestamp, 1234ULL);
+  KUNIT_EXPECT_EQ(test, snap.pending, 0x1U);
+  KUNIT_EXPECT_EQ(test, snap.value, 0x5U);
+  KUNIT_EXPECT_EQ(test, snap.lost, 0U);
+  KUNIT_EXPECT_EQ(test, snap.polled, NO);
+
+  KUNIT_EXPECT_EQ(test, ctx->dev->irq_events, 1ULL);
+  KUNIT_EXPECT_EQ(test, ctx->dev->hardirq_window_events, 1ULL);
+  KUNIT_EXPECT_LE(test, ctx->dev->hardirq_min_ns, ctx->dev->hardirq_max_ns);
+  KUNIT_EXPECT_EQ(test, ctx->dev->hardirq_window_ns, ctx->dev->hardirq_ns);
+}
+
+/**
+ * @brief A coda dei campionamenti piena la ISR azzera comunque ISR e conta i campionamenti
+ *    persi, che il thread riporta nel primo evento accodato successivamente. Con due
+ *    lettori i campionamenti persi sono contati una sola volta nel dispositivo.
+ */
+static void gpio_kunit_snapshot_overflow(struct kunit *test)
+{
+  struct gpio_kunit_ctx *ctx = test->priv;
+  struct gpio_subscriber *sub = gpio_kunit_open(test);
+  struct gpio_subscriber *other = gpio_kunit_open(test);
+  struct gpio_event event;
+  unsigned int i;
+
+  for(i = 0; i < GPIO_SNAPSHOT_FIFO_SIZE + 2; i++){
+    gpio_kunit_pins(ctx->dev, 0x1, 0x1);
+    KUNIT_EXPECT_EQ(test, gpio_kunit_isr(ctx->dev, 1000 + i), IRQ_WAKE_THREAD);
+    KUNIT_EXPECT_EQ(test, ctx->dev->mock->isr, 0U);
+  }
+  KUNIT_EXPECT_TRUE(test, kfifo_is_full(&ctx->dev->snapshots));
+  KUNIT_EXPECT_EQ(test, ctx->dev->snapshot_lost, 2U);
+
+  gpio_bank_thread(ctx->dev);
+  KUNIT_EXPECT_TRUE(test, kfifo_is_empty(&ctx->dev->snapshots));
+  KUNIT_EXPECT_EQ(test, kfifo_len(&sub->events), (unsigned int)GPIO_SNAPSHOT_FIFO_SIZE);
+  KUNIT_EXPECT_EQ(test, ctx->dev->thread_batch_max, (u64)GPIO_SNAPSHOT_FIFO_SIZE);
+
+  gpio_kunit_event(ctx->dev, 0x1, 0x1, 5000);
+  KUNIT_EXPECT_EQ(test, ctx->dev->snapshot_lost, 0U);
+  KUNIT_EXPECT_EQ(test, ctx->dev->overflows, 2ULL);
+  KUNIT_ASSERT_EQ(test, kfifo_len(&sub->events), (unsigned int)GPIO_SNAPSHOT_FIFO_SIZE + 1);
+  for(i = 0; i <= GPIO_SNAPSHOT_FIFO_SIZE; i++)
+    KUNIT_ASSERT_TRUE(test, kfifo_get(&sub->events, &event));
+  KUNIT_EXPECT_EQ(test, event.timestamp, 5000ULL);
+  KUNIT_EXPECT_EQ(test, event.overflow, 2U);
+  KUNIT_EXPECT_EQ(test, event.seq, (u32)GPIO_SNAPSHOT_FIFO_SIZE);
+  KUNIT_EXPECT_EQ(test, kfifo_len(&other->events), (unsigned int)GPIO_SNAPSHOT_FIFO_SIZE + 1);
+}
+
+/**
+ * @brief Il thread consegna l'evento ed il lettore non bloccante lo riceve.
+ */
+static void gpio_kunit_thread_delivery(struct kunit *test)
+{
+  struct gpio_kunit_ctx *ctx = test->priv;
+  struct gpio_subscriber *sub = gpio_kunit_open(test);
+  struct gpio_event event;
+
+  KUNIT_EXPECT_EQ(test, gpio_kunit_rw(test, sub, 0, &event, sizeof(event), GPIO_STREAM_OFFSET), (ssize_t)-EAGAIN);
+  KUNIT_EXPECT_EQ(test, gpio_kunit_rw(test, sub, 0, &event, sizeof(event) - 1, GPIO_STREAM_OFFSET), (ssize_t)-EINVAL);
+
+  gpio_mock_inject(ctx->dev, 0x1, 0x3);
+  KUNIT_EXPECT_EQ(test, ctx->dev->mock->inject_events, 1ULL);
+  KUNIT_EXPECT_EQ(test, ctx->dev->thread_runs, 1ULL);
+  KUNIT_EXPECT_EQ(test, ctx->dev->last_value, 0x3U);
+
+  KUNIT_ASSERT_EQ(test, gpio_kunit_rw(test, sub, 0, &event, sizeof(event), GPIO_STREAM_OFFSET), (ssize_t)sizeof(event));
+  KUNIT_EXPECT_EQ(test, event.pending, 0x1U);
+  KUNIT_EXPECT_EQ(test, event.value, 0x3U);
+  KUNIT_EXPECT_EQ(test, event.overflow, 0U);
+  KUNIT_EXPECT_EQ(test, event.seq, 0U);
+  KUNIT_EXPECT_EQ(test, ctx->dev->reads, 1ULL);
+  KUNIT_EXPECT_EQ(test, ctx->dev->read_events, 1ULL);
+
+  // Un pin mascherato in IER non attiva la ISR
+  ctx->dev->mock->ier = 0x2;
+  gpio_mock_inject(ctx->dev, 0x1, 0x1);
+  KUNIT_EXPECT_EQ(test, ctx->dev->thread_runs, 1ULL);
+  KUNIT_EXPECT_EQ(test, gpio_kunit_rw(test, sub, 0, &event, sizeof(event), GPIO_STREAM_OFFSET), (ssize_t)-EAGAIN);
+}
+
+/****************************** Filtri e code degli eventi ******************************/
+/**
+ * @brief I fronti di discesa sono ricavati da DIN rispetto all'evento precedente.
+ */
+static void gpio_kunit_filter_edges(struct kunit *test)
+{
+  struct gpio_kunit_ctx *ctx = test->priv;
+  struct gpio_subscriber *rising = gpio_kunit_open(test);
+  struct gpio_subscriber *falling = gpio_kunit_open(test);
+  struct gpio_event event;
+
+  mutex_lock(&ctx->dev->subs_lock);
+    falling->filter.mask = 0x1;
+    falling->filter.edges = GPIO_EDGE_FALLING;
+  mutex_unlock(&ctx->dev->subs_lock);
+
+  gpio_kunit_event(ctx->dev, 0x1, 0x1, 1000);   // salita su pin 0
+  gpio_kunit_event(ctx->dev, 0x2, 0x2, 2000);   // salita su pin 1, discesa su pin 0
+  gpio_kunit_event(ctx->dev, 0x2, 0x2, 3000);   // nessuna discesa
+
+  KUNIT_EXPECT_EQ(test, kfifo_len(&rising->events), 3U);
+  KUNIT_ASSERT_EQ(test, kfifo_len(&falling->events), 1U);
+  KUNIT_ASSERT_TRUE(test, kfifo_get(&falling->events, &event));
+  KUNIT_EXPECT_EQ(test, event.timestamp, 2000ULL);
+  KUNIT_EXPECT_EQ(test, event.value, 0x2U);
+  KUNIT_EXPECT_EQ(test, event.seq, 0U);
+}
+
+/**
+ * @brief Filtro sul valore dei pin e sull'intervallo minimo tra eventi consegnati.
+ */
+static void gpio_kunit_filter_value_interval(struct kunit *test)
+{
+  struct gpio_kunit_ctx *ctx = test->priv;
+  struct gpio_subscriber *sub = gpio_kunit_open(test);
+  struct gpio_event event;
+
+  mutex_lock(&ctx->dev->subs_lock);
+    sub->filter.value_mask = 0x8;
+    sub->filter.value_match = 0x8;
+    sub->filter.min_interval_ns = 1000;
+  mutex_unlock(&ctx->dev->subs_lock);
+
+  gpio_kunit_event(ctx->dev, 0x1, 0x9, 1000);   // consegnato
+  gpio_kunit_event(ctx->dev, 0x1, 0x9, 1500);   // troppo vicino al precedente
+  gpio_kunit_event(ctx->dev, 0x1, 0x1, 2000);   // pin 3 basso
+  gpio_kunit_event(ctx->dev, 0x1, 0x9, 2600);   // consegnato
+
+  KUNIT_ASSERT_EQ(test, kfifo_len(&sub->events), 2U);
+  KUNIT_ASSERT_TRUE(test, kfifo_get(&sub->events, &event));
+  KUNIT_EXPECT_EQ(test, event.timestamp, 1000ULL);
+  KUNIT_ASSERT_TRUE(test, kfifo_get(&sub->events, &event));
+  KUNIT_EXPECT_EQ(test, event.timestamp, 2600ULL);
+  KUNIT_EXPECT_EQ(test, event.seq, 1U);
+  KUNIT_EXPECT_EQ(test, event.overflow, 0U);
+
+  // Gli scarti del filtro non sono eventi persi
+  KUNIT_EXPECT_EQ(test, ctx->dev->overflows, 0ULL);
+  KUNIT_EXPECT_EQ(test, ctx->dev->intervals, 3ULL);
+  KUNIT_EXPECT_EQ(test, ctx->dev->interval_min_ns, 500ULL);
+  KUNIT_EXPECT_EQ(test, ctx->dev->interval_max_ns, 600ULL);
+}
+
+/**
+ * @brief A coda del file piena gli eventi sono contati come persi e riportati nel primo
+ *    evento accodato dopo che il lettore ha svuotato la coda.
+ */
+static void gpio_kunit_queue_overflow(struct kunit *test)
+{
+  struct gpio_kunit_ctx *ctx = test->priv;
+  struct gpio_subscriber *sub = gpio_kunit_open(test);
+  size_t len = GPIO_EVENT_FIFO_SIZE * sizeof(struct gpio_event);
+  struct gpio_event *events;
+  unsigned int i;
+
+  events = kunit_kzalloc(test, len, GFP_KERNEL);
+  KUNIT_ASSERT_NOT_ERR_OR_NULL(test, events);
+
+  for(i = 0; i < GPIO_EVENT_FIFO_SIZE + 3; i++)
+    gpio_kunit_event(ctx->dev, 0x1, 0x1, 1000 * (i + 1));
+  KUNIT_EXPECT_TRUE(test, kfifo_is_full(&sub->events));
+  KUNIT_EXPECT_EQ(test, sub->overflow, 3U);
+  KUNIT_EXPECT_EQ(test, ctx->dev->overflows, 3ULL);
+
+  KUNIT_ASSERT_EQ(test, gpio_kunit_rw(test, sub, 0, events, len, GPIO_STREAM_OFFSET), (ssize_t)len);
+  for(i = 0; i < GPIO_EVENT_FIFO_SIZE; i++){
+    KUNIT_EXPECT_EQ(test, events[i].seq, i);
+    KUNIT_EXPECT_EQ(test, events[i].overflow, 0U);
+  }
+  KUNIT_EXPECT_EQ(test, ctx->dev->read_events, (u64)GPIO_EVENT_FIFO_SIZE);
+
+  gpio_kunit_event(ctx->dev, 0x1, 0x1, 1000000);
+  KUNIT_ASSERT_EQ(test, gpio_kunit_rw(test, sub, 0, events, len, GPIO_STREAM_OFFSET), (ssize_t)sizeof(struct gpio_event));
+  KUNIT_EXPECT_EQ(test, events[0].overflow, 3U);
+  KUNIT_EXPECT_EQ(test, events[0].seq, (u32)GPIO_EVENT_FIFO_SIZE);
+  KUNIT_EXPECT_EQ(test, sub->overflow, 0U);
+}
+
+/****************************** Registri e device file ******************************/
+/**
+ * @brief Operazioni del batch su DOUT e su IER, gestito attraverso la sua copia.
+ */
+static void gpio_kunit_batch_op(struct kunit *test)
+{
+  struct gpio_kunit_ctx *ctx = test->priv;
+  struct gpio_device *dev = ctx->dev;
+
+  KUNIT_EXPECT_EQ(test, gpio_kunit_op(dev, GPIO_OP_SET, GPIO_DOUT_OFFSET, 0x3, 0), 0U);
+  KUNIT_EXPECT_EQ(test, dev->mock->dout, 0x3U);
+  gpio_kunit_op(dev, GPIO_OP_CLEAR, GPIO_DOUT_OFFSET, 0x1, 0);
+  KUNIT_EXPECT_EQ(test, dev->mock->dout, 0x2U);
+  gpio_kunit_op(dev, GPIO_OP_TOGGLE, GPIO_DOUT_OFFSET, 0xC, 0);
+  KUNIT_EXPECT_EQ(test, dev->mock->dout, 0xEU);
+  gpio_kunit_op(dev, GPIO_OP_UPDATE, GPIO_DOUT_OFFSET, 0x6, 0x4);
+  KUNIT_EXPECT_EQ(test, dev->mock->dout, 0xCU);
+  KUNIT_EXPECT_EQ(test, gpio_kunit_op(dev, GPIO_OP_READ, GPIO_DOUT_OFFSET, 0, 0), 0xCU);
+
+  // In polling la periferica resta mascherata: cambia solo la copia di IER
+  dev->polling = YES;
+  gpio_kunit_op(dev, GPIO_OP_UPDATE, GPIO_IER_OFFSET, ~0U, 0x1);
+  KUNIT_EXPECT_EQ(test, dev->ier, 0x1U);
+  KUNIT_EXPECT_EQ(test, dev->mock->ier, (u32)INT_ENABLE);
+  KUNIT_EXPECT_EQ(test, gpio_kunit_op(dev, GPIO_OP_READ, GPIO_IER_OFFSET, 0, 0), 0x1U);
+
+  dev->polling = NO;
+  gpio_kunit_op(dev, GPIO_OP_SET, GPIO_IER_OFFSET, 0x2, 0);
+  KUNIT_EXPECT_EQ(test, dev->ier, 0x3U);
+  KUNIT_EXPECT_EQ(test, dev->mock->ier, 0x3U);
+}
+
+/**
+ * @brief La write scrive le parole una dopo l'altra su DOUT.
+ */
+static void gpio_kunit_write_stream(struct kunit *test)
+{
+  struct gpio_kunit_ctx *ctx = test->priv;
+  struct gpio_subscriber *sub = gpio_kunit_open(test);
+  u32 words[3] = { 0x1, 0x2, 0x3 };
+
+  KUNIT_EXPECT_EQ(test, gpio_kunit_rw(test, sub, 1, words, sizeof(words), GPIO_STREAM_OFFSET), (ssize_t)sizeof(words));
+  KUNIT_EXPECT_EQ(test, ctx->dev->mock->dout, 0x3U);
+  KUNIT_EXPECT_EQ(test, ctx->dev->write_words, 3ULL);
+  KUNIT_EXPECT_EQ(test, ctx->dev->writes, 1ULL);
+
+  KUNIT_EXPECT_EQ(test, gpio_kunit_rw(test, sub, 1, words, 6, GPIO_STREAM_OFFSET), (ssize_t)-EINVAL);
+  KUNIT_EXPECT_EQ(test, ctx->dev->writes, 1ULL);
+}
+
+/**
+ * @brief pread e pwrite accedono direttamente al banco di registri.
+ */
+static void gpio_kunit_regs_iter(struct kunit *test)
+{
+  struct gpio_kunit_ctx *ctx = test->priv;
+  struct gpio_subscriber *sub = gpio_kunit_open(test);
+  u32 regs[GPIO_REGS_SIZE/4];
+  u32 tri = 0xA;
+
+  KUNIT_EXPECT_EQ(test, gpio_kunit_rw(test, sub, 1, &tri, 4, GPIO_TRI_OFFSET), 4L);
+  KUNIT_EXPECT_EQ(test, ctx->dev->mock->tri, 0xAU);
+  KUNIT_EXPECT_EQ(test, gpio_kunit_rw(test, sub, 1, &tri, 4, GPIO_ISR_OFFSET), (ssize_t)-EINVAL);
+  KUNIT_EXPECT_EQ(test, gpio_kunit_rw(test, sub, 1, &tri, 4, 2), (ssize_t)-EINVAL);
+
+  gpio_kunit_pins(ctx->dev, 0x4, 0x6);
+  KUNIT_ASSERT_EQ(test, gpio_kunit_rw(test, sub, 0, regs, sizeof(regs), 0), (ssize_t)sizeof(regs));
+  KUNIT_EXPECT_EQ(test, regs[GPIO_DOUT_OFFSET/4], 0U);
+  KUNIT_EXPECT_EQ(test, regs[GPIO_TRI_OFFSET/4], 0xAU);
+  KUNIT_EXPECT_EQ(test, regs[GPIO_DIN_OFFSET/4], 0x6U);
+  KUNIT_EXPECT_EQ(test, regs[GPIO_IER_OFFSET/4], (u32)INT_ENABLE);
+  KUNIT_EXPECT_EQ(test, regs[GPIO_ICL_OFFSET/4], 0U);
+  KUNIT_EXPECT_EQ(test, regs[GPIO_ISR_OFFSET/4], 0x4U);
+
+  KUNIT_EXPECT_EQ(test, gpio_kunit_rw(test, sub, 0, regs, sizeof(regs), GPIO_REGS_SIZE), 0L);
+  KUNIT_EXPECT_EQ(test, gpio_kunit_rw(test, sub, 0, regs, sizeof(regs), 2), (ssize_t)-EINVAL);
+  KUNIT_EXPECT_EQ(test, gpio_kunit_rw(test, sub, 0, regs, 2, 0), (ssize_t)-EINVAL);
+}
+
+/****************************** gpiolib ******************************/
+#ifdef CONFIG_GPIOLIB
+/**
+ * @brief Anche la periferica simulata è registrata presso gpiolib, figlia del device file.
+ */
+static void gpio_kunit_chip_registered(struct kunit *test)
+{
+  struct gpio_kunit_ctx *ctx = test->priv;
+  struct gpio_chip *chip = &ctx->dev->chip;
+
+  KUNIT_ASSERT_EQ(test, ctx->dev->chip_registered, YES);
+  KUNIT_EXPECT_EQ(test, chip->ngpio, (u16)GPIO_NGPIO);
+  KUNIT_EXPECT_EQ(test, chip->parent->devt, ctx->dev->gpiox_dev_number);
+  KUNIT_EXPECT_STREQ(test, chip->label, dev_name(chip->parent));
+  KUNIT_EXPECT_PTR_EQ(test, gpiochip_get_data(chip), (void *)ctx->dev);
+  KUNIT_EXPECT_NOT_ERR_OR_NULL(test, ctx->dev->irq_domain);
+}
+
+/**
+ * @brief La direzione dei pin è quella del registro TRI (bit a 1 = uscita).
+ */
+static void gpio_kunit_chip_direction(struct kunit *test)
+{
+  struct gpio_kunit_ctx *ctx = test->priv;
+  struct gpio_chip *chip = &ctx->dev->chip;
+
+  KUNIT_EXPECT_EQ(test, gpio_chip_get_direction(chip, 2), 1);
+
+  KUNIT_EXPECT_EQ(test, gpio_chip_direction_output(chip, 2, 1), 0);
+  KUNIT_EXPECT_EQ(test, ctx->dev->mock->tri, 0x4U);
+  KUNIT_EXPECT_EQ(test, ctx->dev->mock->dout, 0x4U);
+  KUNIT_EXPECT_EQ(test, gpio_chip_get_direction(chip, 2), 0);
+  KUNIT_EXPECT_EQ(test, gpio_chip_get_direction(chip, 1), 1);
+
+  KUNIT_EXPECT_EQ(test, gpio_chip_direction_output(chip, 1, 0), 0);
+  KUNIT_EXPECT_EQ(test, ctx->dev->mock->tri, 0x6U);
+  KUNIT_EXPECT_EQ(test, ctx->dev->mock->dout, 0x4U);
+
+  KUNIT_EXPECT_EQ(test, gpio_chip_direction_input(chip, 2), 0);
+  KUNIT_EXPECT_EQ(test, ctx->dev->mock->tri, 0x2U);
+  KUNIT_EXPECT_EQ(test, gpio_chip_get_direction(chip, 2), 1);
+}
+
+/**
+ * @brief get_multiple legge DOUT per le uscite e DIN per gli ingressi, set_multiple
+ *    scrive in DOUT i soli pin indicati dalla maschera.
+ */
+static void gpio_kunit_chip_multiple(struct kunit *test)
+{
+  struct gpio_kunit_ctx *ctx = test->priv;
+  struct gpio_chip *chip = &ctx->dev->chip;
+  unsigned long mask, bits;
+
+  gpio_chip_direction_output(chip, 0, 0);
+  gpio_chip_direction_output(chip, 1, 0);
+  ctx->dev->mock->dout = 0x8;
+
+  mask = 0x3;
+  bits = 0x1;
+  gpio_chip_set_multiple(chip, &mask, &bits);
+  KUNIT_EXPECT_EQ(test, ctx->dev->mock->dout, 0x9U);
+
+  gpio_chip_set(chip, 1, 1);
+  gpio_chip_set(chip, 0, 0);
+  KUNIT_EXPECT_EQ(test, ctx->dev->mock->dout, 0xAU);
+
+  // Gli ingressi sono letti da DIN, anche se DOUT contiene altro
+  gpio_kunit_pins(ctx->dev, 0, 0x5);
+  mask = 0xF;
+  bits = 0xF0;
+  KUNIT_EXPECT_EQ(test, gpio_chip_get_multiple(chip, &mask, &bits), 0);
+  KUNIT_EXPECT_EQ(test, bits, 0xF6UL);
+
+  mask = 0x4;
+  bits = 0;
+  gpio_chip_get_multiple(chip, &mask, &bits);
+  KUNIT_EXPECT_EQ(test, bits, 0x4UL);
+
+  KUNIT_EXPECT_EQ(test, gpio_chip_get(chip, 0), 0);
+  KUNIT_EXPECT_EQ(test, gpio_chip_get(chip, 1), 1);
+  KUNIT_EXPECT_EQ(test, gpio_chip_get(chip, 2), 1);
+  KUNIT_EXPECT_EQ(test, gpio_chip_get(chip, 3), 0);
+}
+
+static irqreturn_t gpio_kunit_nested_handler(int irq, void *dev_id)
+{
+  atomic_inc(dev_id);
+  return IRQ_HANDLED;
+}
+
+/**
+ * @brief Il thread di interruzione smista con handle_nested_irq le interruzioni dei
+ *    soli pin richiesti attraverso gpiolib; la richiesta abilita il pin in IER e lo
+ *    blocca come ingresso di interruzione.
+ */
+static void gpio_kunit_chip_nested_irq(struct kunit *test)
+{
+  struct gpio_kunit_ctx *ctx = test->priv;
+  struct gpio_subscriber *sub = gpio_kunit_open(test);
+  atomic_t *count;
+  int virq, ret;
+
+  count = kunit_kzalloc(test, sizeof(*count), GFP_KERNEL);
+  KUNIT_ASSERT_NOT_ERR_OR_NULL(test, count);
+
+  // Senza pin richiesti dal device file, IER contiene solo quelli abilitati attraverso gpiolib
+  gpio_kunit_op(ctx->dev, GPIO_OP_UPDATE, GPIO_IER_OFFSET, ~0U, 0);
+  KUNIT_EXPECT_EQ(test, ctx->dev->mock->ier, 0U);
+
+  virq = gpio_chip_to_irq(&ctx->dev->chip, 1);
+  KUNIT_ASSERT_GT(test, virq, 0);
+  ret = request_threaded_irq(virq, NULL, gpio_kunit_nested_handler, IRQF_ONESHOT, "gpiodrv-kunit", count);
+  KUNIT_ASSERT_EQ(test, ret, 0);
+  KUNIT_EXPECT_TRUE(test, gpiochip_line_is_irq(&ctx->dev->chip, 1));
+  KUNIT_EXPECT_EQ(test, ctx->dev->irq_unmasked, 0x2U);
+  KUNIT_EXPECT_EQ(test, ctx->dev->mock->ier, 0x2U);
+
+  gpio_mock_inject(ctx->dev, 0x2, 0x2);
+  KUNIT_EXPECT_EQ(test, atomic_read(count), 1);
+  gpio_mock_inject(ctx->dev, 0x3, 0x3);
+  KUNIT_EXPECT_EQ(test, atomic_read(count), 2);
+
+  // Il pin 0 è mascherato in IER e non attiva la ISR
+  gpio_mock_inject(ctx->dev, 0x1, 0x1);
+  KUNIT_EXPECT_EQ(test, atomic_read(count), 2);
+
+  // Pin 0 pendente ma non richiesto attraverso gpiolib: evento al file, nessuno smistamento
+  ctx->dev->mock->isr = 0;
+  gpio_kunit_event(ctx->dev, 0x1, 0x1, 1000);
+  KUNIT_EXPECT_EQ(test, atomic_read(count), 2);
+  KUNIT_EXPECT_EQ(test, kfifo_len(&sub->events), 3U);
+
+  free_irq(virq, count);
+  KUNIT_EXPECT_FALSE(test, gpiochip_line_is_irq(&ctx->dev->chip, 1));
+  KUNIT_EXPECT_EQ(test, ctx->dev->irq_unmasked, 0U);
+  KUNIT_EXPECT_EQ(test, ctx->dev->mock->ier, 0U);
+
+  gpio_mock_inject(ctx->dev, 0x2, 0x2);
+  KUNIT_EXPECT_EQ(test, atomic_read(count), 2);
+}
+#endif
+
+/****************************** Minor number e riferimenti ******************************/
+/**
+ * @brief Cerca un minor number nell'idr, come gpio_open.
+ */
+static struct gpio_device *gpio_kunit_lookup(unsigned int minor)
+{
+  struct gpio_device *gpio_dev_ptr;
+
+  rcu_read_lock();
+    gpio_dev_ptr = idr_find(&gpio_idr, minor);
+  rcu_read_unlock();
+  return gpio_dev_ptr;
+}
+
+/**
+ * @brief Registra periferiche fino ad esaurire i minor number riservati, verifica che
+ *    i minor siano distinti e ritrovabili nell'idr, che un file aperto mantenga in vita
+ *    il dispositivo rimosso e che i minor rilasciati siano riassegnati.
+ */
+static void gpio_kunit_scale_minors(struct kunit *test)
+{
+  struct gpio_device **devs;
+  unsigned long *live;
+  struct inode *inode;
+  struct file *filp;
+  unsigned int n, i, minor, reused;
+  long err;
+
+  // Il test esaurisce i minor number: il conteggio atteso vale solo con la riserva di default
+  if(max_devices)
+    kunit_skip(test, "minor number fissati da max_devices = %u", max_devices);
+
+  devs = kunit_kcalloc(test, gpio_minors + 1, sizeof(*devs), GFP_KERNEL);
+  KUNIT_ASSERT_NOT_ERR_OR_NULL(test, devs);
+  live = kunit_kcalloc(test, BITS_TO_LONGS(gpio_minors), sizeof(*live), GFP_KERNEL);
+  KUNIT_ASSERT_NOT_ERR_OR_NULL(test, live);
+  inode = kunit_kzalloc(test, sizeof(*inode), GFP_KERNEL);
+  KUNIT_ASSERT_NOT_ERR_OR_NULL(test, inode);
+  filp = kunit_kzalloc(test, sizeof(*filp), GFP_KERNEL);
+  KUNIT_ASSERT_NOT_ERR_OR_NULL(test, filp);
+
+  for(n = 0; n <= gpio_minors; n++){
+    devs[n] = gpio_mock_create();
+    if(IS_ERR(devs[n]))
+      break;
+  }
+  KUNIT_ASSERT_LE(test, n, gpio_minors);
+  err = PTR_ERR(devs[n]);
+  devs[n] = NULL;
+  KUNIT_EXPECT_EQ(test, err, (long)-ENOSPC);
+  KUNIT_ASSERT_GE(test, n, (unsigned int)GPIO_KUNIT_DEVICES);
+
+  for(i = 0; i < n; i++){
+    minor = MINOR(devs[i]->gpiox_dev_number);
+    KUNIT_EXPECT_EQ(test, MAJOR(devs[i]->gpiox_dev_number), (unsigned int)major);
+    KUNIT_ASSERT_LT(test, minor, gpio_minors);
+    KUNIT_EXPECT_FALSE(test, test_and_set_bit(minor, live));
+    KUNIT_EXPECT_PTR_EQ(test, gpio_kunit_lookup(minor), devs[i]);
+    KUNIT_EXPECT_EQ(test, kref_read(&devs[i]->ref), 1U);
+  }
+
+  // Un file aperto mantiene in vita il dispositivo rimosso, ma non lo rende più apribile
+  minor = MINOR(devs[0]->gpiox_dev_number);
+  inode->i_rdev = devs[0]->gpiox_dev_number;
+  KUNIT_ASSERT_EQ(test, gpio_open(inode, filp), 0);
+  KUNIT_EXPECT_EQ(test, kref_read(&devs[0]->ref), 2U);
+  gpio_mock_destroy(devs[0]);
+  KUNIT_EXPECT_EQ(test, kref_read(&devs[0]->ref), 1U);
+  KUNIT_EXPECT_PTR_EQ(test, gpio_kunit_lookup(minor), NULL);
+  KUNIT_EXPECT_EQ(test, gpio_open(inode, kunit_kzalloc(test, sizeof(*filp), GFP_KERNEL)), -ENODEV);
+  gpio_release(inode, filp);
+  clear_bit(minor, live);
+  devs[0] = NULL;
+
+  // Rimozione di una periferica su due: le altre restano raggiungibili
+  for(i = 1; i < n; i += 2){
+    minor = MINOR(devs[i]->gpiox_dev_number);
+    gpio_mock_destroy(devs[i]);
+    devs[i] = NULL;
+    clear_bit(minor, live);
+    KUNIT_EXPECT_PTR_EQ(test, gpio_kunit_lookup(minor), NULL);
+  }
+  for(i = 2; i < n; i += 2)
+    KUNIT_EXPECT_PTR_EQ(test, gpio_kunit_lookup(MINOR(devs[i]->gpiox_dev_number)), devs[i]);
+
+  // Le nuove periferiche ricevono i minor number rilasciati
+  for(i = reused = 0; i < n; i++){
+    if(devs[i])
+      continue;
+    devs[i] = gpio_mock_create();
+    if(IS_ERR(devs[i])){
+      KUNIT_FAIL(test, "Periferica %u non ricreata: %ld", i, PTR_ERR(devs[i]));
+      devs[i] = NULL;
+      continue;
+    }
+    minor = MINOR(devs[i]->gpiox_dev_number);
+    KUNIT_EXPECT_FALSE(test, test_and_set_bit(minor, live));
+    KUNIT_EXPECT_PTR_EQ(test, gpio_kunit_lookup(minor), devs[i]);
+    reused++;
+  }
+  KUNIT_EXPECT_EQ(test, reused, 1 + n / 2);
+  devs[n] = gpio_mock_create();
+  KUNIT_EXPECT_TRUE(test, IS_ERR(devs[n]));
+  if(!IS_ERR(devs[n]))
+    gpio_mock_destroy(devs[n]);
+
+  for(i = 0; i < n; i++){
+    if(!devs[i])
+      continue;
+    minor = MINOR(devs[i]->gpiox_dev_number);
+    gpio_mock_destroy(devs[i]);
+    KUNIT_EXPECT_PTR_EQ(test, gpio_kunit_lookup(minor), NULL);
+  }
+}
+
+/**
+ * @brief Apre e chiude a rotazione i device file delle periferiche di scale.
+ *
+ * @details Ogni apertura riuscita deve restituire il dispositivo del minor richiesto con
+ *    almeno due riferimenti (quello del test e quello del file); una periferica già
+ *    rimossa deve dare -ENODEV.
+ */
+static int gpio_kunit_scale_worker(void *data)
+{
+  struct gpio_kunit_worker *worker = data;
+  struct gpio_kunit_scale *scale = worker->scale;
+  struct gpio_subscriber *sub;
+  unsigned int i, d;
+  int ret_status;
+
+  wait_for_completion(&scale->start);
+  for(i = 0; i < GPIO_KUNIT_ROUNDS * GPIO_KUNIT_SCALE_DEVICES; i++){
+    d = (i + worker->id * (GPIO_KUNIT_SCALE_DEVICES / GPIO_KUNIT_WORKERS)) % GPIO_KUNIT_SCALE_DEVICES;
+    worker->inode->i_rdev = scale->devnums[d];
+    memset(worker->filp, 0, sizeof(*worker->filp));
+    worker->filp->f_flags = O_RDWR;
+
+    ret_status = gpio_open(worker->inode, worker->filp);
+    if(ret_status == -ENODEV){
+      worker->missing++;
+      continue;
+    }
+    if(ret_status){
+      worker->errors++;
+      continue;
+    }
+
+    sub = worker->filp->private_data;
+    if(sub->dev->gpiox_dev_number != scale->devnums[d] || kref_read(&sub->dev->ref) < 2)
+      worker->errors++;
+    gpio_release(worker->inode, worker->filp);
+    worker->opens++;
+    cond_resched();
+  }
+
+  if(atomic_dec_and_test(&scale->running))
+    complete(&scale->done);
+  return 0;
+}
+
+/**
+ * @brief Rimuove GPIO_KUNIT_SCALE_DEVICES periferiche mentre GPIO_KUNIT_WORKERS thread
+ *    ne aprono e chiudono i device file.
+ *
+ * @details Il test tiene un riferimento a ciascuna periferica: al termine dei thread ogni
+ *    dispositivo deve averne esattamente uno, ovvero aperture e chiusure concorrenti con
+ *    la rimozione non perdono nè lasciano riferimenti, e nessun minor deve essere più
+ *    presente nell'idr.
+ */
+static void gpio_kunit_scale_concurrent(struct kunit *test)
+{
+  struct gpio_device *devs[GPIO_KUNIT_SCALE_DEVICES];
+  struct gpio_kunit_worker *workers;
+  struct gpio_kunit_scale *scale;
+  struct task_struct *task;
+  unsigned int i, opens = 0, errors = 0;
+  long err;
+
+  BUILD_BUG_ON(GPIO_KUNIT_SCALE_DEVICES > GPIO_KUNIT_DEVICES);
+
+  scale = kunit_kzalloc(test, sizeof(*scale), GFP_KERNEL);
+  KUNIT_ASSERT_NOT_ERR_OR_NULL(test, scale);
+  workers = kunit_kcalloc(test, GPIO_KUNIT_WORKERS, sizeof(*workers), GFP_KERNEL);
+  KUNIT_ASSERT_NOT_ERR_OR_NULL(test, workers);
+  init_completion(&scale->start);
+  init_completion(&scale->done);
+
+  for(i = 0; i < GPIO_KUNIT_WORKERS; i++){
+    workers[i].scale = scale;
+    workers[i].id = i;
+    workers[i].inode = kunit_kzalloc(test, sizeof(struct inode), GFP_KERNEL);
+    workers[i].filp = kunit_kzalloc(test, sizeof(struct file), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, workers[i].inode);
+    KUNIT_ASSERT_NOT_ERR_OR_NULL(test, workers[i].filp);
+  }
+
+  for(i = 0; i < GPIO_KUNIT_SCALE_DEVICES; i++){
+    devs[i] = gpio_mock_create();
+    if(IS_ERR(devs[i])){
+      err = PTR_ERR(devs[i]);
+      while(i--){
+        gpio_mock_destroy(devs[i]);
+        gpio_device_put(devs[i]);
+      }
+      // Con max_devices i minor number dei test non sono riservati
+      if(err == -ENOSPC && max_devices)
+        kunit_skip(test, "minor number esauriti (max_devices = %u)", max_devices);
+      KUNIT_FAIL(test, "Periferiche non create: %ld", err);
+      return;
+    }
+    // Riferimento del test, rilasciato dopo la verifica finale
+    kref_get(&devs[i]->ref);
+    scale->devnums[i] = devs[i]->gpiox_dev_number;
+  }
+
+  atomic_set(&scale->running, GPIO_KUNIT_WORKERS);
+  for(i = 0; i < GPIO_KUNIT_WORKERS; i++){
+    task = kthread_run(gpio_kunit_scale_worker, &workers[i], "gpiodrv-kunit/%u", i);
+    if(IS_ERR(task)){
+      KUNIT_FAIL(test, "Thread %u non creato: %ld", i, PTR_ERR(task));
+      if(atomic_dec_and_test(&scale->running))
+        complete(&scale->done);
+    }
+  }
+
+  // Le rimozioni avvengono mentre i thread aprono e chiudono i device file
+  complete_all(&scale->start);
+  for(i = 0; i < GPIO_KUNIT_SCALE_DEVICES; i++){
+    gpio_mock_destroy(devs[i]);
+    cond_resched();
+  }
+  KUNIT_ASSERT_TRUE(test, wait_for_completion_timeout(&scale->done, 30 * HZ) != 0);
+
+  for(i = 0; i < GPIO_KUNIT_WORKERS; i++){
+    opens += workers[i].opens;
+    errors += workers[i].errors;
+    KUNIT_EXPECT_EQ(test, workers[i].opens + workers[i].missing + workers[i].errors,
+                    (unsigned int)(GPIO_KUNIT_ROUNDS * GPIO_KUNIT_SCALE_DEVICES));
+  }
+  KUNIT_EXPECT_EQ(test, errors, 0U);
+  kunit_info(test, "aperture riuscite: %u su %u\n", opens, GPIO_KUNIT_WORKERS * GPIO_KUNIT_ROUNDS * GPIO_KUNIT_SCALE_DEVICES);
+
+  for(i = 0; i < GPIO_KUNIT_SCALE_DEVICES; i++){
+    KUNIT_EXPECT_PTR_EQ(test, gpio_kunit_lookup(MINOR(scale->devnums[i])), NULL);
+    KUNIT_EXPECT_EQ(test, kref_read(&devs[i]->ref), 1U);
+    gpio_device_put(devs[i]);
+  }
+}
+
+static struct kunit_case gpio_kunit_cases[] = {
+  KUNIT_CASE(gpio_kunit_isr_idle),
+  KUNIT_CASE(gpio_kunit_isr_snapshot),
+  KUNIT_CASE(gpio_kunit_snapshot_overflow),
+  KUNIT_CASE(gpio_kunit_thread_delivery),
+  KUNIT_CASE(gpio_kunit_filter_edges),
+  KUNIT_CASE(gpio_kunit_filter_value_interval),
+  KUNIT_CASE(gpio_kunit_queue_overflow),
+  KUNIT_CASE(gpio_kunit_batch_op),
+  KUNIT_CASE(gpio_kunit_write_stream),
+  KUNIT_CASE(gpio_kunit_regs_iter),
+#ifdef CONFIG_GPIOLIB
+  KUNIT_CASE(gpio_kunit_chip_registered),
+  KUNIT_CASE(gpio_kunit_chip_direction),
+  KUNIT_CASE(gpio_kunit_chip_multiple),
+  KUNIT_CASE(gpio_kunit_chip_nested_irq),
+#endif
+  {}
+};
+
+static struct kunit_suite gpio_kunit_suite = {
+  .name = "gpiodrv",
+  .init = gpio_kunit_init,
+  .exit = gpio_kunit_exit,
+  .test_cases = gpio_kunit_cases,
+};
+
+static struct kunit_case gpio_kunit_scale_cases[] = {
+  KUNIT_CASE(gpio_kunit_scale_minors),
+  KUNIT_CASE(gpio_kunit_scale_concurrent),
+  {}
+};
+
+static struct kunit_suite gpio_kunit_scale_suite = {
+  .name = "gpiodrv_scale",
+  .test_cases = gpio_kunit_scale_cases,
+};
+kunit_test_suites(&gpio_kunit_suite, &gpio_kunit_scale_suite);
+/** @} */
+/** @} */
+/** @} */
@@ -0,0 +1,288 @@
+/**
+* @file gpiodrv_mock.c
+* @brief Periferiche GPIO simulate ed iniettore di interruzioni sintetiche.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details. You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup LINUX
+* @{
+*
+* @addtogroup KERNEL_MODULE
+* @{
+*
+* @addtogroup MODULE
+* @{
+*
+* @details Compilato solo con GPIODRV_MOCK=y. Il parametro mock_devices indica quante
+*   periferiche simulate creare al caricamento del modulo: ciascuna ha un device file
+*   /dev/gpioN come quelle reali, ma i suoi registri sono variabili in memoria con la
+*   stessa semantica dell'hardware (ISR azzerato scrivendo ICL, DIN ed ISR in sola lettura).
+*
+*   Le interruzioni si iniettano scrivendo sul file inject nella directory debugfs del
+*   dispositivo la maschera dei pin, il loro stato ed il numero di ripetizioni:
+*
+*     echo "0x1 0x1 100000" > /sys/kernel/debug/gpiodrv/gpio0/inject
+*
+*   Ogni evento attraversa gli stessi gestori di primo e secondo livello di un'interruzione
+*   reale, per cui i contatori ed il file stats del dispositivo misurano ISR, consegna
+*   e risveglio dei lettori; inject_events ed inject_ns riportano il costo complessivo
+*   dell'iniezione. Le periferiche simulate non hanno una linea di interruzione: la
+*   modalità polling non è disponibile e la mmap dei registri restituisce -ENODEV.
+*
+*   Come quelle reali, le periferiche simulate sono registrate presso gpiolib (figlie
+*   del proprio device file): le interruzioni iniettate sono smistate anche ai pin
+*   richiesti attraverso gpiolib.
+*/
+/***************************** Include Files ********************************/
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/slab.h>
+#include <linux/debugfs.h>
+#include <linux/uaccess.h>
+#include <linux/irqflags.h>
+
+#include "gpiodrv_core.h"
+
+/************************** Parametri del modulo *****************************/
+static unsigned int mock_devices = 0;
+module_param(mock_devices, uint, 0444);
+MODULE_PARM_DESC(mock_devices, "Numero di periferiche simulate da creare al caricamento del modulo");
+
+/************************** Variable Definitions *****************************/
+static struct gpio_device **mock_devs;  ///< Periferiche simulate create da gpio_mock_init
+
+/**
+ * @brief Legge un registro simulato.
+ */
+u32 gpio_mock_read(struct gpio_mock_regs *mock, unsigned int offset)
+{
+  switch(offset){
+    case GPIO_DOUT_OFFSET:
+      return READ_ONCE(mock->dout);
+    case GPIO_TRI_OFFSET:
+      return READ_ONCE(mock->tri);
+    case GPIO_DIN_OFFSET:
+      return READ_ONCE(mock->din);
+    case GPIO_IER_OFFSET:
+      return READ_ONCE(mock->ier);
+    case GPIO_ISR_OFFSET:
+      return READ_ONCE(mock->isr);
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief Scrive un registro simulato.
+ *
+ * @note Le scritture su ICL avvengono nella ISR, con irq_lock acquisito, come le
+ *    modifiche di ISR effettuate dall'iniettore.
+ */
+void gpio_mock_write(struct gpio_mock_regs *mock, unsigned int offset, u32 value)
+{
+  switch(offset){
+    case GPIO_DOUT_OFFSET:
+      WRITE_ONCE(mock->dout, value);
+      break;
+    case GPIO_TRI_OFFSET:
+      WRITE_ONCE(mock->tri, value);
+      break;
+    case GPIO_IER_OFFSET:
+      WRITE_ONCE(mock->ier, value);
+      break;
+    case GPIO_ICL_OFFSET:
+      WRITE_ONCE(mock->isr, mock->isr & ~value);
+      break;
+  }
+}
+
+/**
+ * @brief Inietta un evento e lo serve come farebbe la linea di interruzione.
+ *
+ * @details L'ISR registra i fronti anche se mascherati in IER: la ISR è eseguita (con le
+ *    interruzioni locali disabilitate) solo se almeno un pin pendente è abilitato, ed il
+ *    thread di interruzione direttamente nel contesto del processo che scrive su inject.
+ */
+void gpio_mock_inject(struct gpio_device *gpio_dev_ptr, u32 pending, u32 value)
+{
+  struct gpio_mock_regs *mock = gpio_dev_ptr->mock;
+  ktime_t start = ktime_get();
+  unsigned long flags;
+  irqreturn_t ret = IRQ_NONE;
+
+  spin_lock_irqsave(&gpio_dev_ptr->irq_lock, flags);
+    WRITE_ONCE(mock->din, value);
+    WRITE_ONCE(mock->isr, mock->isr | pending);
+  spin_unlock_irqrestore(&gpio_dev_ptr->irq_lock, flags);
+
+  if(READ_ONCE(mock->isr) & READ_ONCE(mock->ier)){
+    local_irq_save(flags);
+      ret = gpio_bank_isr(gpio_dev_ptr, start);
+    local_irq_restore(flags);
+  }
+  if(ret == IRQ_WAKE_THREAD)
+    gpio_bank_thread(gpio_dev_ptr);
+
+  mock->inject_events++;
+  mock->inject_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+/**
+ * @brief Scrittura sul file inject: "pending value [count]" (valori anche esadecimali).
+ */
+static ssize_t gpio_mock_inject_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+  struct gpio_device *gpio_dev_ptr = file->private_data;
+  char cmd[64];
+  u32 pending, value;
+  unsigned int n = 1, i;
+
+  if(count >= sizeof(cmd))
+    return -EINVAL;
+  if(copy_from_user(cmd, buf, count) != 0)
+    return -EFAULT;
+  cmd[count] = '\0';
+
+  if(sscanf(cmd, "%i %i %u", &pending, &value, &n) < 2 || n == 0)
+    return -EINVAL;
+
+  for(i = 0; i < n; i++){
+    gpio_mock_inject(gpio_dev_ptr, pending, value);
+    cond_resched();
+  }
+
+  return count;
+}
+
+static const struct file_operations gpio_mock_inject_fops = {
+  .owner    = THIS_MODULE,
+  .open     = simple_open,
+  .write    = gpio_mock_inject_write,
+  .llseek   = no_llseek,
+};
+
+/**
+ * @brief Restituisce il numero di periferiche simulate, da aggiungere ai minor number riservati.
+ *
+ * @details Con i test KUnit (GPIODRV_KUNIT) sono riservati anche i minor number delle
+ *    periferiche che i test creano e rimuovono.
+ */
+unsigned int gpio_mock_count(void)
+{
+#ifdef GPIODRV_KUNIT
+  return mock_devices + GPIO_KUNIT_DEVICES;
+#else
+  return mock_devices;
+#endif
+}
+
+/**
+ * @brief Crea e registra una periferica simulata, con i file inject, inject_events ed
+ *    inject_ns nella sua directory debugfs.
+ *
+ * @return il dispositivo, con un riferimento, oppure ERR_PTR(errno).
+ */
+struct gpio_device *gpio_mock_create(void)
+{
+  struct gpio_device *gpio_dev_ptr;
+  int ret_status;
+
+  gpio_dev_ptr = gpio_device_alloc();
+  if(!gpio_dev_ptr)
+    return ERR_PTR(-ENOMEM);
+
+  gpio_dev_ptr->mock = kzalloc(sizeof(struct gpio_mock_regs), GFP_KERNEL);
+  if(!gpio_dev_ptr->mock){
+    gpio_device_put(gpio_dev_ptr);
+    return ERR_PTR(-ENOMEM);
+  }
+
+  // Senza linea di interruzione gpio_device_register non abilita IER: lo si fa qui
+  gpio_dev_ptr->ier = INT_ENABLE;
+  gpio_dev_ptr->mock->ier = INT_ENABLE;
+
+  ret_status = gpio_device_register(gpio_dev_ptr, NULL);
+  if(ret_status){
+    gpio_device_put(gpio_dev_ptr);
+    return ERR_PTR(ret_status);
+  }
+
+  debugfs_create_file("inject", 0200, gpio_dev_ptr->debugfs, gpio_dev_ptr, &gpio_mock_inject_fops);
+  debugfs_create_u64("inject_events", 0444, gpio_dev_ptr->debugfs, &gpio_dev_ptr->mock->inject_events);
+  debugfs_create_u64("inject_ns", 0444, gpio_dev_ptr->debugfs, &gpio_dev_ptr->mock->inject_ns);
+  return gpio_dev_ptr;
+}
+
+/**
+ * @brief Rimuove una periferica simulata e ne rilascia il riferimento.
+ *
+ * @details La memoria è liberata con l'ultimo riferimento: un file ancora aperto
+ *    mantiene in vita il dispositivo.
+ */
+void gpio_mock_destroy(struct gpio_device *gpio_dev_ptr)
+{
+  gpio_device_unregister(gpio_dev_ptr);
+  gpio_device_put(gpio_dev_ptr);
+}
+
+/**
+ * @brief Crea le periferiche simulate richieste con il parametro mock_devices.
+ *
+ * @return 0 oppure errno. Le periferiche create prima di un errore restano registrate
+ *    e sono rimosse da gpio_mock_exit.
+ */
+int gpio_mock_init(void)
+{
+  struct gpio_device *gpio_dev_ptr;
+  unsigned int i;
+
+  if(mock_devices == 0)
+    return 0;
+
+  mock_devs = kcalloc(mock_devices, sizeof(*mock_devs), GFP_KERNEL);
+  if(!mock_devs)
+    return -ENOMEM;
+
+  for(i = 0; i < mock_devices; i++){
+    gpio_dev_ptr = gpio_mock_create();
+    if(IS_ERR(gpio_dev_ptr))
+      return PTR_ERR(gpio_dev_ptr);
+    mock_devs[i] = gpio_dev_ptr;
+
+    printk(KERN_INFO "[GPIO driver] Periferica simulata creata (minor %u)\n", MINOR(gpio_dev_ptr->gpiox_dev_number));
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Rimuove le periferiche simulate.
+ */
+void gpio_mock_exit(void)
+{
+  unsigned int i;
+
+  if(!mock_devs)
+    return;
+
+  for(i = 0; i < mock_devices; i++){
+    if(mock_devs[i])
+      gpio_mock_destroy(mock_devs[i]);
+  }
+  kfree(mock_devs);
+  mock_devs = NULL;
+}
+/** @} */
+/** @} */
+/** @} */
@@ -0,0 +1,150 @@
+/**
+* @file gpiodrv_trace.h
+* @brief Tracepoint del modulo kernel per la periferica GPIO.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details. You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup LINUX
+* @{
+*
+* @addtogroup KERNEL_MODULE
+* @{
+*
+* @addtogroup MODULE
+* @{
+*
+* @details Gli eventi sono raggruppati nel sistema "gpiodrv" e sono utilizzabili da
+*   ftrace e perf, ad esempio:
+*
+*     echo 1 > /sys/kernel/debug/tracing/events/gpiodrv/enable
+*     perf record -e 'gpiodrv:*' -a
+*
+*   Quando non sono abilitati il loro costo si riduce ad un salto non preso.
+*/
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM gpiodrv
+
+#if !defined(GPIODRV_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define GPIODRV_TRACE_H_
+
+/***************************** Include Files ********************************/
+#include <linux/tracepoint.h>
+
+/**
+ * @brief Classe comune ad apertura e rilascio del device file.
+ */
+DECLARE_EVENT_CLASS(gpiodrv_file,
+  TP_PROTO(unsigned int minor),
+  TP_ARGS(minor),
+  TP_STRUCT__entry(
+    __field(unsigned int, minor)
+  ),
+  TP_fast_assign(
+    __entry->minor = minor;
+  ),
+  TP_printk("minor=%u", __entry->minor)
+);
+
+DEFINE_EVENT(gpiodrv_file, gpiodrv_open,
+  TP_PROTO(unsigned int minor),
+  TP_ARGS(minor)
+);
+
+DEFINE_EVENT(gpiodrv_file, gpiodrv_release,
+  TP_PROTO(unsigned int minor),
+  TP_ARGS(minor)
+);
+
+/**
+ * @brief Classe comune a lettura e scrittura sul device file.
+ */
+DECLARE_EVENT_CLASS(gpiodrv_rw,
+  TP_PROTO(unsigned int minor, size_t count, ssize_t ret),
+  TP_ARGS(minor, count, ret),
+  TP_STRUCT__entry(
+    __field(unsigned int, minor)
+    __field(size_t, count)
+    __field(ssize_t, ret)
+  ),
+  TP_fast_assign(
+    __entry->minor = minor;
+    __entry->count = count;
+    __entry->ret = ret;
+  ),
+  TP_printk("minor=%u count=%zu ret=%zd", __entry->minor, __entry->count, __entry->ret)
+);
+
+DEFINE_EVENT(gpiodrv_rw, gpiodrv_read,
+  TP_PROTO(unsigned int minor, size_t count, ssize_t ret),
+  TP_ARGS(minor, count, ret)
+);
+
+DEFINE_EVENT(gpiodrv_rw, gpiodrv_write,
+  TP_PROTO(unsigned int minor, size_t count, ssize_t ret),
+  TP_ARGS(minor, count, ret)
+);
+
+/**
+ * @brief Evento servito dalla ISR oppure dalla callback di polling.
+ */
+TRACE_EVENT(gpiodrv_isr,
+  TP_PROTO(unsigned int minor, u32 pending, u32 value, u64 timestamp, int polled),
+  TP_ARGS(minor, pending, value, timestamp, polled),
+  TP_STRUCT__entry(
+    __field(unsigned int, minor)
+    __field(u32, pending)
+    __field(u32, value)
+    __field(u64, timestamp)
+    __field(int, polled)
+  ),
+  TP_fast_assign(
+    __entry->minor = minor;
+    __entry->pending = pending;
+    __entry->value = value;
+    __entry->timestamp = timestamp;
+    __entry->polled = polled;
+  ),
+  TP_printk("minor=%u pending=%08x value=%08x timestamp=%llu polled=%d",
+            __entry->minor, __entry->pending, __entry->value,
+            (unsigned long long)__entry->timestamp, __entry->polled)
+);
+
+/**
+ * @brief Risveglio di un lettore in attesa di eventi.
+ */
+TRACE_EVENT(gpiodrv_wakeup,
+  TP_PROTO(unsigned int minor, unsigned int queued),
+  TP_ARGS(minor, queued),
+  TP_STRUCT__entry(
+    __field(unsigned int, minor)
+    __field(unsigned int, queued)
+  ),
+  TP_fast_assign(
+    __entry->minor = minor;
+    __entry->queued = queued;
+  ),
+  TP_printk("minor=%u queued=%u", __entry->minor, __entry->queued)
+);
+
+#endif /* GPIODRV_TRACE_H_ */
+
+/** @} */
+/** @} */
+/** @} */
+
+// Questa parte deve restare fuori dalla protezione contro l'inclusione multipla
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE gpiodrv_trace
+#include <trace/define_trace.h>
@@ -52,24 +52,120 @@
 #include <linux/module.h>
 #include <linux/spinlock.h>
 #include <linux/idr.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
+#include <linux/kfifo.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/debugfs.h>
+#include <linux/bitops.h>
+#include <linux/irq.h>
+#include <linux/irqdomain.h>
+#include <linux/gpio/driver.h>
+#include <linux/kref.h>
+#include <linux/rcupdate.h>
+#include <linux/of.h>
+#include <linux/seq_file.h>
+#include <linux/uio.h>
+
+#include "gpiodrv_core.h"
+
+#define CREATE_TRACE_POINTS
+#include "gpiodrv_trace.h"
+
+/************************** Parametri del modulo *****************************/
+/*
+ *  Modalità ibrida interruzioni/polling (sullo stile di NAPI).
+ *  Quando in una finestra di poll_window_us microsecondi arrivano più di poll_threshold
+ *  interruzioni, la ISR maschera le interruzioni della periferica (registro IER) ed avvia
+ *  un hrtimer che campiona il registro ISR ogni poll_interval_us microsecondi, servendo
+ *  al più poll_budget eventi per campionamento. Dopo poll_idle_ticks campionamenti
+ *  consecutivi senza eventi il dispositivo torna a lavorare ad interruzioni.
+ */
+static unsigned int poll_threshold = 0;
+module_param(poll_threshold, uint, 0644);
+MODULE_PARM_DESC(poll_threshold, "Interruzioni per finestra oltre le quali si passa al polling (0 = polling disabilitato)");
+
+static unsigned int poll_window_us = 10000;
+module_param(poll_window_us, uint, 0644);
+MODULE_PARM_DESC(poll_window_us, "Durata in microsecondi della finestra di misura del tasso di interruzioni");
+
+static unsigned int poll_interval_us = 100;
+module_param(poll_interval_us, uint, 0644);
+MODULE_PARM_DESC(poll_interval_us, "Periodo in microsecondi dell'hrtimer di polling");
+
+static unsigned int poll_budget = 16;
+module_param(poll_budget, uint, 0644);
+MODULE_PARM_DESC(poll_budget, "Numero massimo di eventi serviti ad ogni campionamento in polling");
+
+static unsigned int poll_idle_ticks = 10;
+module_param(poll_idle_ticks, uint, 0644);
+MODULE_PARM_DESC(poll_idle_ticks, "Campionamenti consecutivi senza eventi dopo i quali si torna alle interruzioni");
+
+/*
+ *  Gestione delle linee di interruzione condivise. Le linee sono sempre richieste con
+ *  IRQF_SHARED, per cui più periferiche possono essere collegate alla stessa interruzione
+ *  del fabric. Per default ogni periferica registra la propria ISR, che verifica il proprio
+ *  registro ISR e restituisce IRQ_NONE se non ha interruzioni pendenti; con irq_aggregate
+ *  una sola ISR per linea serve in un'unica passata tutte le periferiche collegate.
+ */
+static bool irq_aggregate = false;
+module_param(irq_aggregate, bool, 0444);
+MODULE_PARM_DESC(irq_aggregate, "Una sola ISR per linea di interruzione, che serve tutte le periferiche collegate");
+
+/*
+ *  Numero di minor number riservati dal driver. Per default se ne riserva uno per ogni
+ *  periferica compatibile presente (ed abilitata) nel device tree all'inserimento del modulo;
+ *  il parametro consente di riservarne di più, ad esempio per periferiche aggiunte
+ *  successivamente con un device tree overlay.
+ */
+static unsigned int max_devices = 0;
+module_param(max_devices, uint, 0444);
+MODULE_PARM_DESC(max_devices, "Numero di minor number da riservare (0 = uno per ogni periferica compatibile nel device tree)");
+
+/*
+ *  Durata massima di un'acquisizione GPIO_CAPTURE_BURST, che campiona DIN con la
+ *  prelazione disabilitata sulla CPU che esegue la ioctl. Il valore è limitato a
+ *  GPIO_CAPTURE_BURST_MAX_US, così che lo scheduler non resti escluso per più di
+ *  qualche decina di microsecondi; acquisizioni più lunghe usano GPIO_CAPTURE_TIMER.
+ */
+#define GPIO_CAPTURE_BURST_MAX_US 50
+
+static int gpio_capture_burst_param_set(const char *val, const struct kernel_param *kp)
+{
+  unsigned int value;
+  int ret_status;
 
-/************************** Constant Definitions *****************************/
-#define GPIOS_TO_MANAGE   3           ///< Indica quante periferiche deve gestire il driver
-                                      ///<  (o equivalentemente quanti minor number
-                                      ///<  istanziare per un dato major number)
+  ret_status = kstrtouint(val, 0, &value);
+  if(ret_status)
+    return ret_status;
+  if(value > GPIO_CAPTURE_BURST_MAX_US)
+    return -EINVAL;
+  WRITE_ONCE(*(unsigned int *)kp->arg, value);
+  return 0;
+}
 
-#define DRIVER_NAME       "gpiodrv"   ///< Nome con il quale il driver si registra presso il kernel
+static const struct kernel_param_ops gpio_capture_burst_param_ops = {
+  .set = gpio_capture_burst_param_set,
+  .get = param_get_uint,
+};
 
-#define NO 0
-#define YES 1
+static unsigned int capture_burst_us = GPIO_CAPTURE_BURST_MAX_US;
+module_param_cb(capture_burst_us, &gpio_capture_burst_param_ops, &capture_burst_us, 0644);
+MODULE_PARM_DESC(capture_burst_us, "Durata massima in microsecondi di un'acquisizione in modalità burst (al più 50)");
 
-#define GPIO_DOUT_OFFSET  0
-#define GPIO_DIN_OFFSET   8
-#define GPIO_TRI_OFFSET   4
-#define GPIO_IER_OFFSET  12
-#define GPIO_ICL_OFFSET  16
-#define GPIO_ISR_OFFSET  20
-#define INT_ENABLE 0x0000000F
+/*
+ *  Registrazione degli accessi ai registri e degli ingressi nella ISR (formato in
+ *  gpio_trace.h), per riprodurre il traffico reale con il motore di src/trace.
+ *  Ogni dispositivo riceve un buffer di reg_trace_entries record, esportato dal file
+ *  reg_trace in debugfs; a buffer pieno i record successivi sono contati come persi.
+ */
+static unsigned int reg_trace_entries = 0;
+module_param(reg_trace_entries, uint, 0444);
+MODULE_PARM_DESC(reg_trace_entries, "Record della traccia degli accessi ai registri per dispositivo (0 = registrazione disabilitata)");
 
 /*
  *  La struttura dati idr è utilizzata nel kernel per gestire assegnazioni di identificativi
@@ -77,14 +173,15 @@
  *  Per approfondimenti si veda: https://lwn.net/Articles/103209/
  */
 static DEFINE_IDR(gpio_idr);        ///< Istanzia una struttura idr.
-static DEFINE_IDR(irq_idr);         ///< Istanzia una struttura idr.
 
 /*
- *  E' necessario serializzare l'accesso alla struttura dati idr
+ *  E' necessario serializzare le modifiche alla struttura dati idr
  *  per evitare collisioni, dal momento che il driver può avere più istanze
  *  diverse perchè può gestire più dispositivi contemporaneamente.
+ *  La ricerca (idr_find) avviene invece senza lock, all'interno di una sezione
+ *  critica RCU: la memoria di un dispositivo viene liberata con kfree_rcu.
  */
-static DEFINE_MUTEX(minor_lock);    ///< Crea un semaforo binario per l'accesso alla struttura dati gpio_idr.
+static DEFINE_MUTEX(minor_lock);    ///< Crea un semaforo binario per le modifiche alla struttura dati gpio_idr.
 
 // Dati globali a supporto del driver
 struct class *gpio_class;
@@ -92,32 +189,32 @@ struct cdev *device_cdev_p;
 int major;
 
 dev_t gpiodrv_dev_number;   ///< Struttura che conserva i device numbers del driver
-spinlock_t read_lock;       ///< Spinlock utilizzato per gestire l'accesso alla variabile CAN_READ
-wait_queue_head_t rdqueue;  ///< Wait queue sulla quale i processi si bloccano quando viene richiesta una lettura
-int can_read = NO;          ///< Variabile di sincronizzazione tra ISR e processo di lettura
+static unsigned int gpio_minors;    ///< Numero di minor number riservati (si veda max_devices)
+static LIST_HEAD(irq_lines);        ///< Linee di interruzione servite in modalità aggregata
+static DEFINE_MUTEX(irq_lines_lock);  ///< Serializza le modifiche alla lista irq_lines
+static struct dentry *gpio_debugfs_root;  ///< Directory del driver in debugfs (/sys/kernel/debug/gpiodrv)
 
-/**************************** Type Definitions ******************************/
-/**
- * @brief Struttura dati per la gestione del singolo dispositivo GPIO.
- *
- * @details Il driver crea una struttura di questo tipo per ogni dispositivo
- *    presente nel sistema.
- *
- */
-struct gpio_device{
-  unsigned long *base_addr; ///< Indirizzo (virtuale) base della periferica
-  unsigned int irq;         ///< Numero di interruzione (se la periferica genera interruzioni, altrimenti non è specificato)
-  struct resource res;      ///< Struttura dati popolata da informazioni estratte dal device-tree
-  dev_t gpiox_dev_number;   ///< Device numbers della periferica (ogni periferica ha un minor number diverso)
-  spinlock_t write_lock;    ///< Spinlock per garantire l'accesso in mutua esclusione all'operazione di scrittura
-};
 
 /************************** Function Prototypes *****************************/
 int gpio_open(struct inode *, struct file *);
 int gpio_release(struct inode *, struct file *);
-ssize_t gpio_read(struct file *, char __user *, size_t, loff_t *);
-ssize_t gpio_write(struct file *, const char __user *, size_t, loff_t *);
-irqreturn_t gpio_isr(int irq, struct pt_regs * regs);
+ssize_t gpio_read_iter(struct kiocb *, struct iov_iter *);
+ssize_t gpio_write_iter(struct kiocb *, struct iov_iter *);
+unsigned int gpio_poll(struct file *, poll_table *);
+int gpio_mmap(struct file *, struct vm_area_struct *);
+long gpio_ioctl(struct file *, unsigned int, unsigned long);
+irqreturn_t gpio_isr(int irq, void *dev_id);
+irqreturn_t gpio_isr_thread(int irq, void *dev_id);
+irqreturn_t gpio_line_isr(int irq, void *dev_id);
+irqreturn_t gpio_line_thread(int irq, void *dev_id);
+static enum hrtimer_restart gpio_poll_tick(struct hrtimer *timer);
+static enum hrtimer_restart gpio_pattern_tick(struct hrtimer *timer);
+static void gpio_pattern_stop(struct gpio_device *);
+static enum hrtimer_restart gpio_capture_tick(struct hrtimer *timer);
+static void gpio_capture_stop(struct gpio_device *);
+static void gpio_batch_op(struct gpio_device *, struct gpio_op *);
+static int gpio_irq_request(struct gpio_device *);
+static void gpio_irq_release(struct gpio_device *);
 
 /**
  * @brief Operazioni supportate dal driver.
@@ -128,399 +225,2601 @@ irqreturn_t gpio_isr(int irq, struct pt_regs * regs);
  */
 static struct file_operations gpio_fops = {
 		.owner    =   THIS_MODULE,     	///< Proprietario
-    .read     =   gpio_read,        ///< Metodo per la lettura
-    .write    =   gpio_write,       ///< Metodo per la lettura
+    .read_iter  = gpio_read_iter,   ///< Metodo per la lettura (read, readv, AIO, io_uring)
+    .write_iter = gpio_write_iter,  ///< Metodo per la scrittura (write, writev, AIO, io_uring)
+    .poll     =   gpio_poll,        ///< Metodo per l'attesa multipla (poll/select/epoll)
+    .mmap     =   gpio_mmap,        ///< Metodo per il mapping dei registri nello spazio del processo
+    .unlocked_ioctl = gpio_ioctl,   ///< Metodo per le operazioni di controllo
 		.open     =   gpio_open,        ///< Metodo per l'apertura del device file
 		.release  =   gpio_release      ///< Metodo per il rilascio del file aperto legato al device file
 };
 
 /**
- * @brief Funzione di probing.
+ * @brief Stampa le statistiche del dispositivo (file stats in debugfs).
  *
- * @details Chiamata dal kernel quando esiste un device la cui descrizione nel device-tree
- *    coincide con quella esportata dal modulo attraverso la macro module_platform_driver.
+ * @details Riporta minimo, media e massimo dell'intervallo tra eventi consecutivi e
+ *    della durata della ISR (dall'ultimo azzeramento, mentre i contatori irq_events ed
+ *    hardirq_ns restano cumulativi), e l'istogramma della latenza tra l'ingresso nella ISR ed il
+ *    risveglio di un lettore bloccato nella read. I valori sono letti senza fermare
+ *    il dispositivo e vanno intesi come indicativi.
+ */
+static int gpio_stats_show(struct seq_file *m, void *v)
+{
+  struct gpio_device *gpio_dev_ptr = m->private;
+  u64 hist[GPIO_WAKE_HIST_BUCKETS], wake_max, samples = 0;
+  u64 hardirq_events, hardirq_sum, hardirq_min, hardirq_max, intervals;
+  unsigned long flags;
+  unsigned int i;
+
+  spin_lock_irqsave(&gpio_dev_ptr->write_lock, flags);
+    memcpy(hist, gpio_dev_ptr->wake_hist, sizeof(hist));
+    wake_max = gpio_dev_ptr->wake_max_ns;
+  spin_unlock_irqrestore(&gpio_dev_ptr->write_lock, flags);
+
+  spin_lock_irqsave(&gpio_dev_ptr->irq_lock, flags);
+    hardirq_events = gpio_dev_ptr->hardirq_window_events;
+    hardirq_sum = gpio_dev_ptr->hardirq_window_ns;
+    hardirq_min = gpio_dev_ptr->hardirq_min_ns;
+    hardirq_max = gpio_dev_ptr->hardirq_max_ns;
+  spin_unlock_irqrestore(&gpio_dev_ptr->irq_lock, flags);
+
+  intervals = gpio_dev_ptr->intervals;
+
+  seq_printf(m, "interval_ns: count %llu min %llu mean %llu max %llu\n", intervals,
+             gpio_dev_ptr->interval_min_ns, intervals ? div64_u64(gpio_dev_ptr->interval_sum_ns, intervals) : 0,
+             gpio_dev_ptr->interval_max_ns);
+  seq_printf(m, "hardirq_ns: count %llu min %llu mean %llu max %llu\n", hardirq_events,
+             hardirq_min, hardirq_events ? div64_u64(hardirq_sum, hardirq_events) : 0, hardirq_max);
+
+  for(i = 0; i < GPIO_WAKE_HIST_BUCKETS; i++)
+    samples += hist[i];
+  seq_printf(m, "wake_latency_ns: count %llu max %llu\n", samples, wake_max);
+  for(i = 0; i < GPIO_WAKE_HIST_BUCKETS; i++)
+    if(hist[i])
+      seq_printf(m, "  [%12llu, %12llu) %llu\n", 1ULL << i, 2ULL << i, hist[i]);
+
+  return 0;
+}
+
+static int gpio_stats_open(struct inode *inode, struct file *file)
+{
+  return single_open(file, gpio_stats_show, inode->i_private);
+}
+
+/**
+ * @brief Una scrittura qualsiasi sul file stats azzera le statistiche.
+ */
+static ssize_t gpio_stats_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+  struct gpio_device *gpio_dev_ptr = ((struct seq_file *)file->private_data)->private;
+  unsigned long flags;
+
+  spin_lock_irqsave(&gpio_dev_ptr->write_lock, flags);
+    memset(gpio_dev_ptr->wake_hist, 0, sizeof(gpio_dev_ptr->wake_hist));
+    gpio_dev_ptr->wake_max_ns = 0;
+  spin_unlock_irqrestore(&gpio_dev_ptr->write_lock, flags);
+
+  spin_lock_irqsave(&gpio_dev_ptr->irq_lock, flags);
+    gpio_dev_ptr->hardirq_window_events = 0;
+    gpio_dev_ptr->hardirq_window_ns = 0;
+    gpio_dev_ptr->hardirq_min_ns = 0;
+    gpio_dev_ptr->hardirq_max_ns = 0;
+  spin_unlock_irqrestore(&gpio_dev_ptr->irq_lock, flags);
+
+  // Gli intervalli sono aggiornati dal thread di interruzione, sotto subs_lock
+  mutex_lock(&gpio_dev_ptr->subs_lock);
+    gpio_dev_ptr->intervals = 0;
+    gpio_dev_ptr->interval_sum_ns = 0;
+    gpio_dev_ptr->interval_min_ns = 0;
+    gpio_dev_ptr->interval_max_ns = 0;
+  mutex_unlock(&gpio_dev_ptr->subs_lock);
+
+  return count;
+}
+
+static const struct file_operations gpio_stats_fops = {
+  .owner    = THIS_MODULE,
+  .open     = gpio_stats_open,
+  .read     = seq_read,
+  .write    = gpio_stats_write,
+  .llseek   = seq_lseek,
+  .release  = single_release,
+};
+
+/**
+ * @brief Scrive un record nella traccia del dispositivo.
  *
- * @param op struttura che contiene informazioni utili all'inizializzazione del device
- *    come ad esempio le informazioni provenineti dal device-tree.
+ * @details L'indice è riservato con un'operazione atomica: il record può essere scritto
+ *    dalla ISR, dagli hrtimer e dal contesto di processo senza altri lock.
+ */
+static void gpio_reg_trace_put(struct gpio_device *gpio_dev_ptr, u64 time, u8 type, unsigned int offset, u32 value)
+{
+  gpio_trace_record *record;
+  unsigned int index;
+
+  // Il controllo preventivo evita che l'indice, a buffer pieno, continui a crescere
+  if(atomic_read(&gpio_dev_ptr->reg_trace_next) >= gpio_dev_ptr->reg_trace_entries){
+    atomic_inc(&gpio_dev_ptr->reg_trace_dropped);
+    return;
+  }
+  index = atomic_inc_return(&gpio_dev_ptr->reg_trace_next) - 1;
+  if(index >= gpio_dev_ptr->reg_trace_entries){
+    atomic_inc(&gpio_dev_ptr->reg_trace_dropped);
+    return;
+  }
+
+  record = &gpio_dev_ptr->reg_trace[index];
+  record->time = (u32)time;
+  record->type = type;
+  record->device = 0;
+  record->offset = offset;
+  record->reserved = 0;
+  record->value = value;
+}
+
+/**
+ * @brief Registra un accesso ai registri o l'ingresso nella ISR (si veda gpio_trace.h).
  *
- * @return
- *    - 0 se il procedimento di probing è andato a buon fine.
- *    - errno se il procedimento di probing non è andato a buon fine.
+ * @param gpio_dev_ptr è il puntatore al dispositivo.
+ * @param type è il tipo di record (GPIO_TRACE_READ, GPIO_TRACE_WRITE o GPIO_TRACE_IRQ).
+ * @param offset è lo spiazzamento del registro.
+ * @param value è il valore letto o scritto.
+ * @param now è l'istante dell'evento (ktime_get_ns).
+ *
+ * @details Chiamata da gpio_reg_read e gpio_reg_write solo se la registrazione è attiva.
+ *    reg_trace_last è aggiornato senza lock: una corsa tra ISR e contesto di processo può
+ *    al più produrre un record GPIO_TRACE_TIME superfluo.
  */
-static int gpio_probe(struct platform_device *op)
+void gpio_reg_trace(struct gpio_device *gpio_dev_ptr, u8 type, unsigned int offset, u32 value, u64 now)
 {
-  int ret_status;
-  unsigned int size;
-  struct gpio_device *gpio_device_ptr;
+  u64 start = READ_ONCE(gpio_dev_ptr->reg_trace_start);
+  u64 last = READ_ONCE(gpio_dev_ptr->reg_trace_last);
+  u64 time = now > start ? now - start : 0;
+
+  if(time > last && time - last >= GPIO_TRACE_GAP_NS)
+    gpio_reg_trace_put(gpio_dev_ptr, time, GPIO_TRACE_TIME, 0, (u32)(time >> 32));
+  WRITE_ONCE(gpio_dev_ptr->reg_trace_last, time);
+  gpio_reg_trace_put(gpio_dev_ptr, time, type, offset, value);
+}
 
-  printk(KERN_INFO "[GPIO driver] Probing device...\n");
+/**
+ * @brief Stato di un file reg_trace aperto.
+ */
+struct gpio_reg_trace_file{
+  struct gpio_device *dev;
+  gpio_trace_header header; ///< Intestazione fissata all'apertura
+};
 
-  gpio_device_ptr = kmalloc(sizeof(struct gpio_device), GFP_KERNEL);
-  if(!gpio_device_ptr){
-    printk(KERN_WARNING "Allocazione della memoria non riuscita!");
-    return -1;
-  }
+/**
+ * @brief Apre il file reg_trace fissando l'intestazione della traccia.
+ *
+ * @details Il numero di record è quello presente all'apertura, così che l'intestazione
+ *    resti coerente con i dati letti anche se la registrazione prosegue.
+ */
+static int gpio_reg_trace_open(struct inode *inode, struct file *file)
+{
+  struct gpio_device *gpio_dev_ptr = inode->i_private;
+  struct gpio_reg_trace_file *trace_file;
 
-  platform_set_drvdata(op, (void*)gpio_device_ptr);
-  spin_lock_init(&gpio_device_ptr->write_lock);
+  trace_file = kzalloc(sizeof(struct gpio_reg_trace_file), GFP_KERNEL);
+  if(!trace_file)
+    return -ENOMEM;
 
-  mutex_lock(&minor_lock);
-    // Richiede l'allocazione nell'idr del puntatore al dispositivo gpio_device_ptr
-    // La funzione restituisce l'identificativo dell'oggetto nella struttura dati
-    // L'identificativo è un valore compreso tra 0 e GPIOS_TO_MANAGE
-    // Questo identificativo è utilizzato come minor number da assegnare alla periferica
-  	ret_status = idr_alloc(&gpio_idr, gpio_device_ptr, 0, GPIOS_TO_MANAGE, GFP_KERNEL);
-	mutex_unlock(&minor_lock);
+  trace_file->dev = gpio_dev_ptr;
+  trace_file->header.magic = GPIO_TRACE_MAGIC;
+  trace_file->header.version = GPIO_TRACE_VERSION;
+  trace_file->header.record_size = sizeof(gpio_trace_record);
+  trace_file->header.start_ns = READ_ONCE(gpio_dev_ptr->reg_trace_start);
+  trace_file->header.records = min_t(u32, atomic_read(&gpio_dev_ptr->reg_trace_next), gpio_dev_ptr->reg_trace_entries);
+  trace_file->header.dropped = atomic_read(&gpio_dev_ptr->reg_trace_dropped);
+  file->private_data = trace_file;
+  return nonseekable_open(inode, file);
+}
 
-  if (ret_status == -ENOSPC) {
-    printk(KERN_WARNING "Richiesti troppi dispositivi di quanti se ne sono allocati!");
-    kfree(gpio_device_ptr);
-    return -EINVAL;
+/**
+ * @brief Legge la traccia: intestazione gpio_trace_header seguita dai record.
+ *
+ * @note Per una traccia senza record parziali va letta a traffico fermo: un record
+ *    in scrittura durante la lettura può risultare incompleto.
+ */
+static ssize_t gpio_reg_trace_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
+{
+  struct gpio_reg_trace_file *trace_file = file->private_data;
+  size_t records_size = (size_t)trace_file->header.records * sizeof(gpio_trace_record);
+  loff_t pos;
+  ssize_t ret;
+
+  if(*ppos < sizeof(gpio_trace_header))
+    return simple_read_from_buffer(buf, count, ppos, &trace_file->header, sizeof(gpio_trace_header));
+
+  pos = *ppos - sizeof(gpio_trace_header);
+  ret = simple_read_from_buffer(buf, count, &pos, trace_file->dev->reg_trace, records_size);
+  *ppos = pos + sizeof(gpio_trace_header);
+  return ret;
+}
+
+/**
+ * @brief Una scrittura qualsiasi sul file reg_trace fa ripartire la registrazione.
+ *
+ * @details I record scritti in concorrenza con l'azzeramento possono finire nella
+ *    nuova traccia con il tempo della precedente.
+ */
+static ssize_t gpio_reg_trace_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+  struct gpio_device *gpio_dev_ptr = ((struct gpio_reg_trace_file *)file->private_data)->dev;
+
+  WRITE_ONCE(gpio_dev_ptr->reg_trace_start, ktime_get_ns());
+  WRITE_ONCE(gpio_dev_ptr->reg_trace_last, 0);
+  atomic_set(&gpio_dev_ptr->reg_trace_dropped, 0);
+  atomic_set(&gpio_dev_ptr->reg_trace_next, 0);
+  return count;
+}
+
+static int gpio_reg_trace_release(struct inode *inode, struct file *file)
+{
+  kfree(file->private_data);
+  return 0;
+}
+
+static const struct file_operations gpio_reg_trace_fops = {
+  .owner    = THIS_MODULE,
+  .open     = gpio_reg_trace_open,
+  .read     = gpio_reg_trace_read,
+  .write    = gpio_reg_trace_write,
+  .llseek   = no_llseek,
+  .release  = gpio_reg_trace_release,
+};
+
+/**
+ * @brief Crea in debugfs la directory con i contatori del dispositivo.
+ *
+ * @param gpio_dev_ptr è il puntatore al dispositivo.
+ * @param minor è il minor number del dispositivo, usato per dare il nome alla directory.
+ *
+ * @details I contatori sono aggiornati sotto il lock che serializza il percorso al quale
+ *    si riferiscono e sono esportati in sola lettura in /sys/kernel/debug/gpiodrv/gpioN.
+ */
+static void gpio_debugfs_init(struct gpio_device *gpio_dev_ptr, int minor)
+{
+  char name[16];
+
+  snprintf(name, sizeof(name), "gpio%d", minor);
+  gpio_dev_ptr->debugfs = debugfs_create_dir(name, gpio_debugfs_root);
+  if(IS_ERR_OR_NULL(gpio_dev_ptr->debugfs))
+    return;
+
+  debugfs_create_u64("irq_events", 0444, gpio_dev_ptr->debugfs, &gpio_dev_ptr->irq_events);
+  debugfs_create_u64("poll_events", 0444, gpio_dev_ptr->debugfs, &gpio_dev_ptr->poll_events);
+  debugfs_create_u64("hardirq_ns", 0444, gpio_dev_ptr->debugfs, &gpio_dev_ptr->hardirq_ns);
+  debugfs_create_u64("hardirq_max_ns", 0444, gpio_dev_ptr->debugfs, &gpio_dev_ptr->hardirq_max_ns);
+  debugfs_create_u64("thread_runs", 0444, gpio_dev_ptr->debugfs, &gpio_dev_ptr->thread_runs);
+  debugfs_create_u64("thread_batch_max", 0444, gpio_dev_ptr->debugfs, &gpio_dev_ptr->thread_batch_max);
+  debugfs_create_u64("ring_events", 0444, gpio_dev_ptr->debugfs, &gpio_dev_ptr->ring_events);
+  debugfs_create_u64("overflows", 0444, gpio_dev_ptr->debugfs, &gpio_dev_ptr->overflows);
+  debugfs_create_u64("reads", 0444, gpio_dev_ptr->debugfs, &gpio_dev_ptr->reads);
+  debugfs_create_u64("read_events", 0444, gpio_dev_ptr->debugfs, &gpio_dev_ptr->read_events);
+  debugfs_create_u64("writes", 0444, gpio_dev_ptr->debugfs, &gpio_dev_ptr->writes);
+  debugfs_create_u64("write_words", 0444, gpio_dev_ptr->debugfs, &gpio_dev_ptr->write_words);
+  debugfs_create_file("stats", 0644, gpio_dev_ptr->debugfs, gpio_dev_ptr, &gpio_stats_fops);
+  debugfs_create_u64("pattern_steps", 0444, gpio_dev_ptr->debugfs, &gpio_dev_ptr->pattern_steps);
+  debugfs_create_u64("pattern_underruns", 0444, gpio_dev_ptr->debugfs, &gpio_dev_ptr->pattern_underruns);
+  debugfs_create_u64("pattern_jitter_max_ns", 0444, gpio_dev_ptr->debugfs, &gpio_dev_ptr->pattern_jitter_max_ns);
+  if(gpio_dev_ptr->reg_trace)
+    debugfs_create_file("reg_trace", 0600, gpio_dev_ptr->debugfs, gpio_dev_ptr, &gpio_reg_trace_fops);
+}
+
+/**
+ * @brief Scrive nel registro IER la maschera delle interruzioni abilitate.
+ *
+ * @param gpio_dev_ptr è il puntatore al dispositivo.
+ *
+ * @details Le interruzioni abilitate sono quelle richieste attraverso il device file
+ *    (copia ier) più quelle dei pin abilitati attraverso l'irq_chip. In polling la
+ *    periferica resta mascherata e la maschera è applicata al ritorno alle interruzioni.
+ *
+ * @note Deve essere chiamata con irq_lock acquisito.
+ */
+static void gpio_ier_apply(struct gpio_device *gpio_dev_ptr)
+{
+  if(gpio_dev_ptr->polling == NO)
+    gpio_reg_write(gpio_dev_ptr, GPIO_IER_OFFSET, gpio_dev_ptr->ier | gpio_dev_ptr->irq_unmasked);
+}
+
+/**
+ * @brief Disabilita tutte le interruzioni della periferica.
+ *
+ * @param gpio_dev_ptr è il puntatore al dispositivo.
+ *
+ * @details Azzera anche le copie di IER, in modo che la callback di polling non le
+ *    riabiliti al ritorno alle interruzioni.
+ */
+static void gpio_irq_disable(struct gpio_device *gpio_dev_ptr)
+{
+  unsigned long flags;
+
+  spin_lock_irqsave(&gpio_dev_ptr->irq_lock, flags);
+    gpio_dev_ptr->ier = INT_DISABLE;
+    gpio_dev_ptr->irq_unmasked = 0;
+    gpio_reg_write(gpio_dev_ptr, GPIO_IER_OFFSET, INT_DISABLE);
+  spin_unlock_irqrestore(&gpio_dev_ptr->irq_lock, flags);
+}
+
+/****************************** gpiolib ***************************************/
+#ifdef CONFIG_GPIOLIB
+/*
+ *  Oltre al device file il driver registra la periferica presso gpiolib: i pin diventano
+ *  così accessibili con gli strumenti standard (libgpiod, uAPI GPIO v2) e le interruzioni
+ *  dei singoli pin sono consegnate, con timestamp e bufferizzazione, dal percorso upstream.
+ *  Le interruzioni dei pin sono annidate in quella della periferica: la ISR azzera ISR
+ *  come di consueto ed il thread di interruzione le smista con handle_nested_irq.
+ */
+
+/**
+ * @brief Modifica i bit indicati da mask di un registro della periferica.
+ */
+static void gpio_chip_update(struct gpio_device *gpio_dev_ptr, int offset, u32 mask, u32 value)
+{
+  unsigned long flags;
+  u32 reg;
+
+  spin_lock_irqsave(&gpio_dev_ptr->write_lock, flags);
+    reg = gpio_reg_read(gpio_dev_ptr, offset);
+    gpio_reg_write(gpio_dev_ptr, offset, (reg & ~mask) | (value & mask));
+  spin_unlock_irqrestore(&gpio_dev_ptr->write_lock, flags);
+}
+
+/**
+ * @brief Restituisce la direzione di un pin (0 = uscita, 1 = ingresso).
+ */
+static int gpio_chip_get_direction(struct gpio_chip *chip, unsigned int offset)
+{
+  struct gpio_device *gpio_dev_ptr = gpiochip_get_data(chip);
+
+  // Un bit a 1 nel registro TRI indica un pin in scrittura
+  return (gpio_reg_read(gpio_dev_ptr, GPIO_TRI_OFFSET) & BIT(offset)) ? 0 : 1;
+}
+
+static int gpio_chip_direction_input(struct gpio_chip *chip, unsigned int offset)
+{
+  gpio_chip_update(gpiochip_get_data(chip), GPIO_TRI_OFFSET, BIT(offset), 0);
+  return 0;
+}
+
+static int gpio_chip_direction_output(struct gpio_chip *chip, unsigned int offset, int value)
+{
+  struct gpio_device *gpio_dev_ptr = gpiochip_get_data(chip);
+
+  // Il valore è impostato prima di abilitare l'uscita per evitare glitch sul pin
+  gpio_chip_update(gpio_dev_ptr, GPIO_DOUT_OFFSET, BIT(offset), value ? BIT(offset) : 0);
+  gpio_chip_update(gpio_dev_ptr, GPIO_TRI_OFFSET, BIT(offset), BIT(offset));
+  return 0;
+}
+
+/**
+ * @brief Restituisce lo stato dei pin indicati da mask: DOUT per le uscite, DIN per gli ingressi.
+ */
+static int gpio_chip_get_multiple(struct gpio_chip *chip, unsigned long *mask, unsigned long *bits)
+{
+  struct gpio_device *gpio_dev_ptr = gpiochip_get_data(chip);
+  u32 tri, value;
+
+  tri = gpio_reg_read(gpio_dev_ptr, GPIO_TRI_OFFSET);
+  value = (gpio_reg_read(gpio_dev_ptr, GPIO_DOUT_OFFSET) & tri) |
+          (gpio_reg_read(gpio_dev_ptr, GPIO_DIN_OFFSET) & ~tri);
+
+  *bits = (*bits & ~*mask) | (value & *mask);
+  return 0;
+}
+
+static int gpio_chip_get(struct gpio_chip *chip, unsigned int offset)
+{
+  unsigned long mask = BIT(offset), bits = 0;
+
+  gpio_chip_get_multiple(chip, &mask, &bits);
+  return !!bits;
+}
+
+/**
+ * @brief Scrive in DOUT i pin indicati da mask con un'unica scrittura del registro.
+ */
+static void gpio_chip_set_multiple(struct gpio_chip *chip, unsigned long *mask, unsigned long *bits)
+{
+  gpio_chip_update(gpiochip_get_data(chip), GPIO_DOUT_OFFSET, *mask, *bits);
+}
+
+static void gpio_chip_set(struct gpio_chip *chip, unsigned int offset, int value)
+{
+  gpio_chip_update(gpiochip_get_data(chip), GPIO_DOUT_OFFSET, BIT(offset), value ? BIT(offset) : 0);
+}
+
+static int gpio_chip_to_irq(struct gpio_chip *chip, unsigned int offset)
+{
+  struct gpio_device *gpio_dev_ptr = gpiochip_get_data(chip);
+
+  if(!gpio_dev_ptr->irq_domain)
+    return -ENXIO;
+  return irq_create_mapping(gpio_dev_ptr->irq_domain, offset);
+}
+
+/**
+ * @brief Maschera l'interruzione di un pin (bit corrispondente di IER a 0).
+ */
+static void gpio_irq_mask(struct irq_data *d)
+{
+  struct gpio_device *gpio_dev_ptr = irq_data_get_irq_chip_data(d);
+  unsigned long flags;
+
+  spin_lock_irqsave(&gpio_dev_ptr->irq_lock, flags);
+    gpio_dev_ptr->irq_unmasked &= ~BIT(irqd_to_hwirq(d));
+    gpio_ier_apply(gpio_dev_ptr);
+  spin_unlock_irqrestore(&gpio_dev_ptr->irq_lock, flags);
+}
+
+/**
+ * @brief Abilita l'interruzione di un pin (bit corrispondente di IER a 1).
+ */
+static void gpio_irq_unmask(struct irq_data *d)
+{
+  struct gpio_device *gpio_dev_ptr = irq_data_get_irq_chip_data(d);
+  unsigned long flags;
+
+  spin_lock_irqsave(&gpio_dev_ptr->irq_lock, flags);
+    gpio_dev_ptr->irq_unmasked |= BIT(irqd_to_hwirq(d));
+    gpio_ier_apply(gpio_dev_ptr);
+  spin_unlock_irqrestore(&gpio_dev_ptr->irq_lock, flags);
+}
+
+/**
+ * @brief La periferica rileva soltanto i fronti di salita (si veda livelli2impulsi.vhd).
+ */
+static int gpio_irq_set_type(struct irq_data *d, unsigned int type)
+{
+  return (type == IRQ_TYPE_EDGE_RISING ? 0 : -EINVAL);
+}
+
+/**
+ * @brief Blocca il pin come ingresso di interruzione presso gpiolib finché l'interruzione
+ *    è richiesta, così che non possa essere configurato in uscita.
+ */
+static int gpio_irq_request_resources(struct irq_data *d)
+{
+  struct gpio_device *gpio_dev_ptr = irq_data_get_irq_chip_data(d);
+
+  return gpiochip_reqres_irq(&gpio_dev_ptr->chip, irqd_to_hwirq(d));
+}
+
+static void gpio_irq_release_resources(struct irq_data *d)
+{
+  struct gpio_device *gpio_dev_ptr = irq_data_get_irq_chip_data(d);
+
+  gpiochip_relres_irq(&gpio_dev_ptr->chip, irqd_to_hwirq(d));
+}
+
+static struct irq_chip gpio_irq_chip = {
+  .name                  = DRIVER_NAME,
+  .irq_mask              = gpio_irq_mask,
+  .irq_unmask            = gpio_irq_unmask,
+  .irq_set_type          = gpio_irq_set_type,
+  .irq_request_resources = gpio_irq_request_resources,
+  .irq_release_resources = gpio_irq_release_resources,
+};
+
+static int gpio_irq_domain_map(struct irq_domain *d, unsigned int virq, irq_hw_number_t hw)
+{
+  irq_set_chip_data(virq, d->host_data);
+  irq_set_chip_and_handler(virq, &gpio_irq_chip, handle_simple_irq);
+  irq_set_nested_thread(virq, 1);
+  irq_set_noprobe(virq);
+  return 0;
+}
+
+static const struct irq_domain_ops gpio_irq_domain_ops = {
+  .map    = gpio_irq_domain_map,
+  .xlate  = irq_domain_xlate_twocell,
+};
+
+/**
+ * @brief Smista ai pin le interruzioni pendenti di un campionamento.
+ *
+ * @note Chiamata dal thread di interruzione, come richiesto da handle_nested_irq.
+ */
+static void gpio_irq_dispatch(struct gpio_device *gpio_dev_ptr, u32 pending)
+{
+  unsigned long bits = pending & READ_ONCE(gpio_dev_ptr->irq_unmasked);
+  unsigned int pin, virq;
+
+  if(!gpio_dev_ptr->irq_domain)
+    return;
+
+  // handle_nested_irq non verifica il numero di interruzione: i pin senza mappatura sono saltati
+  for_each_set_bit(pin, &bits, GPIO_NGPIO){
+    virq = irq_find_mapping(gpio_dev_ptr->irq_domain, pin);
+    if(virq)
+      handle_nested_irq(virq);
   }
+}
 
-  // Crea una struttura dev_t con il major number del driver ed il primo minor number disponibile
-  gpio_device_ptr->gpiox_dev_number = MKDEV(major, ret_status);
+/**
+ * @brief Registra il dispositivo presso gpiolib.
+ *
+ * @param gpio_dev_ptr è il puntatore al dispositivo.
+ * @param parent è il dispositivo padre del chip: il platform device per le periferiche
+ *    del device tree, il device file per quelle simulate.
+ *
+ * @return
+ *    - 0 se la registrazione è andata a buon fine.
+ *    - errno se la registrazione non è andata a buon fine.
+ *
+ * @details Il dominio delle interruzioni dei pin è creato solo se la periferica
+ *    può generare interruzioni: se è collegata ad una linea oppure se è simulata
+ *    (le interruzioni arrivano dall'iniettore).
+ */
+static int gpio_chip_init(struct gpio_device *gpio_dev_ptr, struct device *parent)
+{
+  struct gpio_chip *chip = &gpio_dev_ptr->chip;
+  int ret_status;
 
-  /********************* Creazione del device file ***********************************/
-  if (!device_create(gpio_class, NULL, gpio_device_ptr->gpiox_dev_number, NULL, "gpio%d", ret_status)){
-    printk(KERN_INFO "Cannot create device\n");
-    mutex_lock(&minor_lock);
-      idr_remove(&gpio_idr, ret_status);
-    mutex_unlock(&minor_lock);
-    kfree(gpio_device_ptr);
-    return -EFAULT;
+  if(gpio_dev_ptr->irq != 0 || gpio_dev_ptr->mock){
+    gpio_dev_ptr->irq_domain = irq_domain_add_linear(NULL, GPIO_NGPIO, &gpio_irq_domain_ops, gpio_dev_ptr);
+    if(!gpio_dev_ptr->irq_domain)
+      return -ENOMEM;
   }
 
-  printk(KERN_INFO "[GPIO driver] Creazione device file avvenuta correttamente\n");
+  chip->label = dev_name(parent);
+  chip->parent = parent;
+  chip->owner = THIS_MODULE;
+  chip->base = -1;
+  chip->ngpio = GPIO_NGPIO;
+  chip->can_sleep = false;
+  chip->get_direction = gpio_chip_get_direction;
+  chip->direction_input = gpio_chip_direction_input;
+  chip->direction_output = gpio_chip_direction_output;
+  chip->get = gpio_chip_get;
+  chip->get_multiple = gpio_chip_get_multiple;
+  chip->set = gpio_chip_set;
+  chip->set_multiple = gpio_chip_set_multiple;
+  chip->to_irq = gpio_chip_to_irq;
+
+  ret_status = gpiochip_add_data(chip, gpio_dev_ptr);
+  if(ret_status){
+    if(gpio_dev_ptr->irq_domain)
+      irq_domain_remove(gpio_dev_ptr->irq_domain);
+    gpio_dev_ptr->irq_domain = NULL;
+    return ret_status;
+  }
 
-  /******************** Estrazione informazioni dal device-tree ***********************/
-  // Popola la struct res del contenuto del tag "reg" del device-tree
-  // Esempio: reg = <0x43c00000 0x10000>
-  // of_address_to_resource pertanto effettuerà le seguenti azioni:
-  // res.start = 0x43c00000 e res.end = 0x43c01000
-  if (of_address_to_resource(op->dev.of_node, 0, &gpio_device_ptr->res)){
-    printk(KERN_INFO "Cannot get device resource\n");
-    device_destroy(gpio_class, gpio_device_ptr->gpiox_dev_number);
+  gpio_dev_ptr->chip_registered = YES;
+  return 0;
+}
+
+/**
+ * @brief Annulla la registrazione presso gpiolib.
+ *
+ * @note Va chiamata dopo free_irq, quando il thread di interruzione non può più
+ *    smistare interruzioni ai pin, e prima di rimuovere il dispositivo padre del chip.
+ */
+static void gpio_chip_remove(struct gpio_device *gpio_dev_ptr)
+{
+  unsigned int pin;
+
+  if(gpio_dev_ptr->chip_registered == NO)
+    return;
+
+  gpiochip_remove(&gpio_dev_ptr->chip);
+  if(gpio_dev_ptr->irq_domain){
+    for(pin = 0; pin < GPIO_NGPIO; pin++)
+      irq_dispose_mapping(irq_find_mapping(gpio_dev_ptr->irq_domain, pin));
+    irq_domain_remove(gpio_dev_ptr->irq_domain);
+  }
+}
+#else
+static inline void gpio_irq_dispatch(struct gpio_device *gpio_dev_ptr, u32 pending) {}
+static inline int gpio_chip_init(struct gpio_device *gpio_dev_ptr, struct device *parent) { return 0; }
+static inline void gpio_chip_remove(struct gpio_device *gpio_dev_ptr) {}
+#endif
+
+/**
+ * @brief Chiamata al rilascio dell'ultimo riferimento ad un dispositivo.
+ *
+ * @param ref è il contatore dei riferimenti contenuto nel dispositivo.
+ *
+ * @details Rilascia la memoria I/O ed il ring. La struttura è liberata con kfree_rcu
+ *    perchè una gpio_open concorrente potrebbe averla appena trovata nell'idr.
+ */
+static void gpio_device_release(struct kref *ref)
+{
+  struct gpio_device *gpio_dev_ptr = container_of(ref, struct gpio_device, ref);
+
+  if(gpio_dev_ptr->base_addr)
+    iounmap(gpio_dev_ptr->base_addr);
+  if(gpio_dev_ptr->mem_region == YES)
+    release_mem_region(gpio_dev_ptr->res.start, resource_size(&gpio_dev_ptr->res));
+  vfree(gpio_dev_ptr->ring);
+  kfree(gpio_dev_ptr->pattern);
+  vfree(gpio_dev_ptr->capture_buf);
+  vfree(gpio_dev_ptr->reg_trace);
+  kfree(gpio_dev_ptr->mock);
+  kfree_rcu(gpio_dev_ptr, rcu);
+}
+
+/**
+ * @brief Rilascia un riferimento al dispositivo.
+ */
+void gpio_device_put(struct gpio_device *gpio_dev_ptr)
+{
+  kref_put(&gpio_dev_ptr->ref, gpio_device_release);
+}
+
+/**
+ * @brief Alloca ed inizializza la struttura dati di un dispositivo.
+ *
+ * @return il puntatore al dispositivo, con un riferimento, oppure NULL.
+ *
+ * @details Prepara ring degli eventi, lock, code e timer; registri ed interruzione
+ *    vanno impostati dal chiamante prima di gpio_device_register.
+ */
+struct gpio_device *gpio_device_alloc(void)
+{
+  struct gpio_device *gpio_device_ptr;
+
+  gpio_device_ptr = kzalloc(sizeof(struct gpio_device), GFP_KERNEL);
+  if(!gpio_device_ptr){
+    printk(KERN_WARNING "Allocazione della memoria non riuscita!");
+    return NULL;
+  }
+
+  // Il ring degli eventi è allocato con vmalloc_user perchè deve poter essere mappato
+  // nello spazio dei processi (la memoria restituita è già azzerata)
+  gpio_device_ptr->ring = vmalloc_user(GPIO_RING_BYTES);
+  if(!gpio_device_ptr->ring){
+    printk(KERN_WARNING "Allocazione del ring degli eventi non riuscita!");
+    kfree(gpio_device_ptr);
+    return NULL;
+  }
+  gpio_device_ptr->ring->entries = GPIO_RING_ENTRIES;
+  gpio_device_ptr->ring->data_offset = PAGE_SIZE;
+  gpio_device_ptr->ring_data = (struct gpio_event *)((char *)gpio_device_ptr->ring + PAGE_SIZE);
+  atomic_set(&gpio_device_ptr->ring_users, 0);
+
+  // Da questo punto in avanti la memoria del dispositivo è rilasciata da gpio_device_put
+  kref_init(&gpio_device_ptr->ref);
+  spin_lock_init(&gpio_device_ptr->write_lock);
+  spin_lock_init(&gpio_device_ptr->irq_lock);
+  INIT_KFIFO(gpio_device_ptr->snapshots);
+  INIT_LIST_HEAD(&gpio_device_ptr->subscribers);
+  mutex_init(&gpio_device_ptr->subs_lock);
+
+  // Inizializza il timer utilizzato nella modalità polling
+  hrtimer_init(&gpio_device_ptr->poll_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+  gpio_device_ptr->poll_timer.function = gpio_poll_tick;
+  gpio_device_ptr->polling = NO;
+
+  // Inizializza il timer che riproduce le sequenze su DOUT: le scadenze sono assolute,
+  // ciascuna calcolata dalla precedente
+  hrtimer_init(&gpio_device_ptr->pattern_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+  gpio_device_ptr->pattern_timer.function = gpio_pattern_tick;
+  mutex_init(&gpio_device_ptr->pattern_mutex);
+  spin_lock_init(&gpio_device_ptr->pattern_lock);
+
+  // Inizializza il timer di campionamento delle acquisizioni
+  hrtimer_init(&gpio_device_ptr->capture_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+  gpio_device_ptr->capture_timer.function = gpio_capture_tick;
+  mutex_init(&gpio_device_ptr->capture_mutex);
+  spin_lock_init(&gpio_device_ptr->capture_lock);
+  init_waitqueue_head(&gpio_device_ptr->capture_wait);
+
+  // La registrazione parte con il dispositivo; senza memoria il driver funziona comunque
+  if(reg_trace_entries){
+    gpio_device_ptr->reg_trace = vmalloc(array_size(reg_trace_entries, sizeof(gpio_trace_record)));
+    if(gpio_device_ptr->reg_trace){
+      gpio_device_ptr->reg_trace_entries = reg_trace_entries;
+      gpio_device_ptr->reg_trace_start = ktime_get_ns();
+    }else
+      printk(KERN_WARNING "[GPIO driver] Allocazione della traccia dei registri non riuscita\n");
+  }
+
+  return gpio_device_ptr;
+}
+
+/**
+ * @brief Rende disponibile un dispositivo: minor number, interruzioni, device file e
+ *    registrazione presso gpiolib.
+ *
+ * @param gpio_device_ptr è il dispositivo, con registri ed interruzione già impostati.
+ * @param parent è il dispositivo dal quale la periferica è stata trovata (il platform
+ *    device), oppure NULL per le periferiche simulate. Il chip gpiolib è figlio di
+ *    parent o, in sua assenza, del device file.
+ *
+ * @return
+ *    - 0 se la registrazione è andata a buon fine.
+ *    - errno altrimenti; il riferimento del chiamante resta valido e va rilasciato
+ *      con gpio_device_put.
+ */
+int gpio_device_register(struct gpio_device *gpio_device_ptr, struct device *parent)
+{
+  struct device *class_dev;
+  int ret_status, minor;
+
+  mutex_lock(&minor_lock);
+    // Richiede l'allocazione nell'idr del puntatore al dispositivo gpio_device_ptr
+    // La funzione restituisce l'identificativo dell'oggetto nella struttura dati
+    // L'identificativo è un valore compreso tra 0 e gpio_minors
+    // Questo identificativo è utilizzato come minor number da assegnare alla periferica
+    minor = idr_alloc(&gpio_idr, gpio_device_ptr, 0, gpio_minors, GFP_KERNEL);
+  mutex_unlock(&minor_lock);
+
+  if (minor < 0) {
+    printk(KERN_WARNING "[GPIO driver] Minor number esauriti (%u riservati, si veda il parametro max_devices)\n", gpio_minors);
+    return minor;
+  }
+
+  // Crea una struttura dev_t con il major number del driver ed il primo minor number disponibile
+  gpio_device_ptr->gpiox_dev_number = MKDEV(major, minor);
+
+  /*************** Richiesta e registrazione di un interrupt handler *****************/
+  // La registrazione avviene solo se il dispositivo supporta le interruzioni
+  if(gpio_device_ptr->irq != 0){
+    printk(KERN_INFO "[GPIO driver] Gestione dell'interrupt line: %d\n", gpio_device_ptr->irq);
+
+    // Registrazione di un ISR per l'irq numero gpio_device_ptr->irq
+    ret_status = gpio_irq_request(gpio_device_ptr);
+    if(ret_status){
+      printk(KERN_WARNING "Cannot get interrupt line %d\n", gpio_device_ptr->irq);
+      mutex_lock(&minor_lock);
+        idr_remove(&gpio_idr, minor);
+      mutex_unlock(&minor_lock);
+      return ret_status;
+    }
+
+    // Abilita le interruzioni nella periferica
+    gpio_device_ptr->window_start = ktime_get();
+    gpio_device_ptr->ier = INT_ENABLE;
+    gpio_ier_apply(gpio_device_ptr);
+  }
+
+  /********************* Creazione del device file ***********************************/
+  // Il device file è creato per ultimo, quando la periferica è pronta per essere utilizzata
+  class_dev = device_create(gpio_class, parent, gpio_device_ptr->gpiox_dev_number, NULL, "gpio%d", minor);
+  if (IS_ERR(class_dev)){
+    printk(KERN_INFO "Cannot create device\n");
+    if(gpio_device_ptr->irq != 0){
+      gpio_irq_disable(gpio_device_ptr);
+      gpio_irq_release(gpio_device_ptr);
+    }
+    hrtimer_cancel(&gpio_device_ptr->poll_timer);
     mutex_lock(&minor_lock);
-      idr_remove(&gpio_idr, ret_status);
+      idr_remove(&gpio_idr, minor);
     mutex_unlock(&minor_lock);
-    kfree(gpio_device_ptr);
-    return -1;
+    return -EFAULT;
+  }
+
+  printk(KERN_INFO "[GPIO driver] Creazione device file avvenuta correttamente\n");
+
+  // Registra i pin presso gpiolib. Un eventuale errore non compromette il funzionamento
+  // del device file e viene pertanto solo segnalato
+  ret_status = gpio_chip_init(gpio_device_ptr, parent ? parent : class_dev);
+  if(ret_status)
+    printk(KERN_WARNING "[GPIO driver] Registrazione presso gpiolib non riuscita: %d\n", ret_status);
+
+  // Esporta i contatori del dispositivo in debugfs. Un eventuale errore non
+  // compromette il funzionamento del driver e viene pertanto ignorato
+  gpio_debugfs_init(gpio_device_ptr, minor);
+  return 0;
+}
+
+/**
+ * @brief Rimuove device file, minor number, interruzioni, timer e chip gpiolib di un
+ *    dispositivo.
+ *
+ * @details Al ritorno nessun gestore o timer opera più sui registri; la memoria è
+ *    rilasciata con l'ultimo riferimento (gpio_device_put). Il device file, che può
+ *    essere il padre del chip, è rimosso per ultimo.
+ */
+void gpio_device_unregister(struct gpio_device *gpio_device_ptr)
+{
+  int minor_number = MINOR(gpio_device_ptr->gpiox_dev_number);
+
+  printk(KERN_INFO "[GPIO driver] Rimozione strutture dati per il device %i\n", minor_number);
+  printk(KERN_INFO "[GPIO driver] Eventi consegnati: %llu (interruzioni: %llu, polling: %llu), interruzioni risparmiate: %llu, eventi persi: %llu\n",
+         gpio_device_ptr->irq_events + gpio_device_ptr->poll_events, gpio_device_ptr->irq_events,
+         gpio_device_ptr->poll_events, gpio_device_ptr->poll_events, gpio_device_ptr->overflows);
+
+  debugfs_remove_recursive(gpio_device_ptr->debugfs);
+
+  // Dopo idr_remove nessuna nuova apertura può trovare il dispositivo
+  mutex_lock(&minor_lock);
+    idr_remove(&gpio_idr, minor_number);
+  mutex_unlock(&minor_lock);
+
+  // ISR e timer vanno fermati prima di rilasciare la memoria I/O sulla quale operano.
+  // Le interruzioni della periferica sono disabilitate prima di rimuovere la ISR:
+  // su una linea condivisa nessun altro gestore potrebbe servirle
+  if(gpio_device_ptr->irq != 0){
+    gpio_irq_disable(gpio_device_ptr);
+    gpio_irq_release(gpio_device_ptr);
+  }
+  hrtimer_cancel(&gpio_device_ptr->poll_timer);
+  gpio_pattern_stop(gpio_device_ptr);
+  gpio_capture_stop(gpio_device_ptr);
+
+  // Senza ISR nè iniettore nessuno smista più interruzioni ai pin
+  gpio_chip_remove(gpio_device_ptr);
+  device_destroy(gpio_class, gpio_device_ptr->gpiox_dev_number);
+}
+
+/**
+ * @brief Funzione di probing.
+ *
+ * @details Chiamata dal kernel quando esiste un device la cui descrizione nel device-tree
+ *    coincide con quella esportata dal modulo attraverso la macro module_platform_driver.
+ *
+ * @param op struttura che contiene informazioni utili all'inizializzazione del device
+ *    come ad esempio le informazioni provenineti dal device-tree.
+ *
+ * @return
+ *    - 0 se il procedimento di probing è andato a buon fine.
+ *    - errno se il procedimento di probing non è andato a buon fine.
+ */
+static int gpio_probe(struct platform_device *op)
+{
+  int ret_status;
+  unsigned int size;
+  struct gpio_device *gpio_device_ptr;
+
+  printk(KERN_INFO "[GPIO driver] Probing device...\n");
+
+  gpio_device_ptr = gpio_device_alloc();
+  if(!gpio_device_ptr)
+    return -ENOMEM;
+  platform_set_drvdata(op, (void*)gpio_device_ptr);
+
+  /******************** Estrazione informazioni dal device-tree ***********************/
+  // Popola la struct res del contenuto del tag "reg" del device-tree
+  // Esempio: reg = <0x43c00000 0x10000>
+  // of_address_to_resource pertanto effettuerà le seguenti azioni:
+  // res.start = 0x43c00000 e res.end = 0x43c01000
+  if (of_address_to_resource(op->dev.of_node, 0, &gpio_device_ptr->res)){
+    printk(KERN_INFO "Cannot get device resource\n");
+    gpio_device_put(gpio_device_ptr);
+    return -ENODEV;
+  }
+
+  // Restituisce informazioni riguardante la parte relativa alle interruzioni
+  // In particolare ricerca il primo tag interrupts e ne restituisce l'irq
+  // Il secondo parametro indica quale tag interrupts considerare (se ce ne sono
+  // più di uno). In questo caso viene considerato il primo
+  // Esempio: interrupts = <0 29 4> -> irq_of_parse_and_map restituirà 29
+  gpio_device_ptr->irq = irq_of_parse_and_map(op->dev.of_node, 0);
+
+  /********************* Allocazione e mapping della memoria I/O *********************/
+  // Richiede l'allocazione di una certa area di memoria di grandezza resource_size(&gpio_dev_t_ptr->res)
+  // per il driver DRIVER_NAME
+  // La macro resource_size restituisce la dimensione del segmento fisico associato alla periferica
+  // Esempio: reg = <0x43c00000 0x10000> -> resource_size restituirà 0x10000
+  if(!request_mem_region(gpio_device_ptr->res.start, resource_size(&gpio_device_ptr->res), DRIVER_NAME)){
+    printk(KERN_INFO "Cannot gain memory in exclusive way\n");
+    gpio_device_put(gpio_device_ptr);
+    return -EBUSY;
+  }
+  gpio_device_ptr->mem_region = YES;
+
+  size = gpio_device_ptr->res.end - gpio_device_ptr->res.start + 1;
+
+  // Effettua il mapping tra il segmento di memoria fisico associato alla periferica
+  // e lo spazio virtuale del processo
+  // NOTA: la combinazione ioremap + of_address_to_resource è equivalente alla chiamata
+  //       di of_iomap(res.start, resource_size(&res))
+  gpio_device_ptr->base_addr = ioremap(gpio_device_ptr->res.start, size);
+  if (!gpio_device_ptr->base_addr) {
+    printk(KERN_INFO "Cannot map virtual address\n");
+    gpio_device_put(gpio_device_ptr);
+    return -ENOMEM;
+  }
+
+  printk(KERN_INFO "[GPIO driver] Allocazione e mapping di memoria I/O avvenuta correttamente\n");
+
+  ret_status = gpio_device_register(gpio_device_ptr, &op->dev);
+  if(ret_status){
+    gpio_device_put(gpio_device_ptr);
+    return ret_status;
+  }
+
+  printk(KERN_INFO "[GPIO driver] Probing completato!\n");
+  return 0;
+}
+
+/**
+ * @brief Funzione di rimozione.
+ *
+ * @details Chiamata dal kernel quando un dispositivo non è più presente nel sistema.
+ *    Dealloca tutte le strutture dati allocate in precedenza per gestire il particolare device.
+ *
+ * @param op struttura che contiene informazioni utili all'deallocazione del device
+ *
+ * @return
+ *    - 0 se il procedimento di rimozione è andato a buon fine.
+ *    - errno se il procedimento di probing non è andato a buon fine.
+ */
+static int gpio_remove(struct platform_device *op)
+{
+  struct gpio_device *gpio_device_ptr = platform_get_drvdata(op);
+
+  gpio_device_unregister(gpio_device_ptr);
+
+  // Memoria I/O e ring sono rilasciati con l'ultimo riferimento: un file ancora aperto
+  // o un ring ancora mappato mantengono in vita il dispositivo
+  gpio_device_put(gpio_device_ptr);
+  return 0;
+}
+
+/**
+ * @brief Chiamata dal kernel quando un processo apre il device file relativo alla periferica.
+ *
+ * @param inode è l'inode relativo al device file. Contiene il major ed il minor number
+ *    alla particolare periferica.
+ * @param filp è il puntatore ad una struttura struct file che viene creata per ogni processo
+ *    che apre il device file.
+ *
+ * @return
+ *    - 0 se il procedimento di apertura è andato a buon fine.
+ *    - errno se il procedimento di apertura non è andato a buon fine.
+ */
+int gpio_open(struct inode *inode, struct file *filp)
+{
+  struct gpio_device* gpio_dev_ptr;
+  struct gpio_subscriber *sub;
+
+  trace_gpiodrv_open(iminor(inode));
+
+  rcu_read_lock();
+    // Interroga la struttura dati idr per ottenere il puntatore al device identificato dal suo minor number
+    // Il minor number è presente nell'inode del device file. Un dispositivo in fase di
+    // rimozione (nessun riferimento residuo) è trattato come non trovato
+    gpio_dev_ptr = idr_find(&gpio_idr, iminor(inode));
+    if(gpio_dev_ptr && !kref_get_unless_zero(&gpio_dev_ptr->ref))
+      gpio_dev_ptr = NULL;
+  rcu_read_unlock();
+
+  if (!gpio_dev_ptr) {
+    printk(KERN_WARNING "[GPIO driver] Puntatore alla struttura gpio_device non trovato!\n");
+    return -ENODEV;
+  }
+
+  sub = kzalloc(sizeof(*sub), GFP_KERNEL);
+  if(!sub){
+    gpio_device_put(gpio_dev_ptr);
+    return -ENOMEM;
+  }
+  sub->dev = gpio_dev_ptr;
+  INIT_KFIFO(sub->events);
+  init_waitqueue_head(&sub->wait);
+  mutex_init(&sub->read_mutex);
+  atomic_set(&sub->ring_maps, 0);
+
+  // Filtro di default: tutti i fronti di salita su tutti i pin
+  sub->filter.mask = ~0U;
+  sub->filter.edges = GPIO_EDGE_RISING;
+
+  mutex_lock(&gpio_dev_ptr->subs_lock);
+    list_add_tail(&sub->node, &gpio_dev_ptr->subscribers);
+  mutex_unlock(&gpio_dev_ptr->subs_lock);
+
+  // Associa il file aperto alla struttura file creata dal kernel
+  filp->private_data = sub;
+
+  // read e write operano sul flusso, pread e pwrite sui registri (si veda gpiodrv.h)
+  filp->f_pos = GPIO_STREAM_OFFSET;
+#ifdef FMODE_NOWAIT
+  // Le operazioni asincrone con IOCB_NOWAIT sono gestite da gpio_read_iter e gpio_write_iter
+  filp->f_mode |= FMODE_NOWAIT;
+#endif
+  return 0;
+}
+
+/**
+ * @brief Chiamata dal kernel quando il device file viene chiuso da tutti i processi che
+ *    lo avevano in precedenza aperto.
+ *
+ * @param inode è l'inode relativo al device file. Contiene il major ed il minor number associato
+ *    associato al driver della periferica.
+ * @param filp è il puntatore ad una struttura struct file che viene creata per ogni processo
+ *    che apre il device file.
+ *
+ * @return
+ *    - 0 se il procedimento di release è andato a buon fine.
+ *    - errno se il procedimento di release non è andato a buon fine.
+ */
+int gpio_release(struct inode *inode, struct file *filp)
+{
+  struct gpio_subscriber *sub = filp->private_data;
+  struct gpio_device *gpio_dev_ptr = sub->dev;
+
+  trace_gpiodrv_release(iminor(inode));
+
+  mutex_lock(&gpio_dev_ptr->subs_lock);
+    list_del(&sub->node);
+  mutex_unlock(&gpio_dev_ptr->subs_lock);
+
+  mutex_destroy(&sub->read_mutex);
+  kfree(sub);
+  gpio_device_put(gpio_dev_ptr);
+  return 0;
+}
+
+/**
+ * @brief Legge parole consecutive dal banco di registri (pread).
+ *
+ * @param gpio_dev_ptr è il puntatore al dispositivo.
+ * @param to descrive i buffer user-space nei quali copiare i registri letti.
+ * @param offset è lo spiazzamento del primo registro da leggere.
+ *
+ * @return il numero di byte letti (0 oltre l'ultimo registro), oppure errno.
+ *
+ * @note I registri sono letti con un'unica acquisizione dei lock del dispositivo e
+ *    costituiscono quindi una fotografia consistente.
+ */
+static ssize_t gpio_read_regs(struct gpio_device *gpio_dev_ptr, struct iov_iter *to, loff_t offset)
+{
+  u32 words[GPIO_REGS_SIZE/4];
+  size_t count = iov_iter_count(to);
+  struct gpio_op op;
+  unsigned long flags;
+  unsigned int i;
+
+  if(offset % 4 != 0 || count < 4)
+    return -EINVAL;
+  if(offset >= GPIO_REGS_SIZE)
+    return 0;
+  count = min_t(size_t, count, GPIO_REGS_SIZE - offset) & ~3;
+
+  op.code = GPIO_OP_READ;
+  spin_lock_irqsave(&gpio_dev_ptr->write_lock, flags);
+  spin_lock(&gpio_dev_ptr->irq_lock);
+    for(i = 0; i < count/4; i++){
+      op.offset = offset + 4*i;
+      gpio_batch_op(gpio_dev_ptr, &op);
+      words[i] = op.value;
+    }
+  spin_unlock(&gpio_dev_ptr->irq_lock);
+  spin_unlock_irqrestore(&gpio_dev_ptr->write_lock, flags);
+
+  if(copy_to_iter(words, count, to) != count)
+    return -EFAULT;
+  return count;
+}
+
+/**
+ * @brief Scrive parole consecutive nel banco di registri (pwrite).
+ *
+ * @param gpio_dev_ptr è il puntatore al dispositivo.
+ * @param from descrive i buffer user-space che contengono i valori da scrivere.
+ * @param offset è lo spiazzamento del primo registro da scrivere.
+ *
+ * @return il numero di byte scritti, oppure errno.
+ *
+ * @note Sono scrivibili soltanto DOUT, TRI ed IER, come per GPIO_IOC_BATCH.
+ */
+static ssize_t gpio_write_regs(struct gpio_device *gpio_dev_ptr, struct iov_iter *from, loff_t offset)
+{
+  u32 words[GPIO_REGS_SIZE/4];
+  size_t count = iov_iter_count(from);
+  struct gpio_op op;
+  unsigned long flags;
+  unsigned int i;
+
+  if(offset % 4 != 0 || count % 4 != 0 || count == 0 || offset >= GPIO_REGS_SIZE || count > GPIO_REGS_SIZE - offset)
+    return -EINVAL;
+
+  for(i = 0; i < count/4; i++){
+    op.offset = offset + 4*i;
+    if(op.offset != GPIO_DOUT_OFFSET && op.offset != GPIO_TRI_OFFSET && op.offset != GPIO_IER_OFFSET)
+      return -EINVAL;
+  }
+
+  if(copy_from_iter(words, count, from) != count)
+    return -EFAULT;
+
+  op.code = GPIO_OP_UPDATE;
+  op.mask = 0xFFFFFFFF;
+  spin_lock_irqsave(&gpio_dev_ptr->write_lock, flags);
+  spin_lock(&gpio_dev_ptr->irq_lock);
+    for(i = 0; i < count/4; i++){
+      op.offset = offset + 4*i;
+      op.value = words[i];
+      gpio_batch_op(gpio_dev_ptr, &op);
+    }
+  spin_unlock(&gpio_dev_ptr->irq_lock);
+  spin_unlock_irqrestore(&gpio_dev_ptr->write_lock, flags);
+
+  return count;
+}
+
+/**
+ * @brief Indica se l'operazione in corso non deve attendere.
+ *
+ * @details L'attesa è esclusa se il file è stato aperto con O_NONBLOCK oppure se la
+ *    richiesta proviene da una sottomissione asincrona (AIO con RWF_NOWAIT, io_uring)
+ *    che preferisce ricevere -EAGAIN piuttosto che bloccare il thread che la sottomette.
+ */
+static inline int gpio_iocb_nowait(struct kiocb *iocb)
+{
+  if(iocb->ki_filp->f_flags & O_NONBLOCK)
+    return YES;
+#ifdef IOCB_NOWAIT
+  if(iocb->ki_flags & IOCB_NOWAIT)
+    return YES;
+#endif
+  return NO;
+}
+
+/**
+ * @brief Chiamata dal kernel ogni volta che un processo legge dal device file. La lettura è bloccante.
+ *
+ * @param iocb descrive la richiesta: file aperto, posizione nel file e modalità
+ *    (sincrona oppure asincrona).
+ * @param to descrive i buffer user-space, anche più di uno (readv, preadv), nei quali
+ *    copiare gli eventi.
+ *
+ * @return
+ *    - il numero di byte copiati (multiplo di sizeof(struct gpio_event)) se il procedimento
+ *      di lettura è andato a buon fine.
+ *    - errno se il procedimento di lettura non è andato a buon fine.
+ *
+ * @details Attende che la coda degli eventi del dispositivo non sia vuota e restituisce
+ *    tanti eventi quanti ne entrano nei buffer forniti; un evento può essere diviso tra
+ *    due buffer consecutivi. Se l'attesa non è ammessa (si veda gpio_iocb_nowait) e non
+ *    ci sono eventi la funzione restituisce immediatamente -EAGAIN.
+ *    Una lettura con posizione all'interno del banco di registri legge invece direttamente
+ *    i registri (si veda gpio_read_regs).
+ *
+ * @note
+ *    Gli eventi sono prima copiati e poi rimossi dalla coda: in caso di errore nella
+ *    copia verso lo spazio user non vanno persi.
+ */
+ssize_t gpio_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+  struct gpio_event events[GPIO_READ_CHUNK];
+  int ret_status, waited;
+  size_t count = iov_iter_count(to);
+  unsigned int n, copied = 0;
+  unsigned long flags;
+  u64 latency = 0;
+  struct gpio_subscriber *sub = iocb->ki_filp->private_data;
+  struct gpio_device* gpio_dev_t_ptr = sub->dev;
+
+  if(iocb->ki_pos != GPIO_STREAM_OFFSET)
+    return gpio_read_regs(gpio_dev_t_ptr, to, iocb->ki_pos);
+
+  if(count < sizeof(struct gpio_event))
+    return -EINVAL;
+
+  // I lettori dello stesso file sono serializzati: la coda ammette un solo consumatore alla volta
+  if(gpio_iocb_nowait(iocb)){
+    if(!mutex_trylock(&sub->read_mutex))
+      return -EAGAIN;
+    if(kfifo_is_empty(&sub->events)){
+      mutex_unlock(&sub->read_mutex);
+      return -EAGAIN;
+    }
+  } else if(mutex_lock_interruptible(&sub->read_mutex)){
+    return -ERESTARTSYS;
+  }
+
+  // Attende l'arrivo di almeno un evento che soddisfi il filtro del file
+  waited = kfifo_is_empty(&sub->events);
+  ret_status = wait_event_interruptible(sub->wait, !kfifo_is_empty(&sub->events));
+  if(ret_status != 0){
+    mutex_unlock(&sub->read_mutex);
+    return -ERESTARTSYS;
+  }
+  trace_gpiodrv_wakeup(MINOR(gpio_dev_t_ptr->gpiox_dev_number), kfifo_len(&sub->events));
+
+  // Passaggio al processo user-space degli eventi accodati, GPIO_READ_CHUNK alla volta
+  count /= sizeof(struct gpio_event);
+  while(copied < count){
+    n = kfifo_out_peek(&sub->events, events, min_t(size_t, count - copied, GPIO_READ_CHUNK));
+    if(n == 0)
+      break;
+
+    // Latenza tra l'ingresso nella ISR ed il risveglio del lettore, misurata solo se
+    // il lettore era effettivamente in attesa
+    if(waited && copied == 0)
+      latency = ktime_get_ns() - events[0].timestamp;
+
+    if(copy_to_iter(events, n * sizeof(struct gpio_event), to) != n * sizeof(struct gpio_event)){
+      printk(KERN_WARNING "[GPIO driver] Problema nella copia dei dati al processo user-space!\n");
+      break;
+    }
+    kfifo_out(&sub->events, events, n);
+    copied += n;
+  }
+  mutex_unlock(&sub->read_mutex);
+  if(copied == 0)
+    return -EFAULT;
+
+  // I contatori sono condivisi da tutti i file aperti sul dispositivo
+  spin_lock_irqsave(&gpio_dev_t_ptr->write_lock, flags);
+    gpio_dev_t_ptr->reads++;
+    gpio_dev_t_ptr->read_events += copied;
+    if(latency){
+      gpio_dev_t_ptr->wake_hist[min_t(unsigned int, fls64(latency) - 1, GPIO_WAKE_HIST_BUCKETS - 1)]++;
+      if(latency > gpio_dev_t_ptr->wake_max_ns)
+        gpio_dev_t_ptr->wake_max_ns = latency;
+    }
+  spin_unlock_irqrestore(&gpio_dev_t_ptr->write_lock, flags);
+
+  trace_gpiodrv_read(MINOR(gpio_dev_t_ptr->gpiox_dev_number), count * sizeof(struct gpio_event), copied * sizeof(struct gpio_event));
+  return copied * sizeof(struct gpio_event);
+}
+
+/**
+ * @brief Chiamata dal kernel ogni volta che un processo scrive sul device file.
+ *
+ * @param iocb descrive la richiesta: file aperto, posizione nel file e modalità
+ *    (sincrona oppure asincrona).
+ * @param from descrive i buffer user-space, anche più di uno (writev, pwritev), che
+ *    contengono i dati da scrivere. La dimensione complessiva deve essere un multiplo di 4 byte.
+ *
+ * @return
+ *    - il numero di byte scritti se il procedimento di scrittura è andato a buon fine
+ *      (minore della dimensione richiesta se la copia si interrompe a metà).
+ *    - errno se il procedimento di scrittura non è andato a buon fine.
+ *
+ * @details Le parole a 32 bit contenute nei buffer sono scritte una dopo l'altra nel registro
+ *    DOUT, così che una sola chiamata di sistema possa produrre una sequenza di valori
+ *    sui pin. La direzione dei pin non viene modificata: va impostata con GPIO_IOC_BATCH
+ *    oppure con una pwrite sul registro TRI (si veda gpio_write_regs).
+ *    La scrittura non attende mai, per cui le richieste con IOCB_NOWAIT sono servite
+ *    direttamente nel contesto di chi le sottomette.
+ *
+ * @note
+ *    L'accesso alla periferica è gestito attraverso uno spinlock per garantire
+ *    mutua esclusione.
+ */
+ssize_t gpio_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+  u32 words[GPIO_WRITE_CHUNK];
+  struct gpio_device* gpio_dev_t_ptr;
+  size_t count = iov_iter_count(from);
+  unsigned long flags;
+  size_t done, chunk;
+  unsigned int i;
+
+  gpio_dev_t_ptr = ((struct gpio_subscriber *)iocb->ki_filp->private_data)->dev;
+
+  if(iocb->ki_pos != GPIO_STREAM_OFFSET)
+    return gpio_write_regs(gpio_dev_t_ptr, from, iocb->ki_pos);
+
+  if(count % 4 != 0)
+    return -EINVAL;
+
+  for(done = 0; done < count; done += chunk){
+    chunk = min_t(size_t, count - done, sizeof(words));
+    if(copy_from_iter(words, chunk, from) != chunk){
+      printk(KERN_WARNING "[GPIO driver] Problema nella copia dei dati dal processo user-space!\n");
+      if(done == 0)
+        return -EFAULT;
+      break;
+    }
+
+    // L'accesso alla periferica è gestito in mutua esclusione poichè è
+    // una risorsa condivisa tra più processi
+    spin_lock_irqsave(&gpio_dev_t_ptr->write_lock, flags);
+      for(i = 0; i < chunk/4; i++)
+        gpio_reg_write(gpio_dev_t_ptr, GPIO_DOUT_OFFSET, words[i]);
+      gpio_dev_t_ptr->write_words += chunk/4;
+    spin_unlock_irqrestore(&gpio_dev_t_ptr->write_lock, flags);
+  }
+
+  spin_lock_irqsave(&gpio_dev_t_ptr->write_lock, flags);
+    gpio_dev_t_ptr->writes++;
+  spin_unlock_irqrestore(&gpio_dev_t_ptr->write_lock, flags);
+
+  trace_gpiodrv_write(MINOR(gpio_dev_t_ptr->gpiox_dev_number), count, done);
+  return done;
+}
+
+/**
+ * @brief Chiamata dal kernel quando un processo attende sul device file mediante
+ *    poll, select o epoll.
+ *
+ * @param filp è il puntatore ad una struttura struct file che viene creata per ogni processo
+ *    che apre il device file.
+ * @param wait è la tabella alla quale va aggiunta la wait queue del dispositivo.
+ *
+ * @return maschera degli eventi disponibili: POLLIN se la coda degli eventi del file oppure
+ *    il ring (se mappato attraverso il file) non sono vuoti, POLLOUT sempre, dal momento che
+ *    la scrittura non è mai bloccante.
+ */
+unsigned int gpio_poll(struct file *filp, poll_table *wait)
+{
+  struct gpio_subscriber *sub = filp->private_data;
+  struct gpio_device* gpio_dev_t_ptr = sub->dev;
+  unsigned int mask = POLLOUT | POLLWRNORM;
+
+  poll_wait(filp, &sub->wait, wait);
+
+  if(!kfifo_is_empty(&sub->events))
+    mask |= POLLIN | POLLRDNORM;
+
+  // L'indice tail è scritto dal consumatore in user-space
+  if(atomic_read(&sub->ring_maps) > 0 &&
+     READ_ONCE(gpio_dev_t_ptr->ring->tail) != READ_ONCE(gpio_dev_t_ptr->ring_head))
+    mask |= POLLIN | POLLRDNORM;
+
+  return mask;
+}
+
+/**
+ * @brief Apertura di una mappatura del ring degli eventi (mmap oppure fork).
+ */
+static void gpio_ring_vm_open(struct vm_area_struct *vma)
+{
+  struct gpio_device* gpio_dev_t_ptr = vma->vm_private_data;
+
+  struct gpio_subscriber *sub = vma->vm_file->private_data;
+
+  // La mappatura mantiene in vita il dispositivo: il file aperto, al quale fa riferimento,
+  // è rilasciato solo dopo la chiusura di tutte le sue mappature
+  kref_get(&gpio_dev_t_ptr->ref);
+  atomic_inc(&gpio_dev_t_ptr->ring_users);
+  atomic_inc(&sub->ring_maps);
+}
+
+/**
+ * @brief Chiusura di una mappatura del ring degli eventi (munmap oppure exit).
+ */
+static void gpio_ring_vm_close(struct vm_area_struct *vma)
+{
+  struct gpio_device* gpio_dev_t_ptr = vma->vm_private_data;
+
+  struct gpio_subscriber *sub = vma->vm_file->private_data;
+
+  atomic_dec(&sub->ring_maps);
+  atomic_dec(&gpio_dev_t_ptr->ring_users);
+  gpio_device_put(gpio_dev_t_ptr);
+}
+
+/**
+ * @brief Operazioni sulle mappature del ring, usate per contarne gli utilizzatori.
+ */
+static const struct vm_operations_struct gpio_ring_vm_ops = {
+  .open   =   gpio_ring_vm_open,
+  .close  =   gpio_ring_vm_close,
+};
+
+/**
+ * @brief Apertura di una mappatura del buffer delle acquisizioni (mmap oppure fork).
+ */
+static void gpio_capture_vm_open(struct vm_area_struct *vma)
+{
+  struct gpio_device* gpio_dev_t_ptr = vma->vm_private_data;
+
+  // Il buffer è rilasciato insieme al dispositivo
+  kref_get(&gpio_dev_t_ptr->ref);
+}
+
+/**
+ * @brief Chiusura di una mappatura del buffer delle acquisizioni (munmap oppure exit).
+ */
+static void gpio_capture_vm_close(struct vm_area_struct *vma)
+{
+  gpio_device_put(vma->vm_private_data);
+}
+
+/**
+ * @brief Operazioni sulle mappature del buffer delle acquisizioni.
+ */
+static const struct vm_operations_struct gpio_capture_vm_ops = {
+  .open   =   gpio_capture_vm_open,
+  .close  =   gpio_capture_vm_close,
+};
+
+/**
+ * @brief Restituisce il buffer delle acquisizioni, allocandolo al primo utilizzo.
+ *
+ * @note Deve essere chiamata con capture_mutex acquisito.
+ */
+static struct gpio_sample *gpio_capture_buffer(struct gpio_device *gpio_dev_ptr)
+{
+  if(!gpio_dev_ptr->capture_buf)
+    gpio_dev_ptr->capture_buf = vmalloc_user(GPIO_CAPTURE_BYTES);
+  return gpio_dev_ptr->capture_buf;
+}
+
+/**
+ * @brief Chiamata dal kernel quando un processo effettua il mapping del device file.
+ *
+ * @param filp è il puntatore ad una struttura struct file che viene creata per ogni processo
+ *    che apre il device file.
+ * @param vma è l'area di memoria virtuale del processo da associare al dispositivo.
+ *
+ * @return
+ *    - 0 se il mapping è andato a buon fine.
+ *    - errno se il mapping non è andato a buon fine.
+ *
+ * @details Mappa nello spazio di indirizzamento del processo la regione fisica dei
+ *    registri della periferica, la stessa richiesta nella funzione di probing, con
+ *    attributi non cacheable. Letture e scritture dei registri diventano così semplici
+ *    load e store, mentre interruzioni e ciclo di vita del dispositivo restano a carico
+ *    del driver.
+ *
+ *    All'offset GPIO_MMAP_RING_OFFSET mappa invece il ring degli eventi (si veda
+ *    struct gpio_ring in gpiodrv.h), dal quale i processi consumano gli eventi senza
+ *    chiamate di sistema, ed all'offset GPIO_MMAP_CAPTURE_OFFSET il buffer dei campioni
+ *    acquisiti con GPIO_IOC_CAPTURE_START.
+ */
+int gpio_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+  struct gpio_device* gpio_dev_t_ptr = ((struct gpio_subscriber *)filp->private_data)->dev;
+  int ret_status;
+
+  if(vma->vm_pgoff == GPIO_MMAP_RING_OFFSET){
+    // remap_vmalloc_range verifica che l'area richiesta non ecceda il ring
+    ret_status = remap_vmalloc_range(vma, gpio_dev_t_ptr->ring, 0);
+    if(ret_status)
+      return ret_status;
+
+    vma->vm_ops = &gpio_ring_vm_ops;
+    vma->vm_private_data = gpio_dev_t_ptr;
+    gpio_ring_vm_open(vma);
+    return 0;
+  }
+
+  if(vma->vm_pgoff == GPIO_MMAP_CAPTURE_OFFSET){
+    struct gpio_sample *buf;
+
+    mutex_lock(&gpio_dev_t_ptr->capture_mutex);
+      buf = gpio_capture_buffer(gpio_dev_t_ptr);
+    mutex_unlock(&gpio_dev_t_ptr->capture_mutex);
+    if(!buf)
+      return -ENOMEM;
+
+    ret_status = remap_vmalloc_range(vma, buf, 0);
+    if(ret_status)
+      return ret_status;
+
+    vma->vm_ops = &gpio_capture_vm_ops;
+    vma->vm_private_data = gpio_dev_t_ptr;
+    gpio_capture_vm_open(vma);
+    return 0;
+  }
+
+  if(vma->vm_pgoff != GPIO_MMAP_REGS_OFFSET)
+    return -EINVAL;
+
+  // Il banco simulato non ha una regione fisica da mappare
+  if(gpio_dev_t_ptr->mock)
+    return -ENODEV;
+
+  vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+
+  // vm_iomap_memory verifica che l'area richiesta non ecceda la regione della periferica
+  return vm_iomap_memory(vma, gpio_dev_t_ptr->res.start, resource_size(&gpio_dev_t_ptr->res));
+}
+
+/**
+ * @brief Esegue una singola operazione di una GPIO_IOC_BATCH.
+ *
+ * @param gpio_dev_ptr è il puntatore al dispositivo.
+ * @param op è l'operazione da eseguire, già validata da gpio_ioctl.
+ *
+ * @note Deve essere chiamata con write_lock ed irq_lock acquisiti. Il registro IER è
+ *    gestito attraverso la sua copia: durante il polling le interruzioni restano
+ *    mascherate nell'hardware e la nuova maschera è applicata al ritorno alle interruzioni.
+ */
+static void gpio_batch_op(struct gpio_device *gpio_dev_ptr, struct gpio_op *op)
+{
+  u32 reg;
+
+  if(op->offset == GPIO_IER_OFFSET)
+    reg = gpio_dev_ptr->ier;
+  else
+    reg = gpio_reg_read(gpio_dev_ptr, op->offset);
+
+  switch(op->code){
+    case GPIO_OP_READ:
+      op->value = reg;
+      return;
+    case GPIO_OP_SET:
+      reg |= op->mask;
+      break;
+    case GPIO_OP_CLEAR:
+      reg &= ~op->mask;
+      break;
+    case GPIO_OP_TOGGLE:
+      reg ^= op->mask;
+      break;
+    case GPIO_OP_UPDATE:
+      reg = (reg & ~op->mask) | (op->value & op->mask);
+      break;
+  }
+
+  if(op->offset == GPIO_IER_OFFSET){
+    gpio_dev_ptr->ier = reg;
+    gpio_ier_apply(gpio_dev_ptr);
+    return;
+  }
+  gpio_reg_write(gpio_dev_ptr, op->offset, reg);
+}
+
+/**
+ * @brief Imposta il filtro degli eventi di un file aperto (GPIO_IOC_SET_FILTER).
+ *
+ * @param sub è il file aperto.
+ * @param arg è il puntatore user-space alla struct gpio_filter.
+ *
+ * @return 0 oppure errno.
+ *
+ * @details Il filtro è sostituito sotto subs_lock, quindi mai durante la consegna di un
+ *    evento. Gli eventi già accodati restano nella coda del file.
+ */
+static long gpio_ioctl_set_filter(struct gpio_subscriber *sub, unsigned long arg)
+{
+  struct gpio_filter filter;
+
+  if(copy_from_user(&filter, (void __user *)arg, sizeof(filter)) != 0)
+    return -EFAULT;
+  if(filter.edges & ~(GPIO_EDGE_RISING | GPIO_EDGE_FALLING))
+    return -EINVAL;
+  if(filter.value_match & ~filter.value_mask)
+    return -EINVAL;
+
+  mutex_lock(&sub->dev->subs_lock);
+    sub->filter = filter;
+    sub->last_ns = 0;
+  mutex_unlock(&sub->dev->subs_lock);
+  return 0;
+}
+
+/**
+ * @brief Esegue un array di operazioni sui registri (GPIO_IOC_BATCH).
+ *
+ * @param gpio_dev_t_ptr è il puntatore al dispositivo.
+ * @param arg è il puntatore user-space alla struct gpio_batch.
+ *
+ * @return 0 oppure errno.
+ *
+ * @details Le operazioni (scritture mascherate, cambi di direzione, aggiornamenti di IER,
+ *    letture) sono eseguite con una sola chiamata di sistema ed una sola acquisizione dei
+ *    lock del dispositivo. Tutte le operazioni sono validate prima di toccare i registri:
+ *    se una non è valida non ne viene eseguita nessuna.
+ */
+static long gpio_ioctl_batch(struct gpio_device *gpio_dev_t_ptr, unsigned long arg)
+{
+  struct gpio_batch batch;
+  struct gpio_op *ops;
+  unsigned long flags;
+  unsigned int i;
+  long ret_status = 0;
+
+  if(copy_from_user(&batch, (void __user *)arg, sizeof(batch)) != 0)
+    return -EFAULT;
+  if(batch.count == 0 || batch.count > GPIO_BATCH_MAX || batch.reserved != 0)
+    return -EINVAL;
+
+  ops = kmalloc_array(batch.count, sizeof(struct gpio_op), GFP_KERNEL);
+  if(!ops)
+    return -ENOMEM;
+
+  if(copy_from_user(ops, (void __user *)(uintptr_t)batch.ops, batch.count * sizeof(struct gpio_op)) != 0){
+    ret_status = -EFAULT;
+    goto out;
+  }
+
+  for(i = 0; i < batch.count; i++){
+    if(ops[i].offset > GPIO_ISR_OFFSET || ops[i].offset % 4 != 0 || ops[i].code > GPIO_OP_READ){
+      ret_status = -EINVAL;
+      goto out;
+    }
+    // Sono modificabili soltanto DOUT, TRI ed IER
+    if(ops[i].code != GPIO_OP_READ && ops[i].offset != GPIO_DOUT_OFFSET &&
+       ops[i].offset != GPIO_TRI_OFFSET && ops[i].offset != GPIO_IER_OFFSET){
+      ret_status = -EINVAL;
+      goto out;
+    }
+  }
+
+  spin_lock_irqsave(&gpio_dev_t_ptr->write_lock, flags);
+  spin_lock(&gpio_dev_t_ptr->irq_lock);
+    for(i = 0; i < batch.count; i++)
+      gpio_batch_op(gpio_dev_t_ptr, &ops[i]);
+  spin_unlock(&gpio_dev_t_ptr->irq_lock);
+  spin_unlock_irqrestore(&gpio_dev_t_ptr->write_lock, flags);
+
+  // Restituisce al processo user-space i valori letti
+  if(copy_to_user((void __user *)(uintptr_t)batch.ops, ops, batch.count * sizeof(struct gpio_op)) != 0)
+    ret_status = -EFAULT;
+
+out:
+  kfree(ops);
+  return ret_status;
+}
+
+/**
+ * @brief Carica una sequenza da riprodurre su DOUT (GPIO_IOC_PATTERN_LOAD).
+ *
+ * @param gpio_dev_ptr è il puntatore al dispositivo.
+ * @param arg è il puntatore user-space alla struct gpio_pattern.
+ *
+ * @return 0 oppure errno (-EBUSY se un buffer è già in coda).
+ *
+ * @details La sequenza è copiata nel buffer non in riproduzione, che l'hrtimer non tocca
+ *    finché non viene marcato come in coda: la copia avviene quindi senza lock.
+ */
+static long gpio_ioctl_pattern_load(struct gpio_device *gpio_dev_ptr, unsigned long arg)
+{
+  struct gpio_pattern pattern;
+  struct gpio_pattern_buf *buf;
+  unsigned long flags;
+  unsigned int i, slot;
+  int start = NO;
+  long ret_status = 0;
+
+  if(copy_from_user(&pattern, (void __user *)arg, sizeof(pattern)) != 0)
+    return -EFAULT;
+  if(pattern.count == 0 || pattern.count > GPIO_PATTERN_MAX ||
+     pattern.flags & ~(GPIO_PATTERN_LOOP | GPIO_PATTERN_LAST))
+    return -EINVAL;
+
+  mutex_lock(&gpio_dev_ptr->pattern_mutex);
+
+  if(!gpio_dev_ptr->pattern){
+    gpio_dev_ptr->pattern = kcalloc(2, sizeof(struct gpio_pattern_buf), GFP_KERNEL);
+    if(!gpio_dev_ptr->pattern){
+      ret_status = -ENOMEM;
+      goto out;
+    }
+  }
+
+  spin_lock_irqsave(&gpio_dev_ptr->pattern_lock, flags);
+    if(gpio_dev_ptr->pattern_next == YES)
+      ret_status = -EBUSY;
+    slot = gpio_dev_ptr->pattern_running == YES ? !gpio_dev_ptr->pattern_active : gpio_dev_ptr->pattern_active;
+  spin_unlock_irqrestore(&gpio_dev_ptr->pattern_lock, flags);
+  if(ret_status)
+    goto out;
+
+  buf = &gpio_dev_ptr->pattern[slot];
+  if(copy_from_user(buf->steps, (void __user *)(uintptr_t)pattern.steps, pattern.count * sizeof(struct gpio_pattern_step)) != 0){
+    ret_status = -EFAULT;
+    goto out;
+  }
+  for(i = 0; i < pattern.count; i++){
+    if(buf->steps[i].delay_ns < GPIO_PATTERN_MIN_DELAY_NS){
+      ret_status = -EINVAL;
+      goto out;
+    }
+  }
+  buf->count = pattern.count;
+  buf->flags = pattern.flags;
+
+  spin_lock_irqsave(&gpio_dev_ptr->pattern_lock, flags);
+    if(gpio_dev_ptr->pattern_running == YES){
+      gpio_dev_ptr->pattern_next = YES;
+    } else {
+      gpio_dev_ptr->pattern_active = slot;
+      gpio_dev_ptr->pattern_pos = 0;
+      gpio_dev_ptr->pattern_running = YES;
+      gpio_dev_ptr->pattern_steps = 0;
+      gpio_dev_ptr->pattern_underruns = 0;
+      gpio_dev_ptr->pattern_jitter_sum_ns = 0;
+      gpio_dev_ptr->pattern_jitter_max_ns = 0;
+      start = YES;
+    }
+  spin_unlock_irqrestore(&gpio_dev_ptr->pattern_lock, flags);
+
+  // Il primo passo scocca immediatamente
+  if(start == YES)
+    hrtimer_start(&gpio_dev_ptr->pattern_timer, ktime_get(), HRTIMER_MODE_ABS);
+
+out:
+  mutex_unlock(&gpio_dev_ptr->pattern_mutex);
+  return ret_status;
+}
+
+/**
+ * @brief Restituisce lo stato della riproduzione (GPIO_IOC_PATTERN_STATUS).
+ */
+static long gpio_ioctl_pattern_status(struct gpio_device *gpio_dev_ptr, unsigned long arg)
+{
+  struct gpio_pattern_status status;
+  unsigned long flags;
+
+  spin_lock_irqsave(&gpio_dev_ptr->pattern_lock, flags);
+    status.running = gpio_dev_ptr->pattern_running == YES;
+    status.queued = gpio_dev_ptr->pattern_next == YES;
+    status.steps = gpio_dev_ptr->pattern_steps;
+    status.underruns = gpio_dev_ptr->pattern_underruns;
+    status.jitter_max_ns = gpio_dev_ptr->pattern_jitter_max_ns;
+    status.jitter_mean_ns = status.steps ? div64_u64(gpio_dev_ptr->pattern_jitter_sum_ns, status.steps) : 0;
+  spin_unlock_irqrestore(&gpio_dev_ptr->pattern_lock, flags);
+
+  return copy_to_user((void __user *)arg, &status, sizeof(status)) ? -EFAULT : 0;
+}
+
+/**
+ * @brief Acquisisce un campione di DIN.
+ *
+ * @param gpio_dev_ptr è il puntatore al dispositivo.
+ * @param now è l'istante del campionamento in nanosecondi.
+ *
+ * @return YES se l'acquisizione è terminata con questo campione.
+ *
+ * @note Deve essere chiamata con capture_lock acquisito.
+ */
+static int gpio_capture_sample(struct gpio_device *gpio_dev_ptr, u64 now)
+{
+  struct gpio_capture *capture = &gpio_dev_ptr->capture;
+  struct gpio_sample *sample;
+
+  sample = &gpio_dev_ptr->capture_buf[gpio_dev_ptr->capture_pos % (capture->pre_samples + capture->post_samples)];
+  sample->timestamp = now;
+  sample->value = gpio_reg_read(gpio_dev_ptr, GPIO_DIN_OFFSET);
+  gpio_dev_ptr->capture_pos++;
+
+  if(gpio_dev_ptr->capture_state == GPIO_CAPTURE_ARMED &&
+     (sample->value & capture->trigger_mask) == capture->trigger_value){
+    gpio_dev_ptr->capture_state = GPIO_CAPTURE_TRIGGERED;
+    gpio_dev_ptr->capture_triggered = YES;
+    gpio_dev_ptr->capture_trigger_pos = gpio_dev_ptr->capture_pos - 1;
+  }
+
+  if(gpio_dev_ptr->capture_state == GPIO_CAPTURE_TRIGGERED &&
+     gpio_dev_ptr->capture_pos - gpio_dev_ptr->capture_trigger_pos == capture->post_samples){
+    gpio_dev_ptr->capture_state = GPIO_CAPTURE_DONE;
+    return YES;
+  }
+  return NO;
+}
+
+/**
+ * @brief Acquisizione in modalità GPIO_CAPTURE_BURST.
+ *
+ * @details Campiona DIN in un ciclo stretto con la prelazione disabilitata, attendendo in
+ *    modo attivo le scadenze se period_ns è diverso da 0. capture_lock, con le interruzioni
+ *    disabilitate, è acquisito solo per la memorizzazione di ciascun campione, così che
+ *    le interruzioni restino servite durante l'acquisizione. Questa termina comunque dopo
+ *    capture_burst_us microsecondi.
+ */
+static void gpio_capture_burst(struct gpio_device *gpio_dev_ptr)
+{
+  u64 now, next, deadline;
+  unsigned int burst_us;
+  unsigned long flags;
+  int done = NO;
+
+  burst_us = min_t(unsigned int, READ_ONCE(capture_burst_us), GPIO_CAPTURE_BURST_MAX_US);
+
+  preempt_disable();
+  now = ktime_get_ns();
+  deadline = now + (u64)burst_us * NSEC_PER_USEC;
+  for(next = now; done == NO && now < deadline; now = ktime_get_ns()){
+    if(now < next)
+      continue;
+    next += gpio_dev_ptr->capture.period_ns;
+    spin_lock_irqsave(&gpio_dev_ptr->capture_lock, flags);
+      done = gpio_capture_sample(gpio_dev_ptr, now);
+    spin_unlock_irqrestore(&gpio_dev_ptr->capture_lock, flags);
+  }
+  preempt_enable();
+
+  spin_lock_irqsave(&gpio_dev_ptr->capture_lock, flags);
+    gpio_dev_ptr->capture_state = GPIO_CAPTURE_DONE;
+  spin_unlock_irqrestore(&gpio_dev_ptr->capture_lock, flags);
+}
+
+/**
+ * @brief Avvia un'acquisizione di DIN (GPIO_IOC_CAPTURE_START).
+ *
+ * @param gpio_dev_ptr è il puntatore al dispositivo.
+ * @param arg è il puntatore user-space alla struct gpio_capture.
+ *
+ * @return 0 oppure errno (-EBUSY se un'acquisizione è già in corso).
+ */
+static long gpio_ioctl_capture_start(struct gpio_device *gpio_dev_ptr, unsigned long arg)
+{
+  struct gpio_capture capture;
+  unsigned long flags;
+  long ret_status = 0;
+
+  if(copy_from_user(&capture, (void __user *)arg, sizeof(capture)) != 0)
+    return -EFAULT;
+  if(capture.mode > GPIO_CAPTURE_BURST || capture.reserved != 0 || capture.post_samples == 0 ||
+     capture.pre_samples > GPIO_CAPTURE_MAX || capture.post_samples > GPIO_CAPTURE_MAX - capture.pre_samples ||
+     capture.trigger_value & ~capture.trigger_mask)
+    return -EINVAL;
+  if(capture.mode == GPIO_CAPTURE_TIMER && capture.period_ns < GPIO_CAPTURE_MIN_PERIOD_NS)
+    return -EINVAL;
+
+  mutex_lock(&gpio_dev_ptr->capture_mutex);
+
+  if(!gpio_capture_buffer(gpio_dev_ptr)){
+    ret_status = -ENOMEM;
+    goto out;
+  }
+
+  spin_lock_irqsave(&gpio_dev_ptr->capture_lock, flags);
+    if(gpio_dev_ptr->capture_state == GPIO_CAPTURE_ARMED || gpio_dev_ptr->capture_state == GPIO_CAPTURE_TRIGGERED){
+      ret_status = -EBUSY;
+    } else {
+      gpio_dev_ptr->capture = capture;
+      gpio_dev_ptr->capture_state = GPIO_CAPTURE_ARMED;
+      gpio_dev_ptr->capture_pos = 0;
+      gpio_dev_ptr->capture_triggered = NO;
+      gpio_dev_ptr->capture_missed = 0;
+    }
+  spin_unlock_irqrestore(&gpio_dev_ptr->capture_lock, flags);
+  if(ret_status)
+    goto out;
+
+  if(capture.mode == GPIO_CAPTURE_BURST){
+    gpio_capture_burst(gpio_dev_ptr);
+    wake_up_interruptible(&gpio_dev_ptr->capture_wait);
+  } else {
+    hrtimer_start(&gpio_dev_ptr->capture_timer, ktime_get(), HRTIMER_MODE_ABS);
+  }
+
+out:
+  mutex_unlock(&gpio_dev_ptr->capture_mutex);
+  return ret_status;
+}
+
+/**
+ * @brief Restituisce lo stato dell'acquisizione (GPIO_IOC_CAPTURE_STATUS, GPIO_IOC_CAPTURE_WAIT).
+ *
+ * @param gpio_dev_ptr è il puntatore al dispositivo.
+ * @param arg è il puntatore user-space alla struct gpio_capture_status.
+ * @param wait è YES se occorre attendere la fine dell'acquisizione.
+ *
+ * @return 0 oppure errno.
+ *
+ * @details La frequenza ottenuta è calcolata dai timestamp del primo e dell'ultimo
+ *    campione valido.
+ */
+static long gpio_ioctl_capture_status(struct gpio_device *gpio_dev_ptr, unsigned long arg, int wait)
+{
+  struct gpio_capture_status status;
+  struct gpio_sample *first, *last;
+  unsigned long flags;
+  u32 size, skipped;
+  u64 span;
+
+  if(wait == YES && wait_event_interruptible(gpio_dev_ptr->capture_wait,
+     READ_ONCE(gpio_dev_ptr->capture_state) == GPIO_CAPTURE_DONE ||
+     READ_ONCE(gpio_dev_ptr->capture_state) == GPIO_CAPTURE_IDLE))
+    return -ERESTARTSYS;
+
+  memset(&status, 0, sizeof(status));
+  spin_lock_irqsave(&gpio_dev_ptr->capture_lock, flags);
+    status.state = gpio_dev_ptr->capture_state;
+    status.missed = gpio_dev_ptr->capture_missed;
+    status.trigger_index = 0xFFFFFFFF;
+    size = gpio_dev_ptr->capture.pre_samples + gpio_dev_ptr->capture.post_samples;
+    if(status.state != GPIO_CAPTURE_IDLE && gpio_dev_ptr->capture_pos > 0){
+      status.count = min(gpio_dev_ptr->capture_pos, size);
+      skipped = gpio_dev_ptr->capture_pos - status.count;
+      status.first = skipped % size;
+      // Il campione di trigger è sempre tra quelli validi: lo seguono al più post_samples - 1 campioni
+      if(gpio_dev_ptr->capture_triggered == YES)
+        status.trigger_index = gpio_dev_ptr->capture_trigger_pos - skipped;
+
+      first = &gpio_dev_ptr->capture_buf[status.first];
+      last = &gpio_dev_ptr->capture_buf[(gpio_dev_ptr->capture_pos - 1) % size];
+      span = last->timestamp - first->timestamp;
+      if(span)
+        status.rate_hz = div64_u64((u64)(status.count - 1) * NSEC_PER_SEC, span);
+    }
+  spin_unlock_irqrestore(&gpio_dev_ptr->capture_lock, flags);
+
+  return copy_to_user((void __user *)arg, &status, sizeof(status)) ? -EFAULT : 0;
+}
+
+/**
+ * @brief Chiamata dal kernel quando un processo invoca una ioctl sul device file.
+ *
+ * @param filp è il puntatore ad una struttura struct file che viene creata per ogni processo
+ *    che apre il device file.
+ * @param cmd è il comando richiesto (si veda gpiodrv.h).
+ * @param arg è l'argomento del comando, un puntatore nello spazio user.
+ *
+ * @return
+ *    - 0 se il comando è andato a buon fine.
+ *    - errno se il comando non è andato a buon fine (-ENOTTY per comandi sconosciuti).
+ */
+long gpio_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+  struct gpio_subscriber *sub = filp->private_data;
+  struct gpio_filter filter;
+
+  switch(cmd){
+    case GPIO_IOC_BATCH:
+      return gpio_ioctl_batch(sub->dev, arg);
+    case GPIO_IOC_SET_FILTER:
+      return gpio_ioctl_set_filter(sub, arg);
+    case GPIO_IOC_GET_FILTER:
+      mutex_lock(&sub->dev->subs_lock);
+        filter = sub->filter;
+      mutex_unlock(&sub->dev->subs_lock);
+      return copy_to_user((void __user *)arg, &filter, sizeof(filter)) ? -EFAULT : 0;
+    case GPIO_IOC_PATTERN_LOAD:
+      return gpio_ioctl_pattern_load(sub->dev, arg);
+    case GPIO_IOC_PATTERN_STOP:
+      gpio_pattern_stop(sub->dev);
+      return 0;
+    case GPIO_IOC_PATTERN_STATUS:
+      return gpio_ioctl_pattern_status(sub->dev, arg);
+    case GPIO_IOC_CAPTURE_START:
+      return gpio_ioctl_capture_start(sub->dev, arg);
+    case GPIO_IOC_CAPTURE_STOP:
+      gpio_capture_stop(sub->dev);
+      return 0;
+    case GPIO_IOC_CAPTURE_STATUS:
+      return gpio_ioctl_capture_status(sub->dev, arg, NO);
+    case GPIO_IOC_CAPTURE_WAIT:
+      return gpio_ioctl_capture_status(sub->dev, arg, YES);
+    default:
+      return -ENOTTY;
   }
+}
 
-  // Restituisce informazioni riguardante la parte relativa alle interruzioni
-  // In particolare ricerca il primo tag interrupts e ne restituisce l'irq
-  // Il secondo parametro indica quale tag interrupts considerare (se ce ne sono
-  // più di uno). In questo caso viene considerato il primo
-  // Esempio: interrupts = <0 29 4> -> irq_of_parse_and_map restituirà 29
-  gpio_device_ptr->irq = irq_of_parse_and_map(op->dev.of_node, 0);
+/**
+ * @brief Campiona la periferica ed accoda il risultato per il thread di interruzione.
+ *
+ * @param gpio_dev_ptr è il puntatore al dispositivo da campionare.
+ * @param polled è YES se il campionamento è effettuato dalla callback di polling.
+ * @param timestamp è l'istante, in nanosecondi, di ingresso nella ISR o nella callback.
+ *
+ * @return la maschera delle interruzioni pendenti trovate nel registro ISR (0 se
+ *    non ve ne sono, nel qual caso non viene accodato nulla).
+ *
+ * @details Se la coda dei campionamenti è piena le interruzioni sono comunque azzerate
+ *    nella periferica ed il campionamento viene contato come perso.
+ *
+ * @note Deve essere chiamata con irq_lock acquisito: ISR e callback di polling sono
+ *    gli unici produttori della coda dei campionamenti.
+ */
+static uint32_t gpio_take_snapshot(struct gpio_device *gpio_dev_ptr, int polled, u64 timestamp)
+{
+  struct gpio_snapshot snap;
 
-  /********************* Allocazione e mapping della memoria I/O *********************/
-  // Richiede l'allocazione di una certa area di memoria di grandezza resource_size(&gpio_dev_t_ptr->res)
-  // per il driver DRIVER_NAME
-  // La macro resource_size restituisce la dimensione del segmento fisico associato alla periferica
-  // Esempio: reg = <0x43c00000 0x10000> -> resource_size restituirà 0x10000
-  if(!request_mem_region(gpio_device_ptr->res.start, resource_size(&gpio_device_ptr->res), DRIVER_NAME)){
-    printk(KERN_INFO "Cannot gain memory in exclusive way\n");
-    if(gpio_device_ptr->irq != 0){
-      free_irq(gpio_device_ptr->irq, NULL);
-    }
-    device_destroy(gpio_class, gpio_device_ptr->gpiox_dev_number);
-    mutex_lock(&minor_lock);
-      idr_remove(&gpio_idr, ret_status);
-    mutex_unlock(&minor_lock);
-    kfree(gpio_device_ptr);
-    return -ENOMEM;
+  snap.pending = gpio_reg_read(gpio_dev_ptr, GPIO_ISR_OFFSET);
+  if(!snap.pending)
+    return 0;
+
+  // Acknoledgement delle interruzioni pendenti
+  gpio_reg_write(gpio_dev_ptr, GPIO_ICL_OFFSET, snap.pending);
+
+  if(kfifo_is_full(&gpio_dev_ptr->snapshots)){
+    gpio_dev_ptr->snapshot_lost++;
+    return snap.pending;
   }
 
-  size = gpio_device_ptr->res.end - gpio_device_ptr->res.start + 1;
+  snap.timestamp = timestamp;
+  snap.value = gpio_reg_read(gpio_dev_ptr, GPIO_DIN_OFFSET);
+  snap.lost = gpio_dev_ptr->snapshot_lost;
+  snap.polled = polled;
+  gpio_dev_ptr->snapshot_lost = 0;
 
-  // Effettua il mapping tra il segmento di memoria fisico associato alla periferica
-  // e lo spazio virtuale del processo
-  // NOTA: la combinazione ioremap + of_address_to_resource è equivalente alla chiamata
-  //       di of_iomap(res.start, resource_size(&res))
-  gpio_device_ptr->base_addr = ioremap(gpio_device_ptr->res.start, size);
-  if (!gpio_device_ptr->base_addr) {
-    printk(KERN_INFO "Cannot map virtual address\n");
-    release_mem_region(gpio_device_ptr->res.start, resource_size(&gpio_device_ptr->res));
-    device_destroy(gpio_class, gpio_device_ptr->gpiox_dev_number);
-    mutex_lock(&minor_lock);
-      idr_remove(&gpio_idr, ret_status);
-    mutex_unlock(&minor_lock);
-    kfree(gpio_device_ptr);
-    return -ENOMEM;
+  kfifo_put(&gpio_dev_ptr->snapshots, snap);
+  return snap.pending;
+}
+
+/**
+ * @brief Scrive un evento nel ring del dispositivo.
+ *
+ * @param gpio_dev_ptr è il puntatore al dispositivo.
+ * @param event è l'evento da scrivere (i campi seq ed overflow sono assegnati qui).
+ * @param lost sono i campionamenti persi dal gestore di primo livello prima dell'evento.
+ *
+ * @details Se il ring è pieno l'evento viene scartato ed il conteggio degli eventi persi
+ *    viene riportato nel primo evento scritto successivamente.
+ */
+static void gpio_ring_put(struct gpio_device *gpio_dev_ptr, struct gpio_event event, u32 lost)
+{
+  gpio_dev_ptr->overflow += lost;
+
+  // Lo spazio libero dipende dall'indice tail scritto dal consumatore: un valore
+  // incoerente fa apparire il ring pieno ma non può far scrivere fuori dal ring
+  if(gpio_dev_ptr->ring_head - smp_load_acquire(&gpio_dev_ptr->ring->tail) >= GPIO_RING_ENTRIES){
+    gpio_dev_ptr->overflow++;
+    gpio_dev_ptr->overflows++;
+    return;
   }
 
-  /*************** Richiesta e registrazione di un interrupt handler *****************/
-  // La registrazione avviene solo se il dispositivo supporta le interruzioni
-  if(gpio_device_ptr->irq != 0){
-    printk(KERN_INFO "[GPIO driver] Gestione dell'interrupt line: %d\n", gpio_device_ptr->irq);
+  event.overflow = gpio_dev_ptr->overflow;
+  event.seq = gpio_dev_ptr->seq++;
+  gpio_dev_ptr->overflow = 0;
 
-    // Associa nell'idr la coppia IRQ -> base_addr
-    ret_status = idr_alloc(&irq_idr, gpio_device_ptr->base_addr, gpio_device_ptr->irq, gpio_device_ptr->irq+1, GFP_KERNEL);
-    printk(KERN_INFO "[GPIO driver] Base address memorizzato con ID: %i\n", ret_status);
+  // L'evento deve essere visibile prima dell'avanzamento di head
+  gpio_dev_ptr->ring_data[gpio_dev_ptr->ring_head & (GPIO_RING_ENTRIES - 1)] = event;
+  smp_store_release(&gpio_dev_ptr->ring->head, ++gpio_dev_ptr->ring_head);
+  gpio_dev_ptr->ring_events++;
+  gpio_dev_ptr->ring_woken = YES;
+}
 
-    if (ret_status == -ENOSPC) {
-      printk(KERN_WARNING "Non è possibile allocare nell'idr il puntatore alla zona fisica di memoria!");
-      release_mem_region(gpio_device_ptr->res.start, resource_size(&gpio_device_ptr->res));
-      device_destroy(gpio_class, gpio_device_ptr->gpiox_dev_number);
-      mutex_lock(&minor_lock);
-        idr_remove(&gpio_idr, ret_status);
-      mutex_unlock(&minor_lock);
-      kfree(gpio_device_ptr);
-      return -EINVAL;
-    }
+/**
+ * @brief Verifica se un evento soddisfa il filtro di un file aperto.
+ *
+ * @param sub è il file aperto.
+ * @param event è l'evento da valutare.
+ * @param last_value è lo stato dei pin all'evento precedente del dispositivo.
+ *
+ * @return YES se l'evento va consegnato al file, NO altrimenti.
+ */
+static int gpio_filter_match(struct gpio_subscriber *sub, struct gpio_event *event, u32 last_value)
+{
+  struct gpio_filter *filter = &sub->filter;
+  u32 edges = 0;
+
+  // La periferica rileva i fronti di salita; quelli di discesa si ricavano da DIN
+  if(filter->edges & GPIO_EDGE_RISING)
+    edges |= event->pending;
+  if(filter->edges & GPIO_EDGE_FALLING)
+    edges |= last_value & ~event->value;
+
+  if(!(edges & filter->mask))
+    return NO;
+  if((event->value & filter->value_mask) != filter->value_match)
+    return NO;
+  if(filter->min_interval_ns && sub->last_ns && event->timestamp - sub->last_ns < filter->min_interval_ns)
+    return NO;
+  return YES;
+}
 
-    // Registrazione di un ISR per l'irq numero gpio_device_ptr->irq
-    ret_status = request_irq(gpio_device_ptr->irq, (irq_handler_t) gpio_isr, 0, DRIVER_NAME, NULL);
-    if(ret_status){
-      printk(KERN_WARNING "Cannot get interrupt line %d\n", gpio_device_ptr->irq);
-      release_mem_region(gpio_device_ptr->res.start, resource_size(&gpio_device_ptr->res));
-      device_destroy(gpio_class, gpio_device_ptr->gpiox_dev_number);
-      mutex_lock(&minor_lock);
-        idr_remove(&gpio_idr, ret_status);
-      mutex_unlock(&minor_lock);
-      kfree(gpio_device_ptr);
-      return ret_status;
+/**
+ * @brief Consegna un evento al ring ed ai file aperti il cui filtro è soddisfatto.
+ *
+ * @param gpio_dev_ptr è il puntatore al dispositivo che ha generato l'evento.
+ * @param snap è il campionamento dal quale costruire l'evento.
+ *
+ * @details Ogni file riceve la propria copia dell'evento, con numero di sequenza
+ *    proprio. Se la coda di un file è piena l'evento viene scartato per quel file ed il
+ *    conteggio degli eventi persi viene riportato nel primo evento accodato successivamente,
+ *    insieme ai campionamenti persi dal gestore di primo livello. I file attraverso i
+ *    quali è mappato il ring ricevono gli eventi solo dal ring.
+ *
+ * @note Chiamata dal thread di interruzione, unico produttore delle code, con subs_lock
+ *    acquisito.
+ */
+static void gpio_queue_event(struct gpio_device *gpio_dev_ptr, struct gpio_snapshot *snap)
+{
+  struct gpio_subscriber *sub;
+  struct gpio_event event;
+
+  event.timestamp = snap->timestamp;
+  event.pending = snap->pending;
+  event.value = snap->value;
+  trace_gpiodrv_isr(MINOR(gpio_dev_ptr->gpiox_dev_number), event.pending, event.value, event.timestamp, snap->polled);
+
+  if(atomic_read(&gpio_dev_ptr->ring_users) > 0)
+    gpio_ring_put(gpio_dev_ptr, event, snap->lost);
+
+  // Statistiche sugli intervalli tra eventi consecutivi del dispositivo
+  if(gpio_dev_ptr->last_event_ns && event.timestamp > gpio_dev_ptr->last_event_ns){
+    u64 interval = event.timestamp - gpio_dev_ptr->last_event_ns;
+
+    gpio_dev_ptr->intervals++;
+    gpio_dev_ptr->interval_sum_ns += interval;
+    if(!gpio_dev_ptr->interval_min_ns || interval < gpio_dev_ptr->interval_min_ns)
+      gpio_dev_ptr->interval_min_ns = interval;
+    if(interval > gpio_dev_ptr->interval_max_ns)
+      gpio_dev_ptr->interval_max_ns = interval;
+  }
+  gpio_dev_ptr->last_event_ns = event.timestamp;
+  // I fronti persi nella periferica sono contati una sola volta per il dispositivo
+  gpio_dev_ptr->overflows += snap->lost;
+
+  list_for_each_entry(sub, &gpio_dev_ptr->subscribers, node){
+    if(atomic_read(&sub->ring_maps) > 0)
+      continue;
+
+    sub->overflow += snap->lost;
+    if(gpio_filter_match(sub, &event, gpio_dev_ptr->last_value) == NO)
+      continue;
+
+    if(kfifo_is_full(&sub->events)){
+      sub->overflow++;
+      gpio_dev_ptr->overflows++;
+      continue;
     }
 
-    // Abilita le interruzioni nella periferica
-    iowrite32(INT_ENABLE, gpio_device_ptr->base_addr + (GPIO_IER_OFFSET/4));
+    event.overflow = sub->overflow;
+    event.seq = sub->seq++;
+    sub->overflow = 0;
+    sub->last_ns = event.timestamp;
+    sub->wake = YES;
+    kfifo_put(&sub->events, event);
   }
 
-  printk(KERN_INFO "[GPIO driver] Allocazione e mapping di memoria I/O avvenuta correttamente\n");
-  printk(KERN_INFO "[GPIO driver] Probing completato!\n");
-  return 0;
+  gpio_dev_ptr->last_value = event.value;
 }
 
 /**
- * @brief Funzione di rimozione.
- *
- * @details Chiamata dal kernel quando un dispositivo non è più presente nel sistema.
- *    Dealloca tutte le strutture dati allocate in precedenza per gestire il particolare device.
+ * @brief Aggiorna la stima del tasso di interruzioni del dispositivo.
  *
- * @param op struttura che contiene informazioni utili all'deallocazione del device
+ * @param gpio_dev_ptr è il puntatore al dispositivo che ha generato l'interruzione.
  *
  * @return
- *    - 0 se il procedimento di rimozione è andato a buon fine.
- *    - errno se il procedimento di probing non è andato a buon fine.
+ *    - YES se nella finestra corrente sono arrivate più di poll_threshold interruzioni.
+ *    - NO altrimenti.
  */
-static int gpio_remove(struct platform_device *op)
+static int gpio_rate_exceeded(struct gpio_device *gpio_dev_ptr)
 {
-  struct gpio_device *gpio_device_ptr;
-  int minor_number;
-
-  gpio_device_ptr = platform_get_drvdata(op);
-  minor_number = MINOR(gpio_device_ptr->gpiox_dev_number);
+  ktime_t now = ktime_get();
 
-  printk(KERN_INFO "[GPIO driver] Rimozione strutture dati per il device %i\n", minor_number);
+  // Il passaggio al polling richiede una linea di interruzione (si veda gpio_poll_tick)
+  if(poll_threshold == 0 || gpio_dev_ptr->irq == 0)
+    return NO;
 
-  iounmap(gpio_device_ptr->base_addr);
-  release_mem_region(gpio_device_ptr->res.start, resource_size(&gpio_device_ptr->res));
-  if(gpio_device_ptr->irq != 0){
-    free_irq(gpio_device_ptr->irq, NULL);
+  // Ad ogni nuova finestra il conteggio riparte da zero
+  if(ktime_to_us(ktime_sub(now, gpio_dev_ptr->window_start)) >= poll_window_us){
+    gpio_dev_ptr->window_start = now;
+    gpio_dev_ptr->window_events = 0;
   }
-  device_destroy(gpio_class, gpio_device_ptr->gpiox_dev_number);
-  mutex_lock(&minor_lock);
-    idr_remove(&gpio_idr, minor_number);
-  mutex_unlock(&minor_lock);
-  kfree(gpio_device_ptr);
-  return 0;
+
+  return (++gpio_dev_ptr->window_events > poll_threshold ? YES : NO);
 }
 
 /**
- * @brief Chiamata dal kernel quando un processo apre il device file relativo alla periferica.
+ * @brief Gestore di primo livello di una singola periferica.
  *
- * @param inode è l'inode relativo al device file. Contiene il major ed il minor number
- *    alla particolare periferica.
- * @param filp è il puntatore ad una struttura struct file che viene creata per ogni processo
- *    che apre il device file.
+ * @param gpio_dev_ptr è il puntatore al dispositivo da servire.
+ * @param start è l'istante di ingresso nella ISR della linea, usato come timestamp
+ *    dell'evento. La durata del gestore è misurata dall'ingresso in questa funzione:
+ *    in modalità aggregata non comprende il servizio delle periferiche precedenti.
  *
  * @return
- *    - 0 se il procedimento di apertura è andato a buon fine.
- *    - errno se il procedimento di apertura non è andato a buon fine.
+ *    - IRQ_WAKE_THREAD se è stato accodato un campionamento per il thread di interruzione.
+ *    - IRQ_NONE se la periferica non ha interruzioni pendenti (la linea può essere
+ *      condivisa ed essere stata attivata da un'altra periferica).
+ *
+ * @details Campiona ed azzera il registro ISR e campiona DIN. Se il tasso di interruzioni
+ *    supera la soglia poll_threshold maschera le interruzioni della periferica ed affida
+ *    il campionamento successivo alla callback di polling gpio_poll_tick.
  */
-int gpio_open(struct inode *inode, struct file *filp)
+irqreturn_t gpio_bank_isr(struct gpio_device *gpio_dev_ptr, ktime_t start)
 {
-  struct gpio_device* gpio_dev_ptr;
+  ktime_t bank_start = ktime_get();
+  uint32_t pending_interrupt = 0;
+  u64 elapsed;
+
+  // L'ingresso nella ISR precede, nella traccia, le letture di ISR e DIN
+  if(unlikely(gpio_dev_ptr->reg_trace))
+    gpio_reg_trace(gpio_dev_ptr, GPIO_TRACE_IRQ, 0, 0, ktime_to_ns(start));
+
+  spin_lock(&gpio_dev_ptr->irq_lock);
+    // In polling la periferica è mascherata e non può aver attivato la linea:
+    // le interruzioni pendenti sono raccolte dalla callback di polling
+    if(gpio_dev_ptr->polling == NO)
+      pending_interrupt = gpio_take_snapshot(gpio_dev_ptr, NO, ktime_to_ns(start));
+
+    if(pending_interrupt){
+      gpio_dev_ptr->irq_events++;
+
+      // Oltre la soglia si mascherano le interruzioni della periferica e si passa al polling
+      if(gpio_rate_exceeded(gpio_dev_ptr) == YES){
+        gpio_reg_write(gpio_dev_ptr, GPIO_IER_OFFSET, INT_DISABLE);
+        gpio_dev_ptr->polling = YES;
+        gpio_dev_ptr->idle_ticks = 0;
+        hrtimer_start(&gpio_dev_ptr->poll_timer, ns_to_ktime((u64)poll_interval_us * NSEC_PER_USEC), HRTIMER_MODE_REL);
+      }
+
+      elapsed = ktime_to_ns(ktime_sub(ktime_get(), bank_start));
+      gpio_dev_ptr->hardirq_ns += elapsed;
+      gpio_dev_ptr->hardirq_window_ns += elapsed;
+      gpio_dev_ptr->hardirq_window_events++;
+      if(elapsed > gpio_dev_ptr->hardirq_max_ns)
+        gpio_dev_ptr->hardirq_max_ns = elapsed;
+      if(!gpio_dev_ptr->hardirq_min_ns || elapsed < gpio_dev_ptr->hardirq_min_ns)
+        gpio_dev_ptr->hardirq_min_ns = elapsed;
+    }
+  spin_unlock(&gpio_dev_ptr->irq_lock);
 
-  printk(KERN_INFO "[GPIO driver] Apertura device file...\n");
-  printk(KERN_INFO "[GPIO driver] Minor number associato alla periferica %i\n", iminor(inode));
+  return (pending_interrupt ? IRQ_WAKE_THREAD : IRQ_NONE);
+}
 
-  mutex_lock(&minor_lock);
-    // Interroga la struttura dati idr per ottenere il puntatore al device identificato dal suo minor number
-    // Il minor number è presente nell'inode del device file
-    gpio_dev_ptr = idr_find(&gpio_idr, iminor(inode));
-  mutex_unlock(&minor_lock);
+/**
+ * @brief Consegna gli eventi di una singola periferica (parte in thread).
+ *
+ * @param gpio_dev_ptr è il puntatore al dispositivo da servire.
+ *
+ * @details Svuota in un'unica passata la coda dei campionamenti prodotti dalla ISR e
+ *    dalla callback di polling, scarta quelli che non riportano interruzioni pendenti,
+ *    smista ai pin registrati presso gpiolib le relative interruzioni, consegna i
+ *    campionamenti rimanenti come eventi ai file il cui filtro è soddisfatto e risveglia
+ *    una sola volta, al termine della passata, i soli lettori che hanno ricevuto eventi.
+ *    Durante la sua esecuzione la ISR continua ad accodare campionamenti, che vengono
+ *    consegnati nella stessa passata oppure nella successiva.
+ */
+void gpio_bank_thread(struct gpio_device *gpio_dev_ptr)
+{
+  struct gpio_subscriber *sub;
+  struct gpio_snapshot snap;
+  u64 delivered = 0;
+
+  mutex_lock(&gpio_dev_ptr->subs_lock);
+    // Il thread è l'unico consumatore della coda dei campionamenti
+    while(kfifo_get(&gpio_dev_ptr->snapshots, &snap)){
+      if(!snap.pending)
+        continue;
+      gpio_irq_dispatch(gpio_dev_ptr, snap.pending);
+      gpio_queue_event(gpio_dev_ptr, &snap);
+      delivered++;
+    }
 
-  if (!gpio_dev_ptr) {
-    printk(KERN_WARNING "[GPIO driver] Puntatore alla struttura gpio_device non trovato!\n");
-    return -ENODEV;
-  }
+    gpio_dev_ptr->thread_runs++;
+    if(delivered > gpio_dev_ptr->thread_batch_max)
+      gpio_dev_ptr->thread_batch_max = delivered;
 
-  // Associa il puntatore appena ottenuto alla struttura file creata dal kernel
-  filp->private_data = gpio_dev_ptr;
-  return 0;
+    // Sblocca, una sola volta per passata, i soli file che hanno ricevuto eventi
+    list_for_each_entry(sub, &gpio_dev_ptr->subscribers, node){
+      if(sub->wake == YES || (gpio_dev_ptr->ring_woken == YES && atomic_read(&sub->ring_maps) > 0))
+        wake_up_interruptible(&sub->wait);
+      sub->wake = NO;
+    }
+    gpio_dev_ptr->ring_woken = NO;
+  mutex_unlock(&gpio_dev_ptr->subs_lock);
 }
 
 /**
- * @brief Chiamata dal kernel quando il device file viene chiuso da tutti i processi che
- *    lo avevano in precedenza aperto.
+ * @brief ISR della periferica.
  *
- * @param inode è l'inode relativo al device file. Contiene il major ed il minor number associato
- *    associato al driver della periferica.
- * @param filp è il puntatore ad una struttura struct file che viene creata per ogni processo
- *    che apre il device file.
+ * @param irq è l'irq number della linea di interruzione.
+ * @param dev_id è il puntatore al dispositivo, passato alla request_threaded_irq.
  *
  * @return
- *    - 0 se il procedimento di release è andato a buon fine.
- *    - errno se il procedimento di release non è andato a buon fine.
+ *    - IRQ_WAKE_THREAD se è stato accodato un campionamento per il thread di interruzione.
+ *    - IRQ_NONE se la periferica non ha interruzioni pendenti.
+ *
+ * @details Gira in contesto di interruzione e fa il minimo indispensabile (si veda
+ *    gpio_bank_isr). La linea è richiesta con IRQF_SHARED: più periferiche possono
+ *    condividere la stessa linea, ciascuna con la propria ISR.
  */
-int gpio_release(struct inode *inode, struct file *filp)
+irqreturn_t gpio_isr(int irq, void *dev_id)
 {
-  printk(KERN_INFO "[GPIO driver] Rilascio device file\n");
-  return 0;
+  return gpio_bank_isr(dev_id, ktime_get());
 }
 
 /**
- * @brief Chiamata dal kernel ogni volta che un processo legge dal device file. La lettura è bloccante.
+ * @brief Thread di interruzione della periferica.
  *
- * @param filp è il puntatore ad una struttura struct file che viene creata per ogni processo
- *    che apre il device file.
- * @param buf è un puntatore ad un buffer nel quale il processo user-space chiamante andrà a
- *    leggere una volta terminata l'operazione.
- * @param count è la dimensione del buffer buf.
- * @param offp è lo spiazzamento all'interno del file.
+ * @param irq è l'irq number della linea di interruzione.
+ * @param dev_id è il puntatore al dispositivo, passato alla request_threaded_irq.
+ *
+ * @return IRQ_HANDLED.
+ */
+irqreturn_t gpio_isr_thread(int irq, void *dev_id)
+{
+  gpio_bank_thread(dev_id);
+  return IRQ_HANDLED;
+}
+
+/**
+ * @brief ISR di una linea di interruzione in modalità aggregata.
+ *
+ * @param irq è l'irq number della linea di interruzione.
+ * @param dev_id è il puntatore alla linea, passato alla request_threaded_irq.
  *
  * @return
- *    - count se il procedimento di lettura è andato a buon fine.
- *    - errno se il procedimento di lettura non è andato a buon fine.
+ *    - IRQ_WAKE_THREAD se almeno una periferica aveva interruzioni pendenti.
+ *    - IRQ_NONE altrimenti.
  *
- * @note
- *    L'accesso al buffer non può essere diretto ma mediato attraverso la funzione
- *    copy_to_user per motivi di portabilità.
+ * @details Serve in un'unica passata tutte le periferiche collegate alla linea.
  */
-ssize_t gpio_read(struct file *filp, char __user *buf, size_t count, loff_t *offp)
+irqreturn_t gpio_line_isr(int irq, void *dev_id)
 {
-  int ret_status;
-  unsigned char valore;
-  struct gpio_device* gpio_dev_t_ptr;
+  struct gpio_irq_line *line = dev_id;
+  struct gpio_device *gpio_dev_ptr;
+  irqreturn_t ret = IRQ_NONE;
+  ktime_t start = ktime_get();
+
+  rcu_read_lock();
+    list_for_each_entry_rcu(gpio_dev_ptr, &line->banks, line_node)
+      if(gpio_bank_isr(gpio_dev_ptr, start) == IRQ_WAKE_THREAD)
+        ret = IRQ_WAKE_THREAD;
+  rcu_read_unlock();
+
+  return ret;
+}
+
+/**
+ * @brief Thread di interruzione di una linea in modalità aggregata.
+ *
+ * @param irq è l'irq number della linea di interruzione.
+ * @param dev_id è il puntatore alla linea, passato alla request_threaded_irq.
+ *
+ * @return IRQ_HANDLED.
+ *
+ * @details Il lock della linea è un mutex (e non RCU) perchè handle_nested_irq può
+ *    eseguire gestori che si sospendono.
+ */
+irqreturn_t gpio_line_thread(int irq, void *dev_id)
+{
+  struct gpio_irq_line *line = dev_id;
+  struct gpio_device *gpio_dev_ptr;
 
-  printk(KERN_INFO "[GPIO driver] Richiesta di lettura\n");
+  mutex_lock(&line->lock);
+    list_for_each_entry(gpio_dev_ptr, &line->banks, line_node)
+      gpio_bank_thread(gpio_dev_ptr);
+  mutex_unlock(&line->lock);
 
-  gpio_dev_t_ptr = filp->private_data;
+  return IRQ_HANDLED;
+}
 
-  printk(KERN_DEBUG "Process %i (%s) going to sleep\n", current->pid, current->comm);
-  // Attende sulla wait queue il verificarsi di un dato evento, indicato dalla
-  // condizione nel secondo parametro
-  ret_status = wait_event_interruptible(rdqueue, can_read == YES);
-  if(ret_status != 0){
-    printk(KERN_DEBUG "Qualche segnale ha interrotto il sonno. Uscita dalla funzione...");
-    return -ERESTARTSYS;
+/**
+ * @brief Registra i gestori delle interruzioni di una periferica.
+ *
+ * @param gpio_dev_ptr è il puntatore al dispositivo.
+ *
+ * @return
+ *    - 0 se la registrazione è andata a buon fine.
+ *    - errno se la registrazione non è andata a buon fine.
+ *
+ * @details Per default ogni periferica registra la propria ISR sulla linea, in modalità
+ *    condivisa. Con irq_aggregate la prima periferica collegata ad una linea registra
+ *    un'unica ISR per la linea e le successive si aggiungono all'elenco che essa serve.
+ */
+static int gpio_irq_request(struct gpio_device *gpio_dev_ptr)
+{
+  struct gpio_irq_line *line;
+  int ret_status;
+
+  // gpio_isr gira in contesto di interruzione e si limita a campionare la periferica,
+  // gpio_isr_thread costruisce gli eventi e risveglia i lettori in un thread del kernel.
+  // IRQF_ONESHOT non serve: la ISR azzera le interruzioni pendenti nella periferica
+  // e può quindi continuare a campionare mentre il thread è in esecuzione.
+  // Il dispositivo è passato come dev_id: i gestori lo ricevono senza doverlo cercare
+  if(!irq_aggregate){
+    gpio_dev_ptr->irq_cookie = gpio_dev_ptr;
+    return request_threaded_irq(gpio_dev_ptr->irq, gpio_isr, gpio_isr_thread, IRQF_SHARED, DRIVER_NAME, gpio_dev_ptr);
   }
-  printk(KERN_DEBUG "Awoken %i (%s)\n", current->pid, current->comm);
 
-  // Lettura del dato alla periferica
-  valore = ioread8(gpio_dev_t_ptr->base_addr + (GPIO_DIN_OFFSET/4));
+  mutex_lock(&irq_lines_lock);
+    list_for_each_entry(line, &irq_lines, node)
+      if(line->irq == gpio_dev_ptr->irq)
+        break;
+
+    if(&line->node == &irq_lines){
+      line = kzalloc(sizeof(*line), GFP_KERNEL);
+      if(!line){
+        mutex_unlock(&irq_lines_lock);
+        return -ENOMEM;
+      }
+      line->irq = gpio_dev_ptr->irq;
+      INIT_LIST_HEAD(&line->banks);
+      mutex_init(&line->lock);
+
+      ret_status = request_threaded_irq(line->irq, gpio_line_isr, gpio_line_thread, IRQF_SHARED, DRIVER_NAME, line);
+      if(ret_status){
+        kfree(line);
+        mutex_unlock(&irq_lines_lock);
+        return ret_status;
+      }
+      list_add(&line->node, &irq_lines);
+    }
 
-  spin_lock_irq(&read_lock);
-    can_read = NO;
-  spin_unlock_irq(&read_lock);
+    mutex_lock(&line->lock);
+      list_add_tail_rcu(&gpio_dev_ptr->line_node, &line->banks);
+    mutex_unlock(&line->lock);
+    gpio_dev_ptr->line = line;
+    gpio_dev_ptr->irq_cookie = line;
+  mutex_unlock(&irq_lines_lock);
 
-  // Passaggio al processo user-space del dato appena letto
-  if(copy_to_user(buf, &valore, 1) != 0){
-    printk(KERN_WARNING "[GPIO driver] Problema nella copia dei dati al processo user-space!\n");
-    return -EFAULT;
+  return 0;
+}
+
+/**
+ * @brief Rimuove i gestori delle interruzioni di una periferica.
+ *
+ * @param gpio_dev_ptr è il puntatore al dispositivo.
+ *
+ * @details Al ritorno nessun gestore sta operando sulla periferica. In modalità
+ *    aggregata la ISR della linea viene rimossa con l'ultima periferica collegata.
+ */
+static void gpio_irq_release(struct gpio_device *gpio_dev_ptr)
+{
+  struct gpio_irq_line *line = gpio_dev_ptr->line;
+
+  if(!line){
+    free_irq(gpio_dev_ptr->irq, gpio_dev_ptr);
+    return;
   }
 
-  printk(KERN_INFO "[GPIO driver] Carettere letto: %08x\n", valore);
-  return count;
+  mutex_lock(&irq_lines_lock);
+    mutex_lock(&line->lock);
+      list_del_rcu(&gpio_dev_ptr->line_node);
+    mutex_unlock(&line->lock);
+
+    if(list_empty(&line->banks)){
+      free_irq(line->irq, line);
+      list_del(&line->node);
+      mutex_destroy(&line->lock);
+      kfree(line);
+    }
+  mutex_unlock(&irq_lines_lock);
+
+  // Attende che la ISR della linea abbia smesso di usare la periferica
+  synchronize_rcu();
+  gpio_dev_ptr->line = NULL;
 }
 
 /**
- * @brief Chiamata dal kernel ogni volta che un processo scrive sul device file.
+ * @brief Callback dell'hrtimer di polling.
  *
- * @param filp è il puntatore ad una struttura struct file che viene creata per ogni processo
- *    che apre il device file.
- * @param buf è un puntatore ad un buffer nel quale il processo user-space ha inserito
- *    i dati da scrivere.
- * @param count è la dimensione del buffer buf.
- * @param offp è lo spiazzamento all'interno del file.
+ * @param timer è il puntatore all'hrtimer del dispositivo in modalità polling.
  *
  * @return
- *    - count se il procedimento di scrittura è andato a buon fine.
- *    - errno se il procedimento di scrittura non è andato a buon fine.
+ *    - HRTIMER_RESTART se il dispositivo resta in modalità polling.
+ *    - HRTIMER_NORESTART se il dispositivo torna a lavorare ad interruzioni.
  *
- * @note
- *    L'accesso alla periferica è gestito attraverso uno spinlock per garantire
- *    mutua esclusione.
+ * @details Campiona il registro ISR servendo al più poll_budget eventi, che vengono
+ *    consegnati ai lettori dal thread di interruzione del dispositivo. Dopo poll_idle_ticks
+ *    campionamenti consecutivi senza eventi riabilita le interruzioni della periferica.
+ *    Un evento arrivato tra l'ultimo campionamento e la riabilitazione resta pendente
+ *    nella periferica e genera immediatamente un'interruzione.
  */
-ssize_t gpio_write(struct file *filp, const char __user *buf, size_t count, loff_t *offp)
+static enum hrtimer_restart gpio_poll_tick(struct hrtimer *timer)
 {
-  unsigned char valore;
-  struct gpio_device* gpio_dev_t_ptr;
+  struct gpio_device *gpio_dev_ptr = container_of(timer, struct gpio_device, poll_timer);
+  unsigned int budget, delivered = 0;
   unsigned long flags;
+  u64 now = ktime_get_ns();
+
+  spin_lock_irqsave(&gpio_dev_ptr->irq_lock, flags);
+    for(budget = poll_budget; budget > 0; budget--){
+      if(!gpio_take_snapshot(gpio_dev_ptr, YES, now))
+        break;
+      delivered++;
+    }
+    gpio_dev_ptr->poll_events += delivered;
+
+    if(delivered){
+      gpio_dev_ptr->idle_ticks = 0;
+    } else if(++gpio_dev_ptr->idle_ticks >= poll_idle_ticks){
+      // Il traffico si è esaurito: si torna a lavorare ad interruzioni
+      gpio_dev_ptr->polling = NO;
+      gpio_dev_ptr->window_start = ktime_get();
+      gpio_dev_ptr->window_events = 0;
+      gpio_ier_apply(gpio_dev_ptr);
+      spin_unlock_irqrestore(&gpio_dev_ptr->irq_lock, flags);
+      return HRTIMER_NORESTART;
+    }
+  spin_unlock_irqrestore(&gpio_dev_ptr->irq_lock, flags);
 
-  printk(KERN_INFO "[GPIO driver] Richiesta di scrittura\n");
+  // In polling le interruzioni sono mascherate: il thread viene risvegliato esplicitamente
+  if(delivered)
+    irq_wake_thread(gpio_dev_ptr->irq, gpio_dev_ptr->irq_cookie);
 
-  gpio_dev_t_ptr = filp->private_data;
+  hrtimer_forward_now(timer, ns_to_ktime((u64)poll_interval_us * NSEC_PER_USEC));
+  return HRTIMER_RESTART;
+}
 
-  if(copy_from_user(&valore, buf, 1) != 0){
-    printk(KERN_WARNING "[GPIO driver] Problema nella copia dei dati dal processo user-space!\n");
-    return -EFAULT;
+/**
+ * @brief Callback dell'hrtimer che riproduce le sequenze su DOUT.
+ *
+ * @details Applica il passo corrente e programma il successivo sommando la durata del
+ *    passo alla scadenza appena servita, così che il ritardo di una callback non si
+ *    propaghi ai passi successivi. Al termine del buffer passa a quello in coda, se
+ *    presente, oppure ricomincia (GPIO_PATTERN_LOOP) oppure si ferma.
+ */
+static enum hrtimer_restart gpio_pattern_tick(struct hrtimer *timer)
+{
+  struct gpio_device *gpio_dev_ptr = container_of(timer, struct gpio_device, pattern_timer);
+  s64 jitter = ktime_to_ns(ktime_sub(ktime_get(), hrtimer_get_expires(timer)));
+  enum hrtimer_restart ret = HRTIMER_RESTART;
+  struct gpio_pattern_step *step;
+  struct gpio_pattern_buf *buf;
+  unsigned long flags;
+  u32 reg;
+
+  spin_lock_irqsave(&gpio_dev_ptr->pattern_lock, flags);
+  if(gpio_dev_ptr->pattern_running == NO){
+    spin_unlock_irqrestore(&gpio_dev_ptr->pattern_lock, flags);
+    return HRTIMER_NORESTART;
   }
 
-  // L'accesso alla periferica è gestito in mutua esclusione poichè è
-  // una risorsa condivisa tra più processi
-  spin_lock_irqsave(&gpio_dev_t_ptr->write_lock, flags);
-    iowrite8(0x0F, gpio_dev_t_ptr->base_addr + (GPIO_TRI_OFFSET/4));
-    iowrite8(valore, gpio_dev_t_ptr->base_addr + (GPIO_DOUT_OFFSET/4));
-  spin_unlock_irqrestore(&gpio_dev_t_ptr->write_lock, flags);
+  buf = &gpio_dev_ptr->pattern[gpio_dev_ptr->pattern_active];
+  step = &buf->steps[gpio_dev_ptr->pattern_pos];
+
+  spin_lock(&gpio_dev_ptr->write_lock);
+    reg = gpio_reg_read(gpio_dev_ptr, GPIO_DOUT_OFFSET);
+    gpio_reg_write(gpio_dev_ptr, GPIO_DOUT_OFFSET, (reg & ~step->mask) | (step->value & step->mask));
+  spin_unlock(&gpio_dev_ptr->write_lock);
+
+  if(jitter < 0)
+    jitter = 0;
+  gpio_dev_ptr->pattern_steps++;
+  gpio_dev_ptr->pattern_jitter_sum_ns += jitter;
+  if(jitter > gpio_dev_ptr->pattern_jitter_max_ns)
+    gpio_dev_ptr->pattern_jitter_max_ns = jitter;
+
+  hrtimer_add_expires_ns(timer, step->delay_ns);
+
+  if(++gpio_dev_ptr->pattern_pos == buf->count){
+    gpio_dev_ptr->pattern_pos = 0;
+    if(gpio_dev_ptr->pattern_next == YES){
+      gpio_dev_ptr->pattern_active = !gpio_dev_ptr->pattern_active;
+      gpio_dev_ptr->pattern_next = NO;
+    } else if(!(buf->flags & GPIO_PATTERN_LOOP)){
+      if(!(buf->flags & GPIO_PATTERN_LAST))
+        gpio_dev_ptr->pattern_underruns++;
+      gpio_dev_ptr->pattern_running = NO;
+      ret = HRTIMER_NORESTART;
+    }
+  }
+  spin_unlock_irqrestore(&gpio_dev_ptr->pattern_lock, flags);
 
-  printk(KERN_INFO "[GPIO driver] Valore scritto %08x\n", valore);
-  return count;
+  return ret;
 }
 
 /**
- * @brief ISR della periferica.
- *
- * @param irq è l'irq number della linea di interruzione.
- * @param regs è un puntatore ad una struttura pt_regs che contiene i valori dei
- *    registri del processore all'atto dell'interruzione.
- *
- * @return
- *    - IRQ_HANDLED se l'interruzione è stata servita correttamente.
- *    - errno se l'interruzione non è stata servita correttamente.
+ * @brief Ferma la riproduzione delle sequenze e scarta il buffer in coda.
  *
+ * @note I pin mantengono il valore dell'ultimo passo riprodotto.
  */
-irqreturn_t gpio_isr(int irq, struct pt_regs * regs)
+static void gpio_pattern_stop(struct gpio_device *gpio_dev_ptr)
 {
-  uint32_t pending_interrupt;
-  unsigned long* gpio_base_addr_ptr;
   unsigned long flags;
 
-  printk(KERN_INFO "[GPIO driver] Inizio IRQ handling\n");
+  mutex_lock(&gpio_dev_ptr->pattern_mutex);
+    spin_lock_irqsave(&gpio_dev_ptr->pattern_lock, flags);
+      gpio_dev_ptr->pattern_running = NO;
+      gpio_dev_ptr->pattern_next = NO;
+    spin_unlock_irqrestore(&gpio_dev_ptr->pattern_lock, flags);
+    hrtimer_cancel(&gpio_dev_ptr->pattern_timer);
+  mutex_unlock(&gpio_dev_ptr->pattern_mutex);
+}
 
-  gpio_base_addr_ptr = idr_find(&irq_idr, irq);
-  if (!gpio_base_addr_ptr) {
-    printk(KERN_WARNING "[GPIO driver] Puntatore al base address non trovato!\n");
-    return -ENODEV;
-  }
+/**
+ * @brief Callback dell'hrtimer delle acquisizioni GPIO_CAPTURE_TIMER.
+ *
+ * @details Acquisisce un campione e programma la scadenza successiva. Se la callback
+ *    è in ritardo di più di un periodo le scadenze perse non sono recuperate ma contate.
+ */
+static enum hrtimer_restart gpio_capture_tick(struct hrtimer *timer)
+{
+  struct gpio_device *gpio_dev_ptr = container_of(timer, struct gpio_device, capture_timer);
+  ktime_t now = ktime_get();
+  int done = NO;
+  u64 overruns;
+
+  spin_lock(&gpio_dev_ptr->capture_lock);
+    if(gpio_dev_ptr->capture_state == GPIO_CAPTURE_ARMED || gpio_dev_ptr->capture_state == GPIO_CAPTURE_TRIGGERED){
+      done = gpio_capture_sample(gpio_dev_ptr, ktime_to_ns(now));
+      if(done == NO){
+        overruns = hrtimer_forward(timer, now, ns_to_ktime(gpio_dev_ptr->capture.period_ns));
+        if(overruns > 1)
+          gpio_dev_ptr->capture_missed += overruns - 1;
+      }
+    } else {
+      done = YES;
+    }
+  spin_unlock(&gpio_dev_ptr->capture_lock);
 
-  // Acknoledgement delle interruzioni pendenti
-  pending_interrupt = ioread32(gpio_base_addr_ptr + (GPIO_ISR_OFFSET/4));
-  iowrite32(pending_interrupt, gpio_base_addr_ptr + (GPIO_ICL_OFFSET/4));
+  if(done == YES){
+    wake_up_interruptible(&gpio_dev_ptr->capture_wait);
+    return HRTIMER_NORESTART;
+  }
+  return HRTIMER_RESTART;
+}
 
-  // Sblocca eventuali processi in attesa di leggere
-  spin_lock_irqsave(&read_lock, flags);
-    can_read = YES;
-  spin_unlock_irqrestore(&read_lock, flags);
+/**
+ * @brief Termina l'acquisizione in corso, conservando i campioni acquisiti.
+ */
+static void gpio_capture_stop(struct gpio_device *gpio_dev_ptr)
+{
+  unsigned long flags;
 
-  printk(KERN_INFO "Process %i (%s) awakening the readers...\n", current->pid, current->comm);
-  wake_up_interruptible(&rdqueue);
+  mutex_lock(&gpio_dev_ptr->capture_mutex);
+    spin_lock_irqsave(&gpio_dev_ptr->capture_lock, flags);
+      if(gpio_dev_ptr->capture_state != GPIO_CAPTURE_IDLE)
+        gpio_dev_ptr->capture_state = GPIO_CAPTURE_DONE;
+    spin_unlock_irqrestore(&gpio_dev_ptr->capture_lock, flags);
+    hrtimer_cancel(&gpio_dev_ptr->capture_timer);
+  mutex_unlock(&gpio_dev_ptr->capture_mutex);
 
-  printk(KERN_INFO "[GPIO driver] Fine IRQ handling\n");
-  return IRQ_HANDLED;
+  wake_up_interruptible(&gpio_dev_ptr->capture_wait);
 }
 
 /************************** Mapping col device tree ****************************/
@@ -549,6 +2848,23 @@ static struct platform_driver gpio_driver = {
 };
 
 /********************* Funzioni di inizializzazione del modulo *************************/
+/**
+ * @brief Conta le periferiche compatibili con il driver presenti nel device tree.
+ *
+ * @return il numero di nodi compatibili ed abilitati, almeno 1.
+ */
+static unsigned int gpio_count_devices(void)
+{
+  struct device_node *np;
+  unsigned int count = 0;
+
+  for_each_matching_node(np, gpio_match)
+    if(of_device_is_available(np))
+      count++;
+
+  return (count ? count : 1);
+}
+
 /**
  * @brief Operazioni svolte all'atto dell'inserimento del modulo.
  *
@@ -570,8 +2886,10 @@ static int __init gpio_init(void)
   device_cdev_p->owner = THIS_MODULE;
 
   // Alloca dinamicamente il primo range di device driver numbers diponibile
-  // I minor number vanno da 0 a GPIOS_TO_MANAGE
-  ret_status = alloc_chrdev_region(&gpiodrv_dev_number, 0, GPIOS_TO_MANAGE, DRIVER_NAME);
+  // I minor number vanno da 0 a gpio_minors
+  gpio_minors = (max_devices ? max_devices : gpio_count_devices() + gpio_mock_count());
+  printk(KERN_INFO "[GPIO driver] Minor number riservati: %u\n", gpio_minors);
+  ret_status = alloc_chrdev_region(&gpiodrv_dev_number, 0, gpio_minors, DRIVER_NAME);
   if(ret_status < 0){
     printk(KERN_WARNING "Allocazione device numbers non riuscita!");
     return ret_status;
@@ -580,11 +2898,11 @@ static int __init gpio_init(void)
   // Richiede al kernel il primo major number disponibile
   major = MAJOR(gpiodrv_dev_number);
 
-  // Aggiorna il device driver model con GPIOS_TO_MANAGE dispositivi
-  ret_status = cdev_add(device_cdev_p, gpiodrv_dev_number, GPIOS_TO_MANAGE);
+  // Aggiorna il device driver model con gpio_minors dispositivi
+  ret_status = cdev_add(device_cdev_p, gpiodrv_dev_number, gpio_minors);
   if(ret_status < 0){
     printk(KERN_WARNING "Registrazione del driver non riuscita!");
-    unregister_chrdev_region(gpiodrv_dev_number, GPIOS_TO_MANAGE);
+    unregister_chrdev_region(gpiodrv_dev_number, gpio_minors);
     return ret_status;
   }
 
@@ -594,17 +2912,25 @@ static int __init gpio_init(void)
   if(!gpio_class){
     printk(KERN_INFO "Cannot create device class\n");
     cdev_del(device_cdev_p);
-    unregister_chrdev_region(gpiodrv_dev_number, GPIOS_TO_MANAGE);
+    unregister_chrdev_region(gpiodrv_dev_number, gpio_minors);
     return -EFAULT;
   }
 
-  spin_lock_init(&read_lock);
-  init_waitqueue_head(&rdqueue);
+  // Directory radice dei contatori in debugfs. In assenza di debugfs il driver funziona comunque
+  gpio_debugfs_root = debugfs_create_dir(DRIVER_NAME, NULL);
 
   printk(KERN_INFO "[GPIO driver] Fine fase di inizializzazione...");
   // Da questo punto in avanti ogni periferica che risulta compatibile
   // con il driver verrà inizializzata attraverso la funzione probe
-  return platform_driver_register(&gpio_driver);
+  ret_status = platform_driver_register(&gpio_driver);
+  if(ret_status)
+    return ret_status;
+
+  // Periferiche simulate (solo con GPIODRV_MOCK), in aggiunta a quelle del device tree
+  ret_status = gpio_mock_init();
+  if(ret_status)
+    printk(KERN_WARNING "[GPIO driver] Creazione delle periferiche simulate non riuscita: %d\n", ret_status);
+  return 0;
 }
 
 /**
@@ -615,13 +2941,16 @@ static void __exit gpio_exit(void)
 {
   printk(KERN_INFO "[GPIO driver] Deinizializzazione...");
 
+  gpio_mock_exit();
   platform_driver_unregister(&gpio_driver);
+  debugfs_remove_recursive(gpio_debugfs_root);
   class_destroy(gpio_class);
   cdev_del(device_cdev_p);
-  unregister_chrdev_region(gpiodrv_dev_number, GPIOS_TO_MANAGE);
+  unregister_chrdev_region(gpiodrv_dev_number, gpio_minors);
   mutex_destroy(&minor_lock);
+  // Attende che le strutture liberate con kfree_rcu siano state effettivamente rilasciate
+  rcu_barrier();
   idr_destroy(&gpio_idr);
-  idr_destroy(&irq_idr);
 }
 
 // Macro che consentono di definire funzioni che vengono chiamate
@@ -634,6 +2963,12 @@ module_exit(gpio_exit);
 MODULE_AUTHOR("Antonio Riccio");
 MODULE_DESCRIPTION("Modulo kernel per l'accesso ad una periferica GPIO su Zynq 7000");
 MODULE_LICENSE("GPL");
+
+/********************************* Test KUnit **********************************/
+// I test sono compilati nella stessa unità di traduzione per accedere alle funzioni static
+#ifdef GPIODRV_KUNIT
+#include "gpiodrv_kunit.c"
+#endif
 /** @} */
 /** @} */
 /** @} */
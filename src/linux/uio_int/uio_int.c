@@ -28,13 +28,18 @@
 /** @} */
 /** @} */
 /***************************** Include Files ********************************/
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <string.h>
+#include <signal.h>
+#include <time.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
+#include <sched.h>
 
 #include "bsp_led.h"
 #include "bsp_switch.h"
@@ -42,14 +47,42 @@
 
 #define DEBUG
 #define GPIO_MAP_SIZE 0x10000
+#define LATENCY_BUCKETS 16		///< Classi dell'istogramma delle latenze: <1 us, [1,2) us, ..., >= 2^14 us
+
+/**
+* @brief Latenze di servizio degli eventi di una modalità.
+*/
+typedef struct {
+	unsigned long count;
+	double sum_us, min_us, max_us;
+	unsigned long hist[LATENCY_BUCKETS];
+} latency_stats_t;
 
 int fd_led, fd_swt, led_data = 0;
 char *uiod_l, *uiod_s;
 void *led_base_addr, *swt_base_addr;
 
+unsigned long poll_window_us = 0;	///< Durata della finestra di busy-polling dopo ogni evento (0 = solo interruzioni)
+unsigned long ack_delay_us = 0;		///< Ritardo massimo con cui un acknowledge è visibile in ISR (0 = immediato)
+volatile sig_atomic_t stop = 0;		///< Settata dal gestore di SIGINT per terminare l'applicazione
+unsigned long events_irq = 0;		///< Eventi serviti dopo il risveglio da interruzione
+unsigned long events_poll = 0;		///< Eventi serviti durante la finestra di busy-polling
+unsigned long poll_samples = 0;		///< Campionamenti dei registri effettuati in busy-polling
+double poll_time_us = 0;		///< Tempo complessivo trascorso in busy-polling
+struct timespec run_start;		///< Istante di avvio dell'applicazione
+latency_stats_t latency_irq;		///< Latenze degli eventi serviti dopo il risveglio da interruzione
+latency_stats_t latency_poll;		///< Latenze degli eventi serviti in busy-polling
+
 /************************** Function Prototypes *****************************/
 void setup(void);
 void loop(void);
+void serve_event(latency_stats_t *latency, struct timespec *detected);
+void wait_ack(void);
+void report(void);
+void latency_add(latency_stats_t *latency, double us);
+void latency_print(const char *name, latency_stats_t *latency);
+void stop_handler(int signum);
+double elapsed_us(struct timespec *from, struct timespec *to);
 
 /**
 *
@@ -62,16 +95,44 @@ void loop(void);
 * 		il contatore viene incrementato di un valore pari al valore in binario della
 * 	configurazione dei pulsanti o degli switch.
 *
+* 		Il terzo parametro, opzionale, abilita la modalità ibrida: dopo ogni evento
+* 	l'applicazione campiona in busy-polling i registri della periferica per il numero
+* 	di microsecondi indicato, e solo allo scadere della finestra riabilita l'interruzione
+* 	e si blocca sulla read. Sotto raffiche di eventi si ottiene così una latenza prossima
+* 	a quella del polling, mentre a riposo l'occupazione della CPU resta prossima a zero.
+* 	Alla terminazione (CTRL+C) vengono riportati, per ciascuna delle due modalità, il numero
+* 	di eventi serviti e la latenza di servizio (minimo, media, massimo ed istogramma),
+* 	insieme all'occupazione della CPU: ripetendo la misura con finestre diverse si ottiene
+* 	la curva di compromesso tra latenza ed occupazione della CPU.
+*
+* 	Es: ./intuio /dev/uio0 /dev/uio1 200
+*
 */
 int main(int argc, char *argv[])
 {
+	struct sigaction sa;
+
 	uiod_l = argv[1];
 	uiod_s = argv[2];
+	if(argc > 3)
+		poll_window_us = strtoul(argv[3], NULL, 10);
+
+	// Sotto fakeuio gli acknowledge sono visibili solo alla scansione successiva
+	if(getenv("FAKEUIO_DEFERRED_STORES") != NULL)
+		ack_delay_us = strtoul(getenv("FAKEUIO_DEFERRED_STORES"), NULL, 10);
+
+	// Il gestore non prevede SA_RESTART così da interrompere la read bloccante
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = stop_handler;
+	sigaction(SIGINT, &sa, NULL);
 
 	printf("Per terminare l'applicazione premi CTRL+C\n");
 
 	setup();
-	for(;;) loop();
+	clock_gettime(CLOCK_MONOTONIC, &run_start);
+	while(!stop) loop();
+
+	report();
 
 	// Unmapping degli indirizzi fisici della periferiche con quelli
 	// virtuali del processo
@@ -158,19 +219,20 @@ void setup(void)
 }
 
 /**
-* @brief Legge il valore degli switch con una chiamata bloccante e riporta
-* 	il loro stato sui LED.
+* @brief Attende un evento con una chiamata bloccante, lo serve ed eventualmente prosegue
+* 	in busy-polling per poll_window_us microsecondi prima di riabilitare l'interruzione.
 *
 */
 void loop(void)
 {
-	int swt_status = 0;
-
-	printf("In attesa che il dato sia pronto...\n");
+	int swt_status = 0, irq_on = 1;
+	struct timespec window_start, now, detected;
 
 	// Comunica al processo UIO l'intenzione di voler leggere dai registri della
 	// periferica al verificarsi di un evento (la chiamata è bloccante)
 	if(read(fd_swt, &swt_status, sizeof(swt_status)) != sizeof(swt_status)){
+		if(errno == EINTR)
+			return;
 		printf("Lettura non riuscita. Errore: %s\n", strerror(errno));
 		munmap(led_base_addr, GPIO_MAP_SIZE);
 		munmap(swt_base_addr, GPIO_MAP_SIZE);
@@ -179,19 +241,38 @@ void loop(void)
 		exit(EXIT_FAILURE);
 	}
 
-	printf("Il dato è arrivato!\n");
-	// Lettura del dato dalla periferica
-	swt_status = switch_get_state(SWT0|SWT1|SWT2|SWT3);
+	clock_gettime(CLOCK_MONOTONIC, &detected);
+	serve_event(&latency_irq, &detected);
+	events_irq++;
 
-	// Acknoledge delle interruzioni. Scrittura redirezionata al device
-	// file di UIO, il quale la replicherà solo dopo aver chiamato la funzione write
-	switch_int_ack();
+	// Finestra di busy-polling: l'interruzione resta disabilitata presso UIO ed i nuovi
+	// eventi sono rilevati campionando il registro delle interruzioni pendenti, che
+	// viene aggiornato dalla periferica anche in assenza di interruzioni abilitate.
+	// La finestra riparte ad ogni evento servito.
+	if(poll_window_us > 0){
+		wait_ack();
+		clock_gettime(CLOCK_MONOTONIC, &window_start);
+		now = window_start;
+		while(!stop && elapsed_us(&window_start, &now) < poll_window_us){
+			if(switch_int_pending()){
+				clock_gettime(CLOCK_MONOTONIC, &detected);
+				serve_event(&latency_poll, &detected);
+				events_poll++;
+				wait_ack();
+				poll_time_us += elapsed_us(&window_start, &now);
+				window_start = now;
+			}
+			poll_samples++;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+		}
+		poll_time_us += elapsed_us(&window_start, &now);
+	}
 
 	// L'istruzione di write è necessaria per notificare il processo UIO dell'operazione
-	// di scrittura. In seguito a tale chiamata infatti il processo replicherà
-	// la scrittura sulla periferica associata. Se non si chiama questa funzione
-	// non vengono applicati effetivamente le operazioni sui registri della periferica
-	if (write(fd_swt, &swt_status, sizeof(swt_status)) < sizeof(swt_status)) {
+	// di scrittura. In seguito a tale chiamata infatti il processo riabiliterà
+	// l'interruzione. Un evento arrivato dopo l'ultimo campionamento resta pendente
+	// nella periferica e genera l'interruzione non appena questa viene riabilitata.
+	if (write(fd_swt, &irq_on, sizeof(irq_on)) < sizeof(irq_on)) {
 		printf("Scrittura non riuscita. Errore: %s\n", strerror(errno));
 		munmap(led_base_addr, GPIO_MAP_SIZE);
 		munmap(swt_base_addr, GPIO_MAP_SIZE);
@@ -199,17 +280,164 @@ void loop(void)
 		close(fd_swt);
 		exit(EXIT_FAILURE);
 	}
+}
+
+/**
+* @brief Legge lo stato degli switch, effettua l'acknowledge delle interruzioni
+* 	e riporta il conteggio sui LED.
+*
+* @param latency sono le statistiche della modalità che ha rilevato l'evento.
+* @param detected è l'istante in cui l'evento è stato rilevato: il ritorno dalla read
+* 	oppure il campionamento di switch_int_pending() che lo ha visto. La latenza
+* 	registrata va da questo istante al completamento dell'aggiornamento dei LED.
+*
+*/
+void serve_event(latency_stats_t *latency, struct timespec *detected)
+{
+	struct timespec done;
+	int swt_status;
+
+	// Lettura del dato dalla periferica
+	swt_status = switch_get_state(SWT0|SWT1|SWT2|SWT3);
+
+	// Acknoledge delle interruzioni
+	switch_int_ack();
 
 	// Incrementa la variabile di conteggio in base allo stato degli switch/pulsanti
 	led_data = led_data + swt_status;
 
+	// Propagazione dello stato degli switch/pulsanti sui LED
+	led_off(~led_data);
+	led_on(led_data);
+
+	clock_gettime(CLOCK_MONOTONIC, &done);
+	latency_add(latency, elapsed_us(detected, &done));
+
+	// Stampe fuori dall'intervallo misurato, per non alterare la latenza
 	#ifdef DEBUG
 	printf("[DEBUG] Stato degli switch %08x\n", swt_status);
 	printf("[DEBUG] Stato del conteggio %08x\n", led_data);
 	#endif
+}
 
-	// Propagazione dello stato degli switch/pulsanti sui LED
-	led_off(~led_data);
-	led_on(led_data);
+/**
+* @brief Attende che l'acknowledge dell'evento appena servito sia visibile in ISR.
+*
+* @details Sulla periferica reale l'acknowledge è immediato e la funzione ritorna subito.
+* 	Sotto fakeuio la scrittura di ICL è applicata entro ack_delay_us microsecondi: senza
+* 	questa attesa la finestra di busy-polling servirebbe più volte lo stesso fronte.
+* 	Un nuovo fronte arrivato nel frattempo resta pendente e viene servito allo scadere
+* 	dell'attesa.
+*
+*/
+void wait_ack(void)
+{
+	struct timespec start, now;
+
+	if(ack_delay_us == 0)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	now = start;
+	while(switch_int_pending() && elapsed_us(&start, &now) < ack_delay_us){
+		// Cede la CPU al thread di fakeuio, che su un solo core non girerebbe
+		sched_yield();
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	}
+}
+
+/**
+* @brief Riporta gli eventi serviti e la loro latenza in ciascuna modalità e l'occupazione della CPU.
+*
+* @details La latenza misurata parte dalla rilevazione dell'evento. Gli eventi serviti in
+* 	polling sono rilevati con un ritardo non superiore al periodo medio di
+* 	campionamento, riportato a parte, mentre quelli serviti da interruzione pagano in
+* 	più la latenza di risveglio del processo, che non è visibile da userspace.
+*/
+void report(void)
+{
+	struct rusage usage;
+	struct timespec now;
+	double wall_us, cpu_us;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	// Solo il thread dell'applicazione: sotto fakeuio il processo contiene anche il
+	// thread che simula la periferica
+	getrusage(RUSAGE_THREAD, &usage);
+
+	wall_us = elapsed_us(&run_start, &now);
+	cpu_us = usage.ru_utime.tv_sec * 1e6 + usage.ru_utime.tv_usec +
+	         usage.ru_stime.tv_sec * 1e6 + usage.ru_stime.tv_usec;
+
+	printf("\nFinestra di busy-polling: %lu us\n", poll_window_us);
+	printf("Eventi serviti: %lu (da interruzione: %lu, in polling: %lu)\n", events_irq + events_poll, events_irq, events_poll);
+	printf("Occupazione della CPU: %.2f%% (%.0f us su %.0f us)\n", wall_us > 0 ? 100.0 * cpu_us / wall_us : 0.0, cpu_us, wall_us);
+	latency_print("da interruzione", &latency_irq);
+	latency_print("in polling", &latency_poll);
+	if(poll_samples > 0)
+		printf("Periodo medio di campionamento in polling: %.3f us\n", poll_time_us / poll_samples);
+}
+
+/**
+* @brief Aggiunge la latenza di un evento alle statistiche di una modalità.
+*
+*/
+void latency_add(latency_stats_t *latency, double us)
+{
+	int bucket = 0;
+
+	while(bucket < LATENCY_BUCKETS - 1 && us >= (double)(1UL << bucket))
+		bucket++;
+
+	if(latency->count == 0 || us < latency->min_us)
+		latency->min_us = us;
+	if(us > latency->max_us)
+		latency->max_us = us;
+	latency->sum_us += us;
+	latency->count++;
+	latency->hist[bucket]++;
+}
+
+/**
+* @brief Stampa minimo, media, massimo e le classi non vuote dell'istogramma delle latenze.
+*
+*/
+void latency_print(const char *name, latency_stats_t *latency)
+{
+	int bucket;
+
+	if(latency->count == 0)
+		return;
+
+	printf("Latenza %s min/med/max: %.3f/%.3f/%.3f us\n", name, latency->min_us,
+	       latency->sum_us / latency->count, latency->max_us);
+	for(bucket = 0; bucket < LATENCY_BUCKETS; bucket++){
+		if(latency->hist[bucket] == 0)
+			continue;
+		if(bucket == 0)
+			printf("  [0, 1) us: %lu\n", latency->hist[bucket]);
+		else if(bucket == LATENCY_BUCKETS - 1)
+			printf("  >= %lu us: %lu\n", 1UL << (bucket - 1), latency->hist[bucket]);
+		else
+			printf("  [%lu, %lu) us: %lu\n", 1UL << (bucket - 1), 1UL << bucket, latency->hist[bucket]);
+	}
+}
+
+/**
+* @brief Gestore di SIGINT. Richiede la terminazione dell'applicazione.
+*
+*/
+void stop_handler(int signum)
+{
+	stop = 1;
+}
+
+/**
+* @brief Restituisce il tempo in microsecondi trascorso tra due istanti.
+*
+*/
+double elapsed_us(struct timespec *from, struct timespec *to)
+{
+	return (to->tv_sec - from->tv_sec) * 1e6 + (to->tv_nsec - from->tv_nsec) / 1e3;
 }
 /** @} */
@@ -0,0 +1,350 @@
+/**
+* @file GpioModel.cpp
+* @brief Implementazione del modello software della periferica GPIO.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup SIM
+* @{
+*/
+/***************************** Include Files ********************************/
+#include <assert.h>
+#include <string.h>
+#include <vector>
+
+#include "GpioModel.h"
+
+/************************** Variable Definitions *****************************/
+static std::vector<GpioModel*> models;          ///< Modelli associati ad un indirizzo base
+static std::vector<uint32_t*> model_bases;      ///< Indirizzi base, nello stesso ordine di models
+static GpioModel* last_model = NULL;            ///< Ultimo modello acceduto dal backend
+static uint32_t* last_base = NULL;
+
+/**
+* @brief Individua il modello associato all'indirizzo base (il driver accede di solito
+* 	più volte di seguito alla stessa periferica).
+*/
+static GpioModel* lookup(uint32_t* base)
+{
+	if(base == last_base)
+		return last_model;
+	for(size_t i = 0; i < model_bases.size(); i++){
+		if(model_bases[i] == base){
+			last_base = base;
+			last_model = models[i];
+			return last_model;
+		}
+	}
+	assert(!"Indirizzo base non associato ad alcun modello");
+	return NULL;
+}
+
+static uint32_t backend_read(void* ctx, uint32_t* base, int offset)
+{
+	(void)ctx;
+	return lookup(base)->read(offset);
+}
+
+static void backend_write(void* ctx, uint32_t* base, int offset, uint32_t mask)
+{
+	(void)ctx;
+	lookup(base)->write(offset, mask);
+}
+
+static const gpio_ll_backend model_backend = { backend_read, backend_write, NULL };
+
+/**
+* @brief Costruttore. Il modello parte dallo stato di reset (tutti i registri a 0).
+*
+* @param size è il numero di pin della periferica (generic gpio_size, al più 32).
+* @param clock_hz è la frequenza del clock del bus AXI.
+*/
+GpioModel::GpioModel(unsigned int size, double clock_hz)
+{
+	assert(size > 0 && size <= 32);
+
+	this->size = size;
+	this->pin_mask = size == 32 ? 0xFFFFFFFF : (1U << size) - 1;
+	this->clock_hz = clock_hz;
+	// Handshake AXI-Lite dello slave: AWREADY/WREADY, poi BVALID; ARREADY, poi RVALID
+	this->read_latency = 2;
+	this->write_latency = 3;
+	this->cycle = 0;
+	this->dout = this->tri = this->ier = this->isr = 0;
+	this->ext_value = this->ext_mask = 0;
+	this->pad = this->sampled = 0;
+	this->pad_cycle = 0;
+	this->latched = 0;
+	this->latch_cycle = UINT64_MAX;
+	this->irq_level = false;
+	this->base_address = NULL;
+	memset(&this->counters, 0, sizeof(this->counters));
+}
+
+GpioModel::~GpioModel()
+{
+	for(size_t i = 0; i < models.size(); i++){
+		if(models[i] == this){
+			models.erase(models.begin() + i);
+			model_bases.erase(model_bases.begin() + i);
+			break;
+		}
+	}
+	last_base = NULL;
+	last_model = NULL;
+}
+
+/**
+* @brief Imposta la durata degli accessi ai registri.
+*
+* @details Le durate di default corrispondono al solo handshake dello slave; per
+* 	modellare l'interconnessione tra processore e logica programmabile vanno aumentate.
+*/
+void GpioModel::setAccessLatency(unsigned int read_cycles, unsigned int write_cycles)
+{
+	this->read_latency = read_cycles;
+	this->write_latency = write_cycles;
+}
+
+/**
+* @brief Imposta la funzione chiamata ad ogni variazione della linea irq.
+*/
+void GpioModel::setIrqCallback(IrqCallback callback)
+{
+	this->irq_callback = callback;
+}
+
+/**
+* @brief Imposta la funzione chiamata ad ogni variazione dei pad, dovuta a DOUT, TRI o
+* 	al pilotaggio esterno. Serve a collegare i pad ad altri modelli.
+*/
+void GpioModel::setPadCallback(PadCallback callback)
+{
+	this->pad_callback = callback;
+}
+
+/**
+* @brief Associa il modello ad un indirizzo base, usato dal backend di gpio_ll per
+* 	instradare gli accessi. L'indirizzo non viene mai dereferenziato.
+*/
+void GpioModel::bind(uint32_t* base_address)
+{
+	assert(base_address != NULL && this->base_address == NULL);
+
+	this->base_address = base_address;
+	models.push_back(this);
+	model_bases.push_back(base_address);
+}
+
+/**
+* @brief Instrada gli accessi di gpio_read_mask e gpio_write_mask verso i modelli.
+*/
+void GpioModel::installBackend()
+{
+	gpio_ll_set_backend(&model_backend);
+}
+
+/**
+* @brief Ripristina l'accesso diretto in gpio_ll.
+*/
+void GpioModel::removeBackend()
+{
+	gpio_ll_set_backend(NULL);
+}
+
+/**
+* @brief Legge un registro. Il valore è quello presente al termine dell'accesso.
+*
+* @param offset è lo spiazzamento del registro (GPIO_*_OFFSET).
+*/
+uint32_t GpioModel::read(int offset)
+{
+	uint32_t value;
+
+	this->cycle += this->read_latency;
+	sync(this->cycle);
+	this->counters.reads++;
+
+	switch((offset >> 2) & 0x7){
+		case GPIO_DOUT_OFFSET/4:
+			value = this->dout;
+			break;
+		case GPIO_TRI_OFFSET/4:
+			value = this->tri;
+			break;
+		case GPIO_DIN_OFFSET/4:
+			value = this->pad;
+			break;
+		case GPIO_IER_OFFSET/4:
+			value = this->ier;
+			break;
+		case GPIO_ISR_OFFSET/4:
+			value = this->isr;
+			break;
+		default:
+			// ICL (impulso già terminato) e indirizzi non decodificati
+			value = 0;
+			break;
+	}
+	return value;
+}
+
+/**
+* @brief Scrive un registro. La scrittura ha effetto al termine dell'accesso.
+*
+* @param offset è lo spiazzamento del registro (GPIO_*_OFFSET).
+* @param value è il valore da scrivere.
+*/
+void GpioModel::write(int offset, uint32_t value)
+{
+	this->cycle += this->write_latency;
+	sync(this->cycle);
+	this->counters.writes++;
+
+	switch((offset >> 2) & 0x7){
+		case GPIO_DOUT_OFFSET/4:
+			this->dout = value;
+			updatePads();
+			break;
+		case GPIO_TRI_OFFSET/4:
+			this->tri = value;
+			updatePads();
+			break;
+		case GPIO_IER_OFFSET/4:
+			this->ier = value;
+			break;
+		case GPIO_ICL_OFFSET/4:
+			// sync ha già registrato i fronti di questo ciclo: il clear li annulla
+			if(this->latch_cycle == this->cycle)
+				this->counters.cleared_lost += __builtin_popcount(this->latched & value);
+			this->isr &= ~(value & this->pin_mask);
+			break;
+		default:
+			// slv_reg2 e slv_reg5 sono scrivibili ma non collegati
+			break;
+	}
+	updateIrq(this->cycle);
+}
+
+/**
+* @brief Pilota dall'esterno i pad indicati in mask con il valore value, a partire
+* 	dal ciclo corrente.
+*/
+void GpioModel::drive(uint32_t value, uint32_t mask)
+{
+	sync(this->cycle);
+	this->ext_value = (this->ext_value & ~mask) | (value & mask);
+	this->ext_mask |= mask;
+	if(this->tri & mask & this->pin_mask)
+		this->counters.conflicts++;
+	updatePads();
+}
+
+/**
+* @brief Smette di pilotare dall'esterno i pad indicati in mask.
+*/
+void GpioModel::release(uint32_t mask)
+{
+	sync(this->cycle);
+	this->ext_mask &= ~mask;
+	updatePads();
+}
+
+/**
+* @brief Restituisce il valore corrente dei pad, visto dall'esterno.
+*/
+uint32_t GpioModel::pads()
+{
+	sync(this->cycle);
+	return this->pad;
+}
+
+/**
+* @brief Fa avanzare il tempo di cycles cicli di clock.
+*/
+void GpioModel::advance(uint64_t cycles)
+{
+	this->cycle += cycles;
+	sync(this->cycle);
+}
+
+/**
+* @brief Fa avanzare il tempo fino al ciclo indicato (nessun effetto se già trascorso).
+*/
+void GpioModel::advanceTo(uint64_t cycle)
+{
+	if(cycle > this->cycle)
+		advance(cycle - this->cycle);
+}
+
+/**
+* @brief Porta lo stato del rilevatore di fronti al ciclo at.
+*
+* @details I pad sono costanti tra due variazioni, per cui il primo fronte di clock dopo
+* 	l'ultima variazione (ciclo pad_cycle + 1) è l'unico che può rilevare un fronte di
+* 	salita: a quel ciclo livelli2impulsi produce l'impulso che abilita il latch di ISR.
+*/
+void GpioModel::sync(uint64_t at)
+{
+	uint32_t rising;
+
+	if(at <= this->pad_cycle || this->pad == this->sampled)
+		return;
+
+	rising = this->pad & ~this->sampled;
+	this->sampled = this->pad;
+	if(!rising)
+		return;
+
+	this->counters.edges += __builtin_popcount(rising);
+	this->counters.coalesced += __builtin_popcount(rising & this->isr);
+	this->isr |= rising;
+	this->latched = rising;
+	this->latch_cycle = this->pad_cycle + 1;
+	updateIrq(this->latch_cycle);
+}
+
+/**
+* @brief Ricalcola i pad (gpio_pad) dopo una variazione di DOUT, TRI o del pilotaggio esterno.
+*
+* @details Un pin in uscita pilotato anche dall'esterno legge DOUT. Più variazioni nello
+* 	stesso ciclo si fondono: un impulso di durata nulla non viene rilevato.
+*/
+void GpioModel::updatePads()
+{
+	uint32_t value = ((this->dout & this->tri) | (this->ext_value & this->ext_mask & ~this->tri)) & this->pin_mask;
+
+	if(value == this->pad)
+		return;
+	this->pad = value;
+	this->pad_cycle = this->cycle;
+	if(this->pad_callback)
+		this->pad_callback(value, this->cycle);
+}
+
+/**
+* @brief Aggiorna la linea di interruzione e notifica le sue variazioni.
+*/
+void GpioModel::updateIrq(uint64_t at)
+{
+	bool level = (this->isr & this->ier & this->pin_mask) != 0;
+
+	if(level == this->irq_level)
+		return;
+	this->irq_level = level;
+	if(level)
+		this->counters.irqs++;
+	if(this->irq_callback)
+		this->irq_callback(level, at);
+}
+/** @} */
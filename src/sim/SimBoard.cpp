@@ -0,0 +1,366 @@
+/**
+* @file SimBoard.cpp
+* @brief Implementazione della scheda simulata.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup SIM
+* @{
+*/
+/***************************** Include Files ********************************/
+#include <assert.h>
+
+#include "SimBoard.h"
+
+/**
+* @brief Costruttore.
+*
+* @param clock_hz è la frequenza del clock comune alle periferiche.
+*/
+SimBoard::SimBoard(double clock_hz)
+{
+	this->clock_hz = clock_hz;
+	this->cpu_cycle = 0;
+	this->irq_entry = 0;
+	this->in_handler = false;
+	this->seq = 0;
+	this->last_device = 0;
+	this->applied = 0;
+	this->backend.read = backendRead;
+	this->backend.write = backendWrite;
+	this->backend.ctx = this;
+}
+
+SimBoard::~SimBoard()
+{
+	for(size_t i = 0; i < this->devices.size(); i++)
+		delete this->devices[i].model;
+}
+
+/**
+* @brief Aggiunge una periferica alla scheda.
+*
+* @param name è il nome usato nel resoconto.
+* @param base_address è l'indirizzo base da passare al driver; non viene mai dereferenziato.
+* @param size è il numero di pin.
+*
+* @return il modello della periferica, per impostarne la latenza degli accessi o
+* 	pilotarne i pad direttamente.
+*/
+GpioModel& SimBoard::addDevice(const char* name, uint32_t* base_address, unsigned int size)
+{
+	Device device;
+	size_t index = this->devices.size();
+
+	device.name = name;
+	device.base_address = base_address;
+	device.model = new GpioModel(size, this->clock_hz);
+	device.irq_pending = false;
+	device.irq_cycle = 0;
+	device.served = device.measured = 0;
+	device.latency_min = UINT64_MAX;
+	device.latency_max = device.latency_sum = 0;
+
+	// Le variazioni dei pad si propagano lungo i collegamenti che partono dalla periferica
+	device.model->setPadCallback([this, index](uint32_t pads, uint64_t cycle){
+		for(size_t i = 0; i < this->links.size(); i++){
+			if(this->links[i].from == index)
+				push(cycle + this->links[i].delay, this->links[i].to, pads, this->links[i].mask, -1);
+		}
+	});
+	device.model->setIrqCallback([this, index](bool level, uint64_t cycle){
+		if(level){
+			this->devices[index].irq_pending = true;
+			this->devices[index].irq_cycle = cycle;
+		}
+	});
+
+	this->devices.push_back(device);
+	return *this->devices.back().model;
+}
+
+/**
+* @brief Collega i pad indicati in mask di from agli stessi pad di to.
+*
+* @details I pad di from, visti dall'esterno (DOUT per i pin in uscita), sono imposti ai
+* 	pad di to delay_ns nanosecondi dopo ogni loro variazione. I pad di to collegati
+* 	vanno configurati in ingresso, altrimenti il modello conta un conflitto.
+*/
+void SimBoard::connect(GpioModel& from, GpioModel& to, uint32_t mask, double delay_ns)
+{
+	Link link;
+
+	link.from = indexOf(from);
+	link.to = indexOf(to);
+	link.mask = mask;
+	link.delay = nsToCycles(delay_ns);
+	this->links.push_back(link);
+
+	push(this->cpu_cycle + link.delay, link.to, from.pads(), mask, -1);
+}
+
+/**
+* @brief Pilota i pad di to con uno stimolo (ne viene conservata una copia).
+*/
+void SimBoard::attach(GpioModel& to, const Stimulus& stimulus)
+{
+	this->stimuli.push_back(stimulus);
+	this->stimulus_device.push_back(indexOf(to));
+	schedule(this->stimuli.size() - 1);
+}
+
+/**
+* @brief Imposta il gestore dell'interruzione di una periferica, eseguito dalla scheda
+* 	come farebbe il GIC (vedi main.c).
+*/
+void SimBoard::setIrqHandler(GpioModel& device, IrqHandler handler)
+{
+	this->devices[indexOf(device)].handler = handler;
+}
+
+/**
+* @brief Imposta il tempo di ingresso nel gestore di interruzione.
+*/
+void SimBoard::setIrqEntry(double ns)
+{
+	this->irq_entry = nsToCycles(ns);
+}
+
+/**
+* @brief Instrada gli accessi di gpio_read_mask e gpio_write_mask verso la scheda.
+*/
+void SimBoard::install()
+{
+	gpio_ll_set_backend(&this->backend);
+}
+
+/**
+* @brief Ripristina l'accesso diretto in gpio_ll.
+*/
+void SimBoard::remove()
+{
+	gpio_ll_set_backend(NULL);
+}
+
+/**
+* @brief Il processore attende ns nanosecondi, servendo le interruzioni che arrivano
+* 	nel frattempo.
+*/
+void SimBoard::idle(double ns)
+{
+	uint64_t target = this->cpu_cycle + nsToCycles(ns);
+	uint64_t at;
+
+	serviceIrqs();
+	while(!this->events.empty() && this->events.top().cycle < target){
+		at = this->events.top().cycle > this->cpu_cycle ? this->events.top().cycle : this->cpu_cycle;
+		this->cpu_cycle = at;
+		runEvents(at);
+		// Un fronte sui pad è registrato al ciclo successivo
+		this->cpu_cycle = at + 1;
+		serviceIrqs();
+	}
+	if(this->cpu_cycle < target)
+		this->cpu_cycle = target;
+	serviceIrqs();
+}
+
+/**
+* @brief Stampa il resoconto della simulazione.
+*/
+void SimBoard::report(FILE* out) const
+{
+	double ns_per_cycle = 1e9 / this->clock_hz;
+
+	fprintf(out, "Tempo simulato: %.3f ms, eventi sui pad: %llu\n", nowNs() / 1e6, (unsigned long long)this->applied);
+	fprintf(out, "%-10s %9s %9s %8s %9s %8s %8s %8s %8s %24s\n", "periferica", "letture", "scritture",
+		"fronti", "accorpati", "persi", "conflitti", "irq", "servite", "latenza min/med/max (ns)");
+	for(size_t i = 0; i < this->devices.size(); i++){
+		const Device& d = this->devices[i];
+		const GpioModel::Stats& s = d.model->stats();
+
+		fprintf(out, "%-10s %9llu %9llu %8llu %9llu %8llu %8llu %8llu %8llu", d.name,
+			(unsigned long long)s.reads, (unsigned long long)s.writes, (unsigned long long)s.edges,
+			(unsigned long long)s.coalesced, (unsigned long long)s.cleared_lost,
+			(unsigned long long)s.conflicts, (unsigned long long)s.irqs, (unsigned long long)d.served);
+		if(d.measured)
+			fprintf(out, " %8.0f/%7.0f/%7.0f\n", d.latency_min * ns_per_cycle,
+				(double)d.latency_sum / d.measured * ns_per_cycle, d.latency_max * ns_per_cycle);
+		else
+			fprintf(out, " %24s\n", "-");
+	}
+}
+
+uint32_t SimBoard::backendRead(void* ctx, uint32_t* base, int offset)
+{
+	SimBoard* board = (SimBoard*)ctx;
+	GpioModel* model = board->devices[board->lookup(base)].model;
+	uint32_t value;
+
+	board->runEvents(board->cpu_cycle);
+	board->alignAll();
+	value = model->read(offset);
+	board->cpu_cycle = model->now();
+	board->serviceIrqs();
+	return value;
+}
+
+void SimBoard::backendWrite(void* ctx, uint32_t* base, int offset, uint32_t mask)
+{
+	SimBoard* board = (SimBoard*)ctx;
+	GpioModel* model = board->devices[board->lookup(base)].model;
+
+	board->runEvents(board->cpu_cycle);
+	board->alignAll();
+	model->write(offset, mask);
+	board->cpu_cycle = model->now();
+	board->serviceIrqs();
+}
+
+/**
+* @brief Restituisce l'indice della periferica di un modello della scheda.
+*/
+size_t SimBoard::indexOf(const GpioModel& model) const
+{
+	for(size_t i = 0; i < this->devices.size(); i++){
+		if(this->devices[i].model == &model)
+			return i;
+	}
+	assert(!"Modello non appartenente alla scheda");
+	return 0;
+}
+
+/**
+* @brief Individua la periferica associata all'indirizzo base.
+*/
+size_t SimBoard::lookup(uint32_t* base)
+{
+	if(this->last_device < this->devices.size() && this->devices[this->last_device].base_address == base)
+		return this->last_device;
+	for(size_t i = 0; i < this->devices.size(); i++){
+		if(this->devices[i].base_address == base){
+			this->last_device = i;
+			return i;
+		}
+	}
+	assert(!"Indirizzo base non associato ad alcuna periferica");
+	return 0;
+}
+
+/**
+* @brief Inserisce una variazione dei pad nella coda degli eventi.
+*/
+void SimBoard::push(uint64_t cycle, size_t device, uint32_t value, uint32_t mask, int stimulus)
+{
+	Event event;
+
+	event.cycle = cycle;
+	event.seq = this->seq++;
+	event.device = device;
+	event.value = value;
+	event.mask = mask;
+	event.stimulus = stimulus;
+	this->events.push(event);
+}
+
+/**
+* @brief Inserisce nella coda il prossimo evento di uno stimolo.
+*/
+void SimBoard::schedule(int stimulus)
+{
+	double time_ns;
+	uint32_t value;
+
+	if(this->stimuli[stimulus].next(&time_ns, &value))
+		push(nsToCycles(time_ns), this->stimulus_device[stimulus], value, this->stimuli[stimulus].mask(), stimulus);
+}
+
+/**
+* @brief Applica ai modelli gli eventi fino al ciclo until compreso.
+*
+* @details Un evento destinato ad un modello che ha già superato il suo ciclo (un
+* 	collegamento con ritardo minore della durata di un accesso) è applicato al ciclo
+* 	corrente del modello.
+*/
+void SimBoard::runEvents(uint64_t until)
+{
+	while(!this->events.empty() && this->events.top().cycle <= until){
+		Event event = this->events.top();
+		GpioModel* model = this->devices[event.device].model;
+
+		this->events.pop();
+		model->advanceTo(event.cycle);
+		model->drive(event.value, event.mask);
+		this->applied++;
+		if(event.stimulus >= 0)
+			schedule(event.stimulus);
+	}
+}
+
+/**
+* @brief Porta tutti i modelli al tempo del processore, così che i fronti già avvenuti
+* 	siano registrati e le linee irq aggiornate.
+*/
+void SimBoard::alignAll()
+{
+	for(size_t i = 0; i < this->devices.size(); i++)
+		this->devices[i].model->advanceTo(this->cpu_cycle);
+}
+
+/**
+* @brief Esegue i gestori delle periferiche con irq alto, se il processore non sta già
+* 	servendo un'interruzione.
+*/
+void SimBoard::serviceIrqs()
+{
+	uint64_t latency;
+	size_t i;
+
+	runEvents(this->cpu_cycle);
+	alignAll();
+	if(this->in_handler)
+		return;
+
+	for(;;){
+		for(i = 0; i < this->devices.size(); i++){
+			if(this->devices[i].handler && this->devices[i].model->irq())
+				break;
+		}
+		if(i == this->devices.size())
+			return;
+
+		Device& d = this->devices[i];
+		this->cpu_cycle += this->irq_entry;
+		if(d.irq_pending){
+			latency = this->cpu_cycle - d.irq_cycle;
+			d.latency_sum += latency;
+			if(latency < d.latency_min)
+				d.latency_min = latency;
+			if(latency > d.latency_max)
+				d.latency_max = latency;
+			d.measured++;
+			d.irq_pending = false;
+		}
+		d.served++;
+
+		this->in_handler = true;
+		runEvents(this->cpu_cycle);
+		alignAll();
+		d.handler();
+		this->in_handler = false;
+
+		runEvents(this->cpu_cycle);
+		alignAll();
+	}
+}
+/** @} */
@@ -0,0 +1,201 @@
+/**
+* @file Stimulus.cpp
+* @brief Implementazione dei generatori di stimoli.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup SIM
+* @{
+*/
+/***************************** Include Files ********************************/
+#include <assert.h>
+#include <algorithm>
+
+#include "Stimulus.h"
+
+/**
+* @brief Costruttore. Tutti i pin partono a 0.
+*
+* @param profile è il profilo dello stimolo.
+* @param mask sono i pin pilotati (non vuota).
+* @param rate_hz è la frequenza media degli eventi; ignorata per SCRIPT.
+*/
+Stimulus::Stimulus(Profile profile, uint32_t mask, double rate_hz)
+{
+	assert(mask != 0);
+	assert(profile == SCRIPT || rate_hz > 0);
+
+	this->profile = profile;
+	this->pin_mask = mask;
+	this->rate_hz = rate_hz;
+	this->burst_length = 8;
+	this->intra_rate_hz = rate_hz * 1000;
+	this->max_bounces = 5;
+	this->bounce_window_ns = 1e6;
+	this->loop = false;
+	this->script_index = 0;
+	this->script_offset_ns = 0;
+	this->time_ns = 0;
+	this->value = 0;
+	this->rng.seed(1);
+}
+
+/**
+* @brief Aggiunge un passo ad uno stimolo SCRIPT. I passi vanno aggiunti in ordine di tempo.
+*/
+void Stimulus::addStep(double time_ns, uint32_t value)
+{
+	assert(this->profile == SCRIPT);
+	assert(this->script.empty() || time_ns >= this->script.back().time_ns);
+
+	this->script.push_back({ time_ns, value & this->pin_mask });
+}
+
+/**
+* @brief Ripete lo script indefinitamente (il periodo è l'istante dell'ultimo passo,
+* 	che deve essere maggiore di zero).
+*/
+void Stimulus::setLoop(bool loop)
+{
+	this->loop = loop;
+}
+
+/**
+* @brief Imposta la lunghezza delle raffiche e la frequenza media al loro interno.
+*/
+void Stimulus::setBurst(unsigned int length, double intra_rate_hz)
+{
+	assert(length > 0 && intra_rate_hz > 0);
+
+	this->burst_length = length;
+	this->intra_rate_hz = intra_rate_hz;
+}
+
+/**
+* @brief Imposta il numero massimo di rimbalzi e la durata della finestra in cui avvengono.
+*/
+void Stimulus::setBounce(unsigned int max_bounces, double window_ns)
+{
+	this->max_bounces = max_bounces;
+	this->bounce_window_ns = window_ns;
+}
+
+/**
+* @brief Imposta il seme del generatore pseudo-casuale.
+*/
+void Stimulus::setSeed(unsigned int seed)
+{
+	this->rng.seed(seed);
+}
+
+/**
+* @brief Restituisce il prossimo evento.
+*
+* @param time_ns è l'istante dell'evento, dall'inizio della simulazione.
+* @param value è il valore dei pin della maschera a partire da quell'istante.
+*
+* @return false se lo stimolo è terminato.
+*/
+bool Stimulus::next(double* time_ns, uint32_t* value)
+{
+	if(this->pending.empty())
+		generate();
+	if(this->pending.empty())
+		return false;
+
+	*time_ns = this->pending.front().time_ns;
+	*value = this->pending.front().value;
+	this->pending.pop_front();
+	return true;
+}
+
+/**
+* @brief Genera il prossimo gruppo di eventi (un passo, una commutazione, una raffica o
+* 	un cambio di stato con i suoi rimbalzi).
+*/
+void Stimulus::generate()
+{
+	std::exponential_distribution<double> interval(this->rate_hz > 0 ? this->rate_hz / 1e9 : 1);
+
+	switch(this->profile){
+		case SCRIPT:
+			if(this->script_index == this->script.size()){
+				if(!this->loop || this->script.empty() || this->script.back().time_ns <= 0)
+					return;
+				this->script_offset_ns += this->script.back().time_ns;
+				this->script_index = 0;
+			}
+			this->pending.push_back({ this->script_offset_ns + this->script[this->script_index].time_ns,
+				this->script[this->script_index].value });
+			this->script_index++;
+			break;
+
+		case POISSON:
+			this->time_ns += interval(this->rng);
+			this->value ^= randomPin();
+			this->pending.push_back({ this->time_ns, this->value });
+			break;
+
+		case BURST: {
+			std::exponential_distribution<double> intra(this->intra_rate_hz / 1e9);
+
+			this->time_ns += interval(this->rng);
+			for(unsigned int i = 0; i < this->burst_length; i++){
+				if(i > 0)
+					this->time_ns += intra(this->rng);
+				this->value ^= randomPin();
+				this->pending.push_back({ this->time_ns, this->value });
+			}
+			break;
+		}
+
+		case BOUNCE: {
+			std::uniform_int_distribution<unsigned int> bounces(0, this->max_bounces);
+			std::uniform_real_distribution<double> offset(0, this->bounce_window_ns);
+			std::vector<double> times;
+			uint32_t pin = randomPin();
+			unsigned int n = bounces(this->rng);
+			double start;
+
+			// Ogni rimbalzo è una coppia di commutazioni; l'ultima commutazione è quella stabile
+			this->time_ns += interval(this->rng);
+			start = this->time_ns;
+			for(unsigned int i = 0; i < 2 * n; i++)
+				times.push_back(start + offset(this->rng));
+			std::sort(times.begin(), times.end());
+			for(size_t i = 0; i < times.size(); i++){
+				this->value ^= pin;
+				this->pending.push_back({ times[i], this->value });
+			}
+			this->time_ns = start + (n ? this->bounce_window_ns : 0);
+			this->value ^= pin;
+			this->pending.push_back({ this->time_ns, this->value });
+			break;
+		}
+	}
+}
+
+/**
+* @brief Restituisce uno dei pin della maschera, scelto a caso.
+*/
+uint32_t Stimulus::randomPin()
+{
+	int count = __builtin_popcount(this->pin_mask);
+	int index = std::uniform_int_distribution<int>(0, count - 1)(this->rng);
+	uint32_t mask = this->pin_mask;
+
+	while(index-- > 0)
+		mask &= mask - 1;
+	return mask & -mask;
+}
+/** @} */
@@ -0,0 +1,226 @@
+/**
+* @file boardsim.cpp
+* @brief Prova delle interruzioni su una scheda simulata con LED, switch e pulsanti.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup SIM
+* @{
+*/
+/***************************** Include Files ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "SimBoard.h"
+
+extern "C" {
+#include "gpio.h"
+#include "config.h"
+}
+
+/************************** Constant Definitions *****************************/
+#define ALL_PINS   (GPIO_PIN_0|GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3)
+#define LOOP_PINS  (GPIO_PIN_0|GPIO_PIN_1)     ///< Pulsanti collegati ai LED
+#define BTN_PINS   (GPIO_PIN_2|GPIO_PIN_3)     ///< Pulsanti pilotati dallo stimolo
+#define TRACE_ENTRIES  (1 << 20)               ///< Record della traccia degli accessi
+
+/************************** Variable Definitions *****************************/
+static myGpio_t gpio_led, gpio_switch, gpio_btn;
+static uint32_t led_data = 0;
+static unsigned long btn_presses = 0;
+static SimBoard* trace_board = NULL;           ///< Scheda che fornisce l'orologio della traccia
+
+/************************** Function Prototypes *****************************/
+static void switch_IRQHandler();
+static void button_IRQHandler();
+static Stimulus make_stimulus(const char* profile, double rate_hz);
+static uint64_t trace_clock();
+static int trace_save(const char* path, const std::vector<gpio_trace_record>& records);
+
+/**
+* @details Ricostruisce la scheda di config.h: i LED sono riportati sui primi due
+* 	pulsanti con un ritardo di propagazione, gli switch sono pilotati dallo stimolo
+* 	scelto e gli altri due pulsanti da un processo di Poisson. I gestori sono quelli di
+* 	main.c (switch) e un gestore che conta le pressioni dei pulsanti.
+*
+* 	Il processore attende le interruzioni a passi di 10 us di tempo simulato.
+*
+* 	Con il quinto argomento gli accessi ai registri e gli ingressi nei gestori sono
+* 	registrati, con il tempo simulato, nel file indicato (si veda src/trace).
+*
+* 	Es: ./boardsim 100 bounce 2000 50 bounce.trc
+* 		(100 ms simulati, switch con rimbalzi a 2 kHz, 50 ns tra LED e pulsanti)
+*/
+int main(int argc, char *argv[])
+{
+	double duration_ms = argc > 1 ? atof(argv[1]) : 100;
+	const char* profile = argc > 2 ? argv[2] : "bounce";
+	double rate_hz = argc > 3 ? atof(argv[3]) : 1000;
+	double delay_ns = argc > 4 ? atof(argv[4]) : 50;
+	const char* trace_path = argc > 5 ? argv[5] : NULL;
+	std::vector<gpio_trace_record> trace;
+	myGpio_config gpio_config;
+	struct timespec start, end;
+	double wall;
+	SimBoard board;
+
+	GpioModel& led = board.addDevice("led", (uint32_t*)GPIO_LED_BASEADDR);
+	GpioModel& swt = board.addDevice("switch", (uint32_t*)GPIO_SWITCH_BASEADDR);
+	GpioModel& btn = board.addDevice("button", (uint32_t*)GPIO_BUTTON_BASEADDR);
+	Stimulus btn_stimulus(Stimulus::POISSON, BTN_PINS, rate_hz / 4);
+
+	btn_stimulus.setSeed(2);
+	board.connect(led, btn, LOOP_PINS, delay_ns);
+	board.attach(swt, make_stimulus(profile, rate_hz));
+	board.attach(btn, btn_stimulus);
+	board.setIrqHandler(swt, switch_IRQHandler);
+	board.setIrqHandler(btn, button_IRQHandler);
+	// Ingresso nell'eccezione, salvataggio del contesto e lettura di ICCIAR
+	board.setIrqEntry(300);
+	board.install();
+
+	// La registrazione parte prima dell'inizializzazione, così che ogni periferica sia
+	// descritta nella traccia prima delle sue interruzioni
+	if(trace_path){
+		trace.resize(TRACE_ENTRIES);
+		trace_board = &board;
+		gpio_ll_trace_start(trace.data(), TRACE_ENTRIES, trace_clock);
+	}
+
+	gpio_config.interrupt_config = INT_DISABLED;
+	gpio_config.base_address = (uint32_t*)GPIO_LED_BASEADDR;
+	myGpio_init(&gpio_led, &gpio_config);
+	gpio_config.interrupt_config = INT_ENABLED;
+	gpio_config.base_address = (uint32_t*)GPIO_SWITCH_BASEADDR;
+	myGpio_init(&gpio_switch, &gpio_config);
+	gpio_config.base_address = (uint32_t*)GPIO_BUTTON_BASEADDR;
+	myGpio_init(&gpio_btn, &gpio_config);
+
+	myGpio_setDataDirection(&gpio_led, ALL_PINS, GPIO_WRITE);
+	myGpio_setDataDirection(&gpio_switch, ALL_PINS, GPIO_READ);
+	myGpio_setDataDirection(&gpio_btn, ALL_PINS, GPIO_READ);
+	myGpio_interruptEnable(&gpio_switch, ALL_PINS);
+	myGpio_interruptClear(&gpio_switch, ALL_PINS);
+	myGpio_interruptEnable(&gpio_btn, ALL_PINS);
+	myGpio_interruptClear(&gpio_btn, ALL_PINS);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while(board.nowNs() < duration_ms * 1e6)
+		board.idle(10000);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	wall = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	board.report(stdout);
+	printf("Pressioni dei pulsanti: %lu, LED finali: 0x%x\n", btn_presses, led_data & ALL_PINS);
+	printf("Tempo reale: %.3f s (simulazione %.1fx più veloce del tempo reale)\n", wall, board.nowNs() / 1e9 / wall);
+
+	if(trace_path && trace_save(trace_path, trace) < 0){
+		perror(trace_path);
+		return 1;
+	}
+
+	board.remove();
+	return 0;
+}
+
+/**
+* @brief Gestore degli switch, come gpio_IRQHandler di main.c.
+*/
+static void switch_IRQHandler()
+{
+	gpio_ll_trace_irq(gpio_switch.base_address);
+
+	uint32_t pending_int = myGpio_interruptGetStatus(&gpio_switch);
+	uint32_t swt_data = myGpio_read_value(&gpio_switch);
+
+	led_data = led_data + swt_data;
+	myGpio_write_value(&gpio_led, led_data);
+	myGpio_interruptClear(&gpio_switch, pending_int);
+}
+
+/**
+* @brief Gestore dei pulsanti: conta i fronti registrati e li cancella.
+*/
+static void button_IRQHandler()
+{
+	gpio_ll_trace_irq(gpio_btn.base_address);
+
+	uint32_t pending_int = myGpio_interruptGetStatus(&gpio_btn);
+
+	btn_presses += __builtin_popcount(pending_int);
+	myGpio_interruptClear(&gpio_btn, pending_int);
+}
+
+/**
+* @brief Costruisce lo stimolo degli switch a partire dal nome del profilo.
+*/
+static Stimulus make_stimulus(const char* profile, double rate_hz)
+{
+	if(strcmp(profile, "poisson") == 0)
+		return Stimulus(Stimulus::POISSON, ALL_PINS, rate_hz);
+
+	if(strcmp(profile, "burst") == 0){
+		Stimulus stimulus(Stimulus::BURST, ALL_PINS, rate_hz / 8);
+		stimulus.setBurst(8, rate_hz * 100);
+		return stimulus;
+	}
+
+	if(strcmp(profile, "script") == 0){
+		Stimulus stimulus(Stimulus::SCRIPT, ALL_PINS);
+		for(int i = 1; i <= 16; i++)
+			stimulus.addStep(i * 1e9 / rate_hz, i & 0xF);
+		stimulus.setLoop(true);
+		return stimulus;
+	}
+
+	// Rimbalzi fino a 5 per cambio di stato, in una finestra di 200 us
+	Stimulus stimulus(Stimulus::BOUNCE, ALL_PINS, rate_hz);
+	stimulus.setBounce(5, 200000);
+	return stimulus;
+}
+/**
+* @brief Orologio della traccia: il tempo simulato della scheda.
+*/
+static uint64_t trace_clock()
+{
+	return (uint64_t)trace_board->nowNs();
+}
+
+/**
+* @brief Termina la registrazione e scrive la traccia nel file indicato.
+*
+* @return 0 in caso di successo, -1 altrimenti.
+*/
+static int trace_save(const char* path, const std::vector<gpio_trace_record>& records)
+{
+	gpio_trace_header header;
+	FILE* file;
+	int ret = 0;
+
+	gpio_ll_trace_stop(&header);
+	printf("Traccia: %u record, %u persi\n", header.records, header.dropped);
+
+	file = fopen(path, "wb");
+	if(file == NULL)
+		return -1;
+	if(fwrite(&header, sizeof(header), 1, file) != 1 ||
+		fwrite(records.data(), sizeof(gpio_trace_record), header.records, file) != header.records)
+		ret = -1;
+	if(fclose(file) != 0)
+		ret = -1;
+	return ret;
+}
+/** @} */
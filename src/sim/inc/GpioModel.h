@@ -0,0 +1,161 @@
+/**
+* @file GpioModel.h
+* @brief Modello software della periferica GPIO (gpio_v2_0) per la simulazione su host.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program; if not,
+* write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup SIM
+* @{
+*
+* @brief Questo modulo contiene un modello della periferica @ref GPIO, accurato al ciclo
+* 		di clock, da usare al posto dell'hardware per provare i driver su host.
+*
+* @details Il modello riproduce gpio_v2_0_S00_AXI.vhd:
+* 		- DOUT, TRI ed IER sono registri a 32 bit (slv_reg0, slv_reg1, slv_reg3); DIN ed
+* 		  ISR sono in sola lettura; ICL si legge come 0 e la sua scrittura produce un
+* 		  impulso di clear di un ciclo; l'indirizzo è decodificato su 3 bit, per cui i
+* 		  registri si ripetono ogni 32 byte;
+* 		- ogni pad (gpio_pad) riporta DOUT se il bit di TRI è 1, altrimenti il valore
+* 		  imposto dall'esterno con drive(); un pin non pilotato da nessuno legge 0;
+* 		- un fronte di salita del pad (anche di un pin in uscita) è rilevato al fronte di
+* 		  clock successivo (livelli2impulsi) e registrato in ISR (irq_generation), che
+* 		  resta alto finché non viene azzerato da ICL; il clear ha priorità, per cui un
+* 		  fronte registrato nello stesso ciclo di un clear va perso. Un impulso più breve
+* 		  di un ciclo di clock non viene rilevato;
+* 		- irq è l'OR dei bit di ISR abilitati in IER.
+*
+* 		Il tempo è contato in cicli di clock: ogni accesso ai registri dura il numero di
+* 		cicli impostato con setAccessLatency ed il tempo avanza anche con advance().
+* 		La valutazione è pigra (lo stato cambia solo agli accessi ed agli stimoli), per
+* 		cui il costo di un accesso non dipende dal tempo simulato.
+*
+* 		Il modello si collega a gpio_ll attraverso il backend (GPIO_LL_BACKEND): ogni modello
+* 		è associato con bind() ad un indirizzo base fittizio, da passare al driver C
+* 		(myGpio_config) o C++ (MyGpio) come se fosse quello della periferica.
+*/
+/*****************************************************************************/
+#ifndef SRC_SIM_GPIOMODEL_H_
+#define SRC_SIM_GPIOMODEL_H_
+
+/***************************** Include Files ********************************/
+#include <stdint.h>
+#include <functional>
+
+extern "C" {
+#include "gpio_ll.h"
+}
+
+class GpioModel {
+public:
+	/**
+	 * @brief Callback invocata ad ogni variazione della linea di interruzione.
+	 *
+	 * @param level è il nuovo livello della linea.
+	 * @param cycle è il ciclo di clock al quale la linea cambia livello.
+	 */
+	typedef std::function<void(bool level, uint64_t cycle)> IrqCallback;
+
+	/**
+	 * @brief Callback invocata ad ogni variazione dei pad.
+	 *
+	 * @param pads è il nuovo valore dei pad.
+	 * @param cycle è il ciclo di clock della variazione.
+	 */
+	typedef std::function<void(uint32_t pads, uint64_t cycle)> PadCallback;
+
+	GpioModel(unsigned int size = 4, double clock_hz = 100e6);
+	~GpioModel();
+
+  /**
+   * @name Configurazione
+   * @{
+   */
+	void setAccessLatency(unsigned int read_cycles, unsigned int write_cycles);
+	void setIrqCallback(IrqCallback callback);
+	void setPadCallback(PadCallback callback);
+	void bind(uint32_t* base_address);
+	static void installBackend();
+	static void removeBackend();
+  /* @} */
+
+  /**
+   * @name Accesso ai registri (lato AXI)
+   * @{
+   */
+	uint32_t read(int offset);
+	void write(int offset, uint32_t value);
+  /* @} */
+
+  /**
+   * @name Lato pad
+   * @{
+   */
+	void drive(uint32_t value, uint32_t mask);
+	void release(uint32_t mask);
+	uint32_t pads();
+	bool irq() const { return irq_level; }
+  /* @} */
+
+  /**
+   * @name Tempo
+   * @{
+   */
+	void advance(uint64_t cycles);
+	void advanceTo(uint64_t cycle);
+	uint64_t now() const { return cycle; }
+	double nowNs() const { return cycle * 1e9 / clock_hz; }
+	uint64_t nsToCycles(double ns) const { return (uint64_t)(ns * clock_hz / 1e9); }
+  /* @} */
+
+	/**
+	 * @brief Contatori del modello.
+	 */
+	struct Stats {
+		uint64_t reads;           ///< Letture di registri
+		uint64_t writes;          ///< Scritture di registri
+		uint64_t edges;           ///< Fronti di salita registrati in ISR
+		uint64_t coalesced;       ///< Fronti arrivati su bit di ISR già alti
+		uint64_t cleared_lost;    ///< Fronti persi perché registrati nello stesso ciclo di un clear
+		uint64_t conflicts;       ///< Pilotaggi esterni di pin configurati in uscita
+		uint64_t irqs;            ///< Fronti di salita della linea di interruzione
+	};
+	const Stats& stats() const { return counters; }
+
+private:
+	void sync(uint64_t at);
+	void updatePads();
+	void updateIrq(uint64_t at);
+
+	unsigned int size;              ///< Numero di pin (generic gpio_size)
+	uint32_t pin_mask;              ///< Maschera dei pin esistenti
+	double clock_hz;                ///< Frequenza di S_AXI_ACLK
+	unsigned int read_latency;      ///< Durata di una lettura in cicli
+	unsigned int write_latency;     ///< Durata di una scrittura in cicli
+	uint64_t cycle;                 ///< Ciclo di clock corrente
+
+	uint32_t dout, tri, ier, isr;   ///< Registri
+	uint32_t ext_value, ext_mask;   ///< Pilotaggio esterno dei pad
+	uint32_t pad;                   ///< Valore corrente dei pad (pad_in)
+	uint32_t sampled;               ///< Valore dei pad all'ultimo fronte di clock (stato di livelli2impulsi)
+	uint64_t pad_cycle;             ///< Ciclo dell'ultima variazione dei pad
+	uint32_t latched;               ///< Bit di ISR registrati dall'ultimo impulso di livelli2impulsi
+	uint64_t latch_cycle;           ///< Ciclo dell'ultimo impulso di livelli2impulsi
+	bool irq_level;                 ///< Livello corrente della linea di interruzione
+	IrqCallback irq_callback;
+	PadCallback pad_callback;
+	uint32_t* base_address;         ///< Indirizzo base associato con bind()
+	Stats counters;
+};
+
+#endif /* SRC_SIM_GPIOMODEL_H_ */
+/** @} */
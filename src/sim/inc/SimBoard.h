@@ -0,0 +1,149 @@
+/**
+* @file SimBoard.h
+* @brief Scheda simulata con più periferiche GPIO collegate tra loro e a generatori di stimoli.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program; if not,
+* write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup SIM
+* @{
+*
+* @details La scheda raggruppa più istanze di GpioModel (ad esempio LED, switch e pulsanti
+* 		come in config.h) su un unico clock e sostituisce il backend di gpio_ll, così che
+* 		le applicazioni girino sul driver C o C++ senza modifiche.
+*
+* 		Il tempo della scheda è quello del processore: avanza con gli accessi ai registri,
+* 		con idle() e con l'ingresso nei gestori di interruzione. Gli eventi sui pad
+* 		(stimoli e collegamenti tra uscite ed ingressi, con il loro ritardo di
+* 		propagazione) sono ordinati in una coda e applicati ai modelli prima di ogni
+* 		accesso; durante idle() il processore si risveglia al ciclo in cui irq si alza.
+*
+* 		Quando la linea irq di una periferica con gestore è alta e il processore non sta
+* 		già servendo un'interruzione, il gestore viene eseguito dopo setIrqEntry()
+* 		nanosecondi (ingresso nell'eccezione e GIC): la latenza tra il fronte di irq e
+* 		l'ingresso nel gestore è riportata nelle statistiche. Come per un'interruzione
+* 		a livello, un gestore che non cancella ISR viene richiamato subito.
+*/
+/*****************************************************************************/
+#ifndef SRC_SIM_SIMBOARD_H_
+#define SRC_SIM_SIMBOARD_H_
+
+/***************************** Include Files ********************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "GpioModel.h"
+#include "Stimulus.h"
+
+class SimBoard {
+public:
+	typedef std::function<void()> IrqHandler;
+
+	SimBoard(double clock_hz = 100e6);
+	~SimBoard();
+
+  /**
+   * @name Composizione della scheda
+   * @{
+   */
+	GpioModel& addDevice(const char* name, uint32_t* base_address, unsigned int size = 4);
+	void connect(GpioModel& from, GpioModel& to, uint32_t mask, double delay_ns);
+	void attach(GpioModel& to, const Stimulus& stimulus);
+	void setIrqHandler(GpioModel& device, IrqHandler handler);
+	void setIrqEntry(double ns);
+	void install();
+	void remove();
+  /* @} */
+
+  /**
+   * @name Tempo
+   * @{
+   */
+	void idle(double ns);
+	uint64_t now() const { return cpu_cycle; }
+	double nowNs() const { return cpu_cycle * 1e9 / clock_hz; }
+  /* @} */
+
+	void report(FILE* out) const;
+
+private:
+	/**
+	 * @brief Periferica della scheda.
+	 */
+	struct Device {
+		const char* name;
+		uint32_t* base_address;
+		GpioModel* model;
+		IrqHandler handler;
+		bool irq_pending;               ///< irq alto e non ancora servito
+		uint64_t irq_cycle;             ///< Ciclo dell'ultimo fronte di salita di irq
+		uint64_t served;                ///< Ingressi nel gestore
+		uint64_t measured;              ///< Fronti di irq serviti (latenze misurate)
+		uint64_t latency_min, latency_max, latency_sum;   ///< Latenza di ingresso in cicli
+	};
+
+	/**
+	 * @brief Collegamento tra i pad di due periferiche.
+	 */
+	struct Link {
+		size_t from, to;
+		uint32_t mask;
+		uint64_t delay;                 ///< Ritardo di propagazione in cicli
+	};
+
+	/**
+	 * @brief Variazione dei pad da applicare ad una periferica.
+	 */
+	struct Event {
+		uint64_t cycle;
+		uint64_t seq;                   ///< Ordine di inserimento, a parità di ciclo
+		size_t device;
+		uint32_t value, mask;
+		int stimulus;                   ///< Stimolo che l'ha generata, -1 per i collegamenti
+		bool operator>(const Event& other) const
+		{
+			return cycle != other.cycle ? cycle > other.cycle : seq > other.seq;
+		}
+	};
+
+	static uint32_t backendRead(void* ctx, uint32_t* base, int offset);
+	static void backendWrite(void* ctx, uint32_t* base, int offset, uint32_t mask);
+
+	size_t indexOf(const GpioModel& model) const;
+	size_t lookup(uint32_t* base);
+	void push(uint64_t cycle, size_t device, uint32_t value, uint32_t mask, int stimulus);
+	void schedule(int stimulus);
+	void runEvents(uint64_t until);
+	void alignAll();
+	void serviceIrqs();
+	uint64_t nsToCycles(double ns) const { return (uint64_t)(ns * clock_hz / 1e9 + 0.5); }
+
+	double clock_hz;
+	uint64_t cpu_cycle;                 ///< Tempo del processore
+	uint64_t irq_entry;                 ///< Cicli di ingresso nel gestore
+	bool in_handler;
+	std::vector<Device> devices;
+	std::vector<Link> links;
+	std::vector<Stimulus> stimuli;
+	std::vector<size_t> stimulus_device;
+	std::priority_queue<Event, std::vector<Event>, std::greater<Event> > events;
+	uint64_t seq;
+	size_t last_device;                 ///< Ultima periferica acceduta dal backend
+	uint64_t applied;                   ///< Eventi applicati ai pad
+	gpio_ll_backend backend;
+};
+
+#endif /* SRC_SIM_SIMBOARD_H_ */
+/** @} */
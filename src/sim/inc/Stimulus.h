@@ -0,0 +1,97 @@
+/**
+* @file Stimulus.h
+* @brief Generatori di stimoli per i pad dei modelli della periferica GPIO.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program; if not,
+* write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup SIM
+* @{
+*
+* @details Uno stimolo produce la sequenza, ordinata nel tempo, dei valori imposti ai pin
+* 		di una maschera. I profili disponibili sono:
+* 		- SCRIPT: valori assegnati ad istanti prefissati con addStep(), eventualmente
+* 		  ripetuti con periodo pari all'istante dell'ultimo passo;
+* 		- POISSON: un pin a caso della maschera commuta, con tempi tra le commutazioni
+* 		  distribuiti esponenzialmente (frequenza media rate_hz);
+* 		- BURST: raffiche di setBurst() commutazioni ravvicinate, con le raffiche che
+* 		  arrivano come un processo di Poisson di frequenza rate_hz;
+* 		- BOUNCE: un interruttore (un pin a caso) cambia stato con frequenza media rate_hz;
+* 		  ogni cambio è preceduto da un numero casuale di rimbalzi, distribuiti in una
+* 		  finestra di setBounce() nanosecondi.
+*
+* 		La sequenza è generata su richiesta, per cui la memoria occupata non dipende dalla
+* 		durata della simulazione, ed è riproducibile a parità di seme.
+*/
+/*****************************************************************************/
+#ifndef SRC_SIM_STIMULUS_H_
+#define SRC_SIM_STIMULUS_H_
+
+/***************************** Include Files ********************************/
+#include <stdint.h>
+#include <deque>
+#include <random>
+#include <vector>
+
+class Stimulus {
+public:
+	enum Profile { SCRIPT, POISSON, BURST, BOUNCE };
+
+	Stimulus(Profile profile, uint32_t mask, double rate_hz = 0);
+
+  /**
+   * @name Configurazione
+   * @{
+   */
+	void addStep(double time_ns, uint32_t value);
+	void setLoop(bool loop);
+	void setBurst(unsigned int length, double intra_rate_hz);
+	void setBounce(unsigned int max_bounces, double window_ns);
+	void setSeed(unsigned int seed);
+  /* @} */
+
+	uint32_t mask() const { return pin_mask; }
+	bool next(double* time_ns, uint32_t* value);
+
+private:
+	void generate();
+	uint32_t randomPin();
+
+	/**
+	 * @brief Passo di uno stimolo SCRIPT, oppure evento già generato.
+	 */
+	struct Step {
+		double time_ns;
+		uint32_t value;
+	};
+
+	Profile profile;
+	uint32_t pin_mask;                 ///< Pin pilotati dallo stimolo
+	double rate_hz;                    ///< Frequenza media degli eventi (o delle raffiche)
+	unsigned int burst_length;         ///< Commutazioni per raffica
+	double intra_rate_hz;              ///< Frequenza media delle commutazioni in una raffica
+	unsigned int max_bounces;          ///< Rimbalzi massimi per cambio di stato
+	double bounce_window_ns;           ///< Durata della finestra dei rimbalzi
+	bool loop;                         ///< Ripetizione dello script
+
+	std::vector<Step> script;
+	size_t script_index;
+	double script_offset_ns;           ///< Inizio della ripetizione corrente dello script
+
+	std::deque<Step> pending;          ///< Eventi generati e non ancora consumati
+	double time_ns;                    ///< Istante dell'ultimo evento generato
+	uint32_t value;                    ///< Valore corrente dei pin
+	std::mt19937 rng;
+};
+
+#endif /* SRC_SIM_STIMULUS_H_ */
+/** @} */
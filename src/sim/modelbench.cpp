@@ -0,0 +1,122 @@
+/**
+* @file modelbench.cpp
+* @brief Misura della velocità del modello della periferica con il driver C in esecuzione su host.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup SIM
+* @{
+*/
+/***************************** Include Files ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "GpioModel.h"
+
+extern "C" {
+#include "gpio.h"
+#include "config.h"
+}
+
+/************************** Function Prototypes *****************************/
+static double elapsed_s(struct timespec *from, struct timespec *to);
+
+/**
+* @details Esegue il ciclo di tb_gpio (lettura degli switch e scrittura dei LED) sul
+* 	driver C, con gli accessi ai registri instradati verso due modelli della periferica.
+* 	Gli switch commutano ogni period_ns nanosecondi di tempo simulato e le interruzioni
+* 	sono servite nel ciclo, come farebbe il gestore di main.c.
+*
+* 	Al termine riporta gli accessi simulati al secondo (tempo reale) ed il rapporto tra
+* 	tempo simulato e tempo reale.
+*
+* 	Es: ./modelbench 10000000 1000
+*/
+int main(int argc, char *argv[])
+{
+	unsigned long iterations = argc > 1 ? strtoul(argv[1], NULL, 0) : 10000000;
+	double period_ns = argc > 2 ? atof(argv[2]) : 1000;
+	GpioModel led_model, swt_model;
+	myGpio_t gpio_led, gpio_swt;
+	myGpio_config gpio_config;
+	struct timespec start, end;
+	uint64_t next_toggle, period;
+	uint32_t swt_value = 0;
+	unsigned long i, served = 0;
+	bool irq = false;
+	double wall;
+
+	led_model.bind((uint32_t*)GPIO_LED_BASEADDR);
+	swt_model.bind((uint32_t*)GPIO_SWITCH_BASEADDR);
+	swt_model.setIrqCallback([&irq](bool level, uint64_t){ irq = level; });
+	GpioModel::installBackend();
+
+	gpio_config.base_address = (uint32_t*)GPIO_LED_BASEADDR;
+	gpio_config.interrupt_config = INT_DISABLED;
+	myGpio_init(&gpio_led, &gpio_config);
+	gpio_config.base_address = (uint32_t*)GPIO_SWITCH_BASEADDR;
+	gpio_config.interrupt_config = INT_ENABLED;
+	myGpio_init(&gpio_swt, &gpio_config);
+
+	myGpio_setDataDirection(&gpio_led, GPIO_PIN_0|GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3, GPIO_WRITE);
+	myGpio_setDataDirection(&gpio_swt, GPIO_PIN_0|GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3, GPIO_READ);
+	myGpio_interruptEnable(&gpio_swt, GPIO_PIN_0|GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3);
+
+	period = swt_model.nsToCycles(period_ns);
+	if(period == 0)
+		period = 1;
+	next_toggle = swt_model.now() + period;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(i = 0; i < iterations; i++){
+		// I due modelli condividono il clock: il tempo è quello del processore che li usa
+		led_model.advanceTo(swt_model.now());
+		myGpio_write_value(&gpio_led, myGpio_read_value(&gpio_swt));
+		swt_model.advanceTo(led_model.now());
+
+		if(swt_model.now() >= next_toggle){
+			swt_value = (swt_value + 1) & 0xF;
+			swt_model.drive(swt_value, 0xF);
+			next_toggle += period;
+		}
+
+		if(irq){
+			myGpio_interruptClear(&gpio_swt, myGpio_interruptGetStatus(&gpio_swt));
+			served++;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	wall = elapsed_s(&start, &end);
+	const GpioModel::Stats &led = led_model.stats(), &swt = swt_model.stats();
+	unsigned long long accesses = led.reads + led.writes + swt.reads + swt.writes;
+
+	printf("Accessi simulati: %llu in %.3f s (%.1f milioni al secondo)\n", accesses, wall, accesses / wall / 1e6);
+	printf("Tempo simulato: %.3f ms (%.2fx il tempo reale)\n", swt_model.nowNs() / 1e6, swt_model.nowNs() / 1e9 / wall);
+	printf("Fronti registrati: %llu, accorpati: %llu, persi per clear: %llu\n",
+		(unsigned long long)swt.edges, (unsigned long long)swt.coalesced, (unsigned long long)swt.cleared_lost);
+	printf("Interruzioni: %llu, servite: %lu\n", (unsigned long long)swt.irqs, served);
+
+	GpioModel::removeBackend();
+	return 0;
+}
+
+/**
+* @brief Restituisce il tempo in secondi trascorso tra due istanti.
+*/
+static double elapsed_s(struct timespec *from, struct timespec *to)
+{
+	return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1e9;
+}
+/** @} */
@@ -0,0 +1,432 @@
+/**
+* @file gpio_replay.c
+* @brief Implementazione del motore di riproduzione delle tracce.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup TRACE
+* @{
+*/
+/***************************** Include Files ********************************/
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gpio_replay.h"
+#include "gpio_ll.h"
+
+/************************** Constant Definitions *****************************/
+#define REPLAY_REGS   6       ///< Registri della periferica (fino a GPIO_ISR_OFFSET)
+#define REPLAY_SPIN_NS  200000  ///< Anticipo del risveglio, recuperato con un'attesa attiva
+
+/**************************** Type Definitions ******************************/
+/**
+* @brief Valore letto da DIN o da ISR durante la registrazione.
+*/
+struct replay_input {
+	uint64_t time;            ///< ns dal primo record
+	uint32_t value;
+};
+
+/**
+* @brief Ingresso nel gestore di interruzione registrato.
+*/
+struct replay_irq {
+	uint64_t time;
+	unsigned int device;
+};
+
+/**
+* @brief Periferica della riproduzione.
+*/
+struct replay_device {
+	uint32_t* base_address;           ///< Indirizzo usato dal driver, NULL se non ancora visto
+	uint32_t recorded_base;           ///< 32 bit bassi dell'indirizzo registrato
+	int recorded;                     ///< 1 se la traccia riporta l'indirizzo
+	struct replay_input* din;
+	uint32_t din_count, din_next;
+	struct replay_input* isr;
+	uint32_t isr_count, isr_next;
+	uint32_t irqs;
+	gpio_replay_handler handler;
+	void* ctx;
+	uint32_t regs[REPLAY_REGS];       ///< Copie locali dei registri
+};
+
+/************************** Variable Definitions *****************************/
+static struct replay_device devices[GPIO_REPLAY_DEVICES];
+static unsigned int trace_devices = 0;    ///< Periferiche presenti nella traccia
+static unsigned int used_devices = 0;     ///< Periferiche della traccia più quelle viste solo nel driver
+static struct replay_irq* irqs = NULL;
+static uint32_t irq_count = 0, irq_next = 0;
+static enum gpio_replay_mode mode = GPIO_REPLAY_FAST;
+static uint64_t clock_ns = 0;             ///< Tempo virtuale (GPIO_REPLAY_FAST)
+static struct timespec origin;            ///< Inizio della riproduzione (GPIO_REPLAY_TIMED)
+static gpio_replay_stats stats;
+
+/************************** Function Prototypes *****************************/
+static uint64_t replay_now(void);
+static void replay_sleep_until(uint64_t time);
+static struct replay_device* replay_lookup(uint32_t* base);
+static uint32_t replay_input_read(struct replay_device* device, int offset);
+static uint32_t backend_read(void* ctx, uint32_t* base, int offset);
+static void backend_write(void* ctx, uint32_t* base, int offset, uint32_t mask);
+
+static const gpio_ll_backend replay_backend = { backend_read, backend_write, NULL };
+
+int gpio_replay_load(const char* path)
+{
+	gpio_trace_header header;
+	gpio_trace_record* records;
+	uint64_t time = 0, first = 0;
+	uint64_t* times;
+	uint32_t i;
+	unsigned int d;
+	FILE* file;
+
+	gpio_replay_unload();
+
+	file = fopen(path, "rb");
+	if(file == NULL)
+		return -1;
+	if(fread(&header, sizeof(header), 1, file) != 1 || header.magic != GPIO_TRACE_MAGIC ||
+		header.version != GPIO_TRACE_VERSION || header.record_size != sizeof(gpio_trace_record)){
+		fclose(file);
+		errno = EINVAL;
+		return -1;
+	}
+
+	records = malloc((size_t)header.records * sizeof(gpio_trace_record) + 1);
+	times = malloc((size_t)header.records * sizeof(uint64_t) + 1);
+	if(records == NULL || times == NULL || fread(records, sizeof(gpio_trace_record), header.records, file) != header.records){
+		free(records);
+		free(times);
+		fclose(file);
+		errno = records == NULL || times == NULL ? ENOMEM : EINVAL;
+		return -1;
+	}
+	fclose(file);
+
+	// Primo passaggio: tempi assoluti, periferiche e dimensione dei vettori
+	for(i = 0; i < header.records; i++){
+		gpio_trace_record* r = &records[i];
+
+		if(r->type == GPIO_TRACE_TIME)
+			time = ((uint64_t)r->value << 32) | r->time;
+		else
+			time = time + (int32_t)(r->time - (uint32_t)time);
+		times[i] = time;
+		if(i == 0)
+			first = time;
+
+		if(r->type == GPIO_TRACE_TIME)
+			continue;
+		if(r->device >= GPIO_REPLAY_DEVICES){
+			free(records);
+			free(times);
+			gpio_replay_unload();
+			errno = EINVAL;
+			return -1;
+		}
+		if(r->device >= trace_devices)
+			trace_devices = r->device + 1;
+
+		d = r->device;
+		if(r->type == GPIO_TRACE_DEVICE){
+			devices[d].recorded_base = r->value;
+			devices[d].recorded = 1;
+		}else if(r->type == GPIO_TRACE_IRQ){
+			devices[d].irqs++;
+			irq_count++;
+		}else if(r->type == GPIO_TRACE_READ && r->offset == GPIO_DIN_OFFSET)
+			devices[d].din_count++;
+		else if(r->type == GPIO_TRACE_READ && r->offset == GPIO_ISR_OFFSET)
+			devices[d].isr_count++;
+	}
+
+	for(d = 0; d < trace_devices; d++){
+		devices[d].din = malloc(devices[d].din_count * sizeof(struct replay_input) + 1);
+		devices[d].isr = malloc(devices[d].isr_count * sizeof(struct replay_input) + 1);
+		devices[d].din_count = devices[d].isr_count = 0;
+	}
+	irqs = malloc(irq_count * sizeof(struct replay_irq) + 1);
+	irq_count = 0;
+	for(d = 0; d < trace_devices; d++){
+		if(devices[d].din == NULL || devices[d].isr == NULL)
+			break;
+	}
+	if(irqs == NULL || d < trace_devices){
+		free(records);
+		free(times);
+		gpio_replay_unload();
+		errno = ENOMEM;
+		return -1;
+	}
+
+	// Secondo passaggio: ingressi ed interruzioni, con il tempo riferito al primo record
+	for(i = 0; i < header.records; i++){
+		gpio_trace_record* r = &records[i];
+		struct replay_device* device = &devices[r->device];
+		uint64_t t = times[i] > first ? times[i] - first : 0;
+
+		if(r->type == GPIO_TRACE_IRQ){
+			irqs[irq_count].time = t;
+			irqs[irq_count].device = r->device;
+			irq_count++;
+		}else if(r->type == GPIO_TRACE_READ && r->offset == GPIO_DIN_OFFSET){
+			device->din[device->din_count].time = t;
+			device->din[device->din_count].value = r->value;
+			device->din_count++;
+		}else if(r->type == GPIO_TRACE_READ && r->offset == GPIO_ISR_OFFSET){
+			device->isr[device->isr_count].time = t;
+			device->isr[device->isr_count].value = r->value;
+			device->isr_count++;
+		}
+	}
+
+	free(records);
+	free(times);
+	gpio_replay_start(GPIO_REPLAY_FAST);
+	return 0;
+}
+
+void gpio_replay_unload(void)
+{
+	unsigned int d;
+
+	for(d = 0; d < GPIO_REPLAY_DEVICES; d++){
+		free(devices[d].din);
+		free(devices[d].isr);
+	}
+	free(irqs);
+	memset(devices, 0, sizeof(devices));
+	irqs = NULL;
+	irq_count = irq_next = 0;
+	trace_devices = used_devices = 0;
+}
+
+unsigned int gpio_replay_devices(void)
+{
+	return trace_devices;
+}
+
+int gpio_replay_device(unsigned int device, gpio_replay_device_info* info)
+{
+	if(device >= trace_devices)
+		return -1;
+
+	info->base_address = devices[device].base_address;
+	if(info->base_address == NULL && devices[device].recorded)
+		info->base_address = (uint32_t*)(uintptr_t)devices[device].recorded_base;
+	info->irqs = devices[device].irqs;
+	info->din_reads = devices[device].din_count;
+	info->isr_reads = devices[device].isr_count;
+	return 0;
+}
+
+void gpio_replay_map(unsigned int device, uint32_t* base_address)
+{
+	assert(device < trace_devices);
+	devices[device].base_address = base_address;
+}
+
+void gpio_replay_set_handler(unsigned int device, gpio_replay_handler handler, void* ctx)
+{
+	assert(device < trace_devices);
+	devices[device].handler = handler;
+	devices[device].ctx = ctx;
+}
+
+/**
+* @details Va chiamata prima di inizializzare il driver, perchè azzera le copie locali
+* 	dei registri. Le periferiche viste solo nel driver sono dimenticate.
+*/
+void gpio_replay_start(enum gpio_replay_mode new_mode)
+{
+	unsigned int d;
+
+	for(d = 0; d < trace_devices; d++){
+		devices[d].din_next = devices[d].isr_next = 0;
+		memset(devices[d].regs, 0, sizeof(devices[d].regs));
+	}
+	memset(&devices[trace_devices], 0, (GPIO_REPLAY_DEVICES - trace_devices) * sizeof(struct replay_device));
+	used_devices = trace_devices;
+	irq_next = 0;
+	mode = new_mode;
+	clock_ns = 0;
+	memset(&stats, 0, sizeof(stats));
+	clock_gettime(CLOCK_MONOTONIC, &origin);
+}
+
+int gpio_replay_wait(void)
+{
+	struct replay_irq* irq;
+	uint64_t now, late;
+
+	while(irq_next < irq_count){
+		irq = &irqs[irq_next++];
+
+		if(mode == GPIO_REPLAY_TIMED){
+			replay_sleep_until(irq->time);
+			now = replay_now();
+			late = now > irq->time ? now - irq->time : 0;
+			stats.late_sum_ns += late;
+			if(late > stats.late_max_ns)
+				stats.late_max_ns = late;
+		}else if(irq->time > clock_ns)
+			clock_ns = irq->time;
+
+		if(devices[irq->device].handler == NULL){
+			stats.irqs_skipped++;
+			continue;
+		}
+		devices[irq->device].handler(devices[irq->device].ctx);
+		stats.irqs++;
+		return 1;
+	}
+	return 0;
+}
+
+void gpio_replay_get_stats(gpio_replay_stats* out)
+{
+	*out = stats;
+	out->time_ns = replay_now();
+}
+
+void gpio_replay_install(void)
+{
+	gpio_ll_set_backend(&replay_backend);
+}
+
+void gpio_replay_remove(void)
+{
+	gpio_ll_set_backend(NULL);
+}
+
+/**
+* @brief Tempo della riproduzione: virtuale in GPIO_REPLAY_FAST, reale in GPIO_REPLAY_TIMED.
+*/
+static uint64_t replay_now(void)
+{
+	struct timespec now;
+
+	if(mode == GPIO_REPLAY_FAST)
+		return clock_ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)(now.tv_sec - origin.tv_sec) * 1000000000 + now.tv_nsec - origin.tv_nsec;
+}
+
+/**
+* @brief Attende l'istante time della riproduzione (GPIO_REPLAY_TIMED).
+*
+* @details Il risveglio di clock_nanosleep arriva con decine di microsecondi di ritardo:
+* 	il processo dorme fino a REPLAY_SPIN_NS prima dell'istante e attende il resto in
+* 	modo attivo. Le interruzioni registrate a distanza ravvicinata non richiedono
+* 	alcuna chiamata di sistema oltre alla lettura dell'orologio.
+*/
+static void replay_sleep_until(uint64_t time)
+{
+	struct timespec deadline;
+	uint64_t wake;
+
+	if(time > REPLAY_SPIN_NS && replay_now() < time - REPLAY_SPIN_NS){
+		wake = origin.tv_nsec + time - REPLAY_SPIN_NS;
+		deadline.tv_sec = origin.tv_sec + wake / 1000000000;
+		deadline.tv_nsec = wake % 1000000000;
+		while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+	}
+	while(replay_now() < time);
+}
+
+/**
+* @brief Individua la periferica associata all'indirizzo base.
+*
+* @details Una periferica della traccia senza indirizzo associato è riconosciuta dai 32
+* 	bit bassi dell'indirizzo registrato; un indirizzo sconosciuto occupa una nuova
+* 	periferica, servita dalle sole copie locali dei registri.
+*/
+static struct replay_device* replay_lookup(uint32_t* base)
+{
+	unsigned int d;
+
+	for(d = 0; d < used_devices; d++){
+		if(devices[d].base_address == base)
+			return &devices[d];
+	}
+	for(d = 0; d < trace_devices; d++){
+		if(devices[d].base_address == NULL && devices[d].recorded && devices[d].recorded_base == (uint32_t)(uintptr_t)base){
+			devices[d].base_address = base;
+			return &devices[d];
+		}
+	}
+
+	assert(used_devices < GPIO_REPLAY_DEVICES);
+	devices[used_devices].base_address = base;
+	return &devices[used_devices++];
+}
+
+/**
+* @brief Lettura di DIN o ISR, servita con i valori registrati.
+*
+* @details In entrambe le modalità la k-esima lettura restituisce il k-esimo valore
+* 	registrato: il tempo reale di GPIO_REPLAY_TIMED scandisce solo le interruzioni in
+* 	gpio_replay_wait, così che i gestori vedono gli stessi ingressi della
+* 	registrazione indipendentemente dalla loro durata.
+*/
+static uint32_t replay_input_read(struct replay_device* device, int offset)
+{
+	struct replay_input* inputs = offset == GPIO_DIN_OFFSET ? device->din : device->isr;
+	uint32_t count = offset == GPIO_DIN_OFFSET ? device->din_count : device->isr_count;
+	uint32_t* next = offset == GPIO_DIN_OFFSET ? &device->din_next : &device->isr_next;
+	uint32_t* reg = &device->regs[offset/4];
+
+	if(*next == count){
+		if(count)
+			stats.exhausted++;
+		return *reg;
+	}
+	if(mode == GPIO_REPLAY_FAST && inputs[*next].time > clock_ns)
+		clock_ns = inputs[*next].time;
+	*reg = offset == GPIO_DIN_OFFSET ? inputs[*next].value : *reg | inputs[*next].value;
+	(*next)++;
+	return *reg;
+}
+
+static uint32_t backend_read(void* ctx, uint32_t* base, int offset)
+{
+	struct replay_device* device = replay_lookup(base);
+
+	assert(offset >= 0 && offset/4 < REPLAY_REGS);
+	stats.reads++;
+	if(offset == GPIO_DIN_OFFSET || offset == GPIO_ISR_OFFSET)
+		return replay_input_read(device, offset);
+	return device->regs[offset/4];
+}
+
+static void backend_write(void* ctx, uint32_t* base, int offset, uint32_t mask)
+{
+	struct replay_device* device = replay_lookup(base);
+
+	assert(offset >= 0 && offset/4 < REPLAY_REGS);
+	stats.writes++;
+	// ICL non conserva il valore scritto: si legge sempre 0
+	if(offset == GPIO_ICL_OFFSET)
+		device->regs[GPIO_ISR_OFFSET/4] &= ~mask;
+	else
+		device->regs[offset/4] = mask;
+}
+/** @} */
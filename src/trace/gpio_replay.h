@@ -0,0 +1,165 @@
+/**
+* @file gpio_replay.h
+* @brief Riproduzione delle tracce degli accessi ai registri come backend di gpio_ll.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup TRACE
+* @{
+*
+* @details Il motore carica una traccia (gpio_trace.h), registrata da gpio_ll con
+* 	GPIO_LL_TRACE oppure dal modulo kernel con il parametro reg_trace_entries, e si
+* 	installa come backend di gpio_ll: il driver da provare gira senza modifiche e vede
+* 	gli ingressi del traffico registrato, mentre i suoi accessi sono indipendenti da
+* 	quelli della registrazione.
+*
+* 	Dalla traccia sono presi solo gli ingressi, cioè i valori letti da DIN e da ISR, e
+* 	gli ingressi nel gestore di interruzione. Gli altri registri sono copie locali delle
+* 	scritture del driver; una scrittura in ICL cancella i bit corrispondenti di ISR e
+* 	ICL, come nella periferica, si legge 0.
+*
+* 	- GPIO_REPLAY_FAST: nessuna attesa. La k-esima lettura di DIN (o di ISR) di una
+* 	  periferica restituisce il valore della k-esima lettura registrata; per ISR il valore
+* 	  registrato si aggiunge ai bit non ancora cancellati. Il tempo virtuale avanza al
+* 	  record consumato, così che la riproduzione è deterministica.
+* 	- GPIO_REPLAY_TIMED: il tempo è quello reale dall'inizio della riproduzione e
+* 	  gpio_replay_wait attende l'istante registrato di ogni interruzione. Le letture
+* 	  consumano gli ingressi nell'ordine registrato, come in GPIO_REPLAY_FAST: il
+* 	  tempo reale scandisce solo le interruzioni e il risultato non dipende dalla
+* 	  durata dei gestori.
+*
+* 	Le periferiche sono individuate dai record GPIO_TRACE_DEVICE (32 bit bassi
+* 	dell'indirizzo base). Le tracce del modulo kernel non li contengono: l'indirizzo
+* 	usato dal driver va associato con gpio_replay_map. Gli accessi ad indirizzi non
+* 	presenti nella traccia (ad esempio i LED pilotati dal gestore) sono serviti dalle
+* 	sole copie locali dei registri.
+*
+* 		make
+* 		./replaybench switch.trc fast 10
+*/
+#ifndef GPIO_REPLAY_H_
+#define GPIO_REPLAY_H_
+
+/***************************** Include Files ********************************/
+#include <stdint.h>
+
+#include "gpio_trace.h"
+
+/************************** Constant Definitions *****************************/
+#define GPIO_REPLAY_DEVICES   16      ///< Periferiche gestite, comprese quelle assenti dalla traccia
+
+/**
+* @brief Modalità di riproduzione.
+*/
+enum gpio_replay_mode {
+	GPIO_REPLAY_FAST,     ///< Tempo virtuale, ingressi consumati nell'ordine registrato
+	GPIO_REPLAY_TIMED     ///< Tempo reale, interruzioni agli istanti registrati e ingressi nell'ordine registrato
+};
+
+/**************************** Type Definitions ******************************/
+/**
+* @brief Gestore di interruzione di una periferica della traccia.
+*/
+typedef void (*gpio_replay_handler)(void* ctx);
+
+/**
+* @brief Descrizione di una periferica della traccia.
+*/
+typedef struct {
+	uint32_t* base_address;   ///< Indirizzo associato, NULL se la traccia non lo riporta
+	uint32_t irqs;            ///< Ingressi nel gestore registrati
+	uint32_t din_reads;       ///< Letture di DIN registrate
+	uint32_t isr_reads;       ///< Letture di ISR registrate
+} gpio_replay_device_info;
+
+/**
+* @brief Statistiche della riproduzione.
+*/
+typedef struct {
+	uint64_t reads;           ///< Letture servite
+	uint64_t writes;          ///< Scritture servite
+	uint64_t irqs;            ///< Gestori eseguiti
+	uint64_t irqs_skipped;    ///< Interruzioni di periferiche senza gestore
+	uint64_t exhausted;       ///< Letture di DIN/ISR oltre quelle registrate
+	uint64_t late_max_ns;     ///< Ritardo massimo di un gestore sull'istante registrato (GPIO_REPLAY_TIMED)
+	uint64_t late_sum_ns;     ///< Somma dei ritardi (GPIO_REPLAY_TIMED)
+	uint64_t time_ns;         ///< Tempo della riproduzione, dal primo record
+} gpio_replay_stats;
+
+/************************** Function Prototypes *****************************/
+/**
+* @brief Carica una traccia.
+*
+* @param path è il file della traccia.
+*
+* @return 0 in caso di successo, -1 altrimenti (errno è EINVAL se il file non è una traccia valida,
+* 	ENOMEM se manca la memoria per i vettori della traccia).
+*/
+int gpio_replay_load(const char* path);
+
+/**
+* @brief Libera la traccia caricata.
+*/
+void gpio_replay_unload(void);
+
+/**
+* @brief Restituisce il numero di periferiche presenti nella traccia.
+*/
+unsigned int gpio_replay_devices(void);
+
+/**
+* @brief Descrive una periferica della traccia.
+*
+* @return 0 in caso di successo, -1 se device non è nella traccia.
+*/
+int gpio_replay_device(unsigned int device, gpio_replay_device_info* info);
+
+/**
+* @brief Associa l'indirizzo base usato dal driver ad una periferica della traccia.
+*/
+void gpio_replay_map(unsigned int device, uint32_t* base_address);
+
+/**
+* @brief Imposta il gestore di interruzione di una periferica della traccia.
+*/
+void gpio_replay_set_handler(unsigned int device, gpio_replay_handler handler, void* ctx);
+
+/**
+* @brief Riporta la riproduzione all'inizio nella modalità indicata, azzerando registri e statistiche.
+*/
+void gpio_replay_start(enum gpio_replay_mode mode);
+
+/**
+* @brief Attende la prossima interruzione registrata ed esegue il gestore della periferica.
+*
+* @return 1 se è stata consegnata un'interruzione, 0 a traccia terminata.
+*/
+int gpio_replay_wait(void);
+
+/**
+* @brief Restituisce le statistiche della riproduzione corrente.
+*/
+void gpio_replay_get_stats(gpio_replay_stats* stats);
+
+/**
+* @brief Instrada gli accessi di gpio_read_mask e gpio_write_mask verso il motore.
+*/
+void gpio_replay_install(void);
+
+/**
+* @brief Ripristina l'accesso diretto in gpio_ll.
+*/
+void gpio_replay_remove(void);
+
+#endif /* GPIO_REPLAY_H_ */
+/** @} */
@@ -0,0 +1,211 @@
+/**
+* @file gpiotrace.c
+* @brief Stampa il contenuto ed il riassunto di una traccia degli accessi ai registri.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup TRACE
+* @{
+*/
+/***************************** Include Files ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "gpio_trace.h"
+
+/************************** Constant Definitions *****************************/
+#define TRACE_DEVICES   256     ///< Valori possibili del campo device
+#define TRACE_REGS      6
+
+/**************************** Type Definitions ******************************/
+/**
+* @brief Contatori di una periferica.
+*/
+struct device_summary {
+	int seen;
+	int recorded;
+	uint32_t base;
+	uint64_t reads[TRACE_REGS];
+	uint64_t writes[TRACE_REGS];
+	uint64_t irqs;
+	uint64_t last_irq;
+	uint64_t interval_min, interval_max, interval_sum;
+};
+
+/************************** Variable Definitions *****************************/
+static const char* reg_names[TRACE_REGS] = { "DOUT", "TRI", "DIN", "IER", "ICL", "ISR" };
+static struct device_summary devices[TRACE_DEVICES];
+
+/************************** Function Prototypes *****************************/
+static void dump(uint64_t time, const gpio_trace_record* r);
+static void account(uint64_t time, const gpio_trace_record* r);
+static void summary(const gpio_trace_header* header, uint64_t duration);
+
+/**
+* @details Legge una traccia prodotta da gpio_ll (GPIO_LL_TRACE), da boardsim oppure dal
+* 	file reg_trace del modulo kernel e ne stampa il riassunto per periferica; con -d
+* 	stampa anche ogni record con il tempo ricostruito.
+*
+* 	Es: ./gpiotrace -d /sys/kernel/debug/gpiodrv/gpio0/reg_trace
+*/
+int main(int argc, char *argv[])
+{
+	gpio_trace_header header;
+	gpio_trace_record r;
+	uint64_t time = 0, first = 0;
+	const char* path;
+	int verbose = 0;
+	uint32_t i;
+	FILE* file;
+
+	if(argc > 1 && strcmp(argv[1], "-d") == 0){
+		verbose = 1;
+		argc--;
+		argv++;
+	}
+	if(argc < 2){
+		fprintf(stderr, "Uso: %s [-d] traccia\n", argv[0]);
+		return 1;
+	}
+	path = argv[1];
+
+	file = fopen(path, "rb");
+	if(file == NULL){
+		perror(path);
+		return 1;
+	}
+	if(fread(&header, sizeof(header), 1, file) != 1 || header.magic != GPIO_TRACE_MAGIC ||
+		header.version != GPIO_TRACE_VERSION || header.record_size != sizeof(gpio_trace_record)){
+		fprintf(stderr, "%s: non è una traccia valida\n", path);
+		fclose(file);
+		return 1;
+	}
+
+	for(i = 0; i < header.records; i++){
+		if(fread(&r, sizeof(r), 1, file) != 1){
+			fprintf(stderr, "%s: traccia troncata al record %" PRIu32 "\n", path, i);
+			header.records = i;
+			break;
+		}
+		if(r.type == GPIO_TRACE_TIME)
+			time = ((uint64_t)r.value << 32) | r.time;
+		else
+			time = time + (int32_t)(r.time - (uint32_t)time);
+		if(i == 0)
+			first = time;
+
+		if(verbose)
+			dump(time, &r);
+		account(time, &r);
+	}
+	fclose(file);
+
+	summary(&header, header.records ? time - first : 0);
+	return 0;
+}
+
+/**
+* @brief Stampa un record.
+*/
+static void dump(uint64_t time, const gpio_trace_record* r)
+{
+	const char* reg = r->offset / 4 < TRACE_REGS && r->offset % 4 == 0 ? reg_names[r->offset / 4] : "?";
+
+	printf("%14.3f us  dev %3u  ", time / 1e3, r->device);
+	switch(r->type){
+		case GPIO_TRACE_READ:   printf("R %-4s  0x%08" PRIx32 "\n", reg, r->value); break;
+		case GPIO_TRACE_WRITE:  printf("W %-4s  0x%08" PRIx32 "\n", reg, r->value); break;
+		case GPIO_TRACE_IRQ:    printf("IRQ\n"); break;
+		case GPIO_TRACE_TIME:   printf("TIME\n"); break;
+		case GPIO_TRACE_DEVICE: printf("DEVICE  0x%08" PRIx32 "\n", r->value); break;
+		default:                printf("tipo %u sconosciuto\n", r->type); break;
+	}
+}
+
+/**
+* @brief Aggiorna i contatori della periferica del record.
+*/
+static void account(uint64_t time, const gpio_trace_record* r)
+{
+	struct device_summary* d = &devices[r->device];
+	uint64_t interval;
+
+	if(r->type == GPIO_TRACE_TIME)
+		return;
+	d->seen = 1;
+
+	switch(r->type){
+		case GPIO_TRACE_READ:
+			if(r->offset / 4 < TRACE_REGS)
+				d->reads[r->offset / 4]++;
+			break;
+		case GPIO_TRACE_WRITE:
+			if(r->offset / 4 < TRACE_REGS)
+				d->writes[r->offset / 4]++;
+			break;
+		case GPIO_TRACE_IRQ:
+			if(d->irqs){
+				interval = time - d->last_irq;
+				d->interval_sum += interval;
+				if(d->irqs == 1 || interval < d->interval_min)
+					d->interval_min = interval;
+				if(interval > d->interval_max)
+					d->interval_max = interval;
+			}
+			d->irqs++;
+			d->last_irq = time;
+			break;
+		case GPIO_TRACE_DEVICE:
+			d->recorded = 1;
+			d->base = r->value;
+			break;
+	}
+}
+
+/**
+* @brief Stampa il riassunto della traccia.
+*/
+static void summary(const gpio_trace_header* header, uint64_t duration)
+{
+	int d, reg;
+
+	printf("Record: %" PRIu32 ", persi: %" PRIu32 ", durata: %.3f ms\n", header->records, header->dropped, duration / 1e6);
+	for(d = 0; d < TRACE_DEVICES; d++){
+		struct device_summary* s = &devices[d];
+
+		if(!s->seen)
+			continue;
+		if(s->recorded)
+			printf("Periferica %d (0x%08" PRIx32 ")\n", d, s->base);
+		else
+			printf("Periferica %d\n", d);
+
+		printf("  %-9s", "");
+		for(reg = 0; reg < TRACE_REGS; reg++)
+			printf(" %10s", reg_names[reg]);
+		printf("\n  %-9s", "letture");
+		for(reg = 0; reg < TRACE_REGS; reg++)
+			printf(" %10" PRIu64, s->reads[reg]);
+		printf("\n  %-9s", "scritture");
+		for(reg = 0; reg < TRACE_REGS; reg++)
+			printf(" %10" PRIu64, s->writes[reg]);
+		printf("\n  irq: %" PRIu64, s->irqs);
+		if(s->irqs > 1)
+			printf(", intervallo min/med/max: %.3f/%.3f/%.3f us", s->interval_min / 1e3,
+				(double)s->interval_sum / (s->irqs - 1) / 1e3, s->interval_max / 1e3);
+		printf("\n");
+	}
+}
+/** @} */
@@ -0,0 +1,175 @@
+/**
+* @file replaybench.c
+* @brief Misura dei gestori di interruzione del driver su traffico registrato.
+* @author: Antonio Riccio
+* @copyright
+* Copyright 2017 Antonio Riccio <antonio.riccio.27@gmail.com>, <antonio.riccio9@studenti.unina.it>.
+* This program is free software; you can redistribute it and/or modify it under the terms of the
+* GNU General Public License as published by the
+* Free Software Foundation; either version 3 of the License, or any later version.
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+* without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* @addtogroup TRACE
+* @{
+*/
+/***************************** Include Files ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "gpio_replay.h"
+#include "gpio.h"
+#include "config.h"
+
+/************************** Constant Definitions *****************************/
+#define ALL_PINS   (GPIO_PIN_0|GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3)
+
+/************************** Variable Definitions *****************************/
+static myGpio_t gpio_led;
+static myGpio_t gpio_inputs[GPIO_REPLAY_DEVICES];
+static uint32_t fake_regs[GPIO_REPLAY_DEVICES][8];   ///< Indirizzi per le periferiche senza indirizzo registrato
+static uint32_t led_data;
+static uint64_t handler_min, handler_max, handler_sum, handler_runs;
+
+/************************** Function Prototypes *****************************/
+static void timed_IRQHandler(void* ctx);
+static void gpio_IRQHandler(myGpio_t* gpio);
+static uint64_t now_ns(void);
+
+/**
+* @details Riproduce una traccia sul driver gpio.c: ogni periferica della traccia con
+* 	interruzioni è servita dal gestore di main.c (lettura di ISR e DIN, somma sui LED,
+* 	cancellazione di ISR) e di ogni esecuzione del gestore è misurata la durata.
+* 	La riproduzione è ripetuta repeat volte; in entrambe le modalità il valore finale
+* 	dei LED deve essere lo stesso ad ogni ripetizione.
+*
+* 	Le tracce del modulo kernel non riportano l'indirizzo delle periferiche: alla
+* 	periferica viene associato un indirizzo fittizio.
+*
+* 	Es: ./replaybench switch.trc fast 10
+*/
+int main(int argc, char *argv[])
+{
+	enum gpio_replay_mode mode = GPIO_REPLAY_FAST;
+	unsigned int devices, d, run, repeat;
+	gpio_replay_device_info info;
+	gpio_replay_stats stats;
+	myGpio_config gpio_config;
+	uint64_t start, wall;
+
+	if(argc < 2){
+		fprintf(stderr, "Uso: %s traccia [fast|timed] [ripetizioni]\n", argv[0]);
+		return 1;
+	}
+	if(argc > 2 && strcmp(argv[2], "timed") == 0)
+		mode = GPIO_REPLAY_TIMED;
+	repeat = argc > 3 ? atoi(argv[3]) : 1;
+
+	if(gpio_replay_load(argv[1]) < 0){
+		perror(argv[1]);
+		return 1;
+	}
+
+	devices = gpio_replay_devices();
+	for(d = 0; d < devices; d++){
+		gpio_replay_device(d, &info);
+		if(info.base_address == NULL){
+			info.base_address = fake_regs[d];
+			gpio_replay_map(d, info.base_address);
+		}
+		gpio_inputs[d].base_address = info.base_address;
+		if(info.irqs)
+			gpio_replay_set_handler(d, timed_IRQHandler, &gpio_inputs[d]);
+		printf("Periferica %u: %" PRIu32 " irq, %" PRIu32 " letture di DIN, %" PRIu32 " letture di ISR\n",
+			d, info.irqs, info.din_reads, info.isr_reads);
+	}
+	gpio_replay_install();
+
+	for(run = 0; run < repeat; run++){
+		gpio_replay_start(mode);
+		led_data = 0;
+		handler_min = UINT64_MAX;
+		handler_max = handler_sum = handler_runs = 0;
+
+		gpio_config.interrupt_config = INT_DISABLED;
+		gpio_config.base_address = (uint32_t*)GPIO_LED_BASEADDR;
+		myGpio_init(&gpio_led, &gpio_config);
+		myGpio_setDataDirection(&gpio_led, ALL_PINS, GPIO_WRITE);
+		for(d = 0; d < devices; d++){
+			gpio_replay_device(d, &info);
+			if(!info.irqs)
+				continue;
+			gpio_config.interrupt_config = INT_ENABLED;
+			gpio_config.base_address = gpio_inputs[d].base_address;
+			myGpio_init(&gpio_inputs[d], &gpio_config);
+			myGpio_setDataDirection(&gpio_inputs[d], ALL_PINS, GPIO_READ);
+			myGpio_interruptEnable(&gpio_inputs[d], ALL_PINS);
+			myGpio_interruptClear(&gpio_inputs[d], ALL_PINS);
+		}
+
+		start = now_ns();
+		while(gpio_replay_wait());
+		wall = now_ns() - start;
+		gpio_replay_get_stats(&stats);
+
+		printf("[%u] gestori: %" PRIu64 " (saltati %" PRIu64 "), durata min/med/max: %" PRIu64 "/%.0f/%" PRIu64 " ns, LED: 0x%x\n",
+			run, stats.irqs, stats.irqs_skipped, handler_runs ? handler_min : 0,
+			handler_runs ? (double)handler_sum / handler_runs : 0.0, handler_max, led_data & ALL_PINS);
+		printf("    letture: %" PRIu64 ", scritture: %" PRIu64 ", letture oltre la traccia: %" PRIu64
+			", traccia %.3f ms in %.3f ms\n", stats.reads, stats.writes, stats.exhausted, stats.time_ns / 1e6, wall / 1e6);
+		if(mode == GPIO_REPLAY_TIMED && stats.irqs)
+			printf("    ritardo sull'istante registrato med/max: %.0f/%" PRIu64 " ns\n",
+				(double)stats.late_sum_ns / stats.irqs, stats.late_max_ns);
+	}
+
+	gpio_replay_remove();
+	gpio_replay_unload();
+	return 0;
+}
+
+/**
+* @brief Esegue il gestore misurandone la durata.
+*/
+static void timed_IRQHandler(void* ctx)
+{
+	uint64_t start = now_ns(), elapsed;
+
+	gpio_IRQHandler((myGpio_t*)ctx);
+	elapsed = now_ns() - start;
+
+	handler_sum += elapsed;
+	handler_runs++;
+	if(elapsed < handler_min)
+		handler_min = elapsed;
+	if(elapsed > handler_max)
+		handler_max = elapsed;
+}
+
+/**
+* @brief Gestore della periferica, come gpio_IRQHandler di main.c.
+*/
+static void gpio_IRQHandler(myGpio_t* gpio)
+{
+	uint32_t pending_int = myGpio_interruptGetStatus(gpio);
+	uint32_t data = myGpio_read_value(gpio);
+
+	led_data = led_data + data;
+	myGpio_write_value(&gpio_led, led_data);
+	myGpio_interruptClear(gpio, pending_int);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+/** @} */